@@ -32,7 +32,7 @@ const getIO = () => {
 // Throttle updates per device to max 1 per second
 const lastBroadcast = {};
 
-const broadcastDeviceUpdate = (deviceId, data) => {
+const broadcastDeviceUpdate = (deviceId, data, force = false) => {
     if (io) {
         const now = Date.now();
         const last = lastBroadcast[deviceId] || 0;
@@ -43,7 +43,7 @@ const broadcastDeviceUpdate = (deviceId, data) => {
         // unless it's a critical state change if we could detect it.
         // For now, strict 500ms throttle is safer for frontend performance.
 
-        if (now - last > 100) {
+        if (force || now - last > 100) {
             io.emit("device_update", { deviceId, data });
             lastBroadcast[deviceId] = now;
         }
@@ -1,8 +1,51 @@
 const mqtt = require('mqtt');
 const db = require('../db');
 const { broadcastDeviceUpdate } = require('../gateway');
+const { decodeStatus, decodeSpoolBatch, decodeBatch, decodeHistory, decodePeerBatch } = require('./status.codec');
 require('dotenv').config();
 
+// One readings row per sample of a time-series batch frame
+const storeBatch = async (deviceId, message, receivedAt) => {
+    const samples = decodeBatch(message, receivedAt);
+    for (const s of samples) {
+        await db.query(
+            "INSERT INTO readings (device_id, data, created_at) VALUES ($1, $2, $3)",
+            [deviceId, { device_id: deviceId, sensors: s.sensors, moisture: s.moisture, temp: s.temp, humidity: s.humidity, batched: true }, s.time]
+        );
+    }
+    return samples;
+};
+
+// One spooled record, stored with its original time; false if it was skipped
+const replayRecord = async (deviceId, type, payload, createdAt) => {
+    if (type === 'status') {
+        let data;
+        try {
+            data = decodeStatus(deviceId, payload);
+        } catch (e) {
+            return false;
+        }
+        await db.query(
+            "INSERT INTO readings (device_id, data, created_at) VALUES ($1, $2, $3)",
+            [deviceId, { ...data, replayed: true }, createdAt]
+        );
+    } else if (type === 'batch') {
+        try {
+            await storeBatch(deviceId, payload, createdAt.getTime());
+        } catch (e) {
+            return false;
+        }
+    } else if (type === 'alert') {
+        await db.query(
+            "INSERT INTO system_logs (device_id, type, message, created_at) VALUES ($1, 'warning', $2, $3)",
+            [deviceId, payload.toString(), createdAt]
+        );
+    } else {
+        return false;
+    }
+    return true;
+};
+
 const initMqtt = () => {
     const client = mqtt.connect(process.env.MQTT_BROKER);
 
@@ -10,9 +53,17 @@ const initMqtt = () => {
         console.log('Connected to MQTT Broker');
         client.subscribe('plantcare/+/status');
         client.subscribe('plantcare/+/online');
+        client.subscribe('plantcare/+/config');
+        client.subscribe('plantcare/+/spool');
+        client.subscribe('plantcare/+/batch');
+        client.subscribe('plantcare/+/ack');
+        client.subscribe('plantcare/+/metrics');
+        client.subscribe('plantcare/+/history');
+        client.subscribe('plantcare/+/dose');
+        client.subscribe('plantcare/+/peers');
     });
 
-    client.on('message', async (topic, message) => {
+    const handleMessage = async (topic, message) => {
         try {
             // topic: plantcare/DEVICE_ID/TYPE
             const parts = topic.split('/');
@@ -30,9 +81,10 @@ const initMqtt = () => {
 
                 let data;
                 try {
-                    data = JSON.parse(payloadStr);
+                    // JSON or binary, told apart by the first byte (see status.codec.js)
+                    data = decodeStatus(deviceId, message);
                 } catch (e) {
-                    console.warn(`[MQTT] Received non-JSON on status topic ${topic}: ${payloadStr}`);
+                    console.warn(`[MQTT] Received undecodable status on topic ${topic}: ${e.message}`);
                     return;
                 }
 
@@ -76,6 +128,138 @@ const initMqtt = () => {
                     );
                 }
 
+            } else if (type === 'config') {
+                // Retained stable settings (threshold, windows, calibration, telemetry).
+                // Report-by-exception statuses omit these, so merge them into the device config.
+                let cfg;
+                try {
+                    cfg = JSON.parse(payloadStr);
+                } catch (e) {
+                    console.warn(`[MQTT] Received non-JSON on config topic ${topic}: ${payloadStr}`);
+                    return;
+                }
+
+                await db.query(`
+          INSERT INTO devices (device_id, name, last_seen, config)
+          VALUES ($1, $1, NOW(), $2)
+          ON CONFLICT (device_id)
+          DO UPDATE SET config = devices.config || EXCLUDED.config;
+        `, [deviceId, cfg]);
+
+                // Config changes are rare and must not be swallowed by the status throttle
+                broadcastDeviceUpdate(deviceId, cfg, true);
+
+            } else if (type === 'ack') {
+                // Result of a BATCH:<id>;... settings transaction, matched by id on the dashboard
+                let ack;
+                try {
+                    ack = JSON.parse(payloadStr);
+                } catch (e) {
+                    console.warn(`[MQTT] Received non-JSON ack on topic ${topic}: ${payloadStr}`);
+                    return;
+                }
+                broadcastDeviceUpdate(deviceId, { ack }, true);
+
+            } else if (type === 'metrics') {
+                // Device-side measurements (e.g. battery-mode wake time and average current)
+                let metrics;
+                try {
+                    metrics = JSON.parse(payloadStr);
+                } catch (e) {
+                    console.warn(`[MQTT] Received non-JSON metrics on topic ${topic}: ${payloadStr}`);
+                    return;
+                }
+                broadcastDeviceUpdate(deviceId, { metrics }, true);
+
+            } else if (type === 'history') {
+                // One page of on-device rollups, requested with HISTORY:<tier>:<page> to backfill charts
+                let history;
+                try {
+                    history = decodeHistory(message);
+                } catch (e) {
+                    console.warn(`[MQTT] Received undecodable history page on topic ${topic}: ${e.message}`);
+                    return;
+                }
+                broadcastDeviceUpdate(deviceId, { history }, true);
+
+            } else if (type === 'dose') {
+                // One pump run: on-time, delivered ml (null without a flow meter) and why it stopped
+                let dose;
+                try {
+                    dose = JSON.parse(payloadStr);
+                } catch (e) {
+                    console.warn(`[MQTT] Received non-JSON dose on topic ${topic}: ${payloadStr}`);
+                    return;
+                }
+                broadcastDeviceUpdate(deviceId, { dose }, true);
+
+            } else if (type === 'batch') {
+                let samples;
+                try {
+                    samples = await storeBatch(deviceId, message, Date.now());
+                } catch (e) {
+                    console.warn(`[MQTT] Received undecodable batch on topic ${topic}: ${e.message}`);
+                    return;
+                }
+
+                // Latest sample drives the live view, like a status would
+                const last = samples[samples.length - 1];
+                if (last) {
+                    await db.query(
+                        "UPDATE devices SET is_online = true, last_seen = NOW() WHERE device_id = $1",
+                        [deviceId]
+                    );
+                    broadcastDeviceUpdate(deviceId, {
+                        sensors: last.sensors, moisture: last.moisture, temp: last.temp, humidity: last.humidity, online: true
+                    });
+                }
+
+            } else if (type === 'spool') {
+                // Telemetry buffered on the device while offline, replayed in batches.
+                // Stored with its original time; not broadcast, the live status follows separately.
+                let records;
+                try {
+                    records = decodeSpoolBatch(message);
+                } catch (e) {
+                    console.warn(`[MQTT] Received undecodable spool batch on topic ${topic}: ${e.message}`);
+                    return;
+                }
+
+                for (const rec of records) {
+                    const createdAt = rec.timestamp > 0 ? new Date(rec.timestamp * 1000) : new Date();
+                    if (rec.type === 'peers') {
+                        // A gateway's uplink batch, spooled while its broker was away
+                        let relayed;
+                        try {
+                            relayed = decodePeerBatch(rec.payload);
+                        } catch (e) {
+                            continue;
+                        }
+                        for (const r of relayed) {
+                            const [, leafId, leafType] = r.topic.split('/');
+                            await replayRecord(leafId, leafType, r.payload, createdAt);
+                        }
+                    } else {
+                        await replayRecord(deviceId, rec.type, rec.payload, createdAt);
+                    }
+                }
+                console.log(`[${deviceId}] Replayed ${records.length} spooled records`);
+
+            } else if (type === 'peers') {
+                // Leaves relayed by a gateway node (firmware/src/PeerGateway.h): each
+                // record is handled as if the leaf had published it itself
+                let records;
+                try {
+                    records = decodePeerBatch(message);
+                } catch (e) {
+                    console.warn(`[MQTT] Received undecodable peer batch on topic ${topic}: ${e.message}`);
+                    return;
+                }
+                for (const rec of records) {
+                    if (rec.topic.split('/')[2] === 'peers') continue;
+                    await handleMessage(rec.topic, rec.payload);
+                }
+
             } else if (type === 'online') {
                 const isOnline = payloadStr.toLowerCase() === 'true';
 
@@ -105,7 +289,9 @@ const initMqtt = () => {
         } catch (err) {
             console.error(`Error processing MQTT message on [${topic}]:`, err);
         }
-    });
+    };
+
+    client.on('message', handleMessage);
 
     return client;
 };
@@ -0,0 +1,196 @@
+// Decoder for the firmware's binary status payloads (see firmware/src/StatusEncoder.h).
+// JSON payloads start with '{'; binary ones start with a format version byte.
+
+const STATUS_FORMAT_BINARY_V1 = 0x01;
+
+// Minimal MessagePack reader: only the types the firmware emits
+const readMsgPack = (buf, offset) => {
+    const type = buf[offset];
+    if (type <= 0x7f) return [type, offset + 1];
+    if (type >= 0xe0) return [type - 0x100, offset + 1];
+    if ((type & 0xf0) === 0x90) return readArray(buf, offset + 1, type & 0x0f);
+    if ((type & 0xe0) === 0xa0) return readStr(buf, offset + 1, type & 0x1f);
+    switch (type) {
+        case 0xc0: return [null, offset + 1];
+        case 0xc2: return [false, offset + 1];
+        case 0xc3: return [true, offset + 1];
+        case 0xcc: return [buf.readUInt8(offset + 1), offset + 2];
+        case 0xcd: return [buf.readUInt16BE(offset + 1), offset + 3];
+        case 0xce: return [buf.readUInt32BE(offset + 1), offset + 5];
+        case 0xd0: return [buf.readInt8(offset + 1), offset + 2];
+        case 0xd1: return [buf.readInt16BE(offset + 1), offset + 3];
+        case 0xd2: return [buf.readInt32BE(offset + 1), offset + 5];
+        case 0xd9: return readStr(buf, offset + 2, buf.readUInt8(offset + 1));
+        case 0xda: return readStr(buf, offset + 3, buf.readUInt16BE(offset + 1));
+        case 0xdc: return readArray(buf, offset + 3, buf.readUInt16BE(offset + 1));
+        case 0xc4: {
+            const len = buf.readUInt8(offset + 1);
+            return [buf.subarray(offset + 2, offset + 2 + len), offset + 2 + len];
+        }
+        case 0xc5: {
+            const len = buf.readUInt16BE(offset + 1);
+            return [buf.subarray(offset + 3, offset + 3 + len), offset + 3 + len];
+        }
+        default:
+            throw new Error(`Unsupported MessagePack type 0x${type.toString(16)}`);
+    }
+};
+
+const readArray = (buf, offset, count) => {
+    const items = [];
+    for (let i = 0; i < count; i++) {
+        const [value, next] = readMsgPack(buf, offset);
+        items.push(value);
+        offset = next;
+    }
+    return [items, offset];
+};
+
+const readStr = (buf, offset, len) => [buf.toString('utf8', offset, offset + len), offset + len];
+
+const tenths = (v) => (v === null ? null : v / 10);
+
+// Rebuild the same object shape the JSON status uses, so DB rows and the frontend are unchanged
+const decodeStatusV1 = (deviceId, buf) => {
+    const [f] = readMsgPack(buf, 1);
+    const [state, moisture, pct, adc, pins, air, water, temp, humidity, dhtAge, threshold, windows, mode, rssi,
+        forecastHours, rates] = f;
+
+    const data = {
+        device_id: deviceId,
+        state,
+        moisture: moisture / 10,
+        sensors: pct,
+        sensor_details: pct.map((p, i) => ({
+            pin: pins[i], adc: adc[i], pct: p, air_cal: air[i], water_cal: water[i]
+        })),
+        calibration: pct.map((_, i) => ({ index: i, air: air[i], water: water[i] })),
+        temp: tenths(temp),
+        humidity: tenths(humidity),
+        threshold,
+        windows: { m_start: windows[0], m_end: windows[1], a_start: windows[2], a_end: windows[3] },
+        mode,
+        rssi,
+        format: 'msgpack-v1'
+    };
+    if (dhtAge !== null) data.dht_age = dhtAge;
+    // Fields 14-15 were added later; older firmware leaves them out
+    if (rates !== undefined) {
+        data.forecast = { hours: tenths(forecastHours), rate: rates.map((r) => r / 100) };
+    }
+    return data;
+};
+
+// Returns the status object, or throws if the payload is neither JSON nor a known binary version
+const decodeStatus = (deviceId, message) => {
+    if (message.length > 0 && message[0] === STATUS_FORMAT_BINARY_V1) {
+        return decodeStatusV1(deviceId, message);
+    }
+    return JSON.parse(message.toString());
+};
+
+// Store-and-forward replay (see firmware/src/TelemetrySpool.h): version byte,
+// then [[timestamp, topicSuffix, payload], ...]. Timestamp 0 means unknown.
+const SPOOL_FRAME_V1 = 0x01;
+
+const decodeSpoolBatch = (message) => {
+    if (message.length === 0 || message[0] !== SPOOL_FRAME_V1) {
+        throw new Error(`Unknown spool frame version ${message[0]}`);
+    }
+    const [records] = readMsgPack(message, 1);
+    return records.map(([timestamp, type, payload]) => ({ timestamp, type, payload }));
+};
+
+// Time-series batch (see firmware/src/SampleBatcher.h): version byte, then
+// [ageMs, dt[], moisture[channel][], temp[], humidity[]], all series delta-encoded.
+// `receivedAt` (ms) anchors the last sample; earlier ones are walked back by dt.
+const BATCH_FRAME_V1 = 0x01;
+
+const undelta = (series) => {
+    let prev = null;
+    return series.map((v) => {
+        if (v === null) return null;
+        prev = prev === null ? v : prev + v;
+        return prev;
+    });
+};
+
+const decodeBatch = (message, receivedAt) => {
+    if (message.length === 0 || message[0] !== BATCH_FRAME_V1) {
+        throw new Error(`Unknown batch frame version ${message[0]}`);
+    }
+    const [[ageMs, dt, moisture, temp, humidity]] = readMsgPack(message, 1);
+    const channels = moisture.map(undelta);
+    const temps = undelta(temp);
+    const hums = undelta(humidity);
+
+    const times = new Array(dt.length);
+    let t = receivedAt - ageMs;
+    for (let i = dt.length - 1; i >= 0; i--) {
+        times[i] = t;
+        t -= dt[i] * 100;
+    }
+
+    return dt.map((_, i) => {
+        const sensors = channels.map((c) => c[i]);
+        return {
+            time: new Date(times[i]),
+            sensors,
+            moisture: sensors.reduce((a, b) => a + b, 0) / (sensors.length || 1),
+            temp: tenths(temps[i]),
+            humidity: tenths(hums[i])
+        };
+    });
+};
+
+// History page (see firmware/src/HistoryStore.h): version byte, then
+// [tier, page, pages, period_s, [[time, temp, humidity, min[], max[], avg[]], ...]],
+// newest first. Moisture in 0.5 % steps, temperature x10, humidity x2.
+const HISTORY_FRAME_V1 = 0x01;
+const HISTORY_TIERS = ['minute', 'hour', 'day'];
+
+const decodeHistory = (message) => {
+    if (message.length === 0 || message[0] !== HISTORY_FRAME_V1) {
+        throw new Error(`Unknown history frame version ${message[0]}`);
+    }
+    const [[tier, page, pages, period, entries]] = readMsgPack(message, 1);
+    const halves = (values) => values.map((v) => v / 2);
+    return {
+        tier: HISTORY_TIERS[tier],
+        page,
+        pages,
+        period,
+        entries: entries.map(([time, temp, humidity, min, max, avg]) => ({
+            time: new Date(time * 1000),
+            temp: tenths(temp),
+            humidity: humidity === null ? null : humidity / 2,
+            min: halves(min),
+            max: halves(max),
+            avg: halves(avg)
+        }))
+    };
+};
+
+// Gateway uplink batch (see firmware/src/PeerGateway.h): version byte, record
+// count, then per record [topic length][topic][payload length, uint16 LE][payload]
+const PEER_BATCH_V1 = 0x01;
+
+const decodePeerBatch = (message) => {
+    if (message.length < 2 || message[0] !== PEER_BATCH_V1) {
+        throw new Error(`Unknown peer batch version ${message[0]}`);
+    }
+    const records = [];
+    let offset = 2;
+    for (let i = 0; i < message[1]; i++) {
+        const topicLen = message[offset];
+        const topic = message.toString('utf8', offset + 1, offset + 1 + topicLen);
+        offset += 1 + topicLen;
+        const length = message.readUInt16LE(offset);
+        if (offset + 2 + length > message.length) throw new Error('Truncated peer batch');
+        records.push({ topic, payload: message.subarray(offset + 2, offset + 2 + length) });
+        offset += 2 + length;
+    }
+    return records;
+};
+
+module.exports = { decodeStatus, decodeSpoolBatch, decodeBatch, decodeHistory, decodePeerBatch, readMsgPack };
@@ -0,0 +1,800 @@
+// Host microbenchmarks for the firmware hot paths.
+//
+//   pio run -e native -t exec                      # all benchmarks
+//   pio run -e native -t exec -a "--filter=status" # only names containing "status"
+//   pio run -e native -t exec -a "--min-time=1000" # run each benchmark for >= 1 s
+//   pio run -e native -t exec -a "--broker=127.0.0.1:1883" # MqttEngine against a local Mosquitto
+//
+// Built with -D NODE_ROLE=1 the device is a gateway, and a "PeerGateway" run
+// emulates leaves on the ESP-NOW stand-in (UDP on 127.0.0.1).
+//
+// Each benchmark reports wall time and heap traffic (malloc count/bytes) per
+// operation. Timing comes from the host CPU, so compare runs on the same
+// machine; allocation counts are exact and portable.
+
+#include <Arduino.h>
+#include <chrono>
+#include "NativeHal.h"
+#include "ConfigManager.h"
+#include "NetworkManager.h"
+#include "SensorManager.h"
+#include "PlantControl.h"
+#include "SampleBatcher.h"
+#include "ExternalAdc.h"
+#include "Scheduler.h"
+#include "PowerManager.h"
+#include "BootProfiler.h"
+#include "MoistureForecast.h"
+#include "DoseController.h"
+#include "HistoryStore.h"
+#include "PerfCounters.h"
+#include "MqttEngine.h"
+#include <LittleFS.h>
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+#include <WiFi.h>
+#include <esp_now.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Defined in src/main.cpp
+void setup();
+void loop();
+void mqttCallback(char* topic, uint8_t* payload, unsigned int length);
+extern NetworkManager networkManager;
+extern SensorManager sensorManager;
+extern PlantControl plantControl;
+extern Scheduler scheduler;
+extern PowerManager powerManager;
+
+namespace {
+
+struct BenchOptions {
+    const char* filter = nullptr;
+    unsigned long minTimeMs = 200;
+    unsigned long minIterations = 5;
+    const char* broker = nullptr; // host:port, runs checkMqttEngine()
+};
+
+BenchOptions options;
+
+uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Fn>
+void runBench(const char* name, Fn fn) {
+    if (options.filter && !strstr(name, options.filter)) return;
+
+    fn(); // warm-up (first-call allocations, caches)
+
+    unsigned long iterations = 0;
+    NativeHal::AllocStats before = NativeHal::getAllocStats();
+    uint64_t start = nowNs();
+    uint64_t elapsed = 0;
+    do {
+        fn();
+        iterations++;
+        elapsed = nowNs() - start;
+    } while (elapsed < options.minTimeMs * 1000000ULL || iterations < options.minIterations);
+    NativeHal::AllocStats after = NativeHal::getAllocStats();
+
+    printf("%-32s %10lu %14.0f %10.1f %12.1f\n",
+           name,
+           iterations,
+           (double)elapsed / iterations,
+           (double)(after.count - before.count) / iterations,
+           (double)(after.bytes - before.bytes) / iterations);
+}
+
+void deliver(const char* payload) {
+    char topic[50];
+    snprintf(topic, sizeof(topic), "plantcare/%s/cmd", DEVICE_ID);
+    mqttCallback(topic, (uint8_t*)payload, strlen(payload));
+    networkManager.flushOutbox(); // hand the queued publishes to the MQTT client
+}
+
+// broadcastStatus() plus the average on-air size (topic + payload) of one status
+void runStatusBench(const char* name) {
+    unsigned long publishes = NativeHal::getPublishCount();
+    unsigned long bytes = NativeHal::getPublishBytes();
+    runBench(name, [] {
+        plantControl.broadcastStatus();
+        networkManager.flushOutbox();
+    });
+    publishes = NativeHal::getPublishCount() - publishes;
+    bytes = NativeHal::getPublishBytes() - bytes;
+    if (publishes > 0) printf("  %lu bytes/publish\n", bytes / publishes);
+}
+
+// Zero-heap steady state. One round makes every armed job due and runs a
+// manual watering cycle through the command path (PUMP_ON, WATERING ->
+// SOAKING -> soak check), alternating between one channel rising (sensor
+// alert, back to IDLE) and none (tank empty, RESET). The first round may
+// allocate (first-use buffers); after it no round may.
+bool checkSteadyStateAllocations() {
+    if (options.filter && !strstr("steady_state_allocs", options.filter)) return true;
+
+    auto round = [](int n) {
+        for (int id = 0; id < scheduler.getJobCount(); id++) scheduler.trigger(id);
+        loop();
+        deliver("PUMP_ON");
+        loop();
+        for (int id = 0; id < scheduler.getJobCount(); id++) scheduler.trigger(id);
+        loop(); // WATERING -> SOAKING
+        if (n % 2) NativeHal::setAnalogValue(SOIL_PINS[0], 1100);
+        for (int id = 0; id < scheduler.getJobCount(); id++) scheduler.trigger(id);
+        loop(); // soak check
+        NativeHal::setAnalogValue(SOIL_PINS[0], 1200);
+        deliver("RESET");
+        loop();
+        // A settings transaction: validate, apply, one NVS commit, status and ack
+        deliver(n % 2 ? "BATCH:steady;SET_THRESHOLD:31;SET_TIME_WINDOW:6:10:16:19;SET_TRIGGER_MODE:1"
+                      : "BATCH:steady;SET_THRESHOLD:30;SET_TIME_WINDOW:6:10:16:19;SET_TRIGGER_MODE:0");
+        loop();
+    };
+
+    round(0);
+    const int rounds = 20;
+    NativeHal::AllocStats before = NativeHal::getAllocStats();
+    for (int n = 1; n <= rounds; n++) round(n);
+    NativeHal::AllocStats after = NativeHal::getAllocStats();
+
+    unsigned long count = after.count - before.count;
+    printf("steady state: %d rounds, %lu allocations (%lu bytes)%s\n", rounds, count,
+           after.bytes - before.bytes, count ? "  FAIL" : "");
+    return count == 0;
+}
+
+// Polls until done() or the timeout; false on timeout
+template <typename Fn>
+bool pollUntil(MqttEngine& a, MqttEngine& b, Fn done, unsigned long timeoutMs) {
+    unsigned long start = millis();
+    while (!done()) {
+        if (millis() - start >= timeoutMs) return false;
+        a.poll();
+        b.poll();
+        delay(1);
+    }
+    return true;
+}
+
+// The MQTT engine against a real broker: persistent session resumption
+// (commands published while the device is away arrive on reconnect) and
+// QoS 1 throughput for several in-flight windows
+bool checkMqttEngine() {
+    static char host[64];
+    snprintf(host, sizeof(host), "%s", options.broker);
+    char* colon = strchr(host, ':');
+    uint16_t port = 1883;
+    if (colon) {
+        *colon = '\0';
+        port = atoi(colon + 1);
+    }
+
+    static MqttEngine device, sender;
+    static int received = 0;
+    static int acked = 0;
+    device.setServer(host, port);
+    device.setClientId("plantcare-bench-device");
+    device.setCleanSession(false);
+    device.setHandlers([](void*, const char*, const uint8_t*, size_t) {
+        received++;
+        return true;
+    }, [](void*, void*, bool delivered) { acked += delivered; }, nullptr);
+    sender.setServer(host, port);
+    sender.setClientId("plantcare-bench-sender");
+    sender.setHandlers(nullptr, [](void*, void*, bool delivered) { acked += delivered; }, nullptr);
+
+    const char* cmdTopic = "plantcare/bench-device/cmd";
+    bool ok = device.connect() && pollUntil(device, sender, [] { return device.connected(); }, 3000);
+    if (!ok) {
+        printf("mqtt engine: no broker at %s:%u\n", host, port);
+        return false;
+    }
+    device.subscribe(cmdTopic, 1);
+    pollUntil(device, sender, [] { return false; }, 200); // SUBACK, and anything left over
+    device.disconnect();
+
+    // Commands while the device is away, then the device comes back
+    const int commands = 3;
+    static const uint8_t command[] = "PUMP_ON";
+    acked = 0;
+    ok = sender.connect() && pollUntil(device, sender, [] { return sender.connected(); }, 3000);
+    for (int i = 0; ok && i < commands; i++) {
+        ok = pollUntil(device, sender, [&] { return sender.publish(cmdTopic, command, 7, 1, false, (void*)command); }, 3000);
+    }
+    ok = ok && pollUntil(device, sender, [] { return acked == commands; }, 3000);
+    received = 0;
+    ok = ok && device.connect() && pollUntil(device, sender, [] { return device.connected(); }, 3000);
+    bool resumed = device.isSessionPresent();
+    ok = ok && pollUntil(device, sender, [] { return received >= commands; }, 3000);
+    printf("mqtt engine: session %s, %d of %d queued commands delivered%s\n", resumed ? "resumed" : "new",
+           received, commands, ok && resumed ? "" : "  FAIL");
+    ok = ok && resumed;
+
+    // Publish throughput, QoS 0 and QoS 1 with growing in-flight windows
+    static uint8_t payload[200];
+    memset(payload, 'x', sizeof(payload));
+    const int messages = 2000;
+    for (int window = 0; ok && window <= MQTT_INFLIGHT_MAX; window = window ? window * 2 : 1) {
+        uint8_t qos = window ? 1 : 0;
+        device.setInflightWindow(window ? window : 1);
+        acked = 0;
+        uint64_t start = nowNs();
+        for (int sent = 0; sent < messages;) {
+            if (device.publish("plantcare/bench-device/load", payload, sizeof(payload), qos, false, payload)) sent++;
+            else if (device.poll() == MQTT_EVENT_DISCONNECTED) break;
+        }
+        ok = pollUntil(device, sender, [&] { return acked == messages; }, 10000);
+        double seconds = (nowNs() - start) / 1e9;
+        printf("mqtt engine: QoS %d window %d  %8.0f msg/s%s\n", qos, window, messages / seconds, ok ? "" : "  FAIL");
+    }
+    MqttEngineStats stats = device.getStats();
+    printf("mqtt engine: %lu published, %lu acked, %lu retransmits, in-flight high water %lu\n",
+           (unsigned long)stats.published, (unsigned long)stats.acked, (unsigned long)stats.retransmits,
+           (unsigned long)stats.inflightHighWater);
+    device.disconnect();
+    sender.disconnect();
+    return ok;
+}
+
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+// A leaf on the ESP-NOW stand-in: its own UDP port, frames as in PeerLink.h
+struct EmulatedLeaf {
+    uint8_t mac[6];
+    int sock;
+    uint8_t seq;
+    char id[16];
+
+    void open(int n) {
+        const uint8_t address[6] = {0x02, 0x4c, 0x45, 0x41, 0x46, (uint8_t)(0x10 + n)};
+        memcpy(mac, address, 6);
+        snprintf(id, sizeof(id), "leaf-%02d", n);
+        seq = 0;
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(ESP_NOW_UDP_BASE_PORT + mac[5]);
+        bind(sock, (sockaddr*)&addr, sizeof(addr));
+        timeval timeout = {0, 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    void send(const char* type, const uint8_t* payload, size_t length) {
+        uint8_t gateway[6];
+        WiFi.macAddress(gateway);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(ESP_NOW_UDP_BASE_PORT + gateway[5]);
+
+        uint8_t message[PEER_MESSAGE_SIZE];
+        int topicLen = snprintf((char*)message + 1, 64, "plantcare/%s/%s", id, type);
+        message[0] = topicLen;
+        memcpy(message + 1 + topicLen, payload, length);
+        size_t total = 1 + topicLen + length;
+        size_t count = (total + PEER_FRAGMENT_SIZE - 1) / PEER_FRAGMENT_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t datagram[6 + PEER_FRAME_SIZE];
+            memcpy(datagram, mac, 6);
+            datagram[6] = PEER_FRAME_UP;
+            datagram[7] = seq;
+            datagram[8] = (uint8_t)(i << 4 | count);
+            size_t n = total - i * PEER_FRAGMENT_SIZE;
+            if (n > PEER_FRAGMENT_SIZE) n = PEER_FRAGMENT_SIZE;
+            memcpy(datagram + 6 + PEER_UP_HEADER, message + i * PEER_FRAGMENT_SIZE, n);
+            sendto(sock, datagram, 6 + PEER_UP_HEADER + n, 0, (sockaddr*)&addr, sizeof(addr));
+        }
+        seq++;
+    }
+
+    // Next frame down: command length (0 = clock sync), -1 = nothing yet
+    int receive(char* command, size_t capacity, uint32_t& epoch) {
+        uint8_t datagram[6 + PEER_FRAME_SIZE];
+        ssize_t n = recv(sock, datagram, sizeof(datagram), 0);
+        if (n < 6 + PEER_DOWN_HEADER || datagram[6] != PEER_FRAME_DOWN) return -1;
+        epoch = datagram[8] | datagram[9] << 8 | datagram[10] << 16 | (uint32_t)datagram[11] << 24;
+        size_t length = n - 6 - PEER_DOWN_HEADER;
+        if (length >= capacity) length = capacity - 1;
+        memcpy(command, datagram + 6 + PEER_DOWN_HEADER, length);
+        command[length] = '\0';
+        return (int)length;
+    }
+};
+#endif
+
+void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--filter=", 9) == 0) {
+            options.filter = argv[i] + 9;
+        } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            options.minTimeMs = strtoul(argv[i] + 11, nullptr, 10);
+        } else if (strncmp(argv[i], "--broker=", 9) == 0) {
+            options.broker = argv[i] + 9;
+        } else {
+            fprintf(stderr, "usage: %s [--filter=substr] [--min-time=ms] [--broker=host:port]\n", argv[0]);
+            exit(2);
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+    if (options.broker) return checkMqttEngine() ? 0 : 1;
+
+    // Plausible mid-range readings so calibration math takes the normal path
+    for (int pin : SOIL_PINS) NativeHal::setAnalogValue(pin, 1200);
+    NativeHal::setDHT(24.5f, 55.0f);
+    NativeHal::setHour(12); // outside the watering windows: IDLE stays IDLE
+    NativeHal::setSerialEcho(false);
+    LittleFS.format(); // no spool left over from an earlier run
+    // Simulated ADS1115s: used by SOIL_EXT_ADC_CHIPS builds and the ExternalAdc benches
+    NativeHal::setExternalAdcChips(EXT_ADC_MAX_CHIPS);
+    for (int ch = 0; ch < EXT_ADC_MAX_CHANNELS; ch++) NativeHal::setExternalAdcValue(ch, 8000 + ch * 100);
+
+    setup();
+
+    {
+        // Boot phases as reported on the metrics topic (cold boot, no fast-connect cache yet)
+        unsigned long start = millis();
+        while (!bootProfiler.isMarked(BOOT_FIRST_PUBLISH) && millis() - start < 5000) loop();
+        printf("boot (%s, fast connect %s):", bootProfiler.getResetReason(),
+               NativeHal::getFastConnectCount() ? "yes" : "no");
+        const char* names[BOOT_PHASE_COUNT] = {"config", "sensors", "wifi", "mqtt", "time", "first publish"};
+        for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+            if (bootProfiler.isMarked((BootPhase)i)) printf(" %s %lu ms,", names[i], (unsigned long)bootProfiler.getMs((BootPhase)i));
+        }
+        printf("\n\n");
+    }
+
+    printf("%-32s %10s %14s %10s %12s\n", "benchmark", "iters", "ns/op", "allocs/op", "bytes/op");
+
+    runStatusBench("broadcastStatus/json");
+
+    deliver("SET_STATUS_FORMAT:1");
+    runStatusBench("broadcastStatus/binary");
+    deliver("SET_STATUS_FORMAT:0");
+
+    // Same readings as one delta-encoded frame per 12 samples
+    {
+        static SampleBatcher batcher;
+        static uint8_t frame[SampleBatcher::MAX_SIZE];
+        static size_t frameBytes = 0;
+        runBench("SampleBatcher/12_samples", [] {
+            while (!batcher.sample(sensorManager, 0, 12, 60000)) {}
+            frameBytes = batcher.encode(frame, sizeof(frame));
+        });
+        printf("  %zu bytes/frame, %.1f bytes/sample\n", frameBytes, frameBytes / 12.0);
+    }
+
+    // Drying-rate regression on a synthetic pot: 10 min samples, daily
+    // temperature/humidity swing, drying faster when warm and dry, 0.3 % noise
+    {
+        static MoistureForecast forecast;
+        static float percent[SOIL_SENSOR_COUNT];
+        static float temp, humidity;
+        static unsigned long step = 0;
+        static uint32_t noise = 1;
+        static auto trueRate = [](int c, float t, float h) {
+            return (1 + 0.5f * c) * (-0.4f - 0.2f * (t - 20) / 10 + 0.1f * (h - 50) / 50);
+        };
+        for (float& p : percent) p = 90;
+        runBench("MoistureForecast::addSample", [] {
+            float phase = (step++ % 144) * 6.2832f / 144;
+            temp = 20 + 8 * sinf(phase);
+            humidity = 50 - 20 * sinf(phase);
+            for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+                noise = noise * 1103515245 + 12345;
+                percent[c] += trueRate(c, temp, humidity) / 6 + ((int)(noise >> 16 & 0xffff) % 61 - 30) / 100.0f;
+                if (percent[c] < 10) percent[c] = 90; // watered: a rise the estimator skips
+            }
+            forecast.addSample(percent, {temp, humidity, true, 0}, 1 / 6.0f);
+        });
+        for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+            printf("  channel %d: %.3f %%/h, true %.3f %%/h at %.1f C %.0f %%RH\n", c, forecast.getRate(c),
+                   trueRate(c, temp, humidity), temp, humidity);
+        }
+    }
+
+    // Dosing a dry pot (8 % and 12 %, threshold 30, average mode) whose
+    // channels rise 0.6 and 0.9 % per pump-second: cycles and time to target
+    // with the old fixed 5 s pulses vs learned pulse lengths
+    {
+        static ConfigManager doseConfig; // not begun: gains stay in RAM
+        static const float trueGain[2] = {0.6f, 0.9f};
+        auto session = [](DoseController* dose, int& cycles, float& pumpedSec) {
+            float level[SOIL_SENSOR_COUNT];
+            int8_t before[SOIL_SENSOR_COUNT], after[SOIL_SENSOR_COUNT];
+            for (int c = 0; c < SOIL_SENSOR_COUNT; c++) level[c] = 8 + 4 * (c % 2);
+            RiseResults rose;
+            for (int i = 0; i < SOIL_SENSOR_COUNT; i++) rose.push_back(true);
+            cycles = 0;
+            pumpedSec = 0;
+            for (;;) {
+                float avg = 0;
+                for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+                    before[c] = (int8_t)level[c];
+                    avg += before[c];
+                }
+                if (avg / SOIL_SENSOR_COUNT >= 30 || cycles == 50) return;
+                uint32_t pulse = dose ? dose->nextPulse(before, 30, 0, cycles == 0) : DOSE_DEFAULT_MS;
+                if (!pulse) return;
+                for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+                    level[c] += trueGain[c % 2] * pulse / 1000;
+                    if (level[c] > 100) level[c] = 100;
+                    after[c] = (int8_t)level[c];
+                }
+                if (dose) dose->learn(before, after, rose, doseConfig);
+                cycles++;
+                pumpedSec += pulse / 1000.0f;
+            }
+        };
+        int cycles;
+        float pumped;
+        session(nullptr, cycles, pumped);
+        printf("DoseController: fixed pulses %d cycles, %.0f s pumped, %.1f min to target\n", cycles, pumped,
+               (pumped + cycles * 60) / 60);
+        static DoseController dose;
+        for (int n = 1; n <= 3; n++) {
+            session(&dose, cycles, pumped);
+            printf("  learned, session %d: %d cycles, %.0f s pumped, %.1f min to target\n", n, cycles, pumped,
+                   (pumped + cycles * 60) / 60);
+        }
+        runBench("DoseController::nextPulse", [] {
+            static const int8_t dry[SOIL_SENSOR_COUNT] = {};
+            dose.nextPulse(dry, 30, 0, true);
+        });
+    }
+
+    // History rollups: 10 s samples on a simulated clock, then paged queries
+    {
+        static HistoryStore store;
+        static uint32_t epoch = 1700000000;
+        runBench("HistoryStore::add", [] {
+            store.add(sensorManager, epoch, 0);
+            epoch += HISTORY_SAMPLE_INTERVAL_MS / 1000;
+        });
+        static uint8_t frame[OUTBOX_PAYLOAD_SIZE];
+        static size_t frameBytes = 0;
+        runBench("HistoryStore::encodePage", [] {
+            frameBytes = store.encodePage(HISTORY_MINUTE, 0, frame, sizeof(frame));
+        });
+        printf("  %zu bytes RAM, %d min / %d h / %d day entries, %d per page, %zu bytes/page\n", sizeof(HistoryStore),
+               store.getCount(HISTORY_MINUTE), store.getCount(HISTORY_HOUR), store.getCount(HISTORY_DAY),
+               HistoryStore::pageSize(sizeof(frame)), frameBytes);
+    }
+
+    runBench("processCommand/unknown", [] {
+        char topic[50];
+        snprintf(topic, sizeof(topic), "plantcare/%s/cmd", DEVICE_ID);
+        plantControl.processCommand(topic, "NOT_A_COMMAND:1");
+    });
+
+    runBench("processCommand/other_topic", [] {
+        plantControl.processCommand("plantcare/other-device/cmd", "PUMP_ON");
+    });
+
+    runBench("mqttCallback/SET_TIME_WINDOW", [] {
+        deliver("SET_TIME_WINDOW:6:10:16:19");
+    });
+
+    runBench("mqttCallback/SET_CALIBRATION", [] {
+        deliver("SET_CALIBRATION_VALUES:1:1700:700");
+    });
+    runBench("mqttCallback/SET_CAL_POINT", [] {
+        deliver("SET_CAL_POINT:1:0:1200:60");
+    });
+
+    runBench("mqttCallback/SET_THRESHOLD", [] {
+        // Alternate values so every command really changes the config
+        static bool flip = false;
+        flip = !flip;
+        deliver(flip ? "SET_THRESHOLD:31" : "SET_THRESHOLD:30");
+    });
+
+    // "Save all settings": four SET_* as one transaction, acked once
+    unsigned long publishesBefore = NativeHal::getPublishCount();
+    unsigned long nvsBefore = NativeHal::getNvsWriteCount();
+    unsigned long batches = 0;
+    runBench("mqttCallback/BATCH_4_settings", [&batches] {
+        static bool flip = false;
+        flip = !flip;
+        deliver(flip ? "BATCH:bench;SET_THRESHOLD:31;SET_TIME_WINDOW:6:10:16:19;SET_TRIGGER_MODE:1;SET_CALIBRATION_VALUES:0:1700:700"
+                     : "BATCH:bench;SET_THRESHOLD:30;SET_TIME_WINDOW:6:10:16:19;SET_TRIGGER_MODE:0;SET_CALIBRATION_VALUES:0:1700:700");
+        batches++;
+    });
+    if (batches > 0) {
+        printf("  %.2f publishes/batch, %.2f nvs writes/batch\n",
+               (double)(NativeHal::getPublishCount() - publishesBefore) / batches,
+               (double)(NativeHal::getNvsWriteCount() - nvsBefore) / batches);
+    }
+
+    // External ADS1115 scan (simulated chips, real conversion and I2C timing).
+    // Pipelined: all chips convert in parallel, a scan is 4 conversion slots.
+    Wire.setClock(EXT_ADC_I2C_HZ);
+    Wire1.setClock(EXT_ADC_I2C_HZ);
+    {
+        static ExternalAdc adcs[4];
+        static const int chipCounts[4] = {1, 2, 4, 8};
+        static const char* names[4] = {"ExternalAdc/scan_4ch", "ExternalAdc/scan_8ch",
+                                       "ExternalAdc/scan_16ch", "ExternalAdc/scan_32ch"};
+        for (int i = 0; i < 4; i++) {
+            static ExternalAdc* adc;
+            adc = &adcs[i];
+            for (int chip = 0; chip < chipCounts[i]; chip++) adc->addChip(chip < 4 ? Wire : Wire1, 0x48 + chip % 4);
+            adc->begin();
+            adc->stop(); // stepped by hand below
+            runBench(names[i], [] {
+                for (int s = 0; s < ADS1115_CHANNELS; s++) adc->step();
+            });
+        }
+
+        // Baseline: the same 32 channels one chip at a time
+        static ExternalAdc single[EXT_ADC_MAX_CHIPS];
+        for (int chip = 0; chip < EXT_ADC_MAX_CHIPS; chip++) {
+            single[chip].addChip(chip < 4 ? Wire : Wire1, 0x48 + chip % 4);
+            single[chip].begin();
+            single[chip].stop();
+        }
+        runBench("ExternalAdc/sequential_32ch", [] {
+            for (ExternalAdc& adc : single) {
+                for (int s = 0; s < ADS1115_CHANNELS; s++) adc.step();
+            }
+        });
+    }
+
+    runBench("SensorManager::update", [] {
+        sensorManager.update();
+    });
+
+    runBench("SensorManager::getDHT", [] {
+        sensorManager.getDHT();
+    });
+
+    // Calibration table: per-sample cost with 0 and 4 interior points, and
+    // the worst table error against the exact piecewise curve
+    {
+        static CalibrationLut<SOIL_SENSOR_COUNT> lut;
+        static int16_t rawIn[SOIL_SENSOR_COUNT];
+        static uint16_t out256[SOIL_SENSOR_COUNT];
+        static int8_t out[SOIL_SENSOR_COUNT];
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+            rawIn[i] = 1200 + 97 * i;
+            lut.compile(i, 2600, 1000, nullptr, 0);
+        }
+        runBench("CalibrationLut::apply/2_points", [] {
+            lut.apply(rawIn, 250, out256, out);
+        });
+
+        const CalPoint points[CAL_MAX_POINTS] = {{2300, 12}, {1900, 35}, {1500, 70}, {1200, 88}};
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) lut.compile(i, 2600, 1000, points, CAL_MAX_POINTS);
+        runBench("CalibrationLut::apply/6_points", [] {
+            lut.apply(rawIn, 250, out256, out);
+        });
+
+        const int xs[] = {1000, 1200, 1500, 1900, 2300, 2600};
+        const int ys[] = {100, 88, 70, 35, 12, 0};
+        float worst = 0;
+        for (int x = 0; x <= CAL_RAW_MAX; x++) {
+            float exact = x <= xs[0] ? ys[0] : ys[5];
+            for (int k = 0; k < 5; k++) {
+                if (x > xs[k] && x <= xs[k + 1]) {
+                    exact = ys[k] + (float)(ys[k + 1] - ys[k]) * (x - xs[k]) / (xs[k + 1] - xs[k]);
+                }
+            }
+            int16_t one[SOIL_SENSOR_COUNT] = {(int16_t)x};
+            lut.apply(one, CAL_REF_TEMP10, out256, out);
+            float error = fabsf(out256[0] / 256.0f - exact);
+            if (error > worst) worst = error;
+        }
+        printf("  %zu bytes of tables, worst table error %.2f %%\n", sizeof(lut), worst);
+    }
+
+    runBench("loop", [] {
+        loop();
+    });
+    // Control-task timers seen during the loop benchmark
+    for (int i = 0; i < scheduler.getJobCount(); i++) {
+        const JobStats& j = scheduler.getStats(i);
+        printf("  job %-14s runs %-6lu avg %-6lu us max %-6lu us max late %lu ms\n", j.name,
+               (unsigned long)j.runs, (unsigned long)(j.runs ? j.totalUs / j.runs : 0),
+               (unsigned long)j.maxUs, (unsigned long)j.maxLateMs);
+    }
+
+    {
+        // Full job table, nothing due: the cost of an idle wake-up
+        static Scheduler idle;
+        for (int i = 0; i < SCHED_MAX_JOBS; i++) {
+            int id = idle.add("noop", [](void*) {}, nullptr);
+            idle.every(id, 60000 + i * 100);
+        }
+        runBench("Scheduler::runDue/16_jobs_idle", [] {
+            idle.runDue();
+        });
+        // A job that is always due: runDue() stops after one run per job (16)
+        static Scheduler busy;
+        for (int i = 0; i < SCHED_MAX_JOBS - 1; i++) {
+            int id = busy.add("noop", [](void*) {}, nullptr);
+            busy.every(id, 60000 + i * 100);
+        }
+        int due = busy.add("due", [](void*) { busy.once(SCHED_MAX_JOBS - 1, 0); }, nullptr);
+        busy.once(due, 0);
+        runBench("Scheduler::runDue/16_runs", [] {
+            busy.runDue();
+        });
+    }
+
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    if (!options.filter || strstr("PeerGateway", options.filter)) {
+        // 12 leaves, 20 ms apart, each send a 38-byte binary status and a
+        // 300-byte message (two frames); they go up in a few batches. Then a
+        // command for one leaf rides down on its next wake-up.
+        static const int LEAVES = 12;
+        static EmulatedLeaf leaves[LEAVES];
+        static unsigned long batches, records, batchBytes;
+        NativeHal::setPublishHook([](const char* topic, const uint8_t* payload, unsigned int length) {
+            if (!strstr(topic, "/peers") || length < 2) return;
+            batches++;
+            records += payload[1];
+            batchBytes += length;
+        });
+        uint8_t status[38], config[300];
+        for (size_t i = 0; i < sizeof(status); i++) status[i] = i;
+        memset(config, 'c', sizeof(config));
+
+        unsigned long publishes = NativeHal::getPublishCount();
+        for (int n = 0; n < LEAVES; n++) {
+            leaves[n].open(n);
+            leaves[n].send("status", status, sizeof(status));
+            leaves[n].send("config", config, sizeof(config));
+            // Leaves wake on their own timers: a few tens of ms apart at worst
+            unsigned long sent = millis();
+            while (millis() - sent < 20) {
+                loop();
+                delay(1);
+            }
+        }
+        unsigned long start = millis();
+        while (networkManager.getGatewayStats().messages < 2 * LEAVES && millis() - start < 3000) {
+            loop();
+            delay(1);
+        }
+        // The last partial batch goes after GATEWAY_BATCH_MS
+        while (millis() - start < GATEWAY_BATCH_MS + 200) {
+            loop();
+            delay(1);
+        }
+        int synced = 0;
+        for (EmulatedLeaf& leaf : leaves) {
+            char command[PEER_COMMAND_SIZE + 1];
+            uint32_t epoch;
+            if (leaf.receive(command, sizeof(command), epoch) == 0) synced++;
+        }
+        GatewayStats gw = networkManager.getGatewayStats();
+        printf("PeerGateway: %d leaves, %lu messages (%lu frames) -> %lu uplink publishes (%lu records, %lu bytes), %d clock syncs, %lu dropped\n",
+               LEAVES, (unsigned long)gw.messages, (unsigned long)gw.frames, batches, records, batchBytes,
+               synced, (unsigned long)gw.dropped);
+
+        // Command for leaf 0 while it sleeps; it goes down once the leaf is heard again
+        char topic[50];
+        snprintf(topic, sizeof(topic), "plantcare/%s/cmd", leaves[0].id);
+        const char* pumpOn = "PUMP_ON";
+        NativeHal::deliverMessage(topic, (const uint8_t*)pumpOn, strlen(pumpOn));
+        loop();
+        delay(GATEWAY_LISTEN_MS);
+        start = millis();
+        leaves[0].send("status", status, sizeof(status));
+        char command[PEER_COMMAND_SIZE + 1] = "";
+        uint32_t epoch = 0;
+        while (millis() - start < 1000) {
+            loop();
+            if (leaves[0].receive(command, sizeof(command), epoch) > 0) break;
+        }
+        loop(); // delivery report
+        printf("  command to %s: \"%s\" after %lu ms (%lu delivered)\n", leaves[0].id, command, millis() - start,
+               (unsigned long)networkManager.getGatewayStats().commands);
+        printf("  %lu publishes for %d leaf messages\n", NativeHal::getPublishCount() - publishes, 2 * LEAVES + 1);
+        NativeHal::setPublishHook(nullptr);
+        for (EmulatedLeaf& leaf : leaves) close(leaf.sock);
+    }
+#endif
+
+    if (!options.filter || strstr("PowerManager", options.filter)) {
+        // Battery mode, two short cycles: the first started at boot, the second
+        // is a timer wake-up (state check, status over the radio, listen, sleep)
+        auto runUntilSleeps = [](unsigned long count) {
+            unsigned long start = millis();
+            while (NativeHal::getDeepSleepCount() < count && millis() - start < 30000) {
+                loop();
+                delay(1);
+            }
+        };
+        unsigned long sleeps = NativeHal::getDeepSleepCount();
+        deliver("SET_SLEEP:6");
+        runUntilSleeps(sleeps + 1);
+        runUntilSleeps(sleeps + 2);
+        PowerStats power = powerManager.getStats();
+        printf("PowerManager: %lu wakes, last %lu ms awake, deep sleep %lu ms\n", (unsigned long)power.wakes,
+               (unsigned long)power.lastWakeMs, (unsigned long)(NativeHal::getLastDeepSleepUs() / 1000));
+        // Back to always-on once the host "wakes up"
+        deliver("SET_SLEEP:0");
+        unsigned long start = millis();
+        while (millis() - start < 5000) {
+            loop();
+            delay(1);
+        }
+    }
+
+    if (!options.filter || strstr("PumpDriver", options.filter)) {
+        // Flow meter at 450 pulses/L, pump delivering 2 L/min: a metered dose,
+        // a timed pulse, then a dry tank (no pulses) stopped by the flow check
+        static char dose[96];
+        NativeHal::setPublishHook([](const char* topic, const uint8_t* payload, unsigned int length) {
+            if (strstr(topic, "/dose") && length < sizeof(dose)) {
+                memcpy(dose, payload, length);
+                dose[length] = '\0';
+            }
+        });
+        auto runPump = [](const char* command, float pulsesPerSec) {
+            NativeHal::setFlow(2, pulsesPerSec);
+            dose[0] = '\0';
+            unsigned long start = millis();
+            deliver(command);
+            while (!dose[0] && millis() - start < 10000) {
+                loop();
+                delay(1);
+            }
+            printf("  %-12s %5lu ms  %s\n", command, millis() - start, dose);
+            deliver("RESET");
+            loop();
+        };
+        deliver("SET_FLOW:450");
+        printf("PumpDriver (450 pulses/L, 2 L/min):\n");
+        runPump("PUMP_ML:50", 15.0f);
+        runPump("PUMP_ON", 15.0f);
+        runPump("PUMP_ML:50", 0.0f);
+        deliver("SET_FLOW:0");
+        NativeHal::setPublishHook(nullptr);
+    }
+
+    // Broker outage: statuses go to the flash spool instead of being dropped
+    NativeHal::setMqttConnected(false);
+    runBench("broadcastStatus/offline_spool", [] {
+        plantControl.broadcastStatus();
+        networkManager.flushOutbox();
+    });
+    NetworkQueueStats queues = networkManager.getQueueStats();
+    printf("  spool pending %lu, overwritten %lu\n",
+           (unsigned long)queues.spoolPending, (unsigned long)queues.spoolOverwritten);
+
+    NativeHal::setMqttConnected(true);
+    unsigned long bytes = NativeHal::getPublishBytes();
+    networkManager.loop(); // first replay batch
+    printf("  replay batch: %lu records, %lu bytes\n",
+           (unsigned long)(queues.spoolPending - networkManager.getQueueStats().spoolPending),
+           NativeHal::getPublishBytes() - bytes);
+
+#if PERF_COUNTERS
+    // Probe overhead, and the metrics report built from everything above
+    runBench("PerfScope", [] {
+        PERF_SCOPE(PERF_STATUS);
+    });
+    {
+        char report[OUTBOX_PAYLOAD_SIZE];
+        size_t length = perfCounters.buildReport(report, sizeof(report));
+        printf("  metrics %zu bytes: %s\n", length, report);
+    }
+#endif
+
+    bool steadyStateOk = checkSteadyStateAllocations();
+
+    printf("publishes: %lu (%lu bytes), nvs writes: %lu\n",
+           NativeHal::getPublishCount(), NativeHal::getPublishBytes(), NativeHal::getNvsWriteCount());
+    return steadyStateOk ? 0 : 1;
+}
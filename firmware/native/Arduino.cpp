@@ -0,0 +1,158 @@
+#include "Arduino.h"
+#include "NativeHal.h"
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+static bool serialEcho = true;
+
+void NativeHal::setSerialEcho(bool enabled) {
+    serialEcho = enabled;
+}
+
+// -- Timing --
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+// Set while NativeHal replays scripted edges into an ISR (see NativeHal.cpp)
+thread_local long long scriptedMicros = -1;
+
+// NativeHal::useVirtualClock(); advanced by esp_timer.cpp
+std::atomic<bool> virtualClock(false);
+std::atomic<uint64_t> virtualMicros(0);
+
+unsigned long micros() {
+    if (scriptedMicros >= 0) return (unsigned long)scriptedMicros;
+    if (virtualClock) return (unsigned long)virtualMicros.load();
+    auto elapsed = std::chrono::steady_clock::now() - bootTime;
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+unsigned long millis() {
+    return micros() / 1000;
+}
+
+void delay(unsigned long ms) {
+    if (virtualClock) NativeHal::advanceClock((uint64_t)ms * 1000);
+    else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+    if (virtualClock) NativeHal::advanceClock(us);
+    else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+// -- Math --
+
+long random(long max) {
+    if (max <= 0) return 0;
+    return rand() % max;
+}
+
+long random(long min, long max) {
+    if (min >= max) return min;
+    return min + random(max - min);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    // Same integer arithmetic as the ESP32 core, including its zero-width guard
+    const long run = in_max - in_min;
+    if (run == 0) return -1;
+    const long rise = out_max - out_min;
+    const long delta = x - in_min;
+    return (delta * rise) / run + out_min;
+}
+
+// -- String --
+
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+    static const char digits[] = "0123456789abcdef";
+    if (base < 2 || base > 16) base = 10;
+    char buf[68];
+    int pos = sizeof(buf) - 1;
+    buf[pos] = '\0';
+    do {
+        buf[--pos] = digits[value % base];
+        value /= base;
+    } while (value > 0);
+    if (negative) buf[--pos] = '-';
+    return std::string(buf + pos);
+}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base) {}
+
+String::String(long value, unsigned char base) {
+    // Like the Arduino core, only base 10 renders a sign
+    if (base == DEC && value < 0) {
+        s = formatInteger(-(unsigned long long)value, true, base);
+    } else {
+        s = formatInteger((unsigned long)value, false, base);
+    }
+}
+
+String::String(unsigned long value, unsigned char base) : s(formatInteger(value, false, base)) {}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+    s = buf;
+}
+
+void String::toCharArray(char* buf, unsigned int bufsize) const {
+    if (!buf || bufsize == 0) return;
+    size_t n = s.size() < bufsize - 1 ? s.size() : bufsize - 1;
+    memcpy(buf, s.data(), n);
+    buf[n] = '\0';
+}
+
+String operator+(const String& lhs, const String& rhs) {
+    return String(lhs.s + rhs.s);
+}
+
+String operator+(const String& lhs, const char* rhs) {
+    return String(lhs.s + rhs);
+}
+
+String operator+(const char* lhs, const String& rhs) {
+    return String(lhs + rhs.s);
+}
+
+// -- Serial --
+
+size_t HardwareSerial::print(const char* s) {
+    size_t n = strlen(s);
+    if (serialEcho) fwrite(s, 1, n, stdout);
+    return n;
+}
+
+size_t HardwareSerial::print(int value) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%d", value);
+    return print(buf);
+}
+
+size_t HardwareSerial::println(const char* s) {
+    return print(s) + print("\n");
+}
+
+size_t HardwareSerial::println(int value) {
+    return print(value) + print("\n");
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    // Format on the stack like the ESP32 core does for short lines
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n < 0) return 0;
+    return print(buf);
+}
@@ -0,0 +1,55 @@
+#include "LittleFS.h"
+#include "NativeHal.h"
+#include <filesystem>
+
+LittleFSFS LittleFS;
+
+static std::string fsRoot;
+
+void NativeHal::setFsRoot(const char* path) {
+    fsRoot = path;
+}
+
+static std::string hostPath(const char* path) {
+    if (fsRoot.empty()) {
+        fsRoot = (std::filesystem::temp_directory_path() / "plantcare_littlefs").string();
+    }
+    return fsRoot + (path[0] == '/' ? "" : "/") + path;
+}
+
+size_t File::size() const {
+    if (!fp) return 0;
+    long pos = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long end = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+    return end;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    (void)formatOnFail; (void)basePath; (void)maxOpenFiles; (void)partitionLabel;
+    std::error_code ec;
+    std::filesystem::create_directories(hostPath(""), ec);
+    return !ec;
+}
+
+bool LittleFSFS::format() {
+    std::error_code ec;
+    std::filesystem::remove_all(hostPath(""), ec);
+    return begin();
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    // Like LittleFS, binary mode is implied
+    std::string m = mode;
+    if (m.find('b') == std::string::npos) m += 'b';
+    return File(fopen(hostPath(path).c_str(), m.c_str()));
+}
+
+bool LittleFSFS::exists(const char* path) {
+    return std::filesystem::exists(hostPath(path));
+}
+
+bool LittleFSFS::remove(const char* path) {
+    return ::remove(hostPath(path).c_str()) == 0;
+}
@@ -0,0 +1,46 @@
+#ifndef NATIVE_LITTLEFS_H
+#define NATIVE_LITTLEFS_H
+
+// Stand-in for the ESP32 LittleFS/FS API, backed by a host directory
+// (NativeHal::setFsRoot(), default: <tmp>/plantcare_littlefs).
+
+#include "Arduino.h"
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File {
+private:
+    FILE* fp = nullptr;
+
+public:
+    File() {}
+    explicit File(FILE* f) : fp(f) {}
+
+    explicit operator bool() const { return fp != nullptr; }
+    size_t read(uint8_t* buf, size_t size) { return fp ? fread(buf, 1, size, fp) : 0; }
+    size_t write(const uint8_t* buf, size_t size) { return fp ? fwrite(buf, 1, size, fp) : 0; }
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) { return fp && fseek(fp, pos, (int)mode) == 0; }
+    size_t position() const { return fp ? ftell(fp) : 0; }
+    size_t size() const;
+    void flush() { if (fp) fflush(fp); }
+    void close() { if (fp) fclose(fp); fp = nullptr; }
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs");
+    void end() {}
+    bool format();
+    File open(const char* path, const char* mode = "r");
+    bool exists(const char* path);
+    bool remove(const char* path);
+    size_t totalBytes() { return 1441792; } // default esp32dev data partition
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef NATIVE_NTP_CLIENT_H
+#define NATIVE_NTP_CLIENT_H
+
+// Stand-in for arduino-libraries/NTPClient; the hour comes from NativeHal::setHour(),
+// or from NativeHal::setLocalTime() once that is set.
+
+#include "WiFiUdp.h"
+
+class NTPClient {
+private:
+    long timeOffset;
+
+public:
+    NTPClient(WiFiUDP& udp, const char* poolServerName, long timeOffset, unsigned long updateInterval)
+        : timeOffset(timeOffset) {
+        (void)udp; (void)poolServerName; (void)updateInterval;
+    }
+    void begin() {}
+    bool update() { return true; }
+    int getHours();
+    int getMinutes() { return 0; }
+    int getSeconds() { return 0; }
+    unsigned long getEpochTime();
+    String getFormattedTime();
+};
+
+#endif
@@ -0,0 +1,501 @@
+#include "NativeHal.h"
+#include "Arduino.h"
+#include "Preferences.h"
+#include "WiFi.h"
+#include "NTPClient.h"
+#include "PubSubClient.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include <atomic>
+#include <chrono>
+#include <time.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+WiFiClass WiFi;
+
+namespace {
+
+const int PIN_COUNT = 64;
+
+int analogValues[PIN_COUNT];
+int digitalValues[PIN_COUNT];
+unsigned long highSinceUs[PIN_COUNT];
+uint64_t highTotalUs[PIN_COUNT];
+
+float dhtTemperature = 25.0f;
+float dhtHumidity = 60.0f;
+int dhtPin = 4;
+int currentHour = 8;
+uint32_t localEpoch = 0;       // setLocalTime(), 0 = host clock
+unsigned long localEpochSetMs = 0;
+
+bool mqttConnected = true;
+unsigned long publishCount = 0;
+unsigned long publishBytes = 0;
+void (*publishHook)(const char*, const uint8_t*, unsigned int) = nullptr;
+std::function<void(char*, uint8_t*, unsigned int)> mqttCallback;
+
+unsigned long nvsWriteCount = 0;
+
+unsigned long fastConnectCount = 0;
+uint8_t stationMac[6];
+bool stationMacSet = false;
+int resetReason = ESP_RST_POWERON;
+
+int wakeupCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+uint64_t sleepTimerUs = 0;
+uint64_t lastDeepSleepUs = 0;
+unsigned long deepSleepCount = 0;
+
+int flowPumpPin = -1;
+float flowRate = 0;
+double flowPulses = 0;
+unsigned long flowLastUs = 0;
+std::mutex flowMutex;
+
+std::map<std::string, std::vector<uint8_t>>& nvsStore() {
+    static std::map<std::string, std::vector<uint8_t>> store;
+    return store;
+}
+
+bool validPin(int pin) {
+    return pin >= 0 && pin < PIN_COUNT;
+}
+
+// Integrates the flow up to now; call with flowMutex held
+void advanceFlow() {
+    unsigned long now = micros();
+    if (validPin(flowPumpPin) && digitalValues[flowPumpPin] == HIGH) flowPulses += flowRate * (now - flowLastUs) / 1e6;
+    flowLastUs = now;
+}
+
+}
+
+// -- NativeHal --
+
+void NativeHal::setAnalogValue(int pin, int value) {
+    if (validPin(pin)) analogValues[pin] = value;
+}
+
+void NativeHal::setDHT(float temperature, float humidity) {
+    dhtTemperature = temperature;
+    dhtHumidity = humidity;
+}
+
+void NativeHal::setDHTPin(int pin) {
+    dhtPin = pin;
+}
+
+void NativeHal::setHour(int hour) {
+    currentHour = hour;
+}
+
+void NativeHal::setLocalTime(uint32_t epoch) {
+    localEpoch = epoch;
+    localEpochSetMs = millis();
+}
+
+int NativeHal::getDigitalValue(int pin) {
+    return validPin(pin) ? digitalValues[pin] : LOW;
+}
+
+uint64_t NativeHal::getHighTimeUs(int pin) {
+    if (!validPin(pin)) return 0;
+    std::lock_guard<std::mutex> lock(flowMutex);
+    uint64_t total = highTotalUs[pin];
+    if (digitalValues[pin] == HIGH) total += micros() - highSinceUs[pin];
+    return total;
+}
+
+void NativeHal::setFlow(int pumpPin, float pulsesPerSec) {
+    std::lock_guard<std::mutex> lock(flowMutex);
+    advanceFlow();
+    flowPumpPin = pumpPin;
+    flowRate = pulsesPerSec;
+}
+
+unsigned long NativeHal::getFlowPulses() {
+    std::lock_guard<std::mutex> lock(flowMutex);
+    advanceFlow();
+    return (unsigned long)flowPulses;
+}
+
+void NativeHal::setMqttConnected(bool connected) {
+    mqttConnected = connected;
+}
+
+unsigned long NativeHal::getPublishCount() {
+    return publishCount;
+}
+
+unsigned long NativeHal::getPublishBytes() {
+    return publishBytes;
+}
+
+void NativeHal::setPublishHook(void (*hook)(const char* topic, const uint8_t* payload, unsigned int length)) {
+    publishHook = hook;
+}
+
+unsigned long NativeHal::getNvsWriteCount() {
+    return nvsWriteCount;
+}
+
+void NativeHal::deliverMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+    if (!mqttCallback) return;
+    // PubSubClient hands out its own receive buffer; mirror that with a mutable copy
+    std::vector<uint8_t> buffer(payload, payload + length);
+    std::string topicCopy(topic);
+    mqttCallback(&topicCopy[0], buffer.data(), length);
+}
+
+// -- GPIO / ADC --
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if (!validPin(pin)) return;
+    std::lock_guard<std::mutex> lock(flowMutex);
+    if (pin == flowPumpPin) advanceFlow();
+    if (val == HIGH && digitalValues[pin] != HIGH) highSinceUs[pin] = micros();
+    if (val != HIGH && digitalValues[pin] == HIGH) highTotalUs[pin] += micros() - highSinceUs[pin];
+    digitalValues[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    return NativeHal::getDigitalValue(pin);
+}
+
+uint16_t analogRead(uint8_t pin) {
+    return validPin(pin) ? analogValues[pin] : 0;
+}
+
+// -- Interrupts / DHT22 --
+
+extern thread_local long long scriptedMicros; // Arduino.cpp
+
+// Replays the falling edges a DHT22 produces after the host releases the
+// line: response start, start of bit 0, then one edge per data bit.
+static void replayDHTFrame(void (*handler)(void*), void* arg) {
+    uint16_t humidity10 = (uint16_t)lroundf(dhtHumidity * 10);
+    int16_t temperature10 = (int16_t)lroundf(dhtTemperature * 10);
+    uint16_t t = temperature10 < 0 ? (uint16_t)(0x8000 | -temperature10) : (uint16_t)temperature10;
+    uint8_t frame[5] = {(uint8_t)(humidity10 >> 8), (uint8_t)humidity10, (uint8_t)(t >> 8), (uint8_t)t, 0};
+    frame[4] = frame[0] + frame[1] + frame[2] + frame[3];
+
+    long long now = (long long)micros() + 30;
+    scriptedMicros = now;
+    handler(arg);                // sensor pulls low
+    scriptedMicros = now += 160; // 80 us low + 80 us high
+    handler(arg);
+    for (int bit = 0; bit < 40; bit++) {
+        bool one = frame[bit / 8] & (0x80 >> (bit % 8));
+        scriptedMicros = now += one ? 120 : 77;
+        handler(arg);
+    }
+    scriptedMicros = -1;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    (void)pin;
+    (void)handler;
+    (void)mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    if (pin == dhtPin && mode == FALLING) replayDHTFrame(handler, arg);
+}
+
+void detachInterrupt(uint8_t pin) {
+    (void)pin;
+}
+
+// -- WiFi --
+
+unsigned long NativeHal::getFastConnectCount() {
+    return fastConnectCount;
+}
+
+void NativeHal::setResetReason(int reason) {
+    resetReason = reason;
+}
+
+void NativeHal::setMacAddress(const uint8_t* mac) {
+    memcpy(stationMac, mac, sizeof(stationMac));
+    stationMacSet = true;
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+    if (!stationMacSet) {
+        // Locally administered, FNV-1a of the device id
+        uint32_t hash = 2166136261u;
+        for (const char* p = DEVICE_ID; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619u;
+        const uint8_t derived[6] = {0x02, 0x50, (uint8_t)(hash >> 24), (uint8_t)(hash >> 16), (uint8_t)(hash >> 8), (uint8_t)hash};
+        memcpy(stationMac, derived, sizeof(derived));
+        stationMacSet = true;
+    }
+    memcpy(mac, stationMac, 6);
+    return mac;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return (esp_reset_reason_t)resetReason;
+}
+
+bool IPAddress::fromString(const char* s) {
+    unsigned a, b, c, d;
+    if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255) return false;
+    address = a | (b << 8) | (c << 16) | (d << 24);
+    return true;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns) {
+    (void)local; (void)gateway; (void)subnet; (void)dns;
+    return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid) {
+    (void)ssid; (void)passphrase; (void)channel;
+    if (bssid) fastConnectCount++;
+    return WL_CONNECTED;
+}
+
+uint8_t* WiFiClass::BSSID() {
+    static uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+    return bssid;
+}
+
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1, const char* server2, const char* server3) {
+    (void)gmtOffsetSec; (void)daylightOffsetSec; (void)server1; (void)server2; (void)server3;
+}
+
+// -- ESP --
+
+EspClass ESP;
+
+static const uint32_t HOST_HEAP_BYTES = 320 * 1024;
+
+uint32_t EspClass::getCycleCount() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return HOST_HEAP_BYTES;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return HOST_HEAP_BYTES;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return HOST_HEAP_BYTES;
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return 1000;
+}
+
+// -- Deep sleep --
+
+void NativeHal::setWakeupCause(int cause) {
+    wakeupCause = cause;
+}
+
+unsigned long NativeHal::getDeepSleepCount() {
+    return deepSleepCount;
+}
+
+uint64_t NativeHal::getLastDeepSleepUs() {
+    return lastDeepSleepUs;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    sleepTimerUs = time_in_us;
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+    return (esp_sleep_wakeup_cause_t)wakeupCause;
+}
+
+void esp_deep_sleep_start() {
+    deepSleepCount++;
+    lastDeepSleepUs = sleepTimerUs;
+}
+
+// -- NTP --
+
+int NTPClient::getHours() {
+    if (localEpoch) return (getEpochTime() % 86400) / 3600;
+    return currentHour;
+}
+
+unsigned long NTPClient::getEpochTime() {
+    if (localEpoch) return localEpoch + (millis() - localEpochSetMs) / 1000;
+    // Host clock, shifted like the real client (local time, not UTC)
+    return (unsigned long)time(NULL) + timeOffset;
+}
+
+String NTPClient::getFormattedTime() {
+    char buf[9];
+    snprintf(buf, sizeof(buf), "%02d:00:00", getHours());
+    return String(buf);
+}
+
+// -- MQTT --
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    mqttCallback = callback;
+    return *this;
+}
+
+bool PubSubClient::connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage) {
+    (void)id; (void)willTopic; (void)willQos; (void)willRetain; (void)willMessage;
+    return mqttConnected;
+}
+
+bool PubSubClient::connected() {
+    return mqttConnected;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+    (void)retained;
+    if (!mqttConnected) return false;
+    publishCount++;
+    publishBytes += strlen(topic) + plength;
+    if (publishHook) publishHook(topic, payload, plength);
+    return true;
+}
+
+// -- Preferences --
+
+std::string Preferences::fullKey(const char* key) const {
+    return ns + "/" + key;
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partition_label) {
+    (void)readOnly;
+    (void)partition_label;
+    ns = name;
+    started = true;
+    return true;
+}
+
+void Preferences::end() {
+    started = false;
+}
+
+bool Preferences::clear() {
+    auto& store = nvsStore();
+    std::string prefix = ns + "/";
+    for (auto it = store.begin(); it != store.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) it = store.erase(it);
+        else ++it;
+    }
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    return nvsStore().erase(fullKey(key)) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    return nvsStore().count(fullKey(key)) > 0;
+}
+
+size_t Preferences::putInt(const char* key, int32_t value) {
+    return putBytes(key, &value, sizeof(value));
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+    int32_t value = defaultValue;
+    if (getBytesLength(key) == sizeof(value)) getBytes(key, &value, sizeof(value));
+    return value;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    return putBytes(key, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+
+size_t Preferences::putString(const char* key, String value) {
+    return putString(key, value.c_str());
+}
+
+String Preferences::getString(const char* key, String defaultValue) {
+    auto it = nvsStore().find(fullKey(key));
+    if (it == nvsStore().end() || it->second.empty()) return defaultValue;
+    return String((const char*)it->second.data());
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    if (!started || !key) return 0;
+    const uint8_t* bytes = (const uint8_t*)value;
+    // Rewrites reuse the entry's storage, so a steady config commit stays off the heap
+    nvsStore()[fullKey(key)].assign(bytes, bytes + len);
+    nvsWriteCount++;
+    return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    auto it = nvsStore().find(fullKey(key));
+    return it == nvsStore().end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    auto it = nvsStore().find(fullKey(key));
+    if (it == nvsStore().end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+// -- Heap accounting --
+// glibc lets the executable interpose malloc; forward to the real allocator and count.
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<unsigned long> allocCount(0);
+static std::atomic<unsigned long> allocBytes(0);
+
+extern "C" void* malloc(size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    allocCount++;
+    allocBytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    allocCount++;
+    allocBytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+NativeHal::AllocStats NativeHal::getAllocStats() {
+    return {allocCount.load(), allocBytes.load()};
+}
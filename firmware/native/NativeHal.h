@@ -0,0 +1,89 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+// Host-side control surface for the Linux stand-ins of the Arduino APIs.
+// Only used by [env:native] builds (benchmarks, simulators), never on the ESP32.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace NativeHal {
+
+// -- Inputs the firmware reads --
+void setAnalogValue(int pin, int value);
+// Served as real DHT22 frames (edge timings) on the sensor's data pin
+void setDHT(float temperature, float humidity);
+void setDHTPin(int pin);
+void setHour(int hour);
+// Local time the NTP stand-in reports from now on, running on with millis();
+// the hour follows it instead of setHour(). 0 = host clock and setHour() again.
+void setLocalTime(uint32_t localEpoch);
+// Simulated ADS1115s on Wire/Wire1 (chip k: bus k / 4, address 0x48 + k % 4)
+void setExternalAdcChips(int count);
+// channel = chip * 4 + AINx, in ADS1115 counts
+void setExternalAdcValue(int channel, int counts);
+
+// -- Outputs the firmware drives --
+int getDigitalValue(int pin);
+// Total time the pin has been driven HIGH, by micros()
+uint64_t getHighTimeUs(int pin);
+
+// -- Flow meter stand-in (counted by the PCNT stand-in) --
+// Pulses arrive at pulsesPerSec while pumpPin is driven HIGH; 0 = dry tank
+void setFlow(int pumpPin, float pulsesPerSec);
+unsigned long getFlowPulses();
+
+// -- MQTT stand-in --
+void setMqttConnected(bool connected);
+unsigned long getPublishCount();
+unsigned long getPublishBytes();
+// Sees every accepted publish (nullptr to remove)
+void setPublishHook(void (*hook)(const char* topic, const uint8_t* payload, unsigned int length));
+// Feed a message to the callback registered with PubSubClient::setCallback
+void deliverMessage(const char* topic, const uint8_t* payload, unsigned int length);
+
+// -- NVS stand-in --
+unsigned long getNvsWriteCount();
+
+// -- LittleFS stand-in --
+// Host directory that backs the flash filesystem
+void setFsRoot(const char* path);
+
+// -- WiFi stand-in --
+// Station connects that used a cached channel/BSSID (WiFi.begin with bssid)
+unsigned long getFastConnectCount();
+// Reset reason reported at boot (esp_reset_reason_t)
+void setResetReason(int reason);
+// Station MAC (also picks the ESP-NOW stand-in's UDP port, see esp_now.h)
+void setMacAddress(const uint8_t* mac);
+
+// -- Deep sleep stand-in --
+// Wake cause reported to the firmware at boot (esp_sleep_wakeup_cause_t)
+void setWakeupCause(int cause);
+unsigned long getDeepSleepCount();
+// Timer wake-up of the last esp_deep_sleep_start()
+uint64_t getLastDeepSleepUs();
+
+// -- Virtual clock --
+// From useVirtualClock() on, micros()/millis() start at 0 and only move with
+// advanceClock() (delay() advances them too). esp_timer callbacks then run
+// inside advanceClock(), on the calling thread, in deadline order, each at
+// its own time. Call it before anything starts an esp_timer.
+void useVirtualClock();
+bool isVirtualClock();
+void advanceClock(uint64_t us);
+
+// -- Serial --
+// Output is still formatted (so its cost is measured) but only echoed when enabled
+void setSerialEcho(bool enabled);
+
+// -- Heap accounting (counts every malloc/calloc/realloc in the process) --
+struct AllocStats {
+    unsigned long count;
+    unsigned long bytes;
+};
+AllocStats getAllocStats();
+
+}
+
+#endif
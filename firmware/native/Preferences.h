@@ -0,0 +1,35 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+// In-memory stand-in for the ESP32 NVS Preferences API.
+
+#include "Arduino.h"
+
+class Preferences {
+private:
+    std::string ns;
+    bool started = false;
+
+    std::string fullKey(const char* key) const;
+
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partition_label = NULL);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putInt(const char* key, int32_t value);
+    int32_t getInt(const char* key, int32_t defaultValue = 0);
+
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, String value);
+    String getString(const char* key, String defaultValue = String());
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// Stand-in for the ESP32 WiFi stack: always associated, fixed RSSI, a fixed
+// AP (channel 6) and DHCP lease, a per-device MAC. Station config calls are recorded only.
+
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+class IPAddress {
+private:
+    uint32_t address = 0;
+
+public:
+    IPAddress() {}
+    IPAddress(uint32_t a) : address(a) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    operator uint32_t() const { return address; }
+    bool fromString(const char* s);
+};
+
+class WiFiClass {
+public:
+    wl_status_t status() { return WL_CONNECTED; }
+    int8_t RSSI() { return -55; }
+    bool disconnect(bool wifiOff = false) { (void)wifiOff; return true; }
+    bool mode(wifi_mode_t m) { (void)m; return true; }
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns = IPAddress());
+    wl_status_t begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid);
+
+    String SSID() { return String("plantcare-lab"); }
+    String psk() { return String("secret"); }
+    int32_t channel() { return 6; }
+    uint8_t* BSSID();
+    // Station MAC: derived from DEVICE_ID unless set with NativeHal::setMacAddress()
+    uint8_t* macAddress(uint8_t* mac);
+    IPAddress localIP() { return IPAddress(192, 168, 1, 50); }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 1, 1); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress dnsIP() { return IPAddress(192, 168, 1, 1); }
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient {};
+
+#endif
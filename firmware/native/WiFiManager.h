@@ -0,0 +1,30 @@
+#ifndef NATIVE_WIFI_MANAGER_H
+#define NATIVE_WIFI_MANAGER_H
+
+// Stand-in for tzapu/WiFiManager: autoConnect always succeeds, no portal.
+
+#include "WiFi.h"
+
+class WiFiManagerParameter {
+private:
+    String value;
+
+public:
+    WiFiManagerParameter(const char* id, const char* label, const char* defaultValue, int length)
+        : value(defaultValue) { (void)id; (void)label; (void)length; }
+    const char* getValue() const { return value.c_str(); }
+};
+
+class WiFiManager {
+public:
+    void setSaveConfigCallback(void (*func)(void)) { (void)func; }
+    void addParameter(WiFiManagerParameter* p) { (void)p; }
+    void setConfigPortalBlocking(bool shouldBlock) { (void)shouldBlock; }
+    bool autoConnect(const char* apName) { (void)apName; return true; }
+    void setSTAStaticIPConfig(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns) {
+        (void)ip; (void)gateway; (void)subnet; (void)dns;
+    }
+    bool process() { return false; }
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef NATIVE_WIFI_UDP_H
+#define NATIVE_WIFI_UDP_H
+
+#include "WiFi.h"
+
+class WiFiUDP {};
+
+#endif
@@ -0,0 +1,117 @@
+#include "Wire.h"
+#include "NativeHal.h"
+#include <atomic>
+#include <chrono>
+
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+namespace {
+
+// Chip k sits on bus k / 4 at address 0x48 + k % 4, like real ADS1115 strapping
+const int MAX_CHIPS = 8;
+const int CHANNELS = 4;
+
+struct Ads1115 {
+    uint8_t pointer = 0;
+    uint16_t config = 0x8583; // power-on default
+    int16_t conversion = 0;
+    int pendingChannel = -1;
+    uint64_t readyAtUs = 0;
+};
+
+std::atomic<int> chipCount(0);
+std::atomic<int> externalValues[MAX_CHIPS * CHANNELS];
+Ads1115 chips[MAX_CHIPS];
+
+const unsigned DATA_RATES[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Ads1115* chipAt(int bus, uint8_t address) {
+    if (address < 0x48 || address > 0x4B) return nullptr;
+    int index = bus * 4 + (address - 0x48);
+    return index < chipCount ? &chips[index] : nullptr;
+}
+
+// Finishes a conversion whose time is up
+void settle(Ads1115& chip, int index) {
+    if (chip.pendingChannel < 0 || nowUs() < chip.readyAtUs) return;
+    chip.conversion = externalValues[index * CHANNELS + chip.pendingChannel];
+    chip.pendingChannel = -1;
+    chip.config |= 0x8000; // OS: idle again
+}
+
+}
+
+void NativeHal::setExternalAdcChips(int count) {
+    chipCount = count < 0 ? 0 : (count > MAX_CHIPS ? MAX_CHIPS : count);
+}
+
+void NativeHal::setExternalAdcValue(int channel, int counts) {
+    if (channel >= 0 && channel < MAX_CHIPS * CHANNELS) externalValues[channel] = counts;
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+    (void)sda; (void)scl;
+    if (frequency) clockHz = frequency;
+    return true;
+}
+
+void TwoWire::busDelay(size_t bytes) {
+    // Start + address byte + data bytes, 9 clocks each (ACK included)
+    uint64_t until = nowUs() + (uint64_t)(bytes + 1) * 9 * 1000000 / clockHz;
+    while (nowUs() < until) {}
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    txAddress = address;
+    txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (txLength >= sizeof(txBuffer)) return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    (void)sendStop;
+    busDelay(txLength);
+    Ads1115* chip = chipAt(busNum, txAddress);
+    if (!chip) return 2;
+    int index = chip - chips;
+    settle(*chip, index);
+
+    if (txLength >= 1) chip->pointer = txBuffer[0] & 0x03;
+    if (txLength >= 3 && chip->pointer == 1) {
+        chip->config = (txBuffer[1] << 8) | txBuffer[2];
+        int mux = (chip->config >> 12) & 0x07;
+        bool singleShot = chip->config & 0x0100;
+        if ((chip->config & 0x8000) && singleShot && mux >= 4) {
+            // OS written: start a single-ended conversion of AIN(mux - 4)
+            chip->pendingChannel = mux - 4;
+            chip->readyAtUs = nowUs() + 1000000 / DATA_RATES[(chip->config >> 5) & 0x07] + 1;
+            chip->config &= ~0x8000; // OS reads 0 while converting
+        }
+    }
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop) {
+    (void)sendStop;
+    rxLength = rxPos = 0;
+    busDelay(quantity);
+    Ads1115* chip = chipAt(busNum, address);
+    if (!chip || quantity > sizeof(rxBuffer)) return 0;
+    settle(*chip, chip - chips);
+
+    uint16_t reg = chip->pointer == 1 ? chip->config : (uint16_t)chip->conversion;
+    for (uint8_t i = 0; i < quantity; i++) {
+        rxBuffer[rxLength++] = (i % 2 == 0) ? reg >> 8 : reg & 0xff;
+    }
+    return rxLength;
+}
@@ -0,0 +1,42 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include "Arduino.h"
+
+// I2C stand-in. The only devices on the bus are simulated ADS1115 ADCs
+// (see NativeHal::setExternalAdcChips). Transactions take the time the
+// bytes would need on the wire at the configured clock, and conversions
+// take 1/data-rate, so scan timings on the host are realistic.
+class TwoWire {
+private:
+    int busNum;
+    uint32_t clockHz = 100000;
+    uint8_t txAddress = 0;
+    uint8_t txBuffer[8];
+    size_t txLength = 0;
+    uint8_t rxBuffer[8];
+    size_t rxLength = 0;
+    size_t rxPos = 0;
+
+    void busDelay(size_t bytes);
+
+public:
+    explicit TwoWire(int bus) : busNum(bus) {}
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    void setClock(uint32_t frequency) { clockHz = frequency; }
+
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    // 0 = ok, 2 = address NACK
+    uint8_t endTransmission(bool sendStop = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+    int available() { return rxLength - rxPos; }
+    int read() { return rxPos < rxLength ? rxBuffer[rxPos++] : -1; }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef NATIVE_ESP_ATTR_H
+#define NATIVE_ESP_ATTR_H
+
+// Stand-in for the ESP-IDF section attributes. Host memory is never powered
+// down, so RTC-retained variables are plain globals.
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
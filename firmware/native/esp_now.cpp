@@ -0,0 +1,151 @@
+#include "esp_now.h"
+#include "WiFi.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const int MAX_PEERS = 20; // ESP_NOW_MAX_TOTAL_PEER_NUM
+
+struct EspNow {
+    std::mutex mutex;
+    int sock = -1;
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    std::atomic<bool> running{false};
+    std::thread receiver;
+    std::atomic<esp_now_recv_cb_t> onReceive{nullptr};
+    std::atomic<esp_now_send_cb_t> onSent{nullptr};
+    uint8_t peers[MAX_PEERS][ESP_NOW_ETH_ALEN];
+    int peerCount = 0;
+
+    int findPeer(const uint8_t* addr) {
+        for (int i = 0; i < peerCount; i++) {
+            if (memcmp(peers[i], addr, ESP_NOW_ETH_ALEN) == 0) return i;
+        }
+        return -1;
+    }
+
+    void run() {
+        uint8_t datagram[ESP_NOW_ETH_ALEN + ESP_NOW_MAX_DATA_LEN];
+        while (running) {
+            ssize_t n = recv(sock, datagram, sizeof(datagram), 0);
+            if (n <= ESP_NOW_ETH_ALEN) continue; // timeout (checks running) or runt
+            esp_now_recv_cb_t cb = onReceive;
+            if (cb) cb(datagram, datagram + ESP_NOW_ETH_ALEN, (int)n - ESP_NOW_ETH_ALEN);
+        }
+    }
+};
+
+// Intentionally leaked: the receive thread may outlive static destruction
+EspNow& espNow = *new EspNow();
+
+const uint8_t BROADCAST_MAC[ESP_NOW_ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+sockaddr_in portAddress(uint8_t last) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(ESP_NOW_UDP_BASE_PORT + last);
+    return addr;
+}
+
+}
+
+esp_err_t esp_now_init() {
+    if (espNow.running) return ESP_OK;
+    WiFi.macAddress(espNow.mac);
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) return ESP_FAIL;
+    sockaddr_in addr = portAddress(espNow.mac[5]);
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return ESP_FAIL;
+    }
+    // Lets the receive thread notice esp_now_deinit()
+    timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    espNow.sock = sock;
+    espNow.peerCount = 0;
+    espNow.running = true;
+    espNow.receiver = std::thread([] { espNow.run(); });
+    return ESP_OK;
+}
+
+esp_err_t esp_now_deinit() {
+    if (!espNow.running) return ESP_OK;
+    espNow.running = false;
+    espNow.receiver.join();
+    close(espNow.sock);
+    espNow.sock = -1;
+    espNow.onReceive = nullptr;
+    espNow.onSent = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+    if (!espNow.running) return ESP_ERR_ESPNOW_NOT_INIT;
+    espNow.onReceive = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+    if (!espNow.running) return ESP_ERR_ESPNOW_NOT_INIT;
+    espNow.onSent = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer) {
+    if (!peer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(espNow.mutex);
+    if (espNow.findPeer(peer->peer_addr) >= 0) return ESP_OK;
+    if (espNow.peerCount >= MAX_PEERS) return ESP_FAIL;
+    memcpy(espNow.peers[espNow.peerCount++], peer->peer_addr, ESP_NOW_ETH_ALEN);
+    return ESP_OK;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t* peer_addr) {
+    std::lock_guard<std::mutex> lock(espNow.mutex);
+    int i = espNow.findPeer(peer_addr);
+    if (i < 0) return ESP_ERR_ESPNOW_NOT_FOUND;
+    memmove(espNow.peers[i], espNow.peers[i + 1], (espNow.peerCount - i - 1) * ESP_NOW_ETH_ALEN);
+    espNow.peerCount--;
+    return ESP_OK;
+}
+
+bool esp_now_is_peer_exist(const uint8_t* peer_addr) {
+    std::lock_guard<std::mutex> lock(espNow.mutex);
+    return espNow.findPeer(peer_addr) >= 0;
+}
+
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t len) {
+    if (!espNow.running) return ESP_ERR_ESPNOW_NOT_INIT;
+    if (!peer_addr || !data || len == 0 || len > ESP_NOW_MAX_DATA_LEN) return ESP_ERR_INVALID_ARG;
+    if (!esp_now_is_peer_exist(peer_addr)) return ESP_ERR_ESPNOW_NOT_FOUND;
+
+    uint8_t datagram[ESP_NOW_ETH_ALEN + ESP_NOW_MAX_DATA_LEN];
+    memcpy(datagram, espNow.mac, ESP_NOW_ETH_ALEN);
+    memcpy(datagram + ESP_NOW_ETH_ALEN, data, len);
+    bool ok;
+    if (memcmp(peer_addr, BROADCAST_MAC, ESP_NOW_ETH_ALEN) == 0) {
+        ok = true;
+        for (int last = 0; last < 256; last++) {
+            if (last == espNow.mac[5]) continue;
+            sockaddr_in addr = portAddress(last);
+            sendto(espNow.sock, datagram, ESP_NOW_ETH_ALEN + len, 0, (sockaddr*)&addr, sizeof(addr));
+        }
+    } else {
+        // No link-layer ACK here: success means the host took the datagram
+        sockaddr_in addr = portAddress(peer_addr[5]);
+        ok = sendto(espNow.sock, datagram, ESP_NOW_ETH_ALEN + len, 0, (sockaddr*)&addr, sizeof(addr)) >= 0;
+    }
+    esp_now_send_cb_t cb = espNow.onSent;
+    if (cb) cb(peer_addr, ok ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+    return ESP_OK;
+}
@@ -0,0 +1,56 @@
+#ifndef NATIVE_ESP_NOW_H
+#define NATIVE_ESP_NOW_H
+
+// Stand-in for ESP-NOW over UDP on 127.0.0.1, so several native processes
+// (a gateway and its leaves, or a bench) can talk to each other. A node
+// listens on ESP_NOW_UDP_BASE_PORT + the last byte of its MAC address
+// (WiFi.macAddress(), see NativeHal::setMacAddress()); a datagram is the
+// sender's MAC followed by the frame. Broadcast goes to all 256 ports.
+// Callbacks run on a receive thread, like the WiFi task on the device;
+// a send is reported successful once the datagram is handed to the host.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_KEY_LEN 16
+#define ESP_NOW_MAX_DATA_LEN 250
+#define ESP_ERR_ESPNOW_NOT_INIT 0x3065
+#define ESP_ERR_ESPNOW_NOT_FOUND 0x3069
+#ifndef ESP_NOW_UDP_BASE_PORT
+#define ESP_NOW_UDP_BASE_PORT 47000
+#endif
+
+typedef enum {
+    ESP_NOW_SEND_SUCCESS = 0,
+    ESP_NOW_SEND_FAIL
+} esp_now_send_status_t;
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP
+} wifi_interface_t;
+
+typedef struct {
+    uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+    uint8_t lmk[ESP_NOW_KEY_LEN];
+    uint8_t channel;
+    wifi_interface_t ifidx;
+    bool encrypt;
+    void* priv;
+} esp_now_peer_info_t;
+
+typedef void (*esp_now_recv_cb_t)(const uint8_t* mac_addr, const uint8_t* data, int data_len);
+typedef void (*esp_now_send_cb_t)(const uint8_t* mac_addr, esp_now_send_status_t status);
+
+esp_err_t esp_now_init();
+esp_err_t esp_now_deinit();
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb);
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb);
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer);
+esp_err_t esp_now_del_peer(const uint8_t* peer_addr);
+bool esp_now_is_peer_exist(const uint8_t* peer_addr);
+esp_err_t esp_now_send(const uint8_t* peer_addr, const uint8_t* data, size_t len);
+
+#endif
@@ -0,0 +1,170 @@
+#include "esp_timer.h"
+#include "Arduino.h"
+#include "NativeHal.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NativeHal::useVirtualClock() state, Arduino.cpp
+extern std::atomic<bool> virtualClock;
+extern std::atomic<uint64_t> virtualMicros;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t period;   // 0 = one-shot
+    int64_t deadline;
+    bool active;
+};
+
+namespace {
+
+// Intentionally leaked: the dispatcher thread may still be running during static destruction
+struct TimerService {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<esp_timer*> timers;
+    bool started = false;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            esp_timer* next = nullptr;
+            for (esp_timer* t : timers) {
+                if (t->active && (!next || t->deadline < next->deadline)) next = t;
+            }
+            if (!next) {
+                wake.wait(lock);
+                continue;
+            }
+            int64_t now = esp_timer_get_time();
+            if (next->deadline > now) {
+                wake.wait_for(lock, std::chrono::microseconds(next->deadline - now));
+                continue;
+            }
+            if (next->period) {
+                next->deadline += next->period;
+                // Like skip_unhandled_events: never queue up a backlog of missed periods
+                if (next->deadline < now) next->deadline = now + next->period;
+            } else {
+                next->active = false;
+            }
+            esp_timer_cb_t cb = next->callback;
+            void* arg = next->arg;
+            lock.unlock();
+            cb(arg);
+            lock.lock();
+        }
+    }
+
+    void start(esp_timer* timer, uint64_t delay, uint64_t period) {
+        std::lock_guard<std::mutex> lock(mutex);
+        timer->period = period;
+        timer->deadline = esp_timer_get_time() + delay;
+        timer->active = true;
+        if (!started && !virtualClock) {
+            started = true;
+            std::thread([this] { run(); }).detach();
+        }
+        wake.notify_one();
+    }
+};
+
+TimerService& service() {
+    static TimerService* instance = new TimerService();
+    return *instance;
+}
+
+}
+
+// -- Virtual clock --
+
+void NativeHal::useVirtualClock() {
+    virtualMicros = 0;
+    virtualClock = true;
+}
+
+bool NativeHal::isVirtualClock() {
+    return virtualClock;
+}
+
+void NativeHal::advanceClock(uint64_t us) {
+    uint64_t until = virtualMicros + us;
+    TimerService& s = service();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    for (;;) {
+        // Earliest due; ties in creation order, so runs repeat exactly
+        esp_timer* next = nullptr;
+        for (esp_timer* t : s.timers) {
+            if (t->active && (uint64_t)t->deadline <= until && (!next || t->deadline < next->deadline)) next = t;
+        }
+        if (!next) break;
+        if ((uint64_t)next->deadline > virtualMicros) virtualMicros = next->deadline;
+        if (next->period) next->deadline += next->period;
+        else next->active = false;
+        esp_timer_cb_t cb = next->callback;
+        void* arg = next->arg;
+        lock.unlock();
+        cb(arg);
+        lock.lock();
+    }
+    // A callback that delay()ed may have moved past until already
+    if (virtualMicros < until) virtualMicros = until;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (!create_args || !create_args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    esp_timer* timer = new esp_timer{create_args->callback, create_args->arg, 0, 0, false};
+    std::lock_guard<std::mutex> lock(service().mutex);
+    service().timers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    service().start(timer, timeout_us, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    if (!timer || period == 0) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    service().start(timer, period, period);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(service().mutex);
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(service().mutex);
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    auto& timers = service().timers;
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (timers[i] == timer) {
+            timers.erase(timers.begin() + i);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(service().mutex);
+    return timer && timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)micros();
+}
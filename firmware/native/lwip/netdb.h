@@ -0,0 +1,8 @@
+#ifndef NATIVE_LWIP_NETDB_H
+#define NATIVE_LWIP_NETDB_H
+
+// Stand-in for lwIP's resolver: the host's getaddrinfo()
+
+#include <netdb.h>
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef NATIVE_LWIP_SOCKETS_H
+#define NATIVE_LWIP_SOCKETS_H
+
+// Stand-in for the lwIP BSD socket API: the host's own sockets, so the
+// MQTT engine can talk to a real broker (e.g. a local Mosquitto).
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#endif
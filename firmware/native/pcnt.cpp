@@ -0,0 +1,130 @@
+#include "driver/pcnt.h"
+#include "NativeHal.h"
+#include <mutex>
+
+namespace {
+
+struct Unit {
+    bool configured = false;
+    bool paused = false;
+    unsigned long base = 0;   // flow pulses at the last clear
+    unsigned long frozen = 0; // count while paused
+    int16_t hLim = INT16_MAX;
+    int16_t threshold0 = 0;
+    bool threshold0Enabled = false;
+    bool threshold0Fired = false;
+    void (*handler)(void*) = nullptr;
+    void* arg = nullptr;
+};
+
+Unit units[PCNT_UNIT_MAX];
+std::mutex mutex;
+
+bool validUnit(pcnt_unit_t unit) {
+    return unit >= 0 && unit < PCNT_UNIT_MAX;
+}
+
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+    if (!config || !validUnit(config->unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    Unit& u = units[config->unit];
+    u.configured = true;
+    u.hLim = config->counter_h_lim;
+    u.base = NativeHal::getFlowPulses();
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+    if (!validUnit(unit) || !count) return ESP_ERR_INVALID_ARG;
+    void (*fire)(void*) = nullptr;
+    void* arg = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Unit& u = units[unit];
+        unsigned long pulses = u.paused ? u.frozen : NativeHal::getFlowPulses() - u.base;
+        *count = pulses > (unsigned long)u.hLim ? u.hLim : (int16_t)pulses;
+        if (u.threshold0Enabled && !u.threshold0Fired && *count >= u.threshold0) {
+            u.threshold0Fired = true;
+            fire = u.handler;
+            arg = u.arg;
+        }
+    }
+    if (fire) fire(arg);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    Unit& u = units[unit];
+    if (!u.paused) u.frozen = NativeHal::getFlowPulses() - u.base;
+    u.paused = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    Unit& u = units[unit];
+    if (u.paused) u.base = NativeHal::getFlowPulses() - u.frozen;
+    u.paused = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    Unit& u = units[unit];
+    u.base = NativeHal::getFlowPulses();
+    u.frozen = 0;
+    u.threshold0Fired = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t value) {
+    (void)value;
+    return validUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+    return validUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_set_event_value(pcnt_unit_t unit, pcnt_evt_type_t evt, int16_t value) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (evt == PCNT_EVT_THRES_0) units[unit].threshold0 = value;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (evt == PCNT_EVT_THRES_0) {
+        units[unit].threshold0Enabled = true;
+        units[unit].threshold0Fired = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_disable(pcnt_unit_t unit, pcnt_evt_type_t evt) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (evt == PCNT_EVT_THRES_0) units[unit].threshold0Enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isr_handler)(void*), void* args) {
+    if (!validUnit(unit)) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(mutex);
+    units[unit].handler = isr_handler;
+    units[unit].arg = args;
+    return ESP_OK;
+}
@@ -0,0 +1,865 @@
+// Fleet simulator: thousands of devices in one process, for load-testing
+// the broker and the backend's ingestion path.
+//
+//   pio run -e fleet -t exec -a "--broker=127.0.0.1:1883 --devices=2000 --rate=400"
+//
+// Every simulated device has its own MqttEngine session (the firmware's
+// client, one TCP connection each) and speaks the firmware's protocol:
+// binary v1 status from StatusEncoder on plantcare/<id>/status, retained
+// online flag with a last will, commands on plantcare/<id>/cmd, BATCH acks
+// on plantcare/<id>/ack. Its soil dries along a configurable curve in
+// simulated time and is watered by the same IDLE/WATERING/SOAKING cycle,
+// inside the configured time windows.
+//
+// All sessions share one thread: epoll on the engine sockets plus a timer
+// heap. Status reports are spread evenly so the fleet publishes --rate
+// messages per second in total. A controller session subscribes to every
+// status (delivered throughput, publish-to-delivery latency) and sends
+// BATCH commands at --cmd-rate, timing each until its ack arrives.
+//
+// Run the backend against the same broker to load its ingestion; the
+// controller's numbers are what the broker delivered to one subscriber.
+
+#include <Arduino.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include "NativeHal.h"
+#include "MqttEngine.h"
+#include "NetworkManager.h"
+#include "PlantControl.h"
+#include "StatusEncoder.h"
+#include "JsonWriter.h"
+
+namespace {
+
+// Model resolution: watering phases end exactly, drying moves in steps of this
+#define SIM_STEP_SEC 60.0
+#define SIM_RECONNECT_MS 1000
+// Report deferred because the session was writing
+#define SIM_RETRY_MS 5
+#define SIM_STATS_MS 5000
+// Acks waiting for the session or their PUBACK; a command beyond that is dropped
+#define SIM_ACK_SLOTS 4
+#define SIM_CMD_SLOTS 16
+// Commands by sequence number, awaiting their ack
+#define SIM_PENDING 4096
+#define SIM_CMD_TIMEOUT_MS 10000
+// ConfigManager defaults
+#define SIM_AIR 1700
+#define SIM_WATER 700
+
+enum DryingCurve { CURVE_LINEAR, CURVE_EXPONENTIAL };
+
+struct FleetOptions {
+    char host[64] = "127.0.0.1";
+    uint16_t port = 1883;
+    int devices = 1000;
+    double rate = 100;          // status reports per second, whole fleet
+    double durationSec = 30;
+    double cmdRate = 10;        // BATCH commands per second
+    double rampPerSec = 500;    // new connections per second at start-up
+    const char* prefix = "sim";
+    uint32_t seed = 1;
+
+    // Drying model
+    DryingCurve curve = CURVE_LINEAR;
+    double timeScale = 60;      // simulated seconds per real second
+    double startHour = 6;
+    double dryRate = 1.5;       // % per hour (exponential: at 50 %)
+    double drySpread = 0.3;     // per-device rate varies by +-spread
+    double daySwing = 0.5;      // drying at 15:00 is 1 + swing times the mean
+    double noise = 0.5;         // % on every reading
+    int threshold = 30;
+    double pumpSec = 5;
+    double gain = 4;            // % per pump-second
+    double soakSec = 60;
+};
+
+FleetOptions options;
+
+uint32_t rngState = 1;
+
+uint32_t nextRandom() {
+    // xorshift32: runs are repeatable for a given --seed
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// Uniform in [-1, 1)
+double uniform() {
+    return nextRandom() / 2147483648.0 - 1.0;
+}
+
+uint64_t nowUs() {
+    return micros();
+}
+
+// One MQTT session and its epoll registration
+struct Session {
+    MqttEngine engine;
+    int fd = -1;
+    uint32_t events = 0;
+    bool connectDue = false;
+    uint64_t connectAt = 0;
+};
+
+struct FleetStats {
+    uint32_t connects;
+    uint32_t connectFailures;
+    uint32_t disconnects;
+    uint32_t published;
+    uint64_t publishedBytes;
+    uint32_t deferred;
+    uint32_t backlogged;       // previous report not acknowledged yet: skipped
+    uint32_t delivered;
+    uint64_t deliveredBytes;
+    uint32_t commandsSent;
+    uint32_t commandsSkipped;  // controller window full
+    uint32_t acks;
+    uint32_t acksRejected;
+    uint32_t commandsReceived;
+    uint32_t commandsDropped;  // device had no room for the ack
+    uint32_t autoWaterings;
+    uint32_t manualWaterings;
+};
+
+FleetStats stats = {};
+std::vector<uint32_t> roundTripUs;
+std::vector<uint32_t> deliveryUs;
+
+struct SimDevice {
+    Session session;
+    int index = 0;
+    char id[32];
+    char statusTopic[64];
+    char cmdTopic[64];
+    char ackTopic[64];
+    char onlineTopic[64];
+    bool onlinePending = false;
+    uint64_t nextReportAt = 0;
+
+    // Model, in simulated seconds
+    double simTime = 0;
+    double moisture[SOIL_SENSOR_COUNT];
+    double channelFactor[SOIL_SENSOR_COUNT];
+    double dryRate = 0;
+    int state = IDLE;
+    double phaseEnd = 0;
+    int threshold = 30;
+    int windows[4] = {6, 10, 16, 19};
+
+    // Payloads stay put until the engine releases them
+    uint8_t status[StatusEncoder::MAX_SIZE];
+    bool statusBusy = false;
+    uint64_t statusSentAt = 0;
+    enum AckSlot : uint8_t { ACK_FREE, ACK_QUEUED, ACK_SENT };
+    char acks[SIM_ACK_SLOTS][128];
+    AckSlot ackState[SIM_ACK_SLOTS] = {};
+    uint32_t ackOrder[SIM_ACK_SLOTS] = {};
+    uint32_t ackCount = 0;
+
+    double dayFactor(double t) const {
+        double hour = fmod(t / 3600.0, 24.0);
+        return 1.0 + options.daySwing * sin(2 * M_PI * (hour - 9) / 24);
+    }
+
+    double dryingPerHour(int c, double t) const {
+        double r = dryRate * channelFactor[c] * dayFactor(t);
+        if (options.curve == CURVE_EXPONENTIAL) r *= moisture[c] / 50.0;
+        return r;
+    }
+
+    double average() const {
+        double sum = 0;
+        for (int c = 0; c < SOIL_SENSOR_COUNT; c++) sum += moisture[c];
+        return sum / SOIL_SENSOR_COUNT;
+    }
+
+    bool inWindow(double t) const {
+        int hour = (int)fmod(t / 3600.0, 24.0);
+        return (hour >= windows[0] && hour < windows[1]) || (hour >= windows[2] && hour < windows[3]);
+    }
+
+    void startWatering(double t, bool manual) {
+        state = WATERING;
+        phaseEnd = t + options.pumpSec;
+        if (manual) stats.manualWaterings++;
+        else stats.autoWaterings++;
+    }
+
+    void advance(double until) {
+        while (simTime < until) {
+            double step = until - simTime;
+            if (step > SIM_STEP_SEC) step = SIM_STEP_SEC;
+            if (state != IDLE && phaseEnd - simTime < step) step = phaseEnd - simTime;
+            for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+                double m = moisture[c] - dryingPerHour(c, simTime) * step / 3600.0;
+                if (state == WATERING) m += options.gain * channelFactor[c] * step;
+                moisture[c] = m < 0 ? 0 : (m > 100 ? 100 : m);
+            }
+            simTime += step;
+
+            if (state == WATERING && simTime >= phaseEnd) {
+                state = SOAKING;
+                phaseEnd = simTime + options.soakSec;
+            } else if (state == SOAKING && simTime >= phaseEnd) {
+                state = IDLE;
+            } else if (state == IDLE && average() < threshold && inWindow(simTime)) {
+                startWatering(simTime, false);
+            }
+        }
+    }
+
+    void fillStatus(StatusSnapshot& s) {
+        double sum = 0;
+        double rate = 0;
+        s.state = state;
+        s.channels = SOIL_SENSOR_COUNT;
+        for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+            double reading = moisture[c] + options.noise * uniform();
+            int percent = (int)lround(reading < 0 ? 0 : (reading > 100 ? 100 : reading));
+            sum += percent;
+            s.percent[c] = percent;
+            s.raw[c] = SIM_AIR - percent * (SIM_AIR - SIM_WATER) / 100;
+#if SOIL_EXT_ADC_CHIPS > 0
+            s.pin[c] = EXT_ADC_PIN_BASE + c;
+#else
+            s.pin[c] = SOIL_PINS[c];
+#endif
+            s.air[c] = SIM_AIR;
+            s.water[c] = SIM_WATER;
+            s.rate[c] = -dryingPerHour(c, simTime);
+            rate += dryingPerHour(c, simTime);
+        }
+        s.moistureAvg = sum / SOIL_SENSOR_COUNT;
+
+        double swing = sin(2 * M_PI * (fmod(simTime / 3600.0, 24.0) - 9) / 24);
+        s.dhtValid = true;
+        s.temperature = 20 + 6 * swing;
+        s.humidity = 55 - 15 * swing;
+        s.dhtAgeMs = 1000;
+
+        s.threshold = threshold;
+        memcpy(s.windows, windows, sizeof(windows));
+        s.triggerMode = 0;
+        s.rssi = -50 - (int)(nextRandom() % 30);
+        rate /= SOIL_SENSOR_COUNT;
+        double above = average() - threshold;
+        if (above <= 0) s.forecastHours = 0;
+        else if (rate <= 0 || above / rate > FORECAST_HORIZON_H) s.forecastHours = FORECAST_NEVER;
+        else s.forecastHours = above / rate;
+    }
+};
+
+struct PendingCommand {
+    uint32_t seq;
+    uint64_t sentAt; // 0 = free
+};
+
+struct Controller {
+    Session session;
+    char clientId[48];
+    bool subscribed = false;
+    uint32_t nextSeq = 1;
+    char payloads[SIM_CMD_SLOTS][96];
+    char topics[SIM_CMD_SLOTS][64];
+    bool busy[SIM_CMD_SLOTS] = {};
+    PendingCommand pending[SIM_PENDING] = {};
+};
+
+SimDevice* devices = nullptr;
+Controller controller;
+int epollFd = -1;
+
+enum TimerKind : uint8_t { TIMER_CONNECT, TIMER_REPORT };
+
+struct Timer {
+    uint64_t at;
+    int device;
+    TimerKind kind;
+    bool operator>(const Timer& other) const { return at > other.at; }
+};
+
+std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+
+uint64_t startUs = 0;
+uint64_t reportPeriodUs = 0;
+
+double simNow(uint64_t us) {
+    return options.startHour * 3600 + (us - startUs) / 1e6 * options.timeScale;
+}
+
+// Keeps the epoll registration in step with the engine's socket, which is
+// replaced on every connect and closed (dropping out of epoll) on failure
+void watch(Session& s, uint32_t key) {
+    int fd = s.engine.getSocket();
+    uint32_t want = EPOLLIN | (s.engine.wantsWrite() ? (uint32_t)EPOLLOUT : 0u);
+    if (fd != s.fd) {
+        s.fd = fd;
+        s.events = 0;
+    }
+    if (fd < 0 || want == s.events) return;
+    epoll_event ev = {};
+    ev.events = want;
+    ev.data.u32 = key;
+    int op = s.events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epollFd, op, fd, &ev) != 0 && errno == ENOENT) {
+        // Same number as a socket closed since: that registration is gone
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    s.events = want;
+}
+
+// plantcare/<prefix>-<n>/<type> of a simulated device, or nullptr
+SimDevice* findDevice(const char* topic, const char** type) {
+    if (strncmp(topic, "plantcare/", 10) != 0) return nullptr;
+    const char* id = topic + 10;
+    const char* slash = strchr(id, '/');
+    if (!slash) return nullptr;
+    const char* dash = (const char*)memrchr(id, '-', slash - id);
+    if (!dash) return nullptr;
+    unsigned long index = strtoul(dash + 1, nullptr, 10);
+    if (index >= (unsigned long)options.devices) return nullptr;
+    SimDevice* d = &devices[index];
+    size_t idLen = slash - id;
+    if (strlen(d->id) != idLen || memcmp(d->id, id, idLen) != 0) return nullptr;
+    *type = slash + 1;
+    return d;
+}
+
+// -- Devices --
+
+void deviceRelease(void* ctx, void* tag, bool delivered) {
+    (void)delivered;
+    SimDevice* d = (SimDevice*)ctx;
+    if (tag == d->status) d->statusBusy = false;
+    for (int i = 0; i < SIM_ACK_SLOTS; i++) {
+        if (tag == d->acks[i]) d->ackState[i] = SimDevice::ACK_FREE;
+    }
+}
+
+// Queued acks go out in order, as far as the session takes them
+void flushAcks(SimDevice& d) {
+    for (;;) {
+        int next = -1;
+        for (int i = 0; i < SIM_ACK_SLOTS; i++) {
+            if (d.ackState[i] == SimDevice::ACK_QUEUED && (next < 0 || d.ackOrder[i] < d.ackOrder[next])) next = i;
+        }
+        if (next < 0 || !d.session.engine.canPublish(MQTT_PUBLISH_QOS)) return;
+        if (!d.session.engine.publish(d.ackTopic, (const uint8_t*)d.acks[next], strlen(d.acks[next]),
+                                      MQTT_PUBLISH_QOS, false, d.acks[next])) return;
+        d.ackState[next] = SimDevice::ACK_SENT;
+    }
+}
+
+bool sendAck(SimDevice& d, const char* id, size_t idLen, bool ok, int applied, const char* error) {
+    int slot = -1;
+    for (int i = 0; i < SIM_ACK_SLOTS && slot < 0; i++) {
+        if (d.ackState[i] == SimDevice::ACK_FREE) slot = i;
+    }
+    if (slot < 0) return false;
+
+    char idCopy[CMD_ID_SIZE];
+    snprintf(idCopy, sizeof(idCopy), "%.*s", (int)idLen, id);
+    JsonWriter json(d.acks[slot], sizeof(d.acks[slot]));
+    json.beginObject();
+    json.field("id", (const char*)idCopy);
+    json.field("ok", ok);
+    json.field("applied", applied);
+    if (error) json.field("error", error);
+    json.endObject();
+    d.ackState[slot] = SimDevice::ACK_QUEUED;
+    d.ackOrder[slot] = d.ackCount++;
+    flushAcks(d);
+    return true;
+}
+
+// The settings PlantControl takes in a BATCH that change what this model does
+bool applySetting(SimDevice& d, const char* cmd, bool apply) {
+    int a[4];
+    if (sscanf(cmd, "SET_THRESHOLD:%d", &a[0]) == 1 && a[0] >= 0 && a[0] <= 100) {
+        if (apply) d.threshold = a[0];
+        return true;
+    }
+    if (sscanf(cmd, "SET_TIME_WINDOW:%d:%d:%d:%d", &a[0], &a[1], &a[2], &a[3]) == 4) {
+        if (apply) memcpy(d.windows, a, sizeof(a));
+        return true;
+    }
+    return strncmp(cmd, "SET_", 4) == 0; // accepted, no effect on the model
+}
+
+bool deviceMessage(void* ctx, const char* topic, const uint8_t* payload, size_t length) {
+    SimDevice& d = *(SimDevice*)ctx;
+    if (strcmp(topic, d.cmdTopic) != 0) return true;
+    char text[INBOX_PAYLOAD_SIZE];
+    if (length >= sizeof(text)) return true;
+    memcpy(text, payload, length);
+    text[length] = '\0';
+
+    if (strncmp(text, "BATCH:", 6) != 0) {
+        stats.commandsReceived++;
+        if (strcmp(text, "PUMP_ON") == 0) {
+            d.advance(simNow(nowUs()));
+            d.startWatering(d.simTime, true);
+        } else {
+            applySetting(d, text, true);
+        }
+        return true;
+    }
+
+    // <id>;CMD;CMD... -- all or nothing, as PlantControl::processBatch
+    char* p = text + 6;
+    char* id = p;
+    size_t idLen = strcspn(p, ";");
+    if (idLen >= CMD_ID_SIZE) idLen = CMD_ID_SIZE - 1;
+    char* cmds[CMD_BATCH_MAX];
+    int count = 0;
+    bool valid = true;
+    for (char* c = strchr(p, ';'); c && c[1]; c = strchr(c, ';')) {
+        *c++ = '\0';
+        if (count == CMD_BATCH_MAX || !applySetting(d, c, false)) {
+            valid = false;
+            break;
+        }
+        cmds[count++] = c;
+    }
+    stats.commandsReceived++;
+    if (!sendAck(d, id, idLen, valid, valid ? count : 0, valid ? nullptr : "invalid command")) {
+        stats.commandsDropped++;
+        return true;
+    }
+    if (valid) {
+        for (int i = 0; i < count; i++) {
+            char* end = strchr(cmds[i], ';');
+            if (end) *end = '\0';
+            applySetting(d, cmds[i], true);
+        }
+    }
+    return true;
+}
+
+void scheduleReport(SimDevice& d, uint64_t at) {
+    d.nextReportAt = at;
+    timers.push({at, d.index, TIMER_REPORT});
+}
+
+void report(SimDevice& d, uint64_t now) {
+    MqttEngine& engine = d.session.engine;
+    if (!engine.connected()) return; // the next session starts over
+    if (d.statusBusy) {
+        // The broker is behind: skip this one rather than pile up
+        stats.backlogged++;
+        scheduleReport(d, now + reportPeriodUs);
+        return;
+    }
+    if (!engine.canPublish(MQTT_PUBLISH_QOS)) {
+        stats.deferred++;
+        scheduleReport(d, now + SIM_RETRY_MS * 1000ULL);
+        return;
+    }
+    d.advance(simNow(now));
+    StatusSnapshot s;
+    d.fillStatus(s);
+    size_t len = StatusEncoder::encode(d.status, sizeof(d.status), s);
+    if (len && engine.publish(d.statusTopic, d.status, len, MQTT_PUBLISH_QOS, false, d.status)) {
+        d.statusBusy = true;
+        d.statusSentAt = now;
+        stats.published++;
+        stats.publishedBytes += len;
+    }
+    scheduleReport(d, now + reportPeriodUs);
+}
+
+void onDeviceEvent(SimDevice& d, MqttEvent event, uint64_t now) {
+    if (event == MQTT_EVENT_CONNECTED) {
+        stats.connects++;
+        d.session.engine.subscribe(d.cmdTopic, MQTT_PUBLISH_QOS);
+        d.onlinePending = true;
+        // First report at this device's slot in the period
+        uint64_t slot = reportPeriodUs * d.index / options.devices;
+        uint64_t phase = (now - startUs) % reportPeriodUs;
+        uint64_t wait = slot >= phase ? slot - phase : reportPeriodUs - phase + slot;
+        scheduleReport(d, now + wait);
+    } else if (event == MQTT_EVENT_CONNECT_FAILED || event == MQTT_EVENT_DISCONNECTED) {
+        if (event == MQTT_EVENT_CONNECT_FAILED) stats.connectFailures++;
+        else stats.disconnects++;
+        d.statusBusy = false;
+        d.nextReportAt = 0;
+        memset(d.ackState, 0, sizeof(d.ackState));
+        if (!d.session.connectDue) {
+            d.session.connectDue = true;
+            uint64_t jitter = nextRandom() % (SIM_RECONNECT_MS * 1000ULL);
+            timers.push({now + SIM_RECONNECT_MS * 1000ULL + jitter, d.index, TIMER_CONNECT});
+        }
+    }
+    if (d.onlinePending && d.session.engine.canPublish(MQTT_PUBLISH_QOS)) {
+        static const uint8_t ONLINE[] = {'t', 'r', 'u', 'e'};
+        if (d.session.engine.publish(d.onlineTopic, ONLINE, sizeof(ONLINE), MQTT_PUBLISH_QOS, true, nullptr)) {
+            d.onlinePending = false;
+        }
+    }
+    flushAcks(d);
+}
+
+void pollDevice(SimDevice& d, uint64_t now) {
+    MqttEvent event = d.session.engine.poll();
+    onDeviceEvent(d, event, now);
+    watch(d.session, d.index);
+}
+
+void connectDevice(SimDevice& d, uint64_t now) {
+    d.session.connectDue = false;
+    if (d.session.engine.connected() || d.session.engine.connecting()) return;
+    if (!d.session.engine.connect()) {
+        onDeviceEvent(d, MQTT_EVENT_CONNECT_FAILED, now);
+        return;
+    }
+    pollDevice(d, now);
+}
+
+void setupDevice(SimDevice& d, int index) {
+    d.index = index;
+    snprintf(d.id, sizeof(d.id), "%s-%05d", options.prefix, index);
+    snprintf(d.statusTopic, sizeof(d.statusTopic), "plantcare/%s/status", d.id);
+    snprintf(d.cmdTopic, sizeof(d.cmdTopic), "plantcare/%s/cmd", d.id);
+    snprintf(d.ackTopic, sizeof(d.ackTopic), "plantcare/%s/ack", d.id);
+    snprintf(d.onlineTopic, sizeof(d.onlineTopic), "plantcare/%s/online", d.id);
+
+    d.simTime = simNow(startUs);
+    d.threshold = options.threshold;
+    d.dryRate = options.dryRate * (1 + options.drySpread * uniform());
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        d.channelFactor[c] = 1 + 0.2 * uniform();
+        // Anywhere between just watered and due
+        d.moisture[c] = options.threshold + 5 + 30 * (uniform() + 1) / 2;
+    }
+
+    MqttEngine& e = d.session.engine;
+    e.setServer(options.host, options.port);
+    e.setClientId(d.id);
+    e.setWill(d.onlineTopic, "false", true);
+    e.setHandlers(deviceMessage, deviceRelease, &d);
+}
+
+// -- Controller --
+
+void controllerRelease(void* ctx, void* tag, bool delivered) {
+    (void)ctx;
+    (void)delivered;
+    for (int i = 0; i < SIM_CMD_SLOTS; i++) {
+        if (tag == controller.payloads[i]) controller.busy[i] = false;
+    }
+}
+
+bool controllerMessage(void* ctx, const char* topic, const uint8_t* payload, size_t length) {
+    (void)ctx;
+    uint64_t now = nowUs();
+    const char* type;
+    SimDevice* d = findDevice(topic, &type);
+    if (!d) return true;
+
+    if (strcmp(type, "status") == 0) {
+        stats.delivered++;
+        stats.deliveredBytes += length;
+        if (d->statusSentAt) {
+            deliveryUs.push_back((uint32_t)(now - d->statusSentAt));
+            d->statusSentAt = 0;
+        }
+    } else if (strcmp(type, "ack") == 0) {
+        // {"id":"<seq>","ok":...}
+        char text[128];
+        size_t n = length < sizeof(text) - 1 ? length : sizeof(text) - 1;
+        memcpy(text, payload, n);
+        text[n] = '\0';
+        const char* id = strstr(text, "\"id\":\"");
+        if (!id) return true;
+        uint32_t seq = strtoul(id + 6, nullptr, 10);
+        PendingCommand& p = controller.pending[seq % SIM_PENDING];
+        if (p.sentAt && p.seq == seq) {
+            roundTripUs.push_back((uint32_t)(now - p.sentAt));
+            p.sentAt = 0;
+            stats.acks++;
+            if (!strstr(text, "\"ok\":true")) stats.acksRejected++;
+        }
+    }
+    return true;
+}
+
+void sendCommand(uint64_t now) {
+    MqttEngine& e = controller.session.engine;
+    int slot = -1;
+    for (int i = 0; i < SIM_CMD_SLOTS && slot < 0; i++) {
+        if (!controller.busy[i]) slot = i;
+    }
+    if (!controller.subscribed || slot < 0 || !e.canPublish(MQTT_PUBLISH_QOS)) {
+        stats.commandsSkipped++;
+        return;
+    }
+    int index = nextRandom() % options.devices;
+    if (!devices[index].session.engine.connected()) {
+        stats.commandsSkipped++;
+        return;
+    }
+    uint32_t seq = controller.nextSeq++;
+    snprintf(controller.topics[slot], sizeof(controller.topics[slot]), "plantcare/%s/cmd", devices[index].id);
+    int len = snprintf(controller.payloads[slot], sizeof(controller.payloads[slot]),
+                       "BATCH:%u;SET_THRESHOLD:%d", (unsigned)seq, options.threshold - 5 + (int)(nextRandom() % 11));
+    if (!e.publish(controller.topics[slot], (const uint8_t*)controller.payloads[slot], len, MQTT_PUBLISH_QOS, false,
+                   controller.payloads[slot])) {
+        stats.commandsSkipped++;
+        return;
+    }
+    controller.busy[slot] = true;
+    controller.pending[seq % SIM_PENDING] = {seq, now};
+    stats.commandsSent++;
+}
+
+void pollController(uint64_t now) {
+    Session& s = controller.session;
+    MqttEvent event = s.engine.poll();
+    if (event == MQTT_EVENT_CONNECTED) {
+        s.engine.subscribe("plantcare/+/status", 0);
+        s.engine.subscribe("plantcare/+/ack", MQTT_PUBLISH_QOS);
+        controller.subscribed = true;
+    } else if (event == MQTT_EVENT_CONNECT_FAILED || event == MQTT_EVENT_DISCONNECTED) {
+        controller.subscribed = false;
+        memset(controller.busy, 0, sizeof(controller.busy));
+        s.connectDue = true;
+        s.connectAt = now + SIM_RECONNECT_MS * 1000ULL;
+    }
+    watch(s, options.devices);
+}
+
+// -- Report --
+
+double percentileMs(std::vector<uint32_t>& samples, double p) {
+    if (samples.empty()) return 0;
+    size_t i = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[i] / 1000.0;
+}
+
+void printLatency(const char* name, std::vector<uint32_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("  %-16s n=%zu  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n", name, samples.size(),
+           percentileMs(samples, 50), percentileMs(samples, 90), percentileMs(samples, 99),
+           percentileMs(samples, 100));
+}
+
+void printProgress(uint64_t now, FleetStats& last, uint64_t lastAt) {
+    int connected = 0;
+    for (int i = 0; i < options.devices; i++) {
+        if (devices[i].session.engine.connected()) connected++;
+    }
+    double sec = (now - lastAt) / 1e6;
+    printf("[%6.1f s] connected %d/%d  published %.0f/s  delivered %.0f/s  commands %u acked %u  skipped %u\n",
+           (now - startUs) / 1e6, connected, options.devices, (stats.published - last.published) / sec,
+           (stats.delivered - last.delivered) / sec, stats.commandsSent, stats.acks, stats.backlogged);
+    fflush(stdout);
+    last = stats;
+}
+
+void printSummary(uint64_t elapsedUs) {
+    double sec = elapsedUs / 1e6;
+    uint32_t lost = 0;
+    uint64_t now = nowUs();
+    for (const PendingCommand& p : controller.pending) {
+        if (p.sentAt && now - p.sentAt >= SIM_CMD_TIMEOUT_MS * 1000ULL) lost++;
+    }
+    printf("\nFleet: %d devices, %.1f s, target %.0f reports/s, %d channels, %s drying at %.2f %%/h\n",
+           options.devices, sec, options.rate, SOIL_SENSOR_COUNT,
+           options.curve == CURVE_LINEAR ? "linear" : "exponential", options.dryRate);
+    printf("  sessions         %u connects, %u failed attempts, %u dropped\n",
+           stats.connects, stats.connectFailures, stats.disconnects);
+    printf("  status           published %u (%.1f/s, %.0f B avg), deferred %u, skipped unacknowledged %u\n",
+           stats.published, stats.published / sec,
+           stats.published ? (double)stats.publishedBytes / stats.published : 0.0, stats.deferred, stats.backlogged);
+    printf("  delivered        %u (%.1f/s, %.1f kB/s, %.2f %% of published)\n", stats.delivered,
+           stats.delivered / sec, stats.deliveredBytes / sec / 1024,
+           stats.published ? 100.0 * stats.delivered / stats.published : 0.0);
+    printf("  commands         sent %u, skipped %u, received %u, dropped %u, acked %u (%u rejected), "
+           "unanswered after %d s: %u\n", stats.commandsSent, stats.commandsSkipped, stats.commandsReceived,
+           stats.commandsDropped, stats.acks, stats.acksRejected, SIM_CMD_TIMEOUT_MS / 1000, lost);
+    printLatency("command rtt", roundTripUs);
+    printLatency("status delivery", deliveryUs);
+    printf("  simulated        %.1f h, waterings %u automatic, %u by command\n",
+           sec * options.timeScale / 3600, stats.autoWaterings, stats.manualWaterings);
+}
+
+bool parseOptions(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = strchr(a, '=');
+        v = v ? v + 1 : "";
+        if (strncmp(a, "--broker=", 9) == 0) {
+            const char* colon = strrchr(v, ':');
+            size_t hostLen = colon ? (size_t)(colon - v) : strlen(v);
+            snprintf(options.host, sizeof(options.host), "%.*s", (int)hostLen, v);
+            if (colon) options.port = (uint16_t)atoi(colon + 1);
+        } else if (strncmp(a, "--devices=", 10) == 0) options.devices = atoi(v);
+        else if (strncmp(a, "--rate=", 7) == 0) options.rate = atof(v);
+        else if (strncmp(a, "--duration=", 11) == 0) options.durationSec = atof(v);
+        else if (strncmp(a, "--cmd-rate=", 11) == 0) options.cmdRate = atof(v);
+        else if (strncmp(a, "--ramp=", 7) == 0) options.rampPerSec = atof(v);
+        else if (strncmp(a, "--prefix=", 9) == 0) options.prefix = v;
+        else if (strncmp(a, "--seed=", 7) == 0) options.seed = (uint32_t)strtoul(v, nullptr, 10);
+        else if (strncmp(a, "--curve=", 8) == 0) options.curve = strcmp(v, "exp") == 0 ? CURVE_EXPONENTIAL : CURVE_LINEAR;
+        else if (strncmp(a, "--time-scale=", 13) == 0) options.timeScale = atof(v);
+        else if (strncmp(a, "--start-hour=", 13) == 0) options.startHour = atof(v);
+        else if (strncmp(a, "--dry-rate=", 11) == 0) options.dryRate = atof(v);
+        else if (strncmp(a, "--dry-spread=", 13) == 0) options.drySpread = atof(v);
+        else if (strncmp(a, "--day-swing=", 12) == 0) options.daySwing = atof(v);
+        else if (strncmp(a, "--noise=", 8) == 0) options.noise = atof(v);
+        else if (strncmp(a, "--threshold=", 12) == 0) options.threshold = atoi(v);
+        else if (strncmp(a, "--pump-sec=", 11) == 0) options.pumpSec = atof(v);
+        else if (strncmp(a, "--gain=", 7) == 0) options.gain = atof(v);
+        else {
+            fprintf(stderr, "unknown option %s\n"
+                    "  --broker=host:port --devices=N --rate=reports/s --duration=s --cmd-rate=cmds/s\n"
+                    "  --ramp=connects/s --prefix=id --seed=N\n"
+                    "  --curve=linear|exp --dry-rate=%%/h --dry-spread=f --day-swing=f --noise=%%\n"
+                    "  --time-scale=x --start-hour=h --threshold=%% --pump-sec=s --gain=%%/s\n", a);
+            return false;
+        }
+    }
+    if (options.devices < 1 || options.rate <= 0 || options.rampPerSec <= 0) {
+        fprintf(stderr, "--devices, --rate and --ramp must be positive\n");
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (!parseOptions(argc, argv)) return 2;
+    NativeHal::setSerialEcho(false);
+    rngState = options.seed ? options.seed : 1;
+
+    // One socket per device, plus the controller, epoll and stdio
+    rlimit files;
+    getrlimit(RLIMIT_NOFILE, &files);
+    rlim_t need = (rlim_t)options.devices + 16;
+    if (files.rlim_cur < need) {
+        files.rlim_cur = need < files.rlim_max ? need : files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+    if (files.rlim_cur < need) {
+        options.devices = (int)files.rlim_cur - 16;
+        fprintf(stderr, "open file limit %lu: simulating %d devices\n", (unsigned long)files.rlim_cur, options.devices);
+    }
+
+    epollFd = epoll_create1(0);
+    startUs = nowUs();
+    reportPeriodUs = (uint64_t)(options.devices / options.rate * 1e6);
+    if (reportPeriodUs == 0) reportPeriodUs = 1;
+
+    devices = new SimDevice[options.devices];
+    for (int i = 0; i < options.devices; i++) {
+        setupDevice(devices[i], i);
+        uint64_t at = startUs + (uint64_t)(i / options.rampPerSec * 1e6);
+        devices[i].session.connectDue = true;
+        timers.push({at, i, TIMER_CONNECT});
+    }
+    roundTripUs.reserve(options.cmdRate * options.durationSec + 16);
+    deliveryUs.reserve(options.rate * options.durationSec + 16);
+
+    snprintf(controller.clientId, sizeof(controller.clientId), "%s-controller-%d", options.prefix, (int)getpid());
+    controller.session.engine.setServer(options.host, options.port);
+    controller.session.engine.setClientId(controller.clientId);
+    controller.session.engine.setHandlers(controllerMessage, controllerRelease, nullptr);
+    controller.session.connectDue = true;
+
+    printf("Fleet: %d devices on %s:%u, %.0f reports/s (every %.1f s each), %.1f commands/s, %.0f s\n",
+           options.devices, options.host, options.port, options.rate, reportPeriodUs / 1e6, options.cmdRate,
+           options.durationSec);
+
+    const uint64_t endUs = startUs + (uint64_t)(options.durationSec * 1e6);
+    const uint64_t cmdPeriodUs = options.cmdRate > 0 ? (uint64_t)(1e6 / options.cmdRate) : 0;
+    uint64_t nextCmdAt = startUs + 1000000;
+    uint64_t nextSweepAt = startUs + 1000000;
+    uint64_t lastStatsAt = startUs;
+    FleetStats lastStats = stats;
+    std::vector<epoll_event> ready(1024);
+
+    uint64_t now = startUs;
+    while (now < endUs) {
+        Session& cs = controller.session;
+        if (cs.connectDue && now >= cs.connectAt) {
+            cs.connectDue = false;
+            if (!cs.engine.connect()) {
+                cs.connectDue = true;
+                cs.connectAt = now + SIM_RECONNECT_MS * 1000ULL;
+            }
+            pollController(now);
+        }
+
+        int timeoutMs = 100;
+        if (!timers.empty()) {
+            int64_t wait = ((int64_t)timers.top().at - (int64_t)now) / 1000;
+            if (wait < timeoutMs) timeoutMs = wait < 0 ? 0 : (int)wait;
+        }
+        int n = epoll_wait(epollFd, ready.data(), (int)ready.size(), timeoutMs);
+        now = nowUs();
+
+        for (int i = 0; i < n; i++) {
+            uint32_t key = ready[i].data.u32;
+            if (key == (uint32_t)options.devices) pollController(now);
+            else pollDevice(devices[key], now);
+        }
+
+        while (!timers.empty() && timers.top().at <= now) {
+            Timer t = timers.top();
+            timers.pop();
+            SimDevice& d = devices[t.device];
+            if (t.kind == TIMER_CONNECT) connectDevice(d, now);
+            else if (t.at == d.nextReportAt) report(d, now); // else superseded
+        }
+
+        if (cmdPeriodUs) {
+            while (nextCmdAt <= now) {
+                sendCommand(now);
+                nextCmdAt += cmdPeriodUs;
+            }
+            watch(controller.session, options.devices);
+        }
+
+        // Keep-alive, retransmits and connect timeouts need polls without traffic
+        if (now >= nextSweepAt) {
+            for (int i = 0; i < options.devices; i++) {
+                if (devices[i].session.fd >= 0) pollDevice(devices[i], now);
+            }
+            pollController(now);
+            nextSweepAt = now + 1000000;
+        }
+
+        if (now - lastStatsAt >= SIM_STATS_MS * 1000ULL) {
+            printProgress(now, lastStats, lastStatsAt);
+            lastStatsAt = now;
+        }
+    }
+
+    // Let the last deliveries and acks arrive
+    uint64_t drainUntil = nowUs() + 500000;
+    while ((now = nowUs()) < drainUntil) {
+        int n = epoll_wait(epollFd, ready.data(), (int)ready.size(), 50);
+        for (int i = 0; i < n; i++) {
+            uint32_t key = ready[i].data.u32;
+            if (key == (uint32_t)options.devices) pollController(now);
+            else pollDevice(devices[key], now);
+        }
+    }
+
+    printSummary(now - startUs);
+    for (int i = 0; i < options.devices; i++) devices[i].session.engine.disconnect();
+    controller.session.engine.disconnect();
+    return 0;
+}
@@ -0,0 +1,601 @@
+// Trace replay: days of the watering state machine in a few seconds, on a
+// virtual clock, for comparing control-logic changes run against run.
+//
+//   pio run -e replay -t exec -a "--days=14 --check-ahead"
+//   pio run -e replay -t exec -a "--trace=bed.csv --log=bed.log"
+//
+// The firmware runs unmodified (setup(), then loop()) on the native
+// stand-ins with NativeHal::useVirtualClock(): millis() and the esp_timer
+// callbacks (ADC sampler, DHT, pump cutoff) only move when the harness
+// advances the clock, straight to the next scheduler deadline, so a run
+// depends on its inputs alone. The NTP stand-in reports a local time that
+// starts at --start-hour and runs on with millis().
+//
+// Soil moisture comes from either
+//   a drying model (default, closed loop): every channel dries along a
+//   linear or exponential curve, faster in the afternoon, and gains --gain
+//   % per second the pump pin is driven HIGH, plus seeded noise
+//   a trace (--trace=file.csv): one header line naming the columns, then
+//   rows of numbers, linearly interpolated between rows. Columns: t
+//   (seconds from start, ascending), ch<N> (moisture %) or raw<N> (ADC
+//   counts) per channel, temp and hum (DHT22). Missing channels read like
+//   ch0. Open loop unless --gain is given, which adds the pump's water on
+//   top of the trace.
+//
+// Output: a decision log (state changes, log lines, alerts, doses, acks;
+// one per line, "d<day> HH:MM:SS.mmm ...") to stdout or --log, and a
+// summary of pump-on time and threshold breaches (average moisture below
+// the configured threshold) to stderr; --quiet leaves out the log. Diff the
+// logs of two builds to see what a change did to the decisions.
+//
+// --check-ahead fails the run (exit 1) when the soil of a pre-emptive
+// session ("Watering ahead", see PlantControl::waterAhead()) reads below
+// the threshold before the next window opens: that dose was too small.
+
+#include <Arduino.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "NativeHal.h"
+#include "ConfigManager.h"
+#include "SensorManager.h"
+#include "PlantControl.h"
+#include "Scheduler.h"
+
+#if MQTT_ASYNC
+#error "replay captures publishes through the PubSubClient stand-in: build with MQTT_ASYNC=0"
+#endif
+#if SOIL_EXT_ADC_CHIPS > 0
+#error "replay drives the on-chip SOIL_PINS channels only"
+#endif
+
+// Defined in src/main.cpp
+void setup();
+void loop();
+extern ConfigManager configManager;
+extern SensorManager sensorManager;
+extern PlantControl plantControl;
+extern Scheduler scheduler;
+
+namespace {
+
+// 2026-06-01 00:00 local
+#define REPLAY_EPOCH 1780272000UL
+#define REPLAY_DAY_MS 86400000ULL
+// Longest clock step: inputs are applied at least this often
+#define REPLAY_MAX_STEP_MS 1000
+#define REPLAY_MAX_CMDS 32
+#define REPLAY_MAX_COLUMNS 24
+// Dips below the threshold this close together are one breach (noise at the edge)
+#define REPLAY_BREACH_GAP_MS (10UL * 60 * 1000)
+
+enum DryingCurve { CURVE_LINEAR, CURVE_EXPONENTIAL };
+
+struct TimedCommand {
+    uint64_t atMs;
+    std::string payload;
+};
+
+struct ReplayOptions {
+    double days = 7;
+    double startHour = 0;
+    const char* trace = nullptr;
+    const char* logPath = nullptr;
+    bool quiet = false;
+    bool checkAhead = false;
+
+    // Drying model
+    DryingCurve curve = CURVE_LINEAR;
+    double dryRate = 1.5;   // % per hour (exponential: at 50 %)
+    double drySpread = 0.2; // per-channel rate varies by +-spread
+    double daySwing = 0.5;  // drying at 15:00 is 1 + swing times the mean
+    double gain = -1;       // % per pump-second; -1 = 2 (model) or 0 (trace)
+    double noise = 0.3;     // % on every reading
+    double initial = 45;
+    uint32_t seed = 1;
+
+    std::vector<TimedCommand> commands;
+};
+
+ReplayOptions options;
+FILE* logOut = stdout;
+
+// -- Deterministic noise --
+
+uint32_t rngState = 1;
+
+double uniform() {
+    // xorshift32
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState / 4294967296.0;
+}
+
+// -- Inputs --
+
+struct Trace {
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> rows;
+    int timeCol = -1;
+    int tempCol = -1;
+    int humCol = -1;
+    int percentCol[SOIL_SENSOR_COUNT];
+    int rawCol[SOIL_SENSOR_COUNT];
+    size_t cursor = 0; // row at or before the current time
+};
+
+Trace trace;
+
+bool splitCsv(char* line, std::vector<std::string>& out) {
+    out.clear();
+    for (char* field = strtok(line, ",\r\n"); field; field = strtok(nullptr, ",\r\n")) {
+        while (*field == ' ') field++;
+        out.push_back(field);
+    }
+    return !out.empty();
+}
+
+bool loadTrace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "cannot open trace %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    char line[512];
+    std::vector<std::string> fields;
+    int lineNo = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)) {
+        lineNo++;
+        if (line[0] == '#' || !splitCsv(line, fields)) continue;
+        if (trace.names.empty()) {
+            trace.names = fields;
+            continue;
+        }
+        if (fields.size() != trace.names.size()) {
+            fprintf(stderr, "%s:%d: %zu fields, header has %zu\n", path, lineNo, fields.size(), trace.names.size());
+            ok = false;
+            break;
+        }
+        std::vector<double> row;
+        for (const std::string& field : fields) row.push_back(atof(field.c_str()));
+        trace.rows.push_back(row);
+    }
+    fclose(f);
+    if (!ok) return false;
+
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) trace.percentCol[c] = trace.rawCol[c] = -1;
+    for (size_t i = 0; i < trace.names.size() && i < REPLAY_MAX_COLUMNS; i++) {
+        const char* name = trace.names[i].c_str();
+        int channel;
+        if (strcmp(name, "t") == 0) trace.timeCol = i;
+        else if (strcmp(name, "temp") == 0) trace.tempCol = i;
+        else if (strcmp(name, "hum") == 0) trace.humCol = i;
+        else if (sscanf(name, "ch%d", &channel) == 1 && channel >= 0 && channel < SOIL_SENSOR_COUNT) trace.percentCol[channel] = i;
+        else if (sscanf(name, "raw%d", &channel) == 1 && channel >= 0 && channel < SOIL_SENSOR_COUNT) trace.rawCol[channel] = i;
+        else fprintf(stderr, "%s: ignoring column %s\n", path, name);
+    }
+    if (trace.timeCol < 0 || trace.rows.empty()) {
+        fprintf(stderr, "%s: needs a t column and at least one row\n", path);
+        return false;
+    }
+    if (trace.percentCol[0] < 0 && trace.rawCol[0] < 0) {
+        fprintf(stderr, "%s: needs ch0 or raw0\n", path);
+        return false;
+    }
+    for (size_t i = 1; i < trace.rows.size(); i++) {
+        if (trace.rows[i][trace.timeCol] < trace.rows[i - 1][trace.timeCol]) {
+            fprintf(stderr, "%s: t must not decrease (row %zu)\n", path, i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Column value at sec, interpolated; the first/last row holds outside the trace
+double traceValue(int col, double sec) {
+    const std::vector<std::vector<double>>& rows = trace.rows;
+    while (trace.cursor + 1 < rows.size() && rows[trace.cursor + 1][trace.timeCol] <= sec) trace.cursor++;
+    const std::vector<double>& a = rows[trace.cursor];
+    if (trace.cursor + 1 >= rows.size() || sec <= a[trace.timeCol]) return a[col];
+    const std::vector<double>& b = rows[trace.cursor + 1];
+    double span = b[trace.timeCol] - a[trace.timeCol];
+    if (span <= 0) return b[col];
+    return a[col] + (b[col] - a[col]) * (sec - a[trace.timeCol]) / span;
+}
+
+// Next time the trace has a row, so steps land on recorded samples
+uint64_t traceNextMs(uint64_t nowMs) {
+    double sec = nowMs / 1000.0;
+    for (size_t i = trace.cursor; i < trace.rows.size(); i++) {
+        double t = trace.rows[i][trace.timeCol];
+        if (t > sec) return (uint64_t)ceil(t * 1000);
+    }
+    return UINT64_MAX;
+}
+
+struct Soil {
+    double percent[SOIL_SENSOR_COUNT];
+    double rateScale[SOIL_SENSOR_COUNT];
+    double watered[SOIL_SENSOR_COUNT]; // trace mode: pump water on top of the trace
+};
+
+Soil soil;
+
+double hourOfDay(uint64_t nowMs) {
+    return fmod(options.startHour + nowMs / 3600000.0, 24.0);
+}
+
+void initSoil() {
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        soil.percent[c] = options.initial;
+        soil.rateScale[c] = 1 + options.drySpread * (2 * uniform() - 1);
+        soil.watered[c] = 0;
+    }
+}
+
+// Dries the model by dtSec ending at nowMs and adds pumpSec of watering
+void stepSoil(uint64_t nowMs, double dtSec, double pumpSec, double gain) {
+    // Peak drying mid-afternoon, least before dawn
+    double swing = 1 + options.daySwing * cos((hourOfDay(nowMs) - 15) * M_PI / 12);
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        double perHour = options.dryRate * soil.rateScale[c] * swing;
+        if (options.curve == CURVE_EXPONENTIAL) perHour *= soil.percent[c] / 50;
+        double p = soil.percent[c] - perHour * dtSec / 3600 + gain * pumpSec;
+        soil.percent[c] = p < 0 ? 0 : p > 100 ? 100 : p;
+        soil.watered[c] += gain * pumpSec;
+    }
+}
+
+int percentToRaw(int channel, double percent) {
+    int air = sensorManager.getAirValue(channel);
+    int water = sensorManager.getWaterValue(channel);
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+    return (int)lround(air - (air - water) * percent / 100);
+}
+
+// Puts the inputs for nowMs on the ADC pins and the DHT line
+void applyInputs(uint64_t nowMs) {
+    double sec = nowMs / 1000.0;
+    double hour = hourOfDay(nowMs);
+    double temperature = 21 + 5 * cos((hour - 15) * M_PI / 12);
+    double humidity = 60 - 15 * cos((hour - 15) * M_PI / 12);
+    if (options.trace) {
+        if (trace.tempCol >= 0) temperature = traceValue(trace.tempCol, sec);
+        if (trace.humCol >= 0) humidity = traceValue(trace.humCol, sec);
+    }
+    NativeHal::setDHT((float)temperature, (float)humidity);
+
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        int raw;
+        if (!options.trace) {
+            raw = percentToRaw(c, soil.percent[c] + options.noise * (2 * uniform() - 1));
+        } else {
+            int pc = trace.percentCol[c] >= 0 || trace.rawCol[c] >= 0 ? c : 0;
+            if (trace.rawCol[pc] >= 0 && trace.percentCol[pc] < 0) {
+                raw = (int)lround(traceValue(trace.rawCol[pc], sec));
+                if (soil.watered[c] > 0) {
+                    int air = sensorManager.getAirValue(c);
+                    int water = sensorManager.getWaterValue(c);
+                    raw -= (int)lround((air - water) * soil.watered[c] / 100);
+                }
+            } else {
+                raw = percentToRaw(c, traceValue(trace.percentCol[pc], sec) + soil.watered[c]);
+            }
+        }
+        NativeHal::setAnalogValue(SOIL_PINS[c], raw);
+    }
+}
+
+// -- Decision log --
+
+void formatTime(uint64_t nowMs, char* buffer, size_t len) {
+    uint64_t ms = nowMs + (uint64_t)(options.startHour * 3600000);
+    unsigned day = ms / REPLAY_DAY_MS;
+    unsigned long inDay = ms % REPLAY_DAY_MS;
+    snprintf(buffer, len, "d%u %02lu:%02lu:%02lu.%03lu", day, inDay / 3600000, inDay / 60000 % 60,
+             inDay / 1000 % 60, inDay % 1000);
+}
+
+void logLine(const char* what, const char* detail) {
+    if (options.quiet) return;
+    char when[32];
+    formatTime(millis(), when, sizeof(when));
+    fprintf(logOut, "%s %s %s\n", when, what, detail);
+}
+
+const char* const STATE_NAMES[] = {"IDLE", "WATERING", "SOAKING", "TANK_EMPTY", "SENSOR_FAULT"};
+const int STATE_COUNT = sizeof(STATE_NAMES) / sizeof(STATE_NAMES[0]);
+
+struct Stats {
+    unsigned long publishes = 0;
+    unsigned long logLines = 0;
+    unsigned long alerts = 0;
+    unsigned long doses = 0;
+    unsigned long acks = 0;
+    unsigned long waterings = 0; // entries into WATERING
+    uint64_t stateMs[STATE_COUNT] = {};
+
+    // Average moisture below the threshold
+    unsigned long breaches = 0;
+    uint64_t breachMs = 0;
+    uint64_t longestBreachMs = 0;
+    uint64_t breachStartMs = 0;
+    uint64_t lastBelowMs = 0;
+    bool belowSeen = false;
+    float lowest = 100;
+    float highest = 0;
+
+    // Pre-emptive sessions, and those that fell below before the next window
+    unsigned long aheadSessions = 0;
+    unsigned long aheadBreached = 0;
+    uint64_t aheadUntilMs = 0; // next window of the latest one, 0 = none open
+};
+
+Stats stats;
+
+// ms from nowMs until the next watering window opens (PlantControl::secondsToNextWindow)
+uint64_t msToNextWindow(uint64_t nowMs) {
+    int starts[] = {configManager.loadMorningStart(), configManager.loadAfternoonStart()};
+    int ends[] = {configManager.loadMorningEnd(), configManager.loadAfternoonEnd()};
+    int64_t msOfDay = (nowMs + (uint64_t)(options.startHour * 3600000)) % REPLAY_DAY_MS;
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 2; i++) {
+        if (starts[i] >= ends[i]) continue; // disabled window
+        int64_t until = (int64_t)starts[i] * 3600000 - msOfDay;
+        if (until <= 0) until += REPLAY_DAY_MS;
+        if ((uint64_t)until < best) best = until;
+    }
+    return best;
+}
+
+// Topic suffix after plantcare/<id>/, or the whole topic
+const char* topicKind(const char* topic) {
+    const char* slash = strrchr(topic, '/');
+    return slash ? slash + 1 : topic;
+}
+
+void onPublish(const char* topic, const uint8_t* payload, unsigned int length) {
+    stats.publishes++;
+    const char* kind = topicKind(topic);
+    unsigned long* counter = nullptr;
+    if (strcmp(topic, "plantcare/log") == 0) counter = &stats.logLines;
+    else if (strcmp(kind, "alert") == 0) counter = &stats.alerts;
+    else if (strcmp(kind, "dose") == 0) counter = &stats.doses;
+    else if (strcmp(kind, "ack") == 0) counter = &stats.acks;
+    if (!counter) return;
+    (*counter)++;
+    std::string text((const char*)payload, length);
+    logLine(kind, text.c_str());
+
+    if (counter == &stats.logLines && text.compare(0, 14, "Watering ahead") == 0) {
+        uint64_t next = msToNextWindow(millis());
+        stats.aheadSessions++;
+        stats.aheadUntilMs = next == UINT64_MAX ? 0 : millis() + next;
+    }
+}
+
+// -- Options --
+
+bool parseCommand(const char* arg) {
+    // <seconds>:<payload>
+    char* end;
+    double sec = strtod(arg, &end);
+    if (end == arg || *end != ':' || sec < 0 || !end[1]) return false;
+    if (options.commands.size() >= REPLAY_MAX_CMDS) return false;
+    options.commands.push_back({(uint64_t)(sec * 1000), end + 1});
+    return true;
+}
+
+bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = strchr(arg, '=');
+        value = value ? value + 1 : "";
+        if (strncmp(arg, "--days=", 7) == 0) options.days = atof(value);
+        else if (strncmp(arg, "--start-hour=", 13) == 0) options.startHour = atof(value);
+        else if (strncmp(arg, "--trace=", 8) == 0) options.trace = value;
+        else if (strncmp(arg, "--log=", 6) == 0) options.logPath = value;
+        else if (strcmp(arg, "--quiet") == 0) options.quiet = true;
+        else if (strcmp(arg, "--check-ahead") == 0) options.checkAhead = true;
+        else if (strncmp(arg, "--curve=", 8) == 0) options.curve = strcmp(value, "exp") == 0 ? CURVE_EXPONENTIAL : CURVE_LINEAR;
+        else if (strncmp(arg, "--dry-rate=", 11) == 0) options.dryRate = atof(value);
+        else if (strncmp(arg, "--dry-spread=", 13) == 0) options.drySpread = atof(value);
+        else if (strncmp(arg, "--day-swing=", 12) == 0) options.daySwing = atof(value);
+        else if (strncmp(arg, "--gain=", 7) == 0) options.gain = atof(value);
+        else if (strncmp(arg, "--noise=", 8) == 0) options.noise = atof(value);
+        else if (strncmp(arg, "--initial=", 10) == 0) options.initial = atof(value);
+        else if (strncmp(arg, "--seed=", 7) == 0) options.seed = strtoul(value, nullptr, 10);
+        else if (strncmp(arg, "--cmd=", 6) == 0) {
+            if (!parseCommand(value)) {
+                fprintf(stderr, "bad %s (want --cmd=<seconds>:<command>, at most %d)\n", arg, REPLAY_MAX_CMDS);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return false;
+        }
+    }
+    if (options.days <= 0 || options.startHour < 0 || options.startHour >= 24) {
+        fprintf(stderr, "need --days > 0 and 0 <= --start-hour < 24\n");
+        return false;
+    }
+    if (options.gain < 0) options.gain = options.trace ? 0 : 2;
+    rngState = options.seed ? options.seed : 1;
+    return true;
+}
+
+// -- Filesystem stand-in --
+
+char fsRoot[64];
+
+void removeTree(const std::string& path) {
+    std::string cmd = "rm -rf '" + path + "'";
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "could not remove %s\n", path.c_str());
+}
+
+// -- Run --
+
+void printSummary(uint64_t endMs, double wallSec, uint64_t pumpUs, unsigned long pumpRuns) {
+    double days = endMs / (double)REPLAY_DAY_MS;
+    fprintf(stderr, "\n-- replay: %.2f days in %.2f s (%.0fx) --\n", days, wallSec, wallSec > 0 ? endMs / 1000.0 / wallSec : 0);
+    fprintf(stderr, "waterings      %lu (%.2f per day)\n", stats.waterings, stats.waterings / days);
+    fprintf(stderr, "pump           %lu runs, %.1f s on (%.1f s per day)\n", pumpRuns, pumpUs / 1e6, pumpUs / 1e6 / days);
+    fprintf(stderr, "state time    ");
+    for (int s = 0; s < STATE_COUNT; s++) {
+        if (stats.stateMs[s]) fprintf(stderr, " %s %.2f%%", STATE_NAMES[s], 100.0 * stats.stateMs[s] / endMs);
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "threshold      %d%% (average moisture %.1f..%.1f%%)\n", configManager.getConfig().threshold,
+            stats.lowest, stats.highest);
+    fprintf(stderr, "breaches       %lu, %.2f h below (%.2f%% of the time), longest %.2f h\n", stats.breaches,
+            stats.breachMs / 3.6e6, 100.0 * stats.breachMs / endMs, stats.longestBreachMs / 3.6e6);
+    fprintf(stderr, "watered ahead  %lu, %lu below threshold before the next window\n", stats.aheadSessions,
+            stats.aheadBreached);
+    fprintf(stderr, "publishes      %lu (log %lu, alert %lu, dose %lu, ack %lu)\n", stats.publishes, stats.logLines,
+            stats.alerts, stats.doses, stats.acks);
+}
+
+int run() {
+    if (options.trace && !loadTrace(options.trace)) return 1;
+    if (options.logPath) {
+        logOut = fopen(options.logPath, "w");
+        if (!logOut) {
+            fprintf(stderr, "cannot write %s: %s\n", options.logPath, strerror(errno));
+            return 1;
+        }
+    }
+
+    // Before setup(): the ADC sampler and DHT reader start their timers there
+    NativeHal::useVirtualClock();
+    NativeHal::setSerialEcho(false);
+    snprintf(fsRoot, sizeof(fsRoot), "/tmp/plantcare_replay_XXXXXX");
+    if (!mkdtemp(fsRoot)) {
+        fprintf(stderr, "mkdtemp: %s\n", strerror(errno));
+        return 1;
+    }
+    NativeHal::setFsRoot(fsRoot);
+    NativeHal::setLocalTime(REPLAY_EPOCH + (uint32_t)(options.startHour * 3600));
+    NativeHal::setPublishHook(onPublish);
+
+    setup();
+    // Calibration is loaded now; nothing has sampled yet (the clock stands still)
+    initSoil();
+    applyInputs(0);
+
+    int pumpPin = plantControl.getPumpPin();
+    char cmdTopic[64];
+    snprintf(cmdTopic, sizeof(cmdTopic), "plantcare/%s/cmd", DEVICE_ID);
+    size_t nextCommand = 0;
+    std::stable_sort(options.commands.begin(), options.commands.end(),
+                     [](const TimedCommand& a, const TimedCommand& b) { return a.atMs < b.atMs; });
+
+    const uint64_t endMs = (uint64_t)(options.days * REPLAY_DAY_MS);
+    State state = plantControl.getState();
+    uint64_t pumpUs = NativeHal::getHighTimeUs(pumpPin);
+    unsigned long pumpRuns = 0;
+    bool pumpHigh = NativeHal::getDigitalValue(pumpPin) == HIGH;
+    auto wallStart = std::chrono::steady_clock::now();
+
+    for (;;) {
+        uint64_t now = millis();
+        while (nextCommand < options.commands.size() && options.commands[nextCommand].atMs <= now) {
+            const std::string& payload = options.commands[nextCommand++].payload;
+            logLine("cmd", payload.c_str());
+            NativeHal::deliverMessage(cmdTopic, (const uint8_t*)payload.data(), payload.size());
+        }
+        loop();
+
+        State next = plantControl.getState();
+        if (next != state) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%s -> %s avg=%.1f", STATE_NAMES[state], STATE_NAMES[next],
+                     sensorManager.getAverageMoisture());
+            logLine("state", detail);
+            if (next == WATERING) stats.waterings++;
+            state = next;
+        }
+        if (now >= endMs) break;
+
+        // Straight to the next thing that can happen
+        uint64_t step = scheduler.msUntilNext();
+        if (step > REPLAY_MAX_STEP_MS) step = REPLAY_MAX_STEP_MS;
+        if (nextCommand < options.commands.size() && options.commands[nextCommand].atMs - now < step) {
+            step = options.commands[nextCommand].atMs - now;
+        }
+        if (options.trace) {
+            uint64_t row = traceNextMs(now);
+            if (row != UINT64_MAX && row - now < step) step = row - now;
+        }
+        if (step > endMs - now) step = endMs - now;
+        if (step == 0) step = 1;
+
+        stats.stateMs[state] += step;
+        NativeHal::advanceClock(step * 1000);
+
+        // What the pump delivered during the step (the cutoff timer stops it exactly)
+        uint64_t pumpTotal = NativeHal::getHighTimeUs(pumpPin);
+        double pumpSec = (pumpTotal - pumpUs) / 1e6;
+        pumpUs = pumpTotal;
+        bool high = NativeHal::getDigitalValue(pumpPin) == HIGH;
+        if (high && !pumpHigh) pumpRuns++;
+        else if (pumpSec > 0 && !pumpHigh) pumpRuns++; // started and stopped within the step
+        pumpHigh = high;
+
+        if (!options.trace) stepSoil(millis(), step / 1000.0, pumpSec, options.gain);
+        else if (pumpSec > 0) {
+            for (int c = 0; c < SOIL_SENSOR_COUNT; c++) soil.watered[c] += options.gain * pumpSec;
+        }
+        applyInputs(millis());
+
+        // Breaches by what the firmware measured, once it has a first reading
+        if (sensorManager.getRaw(0) == 0) continue;
+        float avg = sensorManager.getAverageMoisture();
+        if (avg < stats.lowest) stats.lowest = avg;
+        if (avg > stats.highest) stats.highest = avg;
+        if (stats.aheadUntilMs && millis() >= stats.aheadUntilMs) stats.aheadUntilMs = 0;
+        if (avg < configManager.getConfig().threshold) {
+            uint64_t at = millis();
+            if (stats.aheadUntilMs) {
+                char detail[64];
+                snprintf(detail, sizeof(detail), "watered ahead, below threshold %.1f h before the window",
+                         (stats.aheadUntilMs - at) / 3.6e6);
+                logLine("check", detail);
+                stats.aheadBreached++;
+                stats.aheadUntilMs = 0;
+            }
+            if (!stats.belowSeen || at - stats.lastBelowMs > REPLAY_BREACH_GAP_MS) {
+                stats.breaches++;
+                stats.breachStartMs = at - step;
+            }
+            stats.belowSeen = true;
+            stats.lastBelowMs = at;
+            stats.breachMs += step;
+            if (at - stats.breachStartMs > stats.longestBreachMs) stats.longestBreachMs = at - stats.breachStartMs;
+        }
+    }
+
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    NativeHal::setPublishHook(nullptr);
+    if (logOut != stdout) fclose(logOut);
+    else fflush(stdout);
+    printSummary(endMs, wallSec, pumpUs, pumpRuns);
+    removeTree(fsRoot);
+    return options.checkAhead && stats.aheadBreached ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) return 2;
+    return run();
+}
@@ -0,0 +1,112 @@
+#include "AdcSampler.h"
+
+int AdcSampler::addChannel(int pin) {
+    if (channelCount >= MAX_CHANNELS) return -1;
+    Channel& ch = channels[channelCount];
+    ch.pin = pin;
+    ch.head = 0;
+    ch.fresh = 0;
+    ch.filtered = 0;
+    ch.sequence = 0;
+    memset(ch.ring, 0, sizeof(ch.ring));
+    pinMode(pin, INPUT);
+    return channelCount++;
+}
+
+void AdcSampler::configure(int newOversampling, AdcFilter newFilter, int newTrim) {
+    bool running = timer && esp_timer_is_active(timer);
+    if (running) esp_timer_stop(timer);
+
+    oversampling = constrain(newOversampling, 1, RING_SIZE);
+    filter = newFilter;
+    // Always keep at least one sample after trimming both ends
+    trim = constrain(newTrim, 0, (oversampling - 1) / 2);
+    for (int i = 0; i < channelCount; i++) channels[i].fresh = 0;
+
+    if (running) esp_timer_start_periodic(timer, periodUs);
+}
+
+void AdcSampler::setPeriod(unsigned long newPeriodUs) {
+    periodUs = newPeriodUs > 0 ? newPeriodUs : 1;
+    if (timer && esp_timer_is_active(timer)) {
+        esp_timer_stop(timer);
+        esp_timer_start_periodic(timer, periodUs);
+    }
+}
+
+void AdcSampler::begin() {
+    // Prime every channel so the first read after boot is already filtered
+    for (int s = 0; s < oversampling; s++) {
+        sampleAll();
+    }
+
+    if (!timer) {
+        esp_timer_create_args_t args = {};
+        args.callback = &AdcSampler::onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "adc_sampler";
+        args.skip_unhandled_events = true;
+        esp_timer_create(&args, &timer);
+    }
+    if (!esp_timer_is_active(timer)) {
+        esp_timer_start_periodic(timer, periodUs);
+    }
+}
+
+void AdcSampler::stop() {
+    if (timer && esp_timer_is_active(timer)) esp_timer_stop(timer);
+}
+
+void AdcSampler::onTimer(void* arg) {
+    static_cast<AdcSampler*>(arg)->sampleAll();
+}
+
+void AdcSampler::sampleAll() {
+    for (int i = 0; i < channelCount; i++) {
+        Channel& ch = channels[i];
+        ch.ring[ch.head] = analogRead(ch.pin);
+        ch.head = (ch.head + 1) % RING_SIZE;
+        if (++ch.fresh >= oversampling) {
+            ch.fresh = 0;
+            ch.filtered.store(filterWindow(ch), std::memory_order_relaxed);
+            ch.sequence.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+uint16_t AdcSampler::filterWindow(const Channel& ch) const {
+    // Copy the newest `oversampling` samples and insertion sort them (window <= RING_SIZE)
+    uint16_t window[RING_SIZE];
+    int n = oversampling;
+    int start = (ch.head - n + RING_SIZE) % RING_SIZE;
+    for (int i = 0; i < n; i++) {
+        uint16_t v = ch.ring[(start + i) % RING_SIZE];
+        int j = i;
+        while (j > 0 && window[j - 1] > v) {
+            window[j] = window[j - 1];
+            j--;
+        }
+        window[j] = v;
+    }
+
+    if (filter == ADC_FILTER_MEDIAN) {
+        if (n % 2) return window[n / 2];
+        return (window[n / 2 - 1] + window[n / 2] + 1) / 2;
+    }
+
+    uint32_t sum = 0;
+    for (int i = trim; i < n - trim; i++) sum += window[i];
+    int kept = n - 2 * trim;
+    return (sum + kept / 2) / kept;
+}
+
+uint16_t AdcSampler::read(int index) const {
+    if (index < 0 || index >= channelCount) return 0;
+    return channels[index].filtered.load(std::memory_order_relaxed);
+}
+
+uint32_t AdcSampler::getSequence(int index) const {
+    if (index < 0 || index >= channelCount) return 0;
+    return channels[index].sequence.load(std::memory_order_acquire);
+}
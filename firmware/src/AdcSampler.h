@@ -0,0 +1,74 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// Background soil ADC sampling.
+// A periodic esp_timer samples every channel into a per-channel ring buffer.
+// Each time a channel has collected `oversampling` new samples, the window is
+// filtered (median or trimmed mean) and published. Readers only load the last
+// published value, so the control loop never waits on the ADC.
+
+#ifndef ADC_SAMPLE_PERIOD_US
+#define ADC_SAMPLE_PERIOD_US 2000 // 500 Hz per channel
+#endif
+
+#ifndef ADC_OVERSAMPLING
+#define ADC_OVERSAMPLING 8 // samples per filtered value
+#endif
+
+enum AdcFilter {
+    ADC_FILTER_MEDIAN,
+    ADC_FILTER_TRIMMED_MEAN
+};
+
+class AdcSampler {
+public:
+    static const int MAX_CHANNELS = 8;
+    static const int RING_SIZE = 32; // upper bound for oversampling
+
+private:
+    struct Channel {
+        int pin;
+        uint16_t ring[RING_SIZE];
+        uint8_t head;   // next write position
+        uint8_t fresh;  // samples since the last filtered value
+        std::atomic<uint16_t> filtered;
+        std::atomic<uint32_t> sequence; // bumps on every published value
+    };
+
+    Channel channels[MAX_CHANNELS];
+    int channelCount = 0;
+
+    int oversampling = ADC_OVERSAMPLING;
+    AdcFilter filter = ADC_FILTER_MEDIAN;
+    int trim = 2; // samples dropped at each end for ADC_FILTER_TRIMMED_MEAN
+    unsigned long periodUs = ADC_SAMPLE_PERIOD_US;
+
+    esp_timer_handle_t timer = nullptr;
+
+    static void onTimer(void* arg);
+    void sampleAll();
+    uint16_t filterWindow(const Channel& ch) const;
+
+public:
+    // Returns the channel index, or -1 if full
+    int addChannel(int pin);
+    int getChannelCount() const { return channelCount; }
+
+    // Settings may be changed at any time; sampling restarts with a clean window.
+    void configure(int oversampling, AdcFilter filter, int trim);
+    void setPeriod(unsigned long periodUs);
+
+    // Fills every window synchronously (blocking, boot only) then starts the timer
+    void begin();
+    void stop();
+
+    // O(1): last filtered value for the channel
+    uint16_t read(int index) const;
+    uint32_t getSequence(int index) const;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "BootProfiler.h"
+#include <esp_system.h>
+
+BootProfiler bootProfiler;
+
+static const char* const PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "config_ms", "sensors_ms", "wifi_ms", "mqtt_ms", "time_ms", "first_publish_ms"
+};
+
+void BootProfiler::begin() {
+    for (auto& m : marks) m.store(0, std::memory_order_relaxed);
+    resetReason = esp_reset_reason();
+    reported = false;
+}
+
+void BootProfiler::mark(BootPhase phase) {
+    uint32_t expected = 0;
+    marks[phase].compare_exchange_strong(expected, millis() + 1, std::memory_order_relaxed);
+}
+
+uint32_t BootProfiler::getMs(BootPhase phase) const {
+    uint32_t m = marks[phase].load(std::memory_order_relaxed);
+    return m ? m - 1 : 0;
+}
+
+const char* BootProfiler::getResetReason() const {
+    switch (resetReason) {
+        case ESP_RST_POWERON: return "power_on";
+        case ESP_RST_SW: return "software";
+        case ESP_RST_PANIC: return "panic";
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT: return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep_sleep";
+        case ESP_RST_BROWNOUT: return "brownout";
+        default: return "other";
+    }
+}
+
+bool BootProfiler::isReportDue() const {
+    if (reported || !isMarked(BOOT_FIRST_PUBLISH)) return false;
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (!isMarked((BootPhase)i)) return millis() - getMs(BOOT_FIRST_PUBLISH) >= BOOT_REPORT_WAIT_MS;
+    }
+    return true;
+}
+
+size_t BootProfiler::buildReport(char* buffer, size_t capacity) {
+    int len = snprintf(buffer, capacity, "{\"boot\":{\"reset\":\"%s\",\"fast_connect\":%s", getResetReason(),
+                       fastConnect ? "true" : "false");
+    for (int i = 0; i < BOOT_PHASE_COUNT && len < (int)capacity; i++) {
+        if (isMarked((BootPhase)i)) {
+            len += snprintf(buffer + len, capacity - len, ",\"%s\":%lu", PHASE_NAMES[i], (unsigned long)getMs((BootPhase)i));
+        } else {
+            len += snprintf(buffer + len, capacity - len, ",\"%s\":null", PHASE_NAMES[i]);
+        }
+    }
+    if (len < (int)capacity) len += snprintf(buffer + len, capacity - len, "}}");
+    reported = true;
+    return len < (int)capacity ? len : 0;
+}
@@ -0,0 +1,53 @@
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Timestamps (ms since boot) of the phases between power-on and the first
+// publish, marked from setup() and the network task. Reported once on
+// plantcare/<id>/metrics with the reset reason and whether WiFi came up
+// through the fast-connect cache (see NetworkManager::fastConnect).
+
+enum BootPhase {
+    BOOT_CONFIG,        // settings loaded
+    BOOT_SENSORS,       // sensors primed
+    BOOT_WIFI,          // associated with an IP
+    BOOT_MQTT,          // broker session up
+    BOOT_TIME,          // wall clock known (SNTP/NTP or retained)
+    BOOT_FIRST_PUBLISH, // first queued message accepted by the broker
+    BOOT_PHASE_COUNT
+};
+
+// Wait this long after the first publish for phases still missing (e.g. NTP)
+#ifndef BOOT_REPORT_WAIT_MS
+#define BOOT_REPORT_WAIT_MS 5000
+#endif
+
+class BootProfiler {
+private:
+    std::atomic<uint32_t> marks[BOOT_PHASE_COUNT]; // 0 = not reached (stored as ms + 1)
+    std::atomic<bool> fastConnect{false};
+    int resetReason = 0;
+    bool reported = false;
+
+public:
+    // Start of setup(): records why the chip booted
+    void begin();
+    // First call per phase wins; safe from any task
+    void mark(BootPhase phase);
+    void setFastConnect(bool fast) { fastConnect = fast; }
+    bool isMarked(BootPhase phase) const { return marks[phase].load(std::memory_order_relaxed) != 0; }
+    uint32_t getMs(BootPhase phase) const;
+    const char* getResetReason() const;
+
+    // Report due: first publish done and the rest in, or BOOT_REPORT_WAIT_MS later
+    bool isReportDue() const;
+    bool isReported() const { return reported; }
+    // {"boot":{...}}; marks the report as sent
+    size_t buildReport(char* buffer, size_t capacity);
+};
+
+extern BootProfiler bootProfiler;
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CALIBRATION_LUT_H
+#define CALIBRATION_LUT_H
+
+#include <Arduino.h>
+
+// Raw ADC -> moisture % for all soil channels.
+//
+// Each channel's curve is piecewise linear through its air (0 %) and water
+// (100 %) readings plus up to CAL_MAX_POINTS measured points in between,
+// flat outside the endpoints. Setting a point compiles the curve into a
+// table of knots in 1/256 % steps, one every 2^SHIFT raw counts (32 for up
+// to 4 channels, 64 on external ADC builds to keep the size down); a sample
+// then costs one table step and one interpolation whatever the number of
+// points. Between knots the table cuts the curve's corners by at most a
+// fraction of a percent.
+//
+// Capacitive probes read higher or lower as the soil warms. With a
+// coefficient (raw counts per 10 C, positive when the reading rises with
+// temperature) the raw value is moved back to CAL_REF_TEMP10 using the DHT
+// temperature before the lookup.
+
+#define CAL_MAX_POINTS 4
+#define CAL_RAW_MAX 4095
+// Compensation reference, 0.1 C
+#define CAL_REF_TEMP10 200
+#define CAL_TEMPCO_MAX 1000
+
+struct CalPoint {
+    int16_t raw;    // 0 = unused
+    int8_t percent;
+};
+
+template <int N, int SHIFT = (N <= 4 ? 5 : 6)>
+class CalibrationLut {
+private:
+    static const int SIZE = ((CAL_RAW_MAX + 1) >> SHIFT) + 1;
+
+    uint16_t lut[N][SIZE]; // % x256 at raw = k << SHIFT
+    int16_t tempco[N];     // raw counts per 10 C
+
+public:
+    CalibrationLut() {
+        for (int i = 0; i < N; i++) tempco[i] = 0;
+    }
+
+    // Rebuilds one channel's table from its endpoints and interior points
+    void compile(int channel, int air, int water, const CalPoint* points, int count) {
+        // Knots of the curve, sorted by raw
+        int16_t xs[CAL_MAX_POINTS + 2];
+        int16_t ys[CAL_MAX_POINTS + 2];
+        int n = 0;
+        auto insert = [&](int x, int y) {
+            int at = n;
+            while (at > 0 && xs[at - 1] > x) at--;
+            if (at > 0 && xs[at - 1] == x) return; // first point at a raw value wins
+            for (int k = n; k > at; k--) {
+                xs[k] = xs[k - 1];
+                ys[k] = ys[k - 1];
+            }
+            xs[at] = x;
+            ys[at] = y;
+            n++;
+        };
+        insert(air, 0);
+        insert(water, 100);
+        for (int p = 0; p < count && p < CAL_MAX_POINTS; p++) {
+            if (points[p].raw > 0) insert(points[p].raw, points[p].percent);
+        }
+
+        int seg = 0;
+        for (int k = 0; k < SIZE; k++) {
+            int32_t x = (int32_t)k << SHIFT;
+            while (seg < n - 1 && xs[seg + 1] <= x) seg++;
+            int32_t y256;
+            if (n == 1 || x <= xs[0]) {
+                y256 = ys[0] * 256;
+            } else if (seg >= n - 1) {
+                y256 = ys[n - 1] * 256;
+            } else {
+                int32_t dx = xs[seg + 1] - xs[seg];
+                y256 = ys[seg] * 256 + (ys[seg + 1] - ys[seg]) * 256 * (x - xs[seg]) / dx;
+            }
+            lut[channel][k] = y256 < 0 ? 0 : (y256 > 100 * 256 ? 100 * 256 : y256);
+        }
+    }
+
+    void setTempco(int channel, int countsPer10C) { tempco[channel] = countsPer10C; }
+    int getTempco(int channel) const { return tempco[channel]; }
+
+    // One pass over all channels: percent x256 and rounded percent.
+    // temp10 is the soil temperature in 0.1 C, CAL_REF_TEMP10 if unknown.
+    void apply(const int16_t* raw, int temp10, uint16_t* percent256, int8_t* percent) const {
+        int32_t dt = temp10 - CAL_REF_TEMP10;
+        for (int i = 0; i < N; i++) {
+            int32_t x = raw[i] - tempco[i] * dt / 100;
+            x = x < 0 ? 0 : (x > CAL_RAW_MAX ? CAL_RAW_MAX : x);
+            const uint16_t* t = lut[i];
+            int32_t k = x >> SHIFT;
+            int32_t f = x & ((1 << SHIFT) - 1);
+            int32_t y = (t[k] * ((1 << SHIFT) - f) + t[k + 1] * f) >> SHIFT;
+            percent256[i] = y;
+            percent[i] = (y + 128) >> 8;
+        }
+    }
+};
+
+#endif
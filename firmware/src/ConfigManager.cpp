@@ -1,118 +1,353 @@
 #include "ConfigManager.h"
+#include "Crc32.h"
+
+static const uint32_t CONFIG_MAGIC = 0x47464350; // "PCFG"
 
 void ConfigManager::begin() {
     preferences.begin(NAMESPACE, false); // false = read/write
-    
-    // Initialize defaults if missing to avoid NVS errors
-    if (!preferences.isKey("password")) {
-        preferences.putString("password", "admin123");
+
+    if (!loadBlob()) {
+        // First boot on this firmware (or corrupt blob): import the old per-key settings
+        migrateLegacyKeys();
+        flush();
     }
-    if (!preferences.isKey("threshold")) {
-        preferences.putInt("threshold", 30);
+}
+
+void ConfigManager::begin(const PlantConfig* cached) {
+    if (!cached) {
+        begin();
+        return;
     }
-    if (!preferences.isKey("mqtt_server")) {
-        preferences.putString("mqtt_server", "broker.hivemq.com");
+    preferences.begin(NAMESPACE, false);
+    cfg = *cached;
+}
+
+void ConfigManager::setDefaults() {
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.threshold = 30;
+    for (int i = 0; i < CONFIG_MAX_SENSORS; i++) {
+        airSlot(i) = DEFAULT_AIR;
+        waterSlot(i) = DEFAULT_WATER;
     }
-     if (!preferences.isKey("mqtt_port")) {
-        preferences.putInt("mqtt_port", 1883);
+    cfg.morningStart = 6;
+    cfg.morningEnd = 10;
+    cfg.afternoonStart = 16;
+    cfg.afternoonEnd = 19;
+    cfg.triggerMode = 0; // Average
+    cfg.mqttPort = MQTT_DEFAULT_PORT;
+    snprintf(cfg.mqttServer, sizeof(cfg.mqttServer), "%s", MQTT_DEFAULT_SERVER);
+    snprintf(cfg.password, sizeof(cfg.password), "%s", "admin123");
+    cfg.statusFormat = 0; // JSON
+    cfg.telemetryMode = 0; // periodic
+    cfg.telemetryDeadband = 2;
+    cfg.heartbeatSec = 600;
+    cfg.batchSamples = 0; // off
+    cfg.batchLatencySec = 60;
+    cfg.sleepSec = 0; // always on
+}
+
+bool ConfigManager::loadBlob() {
+    setDefaults();
+
+    size_t len = preferences.getBytesLength(BLOB_KEY);
+    if (len < sizeof(BlobHeader) || len > sizeof(BlobHeader) + sizeof(PlantConfig) + 256) return false;
+
+    uint8_t buffer[sizeof(BlobHeader) + sizeof(PlantConfig) + 256];
+    if (preferences.getBytes(BLOB_KEY, buffer, sizeof(buffer)) != len) return false;
+
+    BlobHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != CONFIG_MAGIC || header.version == 0 || header.version > CONFIG_VERSION) return false;
+    if (header.size != len - sizeof(BlobHeader)) return false;
+    if (crc32(buffer + sizeof(BlobHeader), header.size) != header.crc) return false;
+
+    // Older versions are a prefix of the current layout; the rest keeps its defaults
+    size_t n = header.size < sizeof(PlantConfig) ? header.size : sizeof(PlantConfig);
+    memcpy(&cfg, buffer + sizeof(BlobHeader), n);
+    if (header.version < CONFIG_VERSION) markDirty(); // rewrite in the current format
+    return true;
+}
+
+void ConfigManager::migrateLegacyKeys() {
+    // Pre-blob firmware stored one NVS key per setting
+    cfg.threshold = preferences.getInt("threshold", cfg.threshold);
+    cfg.mqttPort = preferences.getInt("mqtt_port", cfg.mqttPort);
+    preferences.getString("mqtt_server", cfg.mqttServer).toCharArray(cfg.mqttServer, sizeof(cfg.mqttServer));
+    preferences.getString("password", cfg.password).toCharArray(cfg.password, sizeof(cfg.password));
+
+    char key[12];
+    for (int i = 0; i < CONFIG_V1_SENSORS; i++) {
+        snprintf(key, sizeof(key), "air%d", i);
+        cfg.airValues[i] = preferences.getInt(key, DEFAULT_AIR);
+        snprintf(key, sizeof(key), "water%d", i);
+        cfg.waterValues[i] = preferences.getInt(key, DEFAULT_WATER);
     }
+
+    cfg.morningStart = preferences.getInt("m_start", cfg.morningStart);
+    cfg.morningEnd = preferences.getInt("m_end", cfg.morningEnd);
+    cfg.afternoonStart = preferences.getInt("a_start", cfg.afternoonStart);
+    cfg.afternoonEnd = preferences.getInt("a_end", cfg.afternoonEnd);
+    cfg.triggerMode = preferences.getInt("trig_mode", cfg.triggerMode);
+    markDirty();
 }
 
-int ConfigManager::loadThreshold() {
-    // Default to 30% if not set
-    return preferences.getInt("threshold", 30);
+void ConfigManager::markDirty() {
+    dirty = true;
+    lastChange = millis();
 }
 
-void ConfigManager::saveThreshold(int threshold) {
-    preferences.putInt("threshold", threshold);
+void ConfigManager::loop() {
+    if (dirty && millis() - lastChange >= CONFIG_COMMIT_DELAY_MS) {
+        flush();
+    }
 }
 
-String ConfigManager::loadMqttServer() {
-    return preferences.getString("mqtt_server", "broker.hivemq.com");
+void ConfigManager::flush() {
+    if (!dirty) return;
+
+    uint8_t buffer[sizeof(BlobHeader) + sizeof(PlantConfig)];
+    BlobHeader header = {CONFIG_MAGIC, CONFIG_VERSION, (uint16_t)sizeof(PlantConfig), crc32(&cfg, sizeof(cfg))};
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), &cfg, sizeof(cfg));
+
+    // A single NVS entry: either the old or the new blob survives a power cut
+    if (preferences.putBytes(BLOB_KEY, buffer, sizeof(buffer)) == sizeof(buffer)) {
+        dirty = false;
+        commitCount++;
+    }
+}
+
+int ConfigManager::loadThreshold() {
+    return cfg.threshold;
 }
 
-void ConfigManager::saveMqttServer(String server) {
-    preferences.putString("mqtt_server", server);
+void ConfigManager::saveThreshold(int threshold) {
+    if (cfg.threshold == threshold) return;
+    cfg.threshold = threshold;
+    markDirty();
+}
+
+void ConfigManager::saveMqttServer(const char* server) {
+    if (strcmp(cfg.mqttServer, server) == 0) return;
+    snprintf(cfg.mqttServer, sizeof(cfg.mqttServer), "%s", server);
+    markDirty();
 }
 
 int ConfigManager::loadMqttPort() {
-    return preferences.getInt("mqtt_port", 1883);
+    return cfg.mqttPort;
 }
 
 void ConfigManager::saveMqttPort(int port) {
-    preferences.putInt("mqtt_port", port);
+    if (cfg.mqttPort == port) return;
+    cfg.mqttPort = port;
+    markDirty();
 }
 
-String ConfigManager::loadPassword() {
-    return preferences.getString("password", "admin123");
+void ConfigManager::savePassword(const char* password) {
+    if (strcmp(cfg.password, password) == 0) return;
+    snprintf(cfg.password, sizeof(cfg.password), "%s", password);
+    markDirty();
 }
 
-void ConfigManager::savePassword(String password) {
-    preferences.putString("password", password);
+// -- Calibration --
+
+// Channels past the v1 arrays live in the v5 extension
+int16_t& ConfigManager::airSlot(int index) {
+    return index < CONFIG_V1_SENSORS ? cfg.airValues[index] : cfg.airValuesExt[index - CONFIG_V1_SENSORS];
 }
 
-// -- Calibration --
+int16_t& ConfigManager::waterSlot(int index) {
+    return index < CONFIG_V1_SENSORS ? cfg.waterValues[index] : cfg.waterValuesExt[index - CONFIG_V1_SENSORS];
+}
 
 int ConfigManager::loadAirValue(int index) {
-    String key = "air" + String(index);
-    return preferences.getInt(key.c_str(), DEFAULT_AIR);
+    if (index < 0 || index >= CONFIG_MAX_SENSORS) return DEFAULT_AIR;
+    return airSlot(index);
 }
 
 void ConfigManager::saveAirValue(int index, int value) {
-    String key = "air" + String(index);
-    preferences.putInt(key.c_str(), value);
+    if (index < 0 || index >= CONFIG_MAX_SENSORS || airSlot(index) == value) return;
+    airSlot(index) = value;
+    markDirty();
 }
 
 int ConfigManager::loadWaterValue(int index) {
-    String key = "water" + String(index);
-    return preferences.getInt(key.c_str(), DEFAULT_WATER);
+    if (index < 0 || index >= CONFIG_MAX_SENSORS) return DEFAULT_WATER;
+    return waterSlot(index);
 }
 
 void ConfigManager::saveWaterValue(int index, int value) {
-    String key = "water" + String(index);
-    preferences.putInt(key.c_str(), value);
+    if (index < 0 || index >= CONFIG_MAX_SENSORS || waterSlot(index) == value) return;
+    waterSlot(index) = value;
+    markDirty();
+}
+
+static bool validCalSlot(int index, int slot) {
+    return index >= 0 && index < CONFIG_MAX_SENSORS && slot >= 0 && slot < CONFIG_CAL_POINTS;
+}
+
+int ConfigManager::loadCalRaw(int index, int slot) {
+    return validCalSlot(index, slot) ? cfg.calRaw[index][slot] : 0;
+}
+
+int ConfigManager::loadCalPercent(int index, int slot) {
+    return validCalSlot(index, slot) ? cfg.calPercent[index][slot] : 0;
+}
+
+void ConfigManager::saveCalPoint(int index, int slot, int raw, int percent) {
+    if (!validCalSlot(index, slot)) return;
+    if (raw == 0) percent = 0;
+    if (cfg.calRaw[index][slot] == raw && cfg.calPercent[index][slot] == percent) return;
+    cfg.calRaw[index][slot] = raw;
+    cfg.calPercent[index][slot] = percent;
+    markDirty();
+}
+
+int ConfigManager::loadTempco(int index) {
+    if (index < 0 || index >= CONFIG_MAX_SENSORS) return 0;
+    return cfg.calTempco[index];
+}
+
+void ConfigManager::saveTempco(int index, int countsPer10C) {
+    if (index < 0 || index >= CONFIG_MAX_SENSORS || cfg.calTempco[index] == countsPer10C) return;
+    cfg.calTempco[index] = countsPer10C;
+    markDirty();
 }
 
 // -- Time Windows --
 
 int ConfigManager::loadMorningStart() {
-    return preferences.getInt("m_start", 6);
+    return cfg.morningStart;
 }
 
 void ConfigManager::saveMorningStart(int hour) {
-    preferences.putInt("m_start", hour);
+    if (cfg.morningStart == hour) return;
+    cfg.morningStart = hour;
+    markDirty();
 }
 
 int ConfigManager::loadMorningEnd() {
-    return preferences.getInt("m_end", 10);
+    return cfg.morningEnd;
 }
 
 void ConfigManager::saveMorningEnd(int hour) {
-    preferences.putInt("m_end", hour);
+    if (cfg.morningEnd == hour) return;
+    cfg.morningEnd = hour;
+    markDirty();
 }
 
 int ConfigManager::loadAfternoonStart() {
-    return preferences.getInt("a_start", 16);
+    return cfg.afternoonStart;
 }
 
 void ConfigManager::saveAfternoonStart(int hour) {
-    preferences.putInt("a_start", hour);
+    if (cfg.afternoonStart == hour) return;
+    cfg.afternoonStart = hour;
+    markDirty();
 }
 
 int ConfigManager::loadAfternoonEnd() {
-    return preferences.getInt("a_end", 19);
+    return cfg.afternoonEnd;
 }
 
 void ConfigManager::saveAfternoonEnd(int hour) {
-    preferences.putInt("a_end", hour);
+    if (cfg.afternoonEnd == hour) return;
+    cfg.afternoonEnd = hour;
+    markDirty();
 }
 
 // -- Trigger Mode --
 
 int ConfigManager::loadTriggerMode() {
-    return preferences.getInt("trig_mode", 0); // Default 0 (Average)
+    return cfg.triggerMode; // 0 = Average
 }
 
 void ConfigManager::saveTriggerMode(int mode) {
-    preferences.putInt("trig_mode", mode);
+    if (cfg.triggerMode == mode) return;
+    cfg.triggerMode = mode;
+    markDirty();
+}
+
+// -- Status Format --
+
+int ConfigManager::loadStatusFormat() {
+    return cfg.statusFormat;
+}
+
+void ConfigManager::saveStatusFormat(int format) {
+    if (cfg.statusFormat == format) return;
+    cfg.statusFormat = format;
+    markDirty();
+}
+
+// -- Telemetry --
+
+int ConfigManager::loadTelemetryMode() {
+    return cfg.telemetryMode;
+}
+
+int ConfigManager::loadTelemetryDeadband() {
+    return cfg.telemetryDeadband;
+}
+
+int ConfigManager::loadHeartbeatSec() {
+    return cfg.heartbeatSec;
+}
+
+void ConfigManager::saveTelemetry(int mode, int deadband, int heartbeatSec) {
+    if (cfg.telemetryMode == mode && cfg.telemetryDeadband == deadband && cfg.heartbeatSec == heartbeatSec) return;
+    cfg.telemetryMode = mode;
+    cfg.telemetryDeadband = deadband;
+    cfg.heartbeatSec = heartbeatSec;
+    markDirty();
+}
+
+// -- Batching --
+
+int ConfigManager::loadBatchSamples() {
+    return cfg.batchSamples;
+}
+
+int ConfigManager::loadBatchLatencySec() {
+    return cfg.batchLatencySec;
+}
+
+void ConfigManager::saveBatch(int samples, int latencySec) {
+    if (cfg.batchSamples == samples && cfg.batchLatencySec == latencySec) return;
+    cfg.batchSamples = samples;
+    cfg.batchLatencySec = latencySec;
+    markDirty();
+}
+
+// -- Power --
+
+int ConfigManager::loadSleepSec() {
+    return cfg.sleepSec;
+}
+
+void ConfigManager::saveSleepSec(int seconds) {
+    if (cfg.sleepSec == (uint32_t)seconds) return;
+    cfg.sleepSec = seconds;
+    markDirty();
+}
+
+int ConfigManager::loadDoseGain(int index) {
+    if (index < 0 || index >= CONFIG_MAX_SENSORS) return 0;
+    return cfg.doseGain[index];
+}
+
+void ConfigManager::saveDoseGain(int index, int gain) {
+    if (index < 0 || index >= CONFIG_MAX_SENSORS || cfg.doseGain[index] == gain) return;
+    cfg.doseGain[index] = gain;
+    markDirty();
+}
+
+int ConfigManager::loadFlowCalibration() {
+    return cfg.flowPulsesPerL;
+}
+
+void ConfigManager::saveFlowCalibration(int pulsesPerLiter) {
+    if (cfg.flowPulsesPerL == pulsesPerLiter) return;
+    cfg.flowPulsesPerL = pulsesPerLiter;
+    markDirty();
 }
@@ -4,53 +4,177 @@
 #include <Preferences.h>
 #include <Arduino.h>
 
+// Max calibrated soil channels stored in the config blob
+#define CONFIG_MAX_SENSORS 32
+// Channels held by the original (v1) calibration arrays
+#define CONFIG_V1_SENSORS 8
+// Interior calibration points per channel (see CalibrationLut.h)
+#define CONFIG_CAL_POINTS 4
+
+// Broker until set from the WiFi portal; e.g. -D MQTT_DEFAULT_SERVER='"127.0.0.1"'
+// points native builds with MQTT_ASYNC at a local Mosquitto
+#ifndef MQTT_DEFAULT_SERVER
+#define MQTT_DEFAULT_SERVER "broker.hivemq.com"
+#endif
+#ifndef MQTT_DEFAULT_PORT
+#define MQTT_DEFAULT_PORT 1883
+#endif
+
+// Debounce between the last change and the NVS commit
+#ifndef CONFIG_COMMIT_DELAY_MS
+#define CONFIG_COMMIT_DELAY_MS 2000
+#endif
+
+// All persisted settings, kept in RAM and committed to NVS as one blob.
+// Layout is append-only: add new fields at the end and bump CONFIG_VERSION,
+// older blobs keep their prefix and get defaults for the rest.
+struct PlantConfig {
+    int16_t threshold;
+    int16_t airValues[CONFIG_V1_SENSORS];
+    int16_t waterValues[CONFIG_V1_SENSORS];
+    uint8_t morningStart;
+    uint8_t morningEnd;
+    uint8_t afternoonStart;
+    uint8_t afternoonEnd;
+    uint8_t triggerMode;
+    uint16_t mqttPort;
+    char mqttServer[40];
+    char password[32];
+    // v2
+    uint8_t statusFormat; // StatusFormat: 0=JSON, 1=binary v1
+    // v3
+    uint8_t telemetryMode;      // TelemetryMode: 0=periodic, 1=report-by-exception
+    uint8_t telemetryDeadband;  // moisture % points
+    uint16_t heartbeatSec;      // max silence in report-by-exception mode
+    // v4
+    uint8_t batchSamples;       // samples per time-series frame, 0 = batching off
+    uint16_t batchLatencySec;   // max age of the oldest sample in a frame
+    // v5: calibration of channels CONFIG_V1_SENSORS.. (external ADCs)
+    int16_t airValuesExt[CONFIG_MAX_SENSORS - CONFIG_V1_SENSORS];
+    int16_t waterValuesExt[CONFIG_MAX_SENSORS - CONFIG_V1_SENSORS];
+    // v6
+    uint32_t sleepSec;          // deep sleep between checks, 0 = always on
+    // v7
+    uint16_t doseGain[CONFIG_MAX_SENSORS]; // learned moisture % per pump-second x100, 0 = unknown
+    // v8: multi-point calibration, 3 bytes per point
+    uint16_t calRaw[CONFIG_MAX_SENSORS][CONFIG_CAL_POINTS]; // 0 = unused
+    uint8_t calPercent[CONFIG_MAX_SENSORS][CONFIG_CAL_POINTS];
+    int16_t calTempco[CONFIG_MAX_SENSORS]; // raw counts per 10 C
+    // v9
+    uint16_t flowPulsesPerL; // flow meter, 0 = none
+};
+
 class ConfigManager {
 private:
     Preferences preferences;
     const char* NAMESPACE = "plantcare";
+    const char* BLOB_KEY = "cfg";
+    static const uint16_t CONFIG_VERSION = 9;
     // Default calibration values if not set
     // Using widely safe defaults: 1700 (Air), 700 (Water)
     const int DEFAULT_AIR = 1700;
     const int DEFAULT_WATER = 700;
 
+    struct BlobHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;   // sizeof(PlantConfig) when written
+        uint32_t crc;    // over the config bytes
+    };
+
+    PlantConfig cfg;
+    bool dirty = false;
+    unsigned long lastChange = 0;
+    unsigned long commitCount = 0;
+
+    void setDefaults();
+    bool loadBlob();
+    void migrateLegacyKeys();
+    void markDirty();
+    int16_t& airSlot(int index);
+    int16_t& waterSlot(int index);
+
 public:
     void begin();
-    
+    // Takes the settings from a copy kept across deep sleep instead of reading NVS
+    void begin(const PlantConfig* cached);
+    const PlantConfig& getConfig() const { return cfg; }
+    // Commits pending changes once CONFIG_COMMIT_DELAY_MS passed without new ones
+    void loop();
+    // Commits pending changes now
+    void flush();
+    bool isDirty() const { return dirty; }
+    unsigned long getCommitCount() const { return commitCount; }
+
     int loadThreshold();
     void saveThreshold(int threshold);
-    
-    // Calibration for 2 sensors
+
+    // Calibration per sensor (index < CONFIG_MAX_SENSORS)
     int loadAirValue(int index);
     void saveAirValue(int index, int value);
-    
+
     int loadWaterValue(int index);
     void saveWaterValue(int index, int value);
-    
-    String loadMqttServer();
-    void saveMqttServer(String server);
-    
+
+    // Interior calibration points (slot < CONFIG_CAL_POINTS), raw 0 = unused
+    int loadCalRaw(int index, int slot);
+    int loadCalPercent(int index, int slot);
+    void saveCalPoint(int index, int slot, int raw, int percent);
+    int loadTempco(int index);
+    void saveTempco(int index, int countsPer10C);
+
+    const char* loadMqttServer() const { return cfg.mqttServer; }
+    void saveMqttServer(const char* server);
+
     int loadMqttPort();
     void saveMqttPort(int port);
 
-    String loadPassword();
-    void savePassword(String password);
+    const char* loadPassword() const { return cfg.password; }
+    void savePassword(const char* password);
 
     // Time Windows
     int loadMorningStart();
     void saveMorningStart(int hour);
-    
+
     int loadMorningEnd();
     void saveMorningEnd(int hour);
-    
+
     int loadAfternoonStart();
     void saveAfternoonStart(int hour);
-    
+
     int loadAfternoonEnd();
     void saveAfternoonEnd(int hour);
 
     // Trigger Mode: 0=AVG, 1=ANY, 2=ALL
     int loadTriggerMode();
     void saveTriggerMode(int mode);
+
+    // Status payload format: 0=JSON, 1=binary v1 (see StatusEncoder.h)
+    int loadStatusFormat();
+    void saveStatusFormat(int format);
+
+    // Telemetry: 0=periodic, 1=report-by-exception (see TelemetryPolicy.h)
+    int loadTelemetryMode();
+    int loadTelemetryDeadband();
+    int loadHeartbeatSec();
+    void saveTelemetry(int mode, int deadband, int heartbeatSec);
+
+    // Time-series batching (see SampleBatcher.h)
+    int loadBatchSamples();
+    int loadBatchLatencySec();
+    void saveBatch(int samples, int latencySec);
+
+    // Battery mode (see PowerManager.h)
+    int loadSleepSec();
+    void saveSleepSec(int seconds);
+
+    // Adaptive dosing (see DoseController.h), % per pump-second x100
+    int loadDoseGain(int index);
+    void saveDoseGain(int index, int gain);
+
+    // Flow meter pulses per litre (see PumpDriver.h), 0 = none fitted
+    int loadFlowCalibration();
+    void saveFlowCalibration(int pulsesPerLiter);
 };
 
 #endif
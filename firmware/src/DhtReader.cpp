@@ -0,0 +1,119 @@
+#include "DhtReader.h"
+
+// Low 50 us + high 26-28 us (0) or 70 us (1): split at 100 us between falling edges
+static const uint32_t BIT_THRESHOLD_US = 100;
+static const uint32_t BIT_MIN_US = 60;
+static const uint32_t BIT_MAX_US = 160;
+
+static const uint64_t START_PULSE_US = 1100;
+static const uint64_t CAPTURE_WINDOW_US = 6000; // full frame is ~5 ms
+
+DhtReader::DhtReader(int pin) : pin(pin) {}
+
+void DhtReader::begin() {
+    pinMode(pin, INPUT_PULLUP);
+
+    esp_timer_create_args_t args = {};
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.arg = this;
+    args.skip_unhandled_events = true;
+
+    args.callback = &DhtReader::onPeriod;
+    args.name = "dht_period";
+    esp_timer_create(&args, &periodTimer);
+
+    args.callback = &DhtReader::onPhase;
+    args.name = "dht_phase";
+    esp_timer_create(&args, &phaseTimer);
+
+    // First conversion right away, then every DHT_READ_INTERVAL_MS
+    startConversion();
+    esp_timer_start_periodic(periodTimer, (uint64_t)DHT_READ_INTERVAL_MS * 1000);
+}
+
+void DhtReader::onPeriod(void* arg) {
+    static_cast<DhtReader*>(arg)->startConversion();
+}
+
+void DhtReader::onPhase(void* arg) {
+    DhtReader* self = static_cast<DhtReader*>(arg);
+    if (self->phase == PHASE_START) {
+        // Release the line and let the sensor answer
+        self->edgeCount = 0;
+        self->phase = PHASE_CAPTURE;
+        pinMode(self->pin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(self->pin), &DhtReader::onEdge, self, FALLING);
+        esp_timer_start_once(self->phaseTimer, CAPTURE_WINDOW_US);
+    } else if (self->phase == PHASE_CAPTURE) {
+        detachInterrupt(digitalPinToInterrupt(self->pin));
+        self->finishConversion();
+        self->phase = PHASE_IDLE;
+    }
+}
+
+void IRAM_ATTR DhtReader::onEdge(void* arg) {
+    DhtReader* self = static_cast<DhtReader*>(arg);
+    int n = self->edgeCount;
+    if (n < FRAME_EDGES + 2) {
+        self->edges[n] = micros();
+        self->edgeCount = n + 1;
+    }
+}
+
+void DhtReader::startConversion() {
+    if (phase != PHASE_IDLE) return; // previous frame still in flight
+    phase = PHASE_START;
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    esp_timer_start_once(phaseTimer, START_PULSE_US);
+}
+
+void DhtReader::finishConversion() {
+    uint8_t frame[5];
+    if (!decodeEdges(edges, edgeCount, frame)) {
+        timeouts++;
+        return;
+    }
+    if ((uint8_t)(frame[0] + frame[1] + frame[2] + frame[3]) != frame[4]) {
+        checksumErrors++;
+        return;
+    }
+
+    uint16_t humidity10 = ((uint16_t)frame[0] << 8) | frame[1];
+    int16_t temperature10 = (int16_t)((((uint16_t)frame[2] & 0x7F) << 8) | frame[3]);
+    if (frame[2] & 0x80) temperature10 = -temperature10;
+
+    packedSample.store(((uint32_t)(uint16_t)temperature10 << 16) | humidity10, std::memory_order_relaxed);
+    sampleTime.store(millis(), std::memory_order_relaxed);
+    hasSample.store(true, std::memory_order_release);
+    okCount++;
+}
+
+bool DhtReader::decodeEdges(const volatile uint32_t* edges, int count, uint8_t out[5]) {
+    // The first edge (response start) can be missed if the sensor answers
+    // before the interrupt is armed, so decode from the last 41 edges.
+    const int needed = FRAME_EDGES - 1;
+    if (count < needed) return false;
+    int first = count - needed;
+
+    memset(out, 0, 5);
+    for (int bit = 0; bit < 40; bit++) {
+        uint32_t width = edges[first + bit + 1] - edges[first + bit];
+        if (width < BIT_MIN_US || width > BIT_MAX_US) return false;
+        out[bit / 8] <<= 1;
+        if (width > BIT_THRESHOLD_US) out[bit / 8] |= 1;
+    }
+    return true;
+}
+
+DHTReading DhtReader::read() const {
+    DHTReading r = {0, 0, false, 0};
+    if (!hasSample.load(std::memory_order_acquire)) return r;
+
+    uint32_t packed = packedSample.load(std::memory_order_relaxed);
+    r.temperature = (int16_t)(packed >> 16) / 10.0f;
+    r.humidity = (uint16_t)(packed & 0xFFFF) / 10.0f;
+    r.valid = true;
+    r.ageMs = millis() - sampleTime.load(std::memory_order_relaxed);
+    return r;
+}
@@ -0,0 +1,77 @@
+#ifndef DHT_READER_H
+#define DHT_READER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// Interrupt-driven DHT22 reader.
+// A periodic esp_timer starts a conversion (1.1 ms start pulse), a GPIO
+// interrupt timestamps the falling edges of the 40-bit reply, and a one-shot
+// timer decodes and checksums the frame once it is complete. Nothing here
+// runs on the caller's stack: read() only loads the last valid sample.
+
+#ifndef DHT_READ_INTERVAL_MS
+#define DHT_READ_INTERVAL_MS 2500 // DHT22 needs >= 2 s between conversions
+#endif
+
+struct DHTReading {
+    float temperature;
+    float humidity;
+    bool valid;            // false until the first good frame
+    unsigned long ageMs;   // time since that frame was captured
+};
+
+class DhtReader {
+public:
+    // Falling edges: response start, start of bit 0, then the end of each of the 40 bits
+    static const int FRAME_EDGES = 42;
+
+private:
+    enum Phase {
+        PHASE_IDLE,
+        PHASE_START,    // host is holding the line low
+        PHASE_CAPTURE   // ISR is collecting edges
+    };
+
+    int pin;
+    Phase phase = PHASE_IDLE;
+
+    esp_timer_handle_t periodTimer = nullptr;
+    esp_timer_handle_t phaseTimer = nullptr;
+
+    volatile uint32_t edges[FRAME_EDGES + 2];
+    volatile int edgeCount = 0;
+
+    // temperature*10 (int16) in the high half, humidity*10 in the low half
+    std::atomic<uint32_t> packedSample{0};
+    std::atomic<uint32_t> sampleTime{0};
+    std::atomic<bool> hasSample{false};
+
+    std::atomic<uint32_t> okCount{0};
+    std::atomic<uint32_t> checksumErrors{0};
+    std::atomic<uint32_t> timeouts{0};
+
+    static void onPeriod(void* arg);
+    static void onPhase(void* arg);
+    static void onEdge(void* arg);
+
+    void startConversion();
+    void finishConversion();
+
+public:
+    explicit DhtReader(int pin);
+    void begin();
+
+    // Non-blocking
+    DHTReading read() const;
+
+    uint32_t getOkCount() const { return okCount; }
+    uint32_t getChecksumErrors() const { return checksumErrors; }
+    uint32_t getTimeouts() const { return timeouts; }
+
+    // Decodes edge timestamps (micros) into the 5 frame bytes. Returns false on timeout/short frame.
+    static bool decodeEdges(const volatile uint32_t* edges, int count, uint8_t out[5]);
+};
+
+#endif
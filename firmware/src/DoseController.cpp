@@ -0,0 +1,80 @@
+#include "DoseController.h"
+
+DoseController::DoseController() {
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) gain[i] = 0;
+}
+
+void DoseController::begin(ConfigManager& config) {
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) gain[i] = config.loadDoseGain(i) / 100.0f;
+}
+
+uint32_t DoseController::nextPulse(const int8_t* percent, int threshold, int mode, bool newSession, float reserve) {
+    if (newSession) sessionMs = 0;
+
+    // The value needsWater() compares, and how fast the pump moves it
+    float value = 0, valueGain = 0;
+    if (mode == 0) {
+        // AVG: unknown channels are left out of the average gain
+        int known = 0;
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+            value += percent[i];
+            if (gain[i] > 0) {
+                valueGain += gain[i];
+                known++;
+            }
+        }
+        value /= SOIL_SENSOR_COUNT;
+        if (known) valueGain /= known;
+    } else {
+        // ANY waters until the driest channel is wet, ALL until the wettest is
+        int pick = 0;
+        for (int i = 1; i < SOIL_SENSOR_COUNT; i++) {
+            bool better = mode == 1 ? percent[i] < percent[pick]
+                                    : percent[i] > percent[pick];
+            if (better) pick = i;
+        }
+        value = percent[pick];
+        valueGain = gain[pick];
+    }
+
+    uint32_t ms = DOSE_DEFAULT_MS;
+    if (valueGain > 0) {
+        float needed = threshold + DOSE_TARGET_MARGIN + reserve - value;
+        ms = needed > 0 ? (uint32_t)(needed / valueGain * 1000) : DOSE_MIN_MS;
+    }
+    if (ms < DOSE_MIN_MS) ms = DOSE_MIN_MS;
+    if (ms > DOSE_MAX_MS) ms = DOSE_MAX_MS;
+
+    uint32_t left = sessionMs < DOSE_SESSION_MAX_MS ? DOSE_SESSION_MAX_MS - sessionMs : 0;
+    if (left < DOSE_MIN_MS) return 0;
+    if (ms > left) ms = left;
+    sessionMs += ms;
+    pulseMs = ms;
+    return ms;
+}
+
+uint32_t DoseController::manualPulse() {
+    // Starts a session: follow-up pulses after the soak count against it
+    pulseMs = DOSE_DEFAULT_MS;
+    sessionMs = pulseMs;
+    return pulseMs;
+}
+
+void DoseController::recordPulse(uint32_t onMs) {
+    sessionMs = sessionMs > pulseMs ? sessionMs - pulseMs + onMs : onMs;
+    pulseMs = onMs;
+}
+
+void DoseController::learn(const int8_t* before, const int8_t* after, Span<const bool> rose, ConfigManager& config) {
+    if (pulseMs == 0) return;
+    for (int i = 0; i < SOIL_SENSOR_COUNT && i < (int)rose.size(); i++) {
+        // A channel that did not respond says nothing about the dose (fault or dry tank)
+        if (!rose[i]) continue;
+        // A channel pinned at 100 % rose less than the water it got
+        if (after[i] >= 100) continue;
+        float observed = (after[i] - before[i]) * 1000.0f / pulseMs;
+        gain[i] = gain[i] > 0 ? gain[i] + DOSE_LEARN_RATE * (observed - gain[i]) : observed;
+        long stored = lroundf(gain[i] * 100);
+        config.saveDoseGain(i, stored > 65535 ? 65535 : stored);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef DOSE_CONTROLLER_H
+#define DOSE_CONTROLLER_H
+
+#include <Arduino.h>
+#include "SensorManager.h"
+#include "ConfigManager.h"
+
+// Pulse length for each WATERING cycle.
+//
+// Every soak ends with the rise of each channel since its snapshot; divided
+// by the pulse that caused it this is the channel's gain in moisture % per
+// pump-second, smoothed over sessions and kept in the config blob. The next
+// pulse is sized to lift the value needsWater() looks at (average, driest
+// or wettest channel, by trigger mode) to threshold + DOSE_TARGET_MARGIN,
+// so a dry pot is usually done in one or two cycles instead of many fixed
+// pulses. Watering ahead of a window adds a reserve on top: the drying
+// forecast until the next window opens. Until a gain is known, pulses are
+// DOSE_DEFAULT_MS.
+
+#ifndef DOSE_DEFAULT_MS
+#define DOSE_DEFAULT_MS 5000
+#endif
+#ifndef DOSE_MIN_MS
+#define DOSE_MIN_MS 2000
+#endif
+// Longest single pulse
+#ifndef DOSE_MAX_MS
+#define DOSE_MAX_MS 30000
+#endif
+// All pulses of one session (IDLE until needsWater() is false again)
+#ifndef DOSE_SESSION_MAX_MS
+#define DOSE_SESSION_MAX_MS 90000
+#endif
+// Aim this many points above the threshold
+#ifndef DOSE_TARGET_MARGIN
+#define DOSE_TARGET_MARGIN 8
+#endif
+// Weight of the newest observation in the smoothed gain
+#define DOSE_LEARN_RATE 0.3f
+
+class DoseController {
+private:
+    float gain[SOIL_SENSOR_COUNT]; // % per pump-second, 0 = unknown
+    uint32_t pulseMs = 0;          // current/last pulse
+    uint32_t sessionMs = 0;        // pumped since the session started
+
+public:
+    DoseController();
+    // Learned gains from the config
+    void begin(ConfigManager& config);
+
+    // Pulse for the next cycle (newSession: leaving IDLE), aiming reserve
+    // points above threshold + DOSE_TARGET_MARGIN; 0 when the session limit
+    // is used up
+    uint32_t nextPulse(const int8_t* percent, int threshold, int mode, bool newSession, float reserve = 0);
+    // Manual run: fixed length, starts a new session
+    uint32_t manualPulse();
+    // The pump's actual on-time for the last pulse (cut short by a metered
+    // dose, no flow or a state change); learn() divides by it
+    void recordPulse(uint32_t onMs);
+    // After the soak: learns from the rise since the snapshot on the channels
+    // that responded (`rose`), and stores the gains in the config
+    void learn(const int8_t* before, const int8_t* after, Span<const bool> rose, ConfigManager& config);
+
+    uint32_t getPulseMs() const { return pulseMs; }
+    uint32_t getSessionMs() const { return sessionMs; }
+    float getGain(int channel) const { return gain[channel]; }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "ExternalAdc.h"
+
+// ADS1115 registers and config fields
+static const uint8_t REG_CONVERSION = 0x00;
+static const uint8_t REG_CONFIG = 0x01;
+static const uint16_t CFG_OS_START = 0x8000;
+static const uint16_t CFG_PGA_4V096 = 0x0200; // 125 uV per count
+static const uint16_t CFG_MODE_SINGLE = 0x0100;
+static const uint16_t CFG_COMP_DISABLE = 0x0003;
+
+// 3.3 V full scale at 125 uV/count
+static const int32_t COUNTS_3V3 = 26400;
+
+static const uint16_t DATA_RATES[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+uint32_t ExternalAdc::conversionTimeUs() {
+    // Internal oscillator is +-10%: wait for the slow end
+    return 1100000UL / DATA_RATES[EXT_ADC_DATA_RATE & 0x07] + 20;
+}
+
+int ExternalAdc::addChip(TwoWire& bus, uint8_t address) {
+    if (chipCount >= EXT_ADC_MAX_CHIPS) return -1;
+    chips[chipCount] = {&bus, address, false};
+    return chipCount++ * ADS1115_CHANNELS;
+}
+
+bool ExternalAdc::startConversion(Chip& chip, int input) {
+    uint16_t config = CFG_OS_START | ((4 + input) << 12) | CFG_PGA_4V096 | CFG_MODE_SINGLE |
+                      ((EXT_ADC_DATA_RATE & 0x07) << 5) | CFG_COMP_DISABLE;
+    chip.bus->beginTransmission(chip.address);
+    chip.bus->write(REG_CONFIG);
+    chip.bus->write(config >> 8);
+    chip.bus->write(config & 0xff);
+    return chip.bus->endTransmission() == 0;
+}
+
+bool ExternalAdc::readConversion(Chip& chip, int16_t& counts) {
+    chip.bus->beginTransmission(chip.address);
+    chip.bus->write(REG_CONVERSION);
+    if (chip.bus->endTransmission(false) != 0) return false;
+    if (chip.bus->requestFrom(chip.address, (uint8_t)2) != 2) return false;
+    int hi = chip.bus->read();
+    int lo = chip.bus->read();
+    counts = (int16_t)((hi << 8) | lo);
+    return true;
+}
+
+void ExternalAdc::begin() {
+    for (int i = 0; i < chipCount; i++) {
+        chips[i].bus->beginTransmission(chips[i].address);
+        chips[i].present = chips[i].bus->endTransmission() == 0;
+        if (!chips[i].present) Serial.printf("ADS1115 0x%02x not found\n", chips[i].address);
+    }
+
+    phase = 0;
+    stepStartedUs = micros();
+    for (int i = 0; i < chipCount; i++) {
+        if (chips[i].present) startConversion(chips[i], phase);
+    }
+    // Fill every channel before anyone reads
+    for (int i = 0; i < ADS1115_CHANNELS; i++) step();
+
+    if (!timer) {
+        esp_timer_create_args_t args = {};
+        args.callback = &ExternalAdc::onTimer;
+        args.arg = this;
+        args.name = "ext_adc";
+        esp_timer_create(&args, &timer);
+    }
+    esp_timer_start_periodic(timer, conversionTimeUs());
+}
+
+void ExternalAdc::stop() {
+    if (timer) esp_timer_stop(timer);
+}
+
+void ExternalAdc::onTimer(void* arg) {
+    static_cast<ExternalAdc*>(arg)->step();
+}
+
+void ExternalAdc::step() {
+    // Chips were started in order, so waiting on the first covers the rest
+    uint32_t waited = micros() - stepStartedUs;
+    if (waited < conversionTimeUs()) delayMicroseconds(conversionTimeUs() - waited);
+
+    for (int i = 0; i < chipCount; i++) {
+        if (!chips[i].present) continue;
+        int16_t counts;
+        if (!readConversion(chips[i], counts)) {
+            errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        int32_t raw = counts <= 0 ? 0 : (int32_t)counts * 4095 / COUNTS_3V3;
+        values[i * ADS1115_CHANNELS + phase].store(raw > 4095 ? 4095 : raw, std::memory_order_relaxed);
+    }
+
+    phase = (phase + 1) % ADS1115_CHANNELS;
+    if (phase == 0) scans.fetch_add(1, std::memory_order_release);
+
+    stepStartedUs = micros();
+    for (int i = 0; i < chipCount; i++) {
+        if (chips[i].present && !startConversion(chips[i], phase)) errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint16_t ExternalAdc::read(int channel) const {
+    if (channel < 0 || channel >= getChannelCount()) return 0;
+    return values[channel].load(std::memory_order_relaxed);
+}
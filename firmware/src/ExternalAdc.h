@@ -0,0 +1,74 @@
+#ifndef EXTERNAL_ADC_H
+#define EXTERNAL_ADC_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include <atomic>
+
+// Soil channels on external ADS1115 ADCs (4 single-ended inputs each, up to
+// 4 per I2C bus by address strapping, two buses).
+//
+// Conversions are pipelined across chips: every timer tick collects the
+// finished conversion from each chip and immediately starts the next input
+// on it, so all chips convert in parallel. A full scan takes 4 ticks no
+// matter how many chips are fitted, until I2C traffic exceeds a conversion.
+// Values are scaled to the on-chip 12-bit / 3.3 V range, so calibration
+// values are interchangeable with SOIL_PINS channels.
+
+#define ADS1115_CHANNELS 4
+#define EXT_ADC_MAX_CHIPS 8
+#define EXT_ADC_MAX_CHANNELS (EXT_ADC_MAX_CHIPS * ADS1115_CHANNELS)
+
+#ifndef EXT_ADC_I2C_HZ
+#define EXT_ADC_I2C_HZ 400000
+#endif
+
+// ADS1115 data rate code 0..7 (8..860 SPS); 7 = 860 SPS, ~1.2 ms per conversion
+#ifndef EXT_ADC_DATA_RATE
+#define EXT_ADC_DATA_RATE 7
+#endif
+
+class ExternalAdc {
+private:
+    struct Chip {
+        TwoWire* bus;
+        uint8_t address;
+        bool present;
+    };
+
+    Chip chips[EXT_ADC_MAX_CHIPS];
+    int chipCount = 0;
+    uint8_t phase = 0; // input being converted on every chip
+
+    // One slot per channel (chip * 4 + input), written by the timer only
+    std::atomic<uint16_t> values[EXT_ADC_MAX_CHANNELS];
+    std::atomic<uint32_t> scans{0};
+    std::atomic<uint32_t> errors{0};
+    uint64_t stepStartedUs = 0;
+
+    esp_timer_handle_t timer = nullptr;
+
+    static void onTimer(void* arg);
+    bool startConversion(Chip& chip, int input);
+    bool readConversion(Chip& chip, int16_t& counts);
+
+public:
+    // Returns the index of the chip's first channel, or -1 if full
+    int addChip(TwoWire& bus, uint8_t address);
+    int getChannelCount() const { return chipCount * ADS1115_CHANNELS; }
+
+    // Probes the chips, runs one blocking scan (boot only), then starts the timer
+    void begin();
+    void stop();
+    // One pipeline stage: collect the current input from every chip, start the next
+    void step();
+
+    // O(1): last value of the channel, on the 12-bit scale
+    uint16_t read(int channel) const;
+    uint32_t getScanCount() const { return scans.load(std::memory_order_relaxed); }
+    uint32_t getErrorCount() const { return errors.load(std::memory_order_relaxed); }
+    static uint32_t conversionTimeUs();
+};
+
+#endif
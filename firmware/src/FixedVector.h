@@ -0,0 +1,61 @@
+#ifndef FIXED_VECTOR_H
+#define FIXED_VECTOR_H
+
+#include <stddef.h>
+
+// Non-owning view of a contiguous array (std::span without C++20)
+template <typename T>
+class Span {
+private:
+    T* ptr = nullptr;
+    size_t len = 0;
+
+public:
+    Span() {}
+    Span(T* data, size_t size) : ptr(data), len(size) {}
+    template <size_t N>
+    Span(T (&array)[N]) : ptr(array), len(N) {}
+
+    T* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T& operator[](size_t i) const { return ptr[i]; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + len; }
+};
+
+// Vector with its storage inline, capacity fixed at compile time. Used where
+// the firmware returned std::vector copies, so steady state stays off the
+// heap. push_back() past the capacity is dropped.
+template <typename T, size_t N>
+class FixedVector {
+private:
+    T items[N];
+    size_t count = 0;
+
+public:
+    static const size_t CAPACITY = N;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    void clear() { count = 0; }
+
+    bool push_back(const T& value) {
+        if (count == N) return false;
+        items[count++] = value;
+        return true;
+    }
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+    operator Span<T>() { return Span<T>(items, count); }
+    operator Span<const T>() const { return Span<const T>(items, count); }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "HistoryStore.h"
+
+const uint32_t HistoryStore::PERIODS[HISTORY_TIER_COUNT] = {60, 3600, 86400};
+
+HistoryStore::HistoryStore() {
+    static const uint16_t capacities[HISTORY_TIER_COUNT] = {HISTORY_MINUTES, HISTORY_HOURS, HISTORY_DAYS};
+    uint16_t base = 0;
+    for (int t = 0; t < HISTORY_TIER_COUNT; t++) {
+        rings[t] = {base, capacities[t], 0, 0};
+        base += capacities[t];
+        clear(open[t]);
+    }
+}
+
+void HistoryStore::clear(Rollup& r) {
+    memset(&r, 0, sizeof(r));
+}
+
+void HistoryStore::add(SensorManager& sensors, uint32_t localEpoch, int32_t utcOffsetSec) {
+    if (!localEpoch) return;
+    utcOffset = utcOffsetSec;
+
+    // Close what this sample has left, finest first: a closed minute still
+    // belongs to the hour it started in
+    for (int t = 0; t < HISTORY_TIER_COUNT; t++) {
+        if (open[t].count && localEpoch / PERIODS[t] != open[t].start / PERIODS[t]) close(t);
+    }
+
+    Rollup& m = open[HISTORY_MINUTE];
+    if (m.count == 0) m.start = localEpoch - localEpoch % PERIODS[HISTORY_MINUTE];
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        uint8_t v = (uint8_t)lroundf(sensors.getPercentExact(i) * 2);
+        m.sum[i] += v;
+        if (m.count == 0 || v < m.min[i]) m.min[i] = v;
+        if (m.count == 0 || v > m.max[i]) m.max[i] = v;
+    }
+    DHTReading dht = sensors.getDHT();
+    if (dht.valid) {
+        m.tempSum += lroundf(dht.temperature * 10);
+        m.humiditySum += lroundf(dht.humidity * 2);
+        m.envCount++;
+    }
+    m.count++;
+}
+
+void HistoryStore::close(int tier) {
+    Rollup& r = open[tier];
+    Ring& ring = rings[tier];
+    Entry& e = entries[ring.base + ring.head];
+
+    e.time = r.start - utcOffset;
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        e.min[i] = r.min[i];
+        e.max[i] = r.max[i];
+        e.avg[i] = (r.sum[i] + r.count / 2) / r.count;
+    }
+    if (r.envCount) {
+        e.temp10 = lroundf((float)r.tempSum / r.envCount);
+        e.humidity2 = (r.humiditySum + r.envCount / 2) / r.envCount;
+    } else {
+        e.temp10 = NO_TEMP;
+        e.humidity2 = NO_HUMIDITY;
+    }
+    ring.head = (ring.head + 1) % ring.capacity;
+    if (ring.count < ring.capacity) ring.count++;
+
+    if (tier + 1 < HISTORY_TIER_COUNT) merge(open[tier + 1], r, PERIODS[tier + 1]);
+    clear(r);
+}
+
+void HistoryStore::merge(Rollup& into, const Rollup& from, uint32_t period) {
+    // Sums and counts carry over, so every tier's average is over the raw samples
+    if (into.count == 0) into.start = from.start - from.start % period;
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        into.sum[i] += from.sum[i];
+        if (into.count == 0 || from.min[i] < into.min[i]) into.min[i] = from.min[i];
+        if (into.count == 0 || from.max[i] > into.max[i]) into.max[i] = from.max[i];
+    }
+    into.tempSum += from.tempSum;
+    into.humiditySum += from.humiditySum;
+    into.envCount += from.envCount;
+    into.count += from.count;
+}
+
+size_t HistoryStore::encodePage(int tier, int page, uint8_t* buffer, size_t capacity) {
+    int perPage = pageSize(capacity);
+    if (tier < 0 || tier >= HISTORY_TIER_COUNT || page < 0 || perPage <= 0) return 0;
+    const Ring& ring = rings[tier];
+    int pages = (ring.count + perPage - 1) / perPage;
+    int first = page * perPage;
+    int n = first < ring.count ? ring.count - first : 0;
+    if (n > perPage) n = perPage;
+
+    MsgPackWriter w(buffer, capacity);
+    w.writeRaw(HISTORY_FRAME_V1);
+    w.writeArray(5);
+    w.writeUInt(tier);
+    w.writeUInt(page);
+    w.writeUInt(pages);
+    w.writeUInt(PERIODS[tier]);
+    w.writeArray(n);
+    for (int k = 0; k < n; k++) {
+        // Newest first: head - 1 is the last one written
+        const Entry& e = entries[ring.base + (ring.head + 2 * ring.capacity - 1 - first - k) % ring.capacity];
+        w.writeArray(6);
+        w.writeUInt(e.time);
+        if (e.temp10 == NO_TEMP) w.writeNil();
+        else w.writeInt(e.temp10);
+        if (e.humidity2 == NO_HUMIDITY) w.writeNil();
+        else w.writeUInt(e.humidity2);
+        w.writeArray(SOIL_SENSOR_COUNT);
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) w.writeUInt(e.min[i]);
+        w.writeArray(SOIL_SENSOR_COUNT);
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) w.writeUInt(e.max[i]);
+        w.writeArray(SOIL_SENSOR_COUNT);
+        for (int i = 0; i < SOIL_SENSOR_COUNT; i++) w.writeUInt(e.avg[i]);
+    }
+    return w.ok() ? w.size() : 0;
+}
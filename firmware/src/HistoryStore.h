@@ -0,0 +1,113 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <Arduino.h>
+#include "MsgPack.h"
+#include "SensorManager.h"
+
+// On-device history in three fixed rings: 1 min, 1 h and 1 day rollups
+// with per-channel min/max/avg moisture and average temperature/humidity.
+// Samples go into the open minute; a closed minute is stored and merged
+// into the open hour, a closed hour into the open day. Buckets follow the
+// local clock (days start at local midnight), so nothing is recorded
+// until the time is known. RAM only: lost on reboot and deep sleep.
+//
+// Queried with HISTORY:<tier>:<page> (tier 0 = minutes, 1 = hours,
+// 2 = days; page 0 = newest) and answered on plantcare/<id>/history:
+// one version byte, then a MessagePack array
+//   [tier, page, pages, period_s, [[time, temp, humidity, min[], max[], avg[]], ...]]
+// newest entry first. time is the UTC epoch of the bucket start, moisture
+// is in 0.5 % steps (0-200), temperature x10 and humidity x2, nil when the
+// DHT had no reading in that bucket.
+
+#ifndef HISTORY_SAMPLE_INTERVAL_MS
+#define HISTORY_SAMPLE_INTERVAL_MS 10000
+#endif
+// Ring sizes; external ADC builds keep less so the budget stays about the same
+#ifndef HISTORY_MINUTES
+#define HISTORY_MINUTES (SOIL_SENSOR_COUNT <= 4 ? 120 : 60)
+#endif
+#ifndef HISTORY_HOURS
+#define HISTORY_HOURS (SOIL_SENSOR_COUNT <= 4 ? 168 : 48)
+#endif
+#ifndef HISTORY_DAYS
+#define HISTORY_DAYS (SOIL_SENSOR_COUNT <= 4 ? 90 : 30)
+#endif
+#define HISTORY_MAX_RAM_BYTES 16384
+#define HISTORY_FRAME_V1 0x01
+
+enum HistoryTier {
+    HISTORY_MINUTE = 0,
+    HISTORY_HOUR = 1,
+    HISTORY_DAY = 2,
+    HISTORY_TIER_COUNT = 3
+};
+
+class HistoryStore {
+private:
+    static const int16_t NO_TEMP = INT16_MIN;
+    static const uint8_t NO_HUMIDITY = 0xff;
+
+    struct Entry {
+        uint32_t time; // UTC bucket start
+        int16_t temp10;
+        uint8_t humidity2;
+        uint8_t min[SOIL_SENSOR_COUNT];
+        uint8_t max[SOIL_SENSOR_COUNT];
+        uint8_t avg[SOIL_SENSOR_COUNT];
+    };
+
+    // Open bucket of one tier
+    struct Rollup {
+        uint32_t start; // local epoch
+        uint32_t count; // samples
+        uint32_t sum[SOIL_SENSOR_COUNT];
+        uint8_t min[SOIL_SENSOR_COUNT];
+        uint8_t max[SOIL_SENSOR_COUNT];
+        int32_t tempSum;
+        uint32_t humiditySum;
+        uint32_t envCount;
+    };
+
+    struct Ring {
+        uint16_t base;     // first slot in entries[]
+        uint16_t capacity;
+        uint16_t head;     // next slot to write
+        uint16_t count;
+    };
+
+    static const uint32_t PERIODS[HISTORY_TIER_COUNT];
+
+    Entry entries[HISTORY_MINUTES + HISTORY_HOURS + HISTORY_DAYS];
+    Ring rings[HISTORY_TIER_COUNT];
+    Rollup open[HISTORY_TIER_COUNT];
+    int32_t utcOffset = 0;
+
+    void clear(Rollup& r);
+    void close(int tier);
+    void merge(Rollup& into, const Rollup& from, uint32_t period);
+
+public:
+    // Worst case per entry and per frame header, for page sizing
+    static constexpr size_t MAX_ENTRY_SIZE = 2 * MsgPackWriter::MAX_ARRAY_HEADER_SIZE + MsgPackWriter::MAX_INT_SIZE +
+        MsgPackWriter::MAX_INT16_SIZE + MsgPackWriter::MAX_INT8_SIZE +
+        3 * (MsgPackWriter::MAX_ARRAY_HEADER_SIZE + SOIL_SENSOR_COUNT * MsgPackWriter::MAX_INT8_SIZE);
+    static constexpr size_t MAX_HEADER_SIZE = 1 + 2 * MsgPackWriter::MAX_ARRAY_HEADER_SIZE + 4 * MsgPackWriter::MAX_INT_SIZE;
+
+    HistoryStore();
+
+    // One sample of every channel; localEpoch 0 (clock unknown) is ignored
+    void add(SensorManager& sensors, uint32_t localEpoch, int32_t utcOffsetSec);
+
+    int getCount(int tier) const { return rings[tier].count; }
+    // Entries per page for a frame of `capacity` bytes
+    static int pageSize(size_t capacity) {
+        return capacity > MAX_HEADER_SIZE ? (int)((capacity - MAX_HEADER_SIZE) / MAX_ENTRY_SIZE) : 0;
+    }
+    // Returns the frame length, or 0 if the tier is invalid or the buffer too small
+    size_t encodePage(int tier, int page, uint8_t* buffer, size_t capacity);
+};
+
+static_assert(sizeof(HistoryStore) <= HISTORY_MAX_RAM_BYTES, "history rings over their RAM budget");
+
+#endif
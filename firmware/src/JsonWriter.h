@@ -0,0 +1,143 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Minimal streaming JSON writer over a caller-owned buffer, for payloads
+// built on every cycle (status, acks) where a JsonDocument would allocate.
+// Commas are placed automatically; the output is always NUL-terminated.
+// A write that does not fit sets the overflow flag and everything after it
+// is dropped, so check ok() before publishing.
+class JsonWriter {
+private:
+    static const int MAX_DEPTH = 31;
+
+    char* buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+    int depth = 0;
+    uint32_t hasItems = 0; // bit d: container at depth d has an element
+    bool afterKey = false;
+
+    void put(char c) {
+        if (overflow || len + 1 >= cap) {
+            overflow = true;
+            return;
+        }
+        buf[len++] = c;
+        buf[len] = '\0';
+    }
+
+    void putf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        if (overflow) return;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, cap - len, fmt, args);
+        va_end(args);
+        if (n < 0 || len + n >= cap) {
+            overflow = true;
+            buf[len] = '\0';
+            return;
+        }
+        len += n;
+    }
+
+    void putString(const char* s) {
+        put('"');
+        for (; *s; s++) {
+            if (*s == '"' || *s == '\\') {
+                put('\\');
+                put(*s);
+            } else if ((uint8_t)*s < 0x20) {
+                putf("\\u%04x", *s);
+            } else {
+                put(*s);
+            }
+        }
+        put('"');
+    }
+
+    void separator() {
+        if (afterKey) {
+            afterKey = false;
+            return;
+        }
+        if (hasItems & (1u << depth)) put(',');
+        hasItems |= 1u << depth;
+    }
+
+    void open(char c) {
+        separator();
+        put(c);
+        if (depth < MAX_DEPTH) depth++;
+        hasItems &= ~(1u << depth);
+    }
+
+    void close(char c) {
+        put(c);
+        if (depth > 0) depth--;
+    }
+
+public:
+    JsonWriter(char* buffer, size_t capacity) : buf(buffer), cap(capacity) {
+        if (cap > 0) buf[0] = '\0';
+        else overflow = true;
+    }
+
+    size_t size() const { return len; }
+    bool ok() const { return !overflow; }
+
+    void beginObject() { open('{'); }
+    void endObject() { close('}'); }
+    void beginArray() { open('['); }
+    void endArray() { close(']'); }
+
+    void key(const char* k) {
+        separator();
+        putString(k);
+        put(':');
+        afterKey = true;
+    }
+
+    void valueNull() {
+        separator();
+        putf("null");
+    }
+    void value(bool v) {
+        separator();
+        putf(v ? "true" : "false");
+    }
+    void value(int v) { value((long)v); }
+    void value(unsigned int v) { value((unsigned long)v); }
+    void value(long v) {
+        separator();
+        putf("%ld", v);
+    }
+    void value(unsigned long v) {
+        separator();
+        putf("%lu", v);
+    }
+    // NaN and infinity are written as null, as ArduinoJson does
+    void value(float v) {
+        separator();
+        if (isnan(v) || isinf(v)) putf("null");
+        else putf("%.6g", v);
+    }
+    void value(const char* s) {
+        separator();
+        putString(s);
+    }
+
+    template <typename T>
+    void field(const char* k, T v) {
+        key(k);
+        value(v);
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "MoistureForecast.h"
+
+// Prior covariance: rates of a few % per hour are plausible before any data
+static const float COV_INIT = 10.0f;
+// Unexcited directions (e.g. constant humidity) would grow without bound under forgetting
+static const float COV_MAX_TRACE = 3 * COV_INIT;
+// Slower than this is "not drying"
+static const float MIN_DRYING_RATE = 0.01f;
+
+MoistureForecast::MoistureForecast() {
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        for (int j = 0; j < PARAMS; j++) coef[i][j] = 0;
+        lastPercent[i] = 0;
+    }
+    for (int i = 0; i < PARAMS; i++) {
+        for (int j = 0; j < PARAMS; j++) cov[i][j] = i == j ? COV_INIT : 0;
+    }
+}
+
+void MoistureForecast::covariates(const DHTReading& dht, float* x) {
+    // Without a reading, assume the last known conditions still hold
+    if (dht.valid) {
+        lastX[1] = (dht.temperature - 20) / 10;
+        lastX[2] = (dht.humidity - 50) / 50;
+    }
+    for (int i = 0; i < PARAMS; i++) x[i] = lastX[i];
+}
+
+float MoistureForecast::rate(int channel, const float* x) const {
+    return coef[channel][0] * x[0] + coef[channel][1] * x[1] + coef[channel][2] * x[2];
+}
+
+void MoistureForecast::update(SensorManager& sensors) {
+    unsigned long now = millis();
+    if ((long)(now - nextSampleMs) < 0) return;
+
+    float percent[SOIL_SENSOR_COUNT];
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) percent[i] = sensors.getPercentExact(i);
+    addSample(percent, sensors.getDHT(), haveLast ? (now - lastSampleMs) / 3600000.0f : 0);
+    lastSampleMs = now;
+    nextSampleMs = now + FORECAST_SAMPLE_MS;
+}
+
+void MoistureForecast::addSample(const float* percent, const DHTReading& dht, float dtHours) {
+    float x[PARAMS];
+    covariates(dht, x);
+
+    if (haveLast && dtHours > 0) {
+        // Shared part of the RLS step: gain from the covariance and x
+        float lambda = exp2f(-dtHours / FORECAST_HALF_LIFE_H);
+        float px[PARAMS];
+        for (int i = 0; i < PARAMS; i++) px[i] = cov[i][0] * x[0] + cov[i][1] * x[1] + cov[i][2] * x[2];
+        float denom = lambda + x[0] * px[0] + x[1] * px[1] + x[2] * px[2];
+        float gain[PARAMS];
+        for (int i = 0; i < PARAMS; i++) gain[i] = px[i] / denom;
+
+        // Per channel: only the coefficients move
+        for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+            float delta = percent[c] - lastPercent[c];
+            if (delta > FORECAST_RISE_RESET) continue;
+            float error = delta / dtHours - rate(c, x);
+            for (int i = 0; i < PARAMS; i++) coef[c][i] += gain[i] * error;
+        }
+
+        float trace = 0;
+        for (int i = 0; i < PARAMS; i++) {
+            for (int j = 0; j < PARAMS; j++) cov[i][j] = (cov[i][j] - gain[i] * px[j]) / lambda;
+            trace += cov[i][i];
+        }
+        if (trace > COV_MAX_TRACE) {
+            float scale = COV_MAX_TRACE / trace;
+            for (int i = 0; i < PARAMS; i++) {
+                for (int j = 0; j < PARAMS; j++) cov[i][j] *= scale;
+            }
+        }
+        samples++;
+    }
+
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) lastPercent[c] = percent[c];
+    haveLast = true;
+}
+
+void MoistureForecast::restart() {
+    // Coefficients are kept: only the next difference would be wrong
+    haveLast = false;
+    nextSampleMs = millis() + FORECAST_SETTLE_MS;
+}
+
+static float hoursUntil(float percent, float ratePerHour, int threshold) {
+    if (percent < threshold) return 0;
+    if (ratePerHour > -MIN_DRYING_RATE) return FORECAST_NEVER;
+    float hours = (percent - threshold) / -ratePerHour;
+    return hours > FORECAST_HORIZON_H ? FORECAST_NEVER : hours;
+}
+
+float MoistureForecast::dryingRate(int mode) const {
+    if (!isReady()) return 0;
+    float result = 0;
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        float drying = -rate(c, lastX);
+        if (mode == 0) result += drying / SOIL_SENSOR_COUNT;
+        else if (drying > result) result = drying;
+    }
+    return result > 0 ? result : 0;
+}
+
+float MoistureForecast::hoursToTrigger(SensorManager& sensors, int threshold, int mode) const {
+    if (!isReady()) return FORECAST_NEVER;
+
+    // Mode 0 (AVG): the average is linear, so it moves at the average rate
+    if (mode == 0) {
+        float percentSum = 0, rateSum = 0;
+        for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+            percentSum += sensors.getPercentExact(c);
+            rateSum += rate(c, lastX);
+        }
+        return hoursUntil(percentSum / SOIL_SENSOR_COUNT, rateSum / SOIL_SENSOR_COUNT, threshold);
+    }
+
+    // Mode 1 (ANY): first channel to cross; mode 2 (ALL): last one
+    float result = mode == 1 ? FORECAST_NEVER : 0;
+    for (int c = 0; c < SOIL_SENSOR_COUNT; c++) {
+        float hours = hoursUntil(sensors.getPercentExact(c), rate(c, lastX), threshold);
+        if (mode == 1) {
+            if (hours != FORECAST_NEVER && (result == FORECAST_NEVER || hours < result)) result = hours;
+        } else {
+            if (hours == FORECAST_NEVER) return FORECAST_NEVER;
+            if (hours > result) result = hours;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,82 @@
+#ifndef MOISTURE_FORECAST_H
+#define MOISTURE_FORECAST_H
+
+#include <Arduino.h>
+#include "SensorManager.h"
+
+// Per-channel drying-rate estimate and time-to-threshold forecast.
+//
+// Every FORECAST_SAMPLE_MS (at the IDLE checks) the change in moisture since
+// the previous sample, in % per hour, is regressed on
+//   x = [1, (temp - 20) / 10, (humidity - 50) / 50]
+// with exponentially weighted recursive least squares (half-life
+// FORECAST_HALF_LIFE_H). All channels share x, so the 3x3 covariance and
+// the gain are computed once per sample and each channel only updates its
+// three coefficients: O(1) per channel, no history kept. Watering restarts
+// the trend (the jump and the fast drain afterwards are not drying).
+
+#ifndef FORECAST_SAMPLE_MS
+#define FORECAST_SAMPLE_MS 600000UL // 10 min
+#endif
+#ifndef FORECAST_HALF_LIFE_H
+#define FORECAST_HALF_LIFE_H 24
+#endif
+// Samples before forecasts are trusted
+#ifndef FORECAST_MIN_SAMPLES
+#define FORECAST_MIN_SAMPLES 6
+#endif
+// After watering, skip the drain-off before sampling again
+#ifndef FORECAST_SETTLE_MS
+#define FORECAST_SETTLE_MS 3600000UL
+#endif
+// A channel rising this much between samples was watered or rained on: not a trend
+#define FORECAST_RISE_RESET 3.0f
+// Crossings further out than this are reported as none
+#define FORECAST_HORIZON_H 72
+#define FORECAST_NEVER -1.0f
+
+class MoistureForecast {
+private:
+    static const int PARAMS = 3;
+
+    float coef[SOIL_SENSOR_COUNT][PARAMS]; // rate = coef . x, % per hour
+    float lastPercent[SOIL_SENSOR_COUNT];
+    float cov[PARAMS][PARAMS];
+    float lastX[PARAMS] = {1, 0, 0};       // covariates of the last valid DHT reading
+    uint32_t samples = 0;
+    unsigned long lastSampleMs = 0;
+    unsigned long nextSampleMs = 0;
+    bool haveLast = false;
+
+    void covariates(const DHTReading& dht, float* x);
+    float rate(int channel, const float* x) const;
+
+public:
+    MoistureForecast();
+
+    // At every IDLE check; takes a sample when one is due
+    void update(SensorManager& sensors);
+    // One sample `dtHours` after the previous one (update() fills in the readings)
+    void addSample(const float* percent, const DHTReading& dht, float dtHours);
+    // Watering happened: restart the trend after FORECAST_SETTLE_MS
+    void restart();
+
+    bool isReady() const { return samples >= FORECAST_MIN_SAMPLES; }
+    uint32_t getSampleCount() const { return samples; }
+    // Drying rate at the last temperature/humidity, % per hour (negative = drying)
+    float getRate(int channel) const { return rate(channel, lastX); }
+    // Hours until needsWater() would trigger (threshold and trigger mode as
+    // configured), 0 if it already does, FORECAST_NEVER when not within the horizon
+    float hoursToTrigger(SensorManager& sensors, int threshold, int mode) const;
+    // How fast the value needsWater() watches falls, % per hour (0 = not
+    // drying): the average rate for AVG, the fastest-drying channel for ANY/ALL
+    float dryingRate(int mode) const;
+
+    // After a deep sleep millis() restarted: move the sample clock back by shiftMs
+    void rebase(unsigned long shiftMs) {
+        lastSampleMs -= shiftMs;
+        nextSampleMs -= shiftMs;
+    }
+};
+
+#endif
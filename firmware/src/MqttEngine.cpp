@@ -0,0 +1,501 @@
+#include "MqttEngine.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <lwip/netdb.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Fixed header types (upper nibble of the first byte)
+static const uint8_t PKT_CONNECT = 0x10;
+static const uint8_t PKT_CONNACK = 0x20;
+static const uint8_t PKT_PUBLISH = 0x30;
+static const uint8_t PKT_PUBACK = 0x40;
+static const uint8_t PKT_SUBSCRIBE = 0x82; // with the reserved bits set
+static const uint8_t PKT_SUBACK = 0x90;
+static const uint8_t PKT_PINGREQ = 0xC0;
+static const uint8_t PKT_PINGRESP = 0xD0;
+static const uint8_t PKT_DISCONNECT = 0xE0;
+
+static size_t putRemainingLength(uint8_t* out, size_t length) {
+    size_t n = 0;
+    do {
+        uint8_t b = length & 0x7F;
+        length >>= 7;
+        out[n++] = length ? (b | 0x80) : b;
+    } while (length && n < 4);
+    return n;
+}
+
+static size_t putString(uint8_t* out, const char* s, size_t length) {
+    out[0] = length >> 8;
+    out[1] = length & 0xFF;
+    memcpy(out + 2, s, length);
+    return length + 2;
+}
+
+void MqttEngine::setServer(const char* hostName, uint16_t portNumber) {
+    host = hostName;
+    port = portNumber;
+    resolved = false;
+}
+
+void MqttEngine::setWill(const char* topic, const char* message, bool retain) {
+    willTopic = topic;
+    willMessage = message;
+    willRetain = retain;
+}
+
+void MqttEngine::setInflightWindow(uint8_t size) {
+    window = size < 1 ? 1 : (size > MQTT_INFLIGHT_MAX ? MQTT_INFLIGHT_MAX : size);
+}
+
+void MqttEngine::setHandlers(MessageHandler onMessage, ReleaseHandler onRelease, void* ctx) {
+    messageHandler = onMessage;
+    releaseHandler = onRelease;
+    handlerCtx = ctx;
+}
+
+bool MqttEngine::resolve() {
+    if (resolved) return true;
+    if (!host) return false;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+        // The one blocking step; the result is kept for later reconnects
+        struct addrinfo hints = {};
+        struct addrinfo* result = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) return false;
+        address.sin_addr = ((struct sockaddr_in*)result->ai_addr)->sin_addr;
+        freeaddrinfo(result);
+    }
+    resolved = true;
+    return true;
+}
+
+bool MqttEngine::connect() {
+    if (state != STATE_IDLE) return false;
+    if (!resolve()) return false;
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) return false;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    ctrlLen = ctrlWritten = 0;
+    pubActive = false;
+    rxLen = rxSkip = 0;
+    pingPending = false;
+    sessionPresent = false;
+    connectStartedAt = millis();
+    stats.connects++;
+
+    if (::connect(sock, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        state = STATE_CONNACK_WAIT;
+        return queueConnect();
+    }
+    if (errno != EINPROGRESS) {
+        closeSocket();
+        resolved = false; // the address may have moved
+        return false;
+    }
+    state = STATE_TCP_CONNECTING;
+    return true;
+}
+
+void MqttEngine::closeSocket() {
+    if (sock >= 0) close(sock);
+    sock = -1;
+    state = STATE_IDLE;
+}
+
+MqttEvent MqttEngine::fail() {
+    bool wasConnected = state == STATE_CONNECTED;
+    closeSocket();
+    // A QoS 0 publish cut off mid-write is lost with the connection
+    if (pubActive && pubTag && releaseHandler) releaseHandler(handlerCtx, pubTag, false);
+    pubActive = false;
+    if (!wasConnected) resolved = false;
+    return wasConnected ? MQTT_EVENT_DISCONNECTED : MQTT_EVENT_CONNECT_FAILED;
+}
+
+void MqttEngine::disconnect() {
+    if (state == STATE_CONNECTED) {
+        uint8_t packet[2] = {PKT_DISCONNECT, 0};
+        if (queueCtrl(packet, sizeof(packet))) flush();
+    }
+    closeSocket();
+    if (pubActive && pubTag && releaseHandler) releaseHandler(handlerCtx, pubTag, false);
+    pubActive = false;
+}
+
+bool MqttEngine::ctrlHasRoom(size_t length) const {
+    return (ctrlWritten == ctrlLen ? 0 : ctrlLen) + length <= sizeof(ctrl);
+}
+
+bool MqttEngine::queueCtrl(const uint8_t* data, size_t length) {
+    if (ctrlWritten == ctrlLen) ctrlLen = ctrlWritten = 0;
+    if (ctrlLen + length > sizeof(ctrl)) return false;
+    memcpy(ctrl + ctrlLen, data, length);
+    ctrlLen += length;
+    return true;
+}
+
+bool MqttEngine::queueConnect() {
+    size_t idLen = strlen(clientId);
+    size_t willTopicLen = willTopic ? strlen(willTopic) : 0;
+    size_t willLen = willMessage ? strlen(willMessage) : 0;
+    size_t rem = 10 + 2 + idLen + (willTopic ? 4 + willTopicLen + willLen : 0);
+    if (rem + 5 > sizeof(ctrl)) return false;
+
+    uint8_t* p = ctrl;
+    *p++ = PKT_CONNECT;
+    p += putRemainingLength(p, rem);
+    p += putString(p, "MQTT", 4);
+    *p++ = 4; // protocol level 3.1.1
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    if (willTopic) flags |= 0x04 | (willRetain ? 0x20 : 0); // will QoS 0
+    *p++ = flags;
+    *p++ = keepAliveSec >> 8;
+    *p++ = keepAliveSec & 0xFF;
+    p += putString(p, clientId, idLen);
+    if (willTopic) {
+        p += putString(p, willTopic, willTopicLen);
+        p += putString(p, willMessage ? willMessage : "", willLen);
+    }
+    ctrlLen = p - ctrl;
+    ctrlWritten = 0;
+    return true;
+}
+
+uint16_t MqttEngine::nextPacketId() {
+    if (++lastPacketId == 0) lastPacketId = 1;
+    return lastPacketId;
+}
+
+int MqttEngine::inflightCount() const {
+    int n = 0;
+    for (const Inflight& f : inflight) n += f.id != 0;
+    return n;
+}
+
+bool MqttEngine::canPublish(uint8_t qos) const {
+    if (state != STATE_CONNECTED || pubActive) return false;
+    for (const Inflight& f : inflight) {
+        if (f.id && f.resend) return false; // retransmits go first
+    }
+    return qos == 0 || inflightCount() < window;
+}
+
+void MqttEngine::stagePublish(const char* topic, size_t topicLen, size_t length, uint8_t qos, bool retain, bool dup, uint16_t id) {
+    uint8_t* p = pubHead;
+    *p++ = PKT_PUBLISH | (dup ? 0x08 : 0) | (qos << 1) | (retain ? 0x01 : 0);
+    p += putRemainingLength(p, 2 + topicLen + (qos ? 2 : 0) + length);
+    p += putString(p, topic, topicLen);
+    if (qos) {
+        *p++ = id >> 8;
+        *p++ = id & 0xFF;
+    }
+    pubHeadLen = p - pubHead;
+    pubPayloadLen = length;
+    pubWritten = 0;
+    pubActive = true;
+}
+
+bool MqttEngine::publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain, void* tag) {
+    if (!canPublish(qos)) return false;
+    size_t topicLen = strlen(topic);
+    if (topicLen > MQTT_ENGINE_TOPIC_MAX || length > 0xFFFF) {
+        stats.dropped++;
+        if (releaseHandler) releaseHandler(handlerCtx, tag, false);
+        return true;
+    }
+
+    uint16_t id = 0;
+    if (qos) {
+        Inflight* slot = nullptr;
+        for (Inflight& f : inflight) {
+            if (!f.id) {
+                slot = &f;
+                break;
+            }
+        }
+        id = nextPacketId();
+        slot->id = id;
+        slot->resend = false;
+        slot->retain = retain;
+        slot->length = length;
+        slot->topic = topic;
+        slot->payload = payload;
+        slot->tag = tag;
+        slot->sentAt = millis();
+        uint32_t count = inflightCount();
+        if (count > stats.inflightHighWater) stats.inflightHighWater = count;
+    }
+    stagePublish(topic, topicLen, length, qos ? 1 : 0, retain, false, id);
+    pubPayload = payload;
+    pubTag = qos ? nullptr : tag;
+    stats.published++;
+    flush(); // errors surface in the next poll()
+    return true;
+}
+
+bool MqttEngine::startResend() {
+    if (state != STATE_CONNECTED || pubActive) return false;
+    Inflight* oldest = nullptr;
+    for (Inflight& f : inflight) {
+        if (f.id && f.resend && (!oldest || (long)(f.sentAt - oldest->sentAt) < 0)) oldest = &f;
+    }
+    if (!oldest) return false;
+    oldest->resend = false;
+    oldest->sentAt = millis();
+    stagePublish(oldest->topic, strlen(oldest->topic), oldest->length, 1, oldest->retain, true, oldest->id);
+    pubPayload = oldest->payload;
+    pubTag = nullptr;
+    stats.retransmits++;
+    return true;
+}
+
+bool MqttEngine::subscribe(const char* topic, uint8_t qos) {
+    if (state != STATE_CONNECTED) return false;
+    size_t topicLen = strlen(topic);
+    if (topicLen > MQTT_ENGINE_TOPIC_MAX) return false;
+    uint8_t packet[5 + 2 + 2 + MQTT_ENGINE_TOPIC_MAX + 1];
+    uint8_t* p = packet;
+    *p++ = PKT_SUBSCRIBE;
+    p += putRemainingLength(p, 2 + 2 + topicLen + 1);
+    uint16_t id = nextPacketId();
+    *p++ = id >> 8;
+    *p++ = id & 0xFF;
+    p += putString(p, topic, topicLen);
+    *p++ = qos;
+    if (!queueCtrl(packet, p - packet)) return false;
+    flush();
+    return true;
+}
+
+void MqttEngine::abandonInflight() {
+    for (Inflight& f : inflight) {
+        if (!f.id) continue;
+        f.id = 0;
+        if (releaseHandler) releaseHandler(handlerCtx, f.tag, false);
+    }
+}
+
+bool MqttEngine::flush() {
+    if (sock < 0 || state == STATE_TCP_CONNECTING) return true;
+    for (;;) {
+        if (pubActive) {
+            size_t total = pubHeadLen + pubPayloadLen;
+            struct iovec iov[2];
+            int count = 0;
+            if (pubWritten < pubHeadLen) {
+                iov[count].iov_base = pubHead + pubWritten;
+                iov[count++].iov_len = pubHeadLen - pubWritten;
+            }
+            if (pubPayloadLen) {
+                size_t skip = pubWritten > pubHeadLen ? pubWritten - pubHeadLen : 0;
+                iov[count].iov_base = (void*)(pubPayload + skip);
+                iov[count++].iov_len = pubPayloadLen - skip;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t n = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+            pubWritten += n;
+            lastTx = millis();
+            if (pubWritten < total) return true;
+            pubActive = false;
+            if (pubTag && releaseHandler) releaseHandler(handlerCtx, pubTag, true);
+            continue;
+        }
+        if (ctrlWritten < ctrlLen) {
+            ssize_t n = send(sock, ctrl + ctrlWritten, ctrlLen - ctrlWritten, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+            ctrlWritten += n;
+            lastTx = millis();
+            if (ctrlWritten < ctrlLen) return true;
+            ctrlLen = ctrlWritten = 0;
+            continue;
+        }
+        if (!startResend()) return true;
+    }
+}
+
+int MqttEngine::handlePacket(const uint8_t* p, size_t avail, MqttEvent& event) {
+    // Fixed header: type byte, remaining length in 1-4 bytes
+    size_t rem = 0;
+    size_t hdr = 1;
+    for (int shift = 0;; shift += 7) {
+        if (hdr >= avail) return 0;
+        if (hdr > 4) return -1;
+        uint8_t b = p[hdr++];
+        rem |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    size_t total = hdr + rem;
+    uint8_t type = p[0] & 0xF0;
+
+    if (total > sizeof(rx)) {
+        // Too large to buffer: acknowledge (so it is not redelivered) and skip it
+        if (type != PKT_PUBLISH) return -1;
+        uint8_t qos = (p[0] >> 1) & 0x03;
+        if (avail < hdr + 2) return 0;
+        size_t topicLen = (p[hdr] << 8) | p[hdr + 1];
+        size_t idAt = hdr + 2 + topicLen;
+        if (qos && avail < idAt + 2) return avail == sizeof(rx) ? -1 : 0;
+        if (qos) {
+            if (!ctrlHasRoom(4)) return 0;
+            uint8_t ack[4] = {PKT_PUBACK, 2, p[idAt], p[idAt + 1]};
+            queueCtrl(ack, sizeof(ack));
+        }
+        stats.dropped++;
+        rxSkip = total - avail;
+        return avail;
+    }
+    if (avail < total) return 0;
+
+    const uint8_t* body = p + hdr;
+    switch (type) {
+        case PKT_CONNACK:
+            if (rem < 2 || body[1] != 0) {
+                event = MQTT_EVENT_CONNECT_FAILED;
+                return -1;
+            }
+            sessionPresent = body[0] & 0x01;
+            state = STATE_CONNECTED;
+            lastRx = lastTx = millis();
+            // Everything unacknowledged goes out again, in order
+            for (Inflight& f : inflight) f.resend = f.id != 0;
+            event = MQTT_EVENT_CONNECTED;
+            break;
+        case PKT_PUBLISH: {
+            uint8_t qos = (p[0] >> 1) & 0x03;
+            if (rem < 2) return -1;
+            size_t topicLen = (body[0] << 8) | body[1];
+            size_t at = 2 + topicLen + (qos ? 2 : 0);
+            if (at > rem || topicLen > MQTT_ENGINE_TOPIC_MAX) return -1;
+            // A PUBACK must fit before the message is handed over
+            if (qos && !ctrlHasRoom(4)) return 0;
+            char topic[MQTT_ENGINE_TOPIC_MAX + 1];
+            memcpy(topic, body + 2, topicLen);
+            topic[topicLen] = '\0';
+            if (messageHandler && !messageHandler(handlerCtx, topic, body + at, rem - at)) return 0;
+            stats.received++;
+            if (qos) {
+                uint8_t ack[4] = {PKT_PUBACK, 2, body[2 + topicLen], body[3 + topicLen]};
+                queueCtrl(ack, sizeof(ack));
+            }
+            break;
+        }
+        case PKT_PUBACK: {
+            if (rem < 2) return -1;
+            uint16_t id = (body[0] << 8) | body[1];
+            for (Inflight& f : inflight) {
+                if (f.id != id) continue;
+                f.id = 0;
+                stats.acked++;
+                if (releaseHandler) releaseHandler(handlerCtx, f.tag, true);
+                break;
+            }
+            break;
+        }
+        case PKT_SUBACK:
+            if (rem >= 3 && body[2] == 0x80) Serial.println("MQTT: subscription refused");
+            break;
+        case PKT_PINGRESP:
+            pingPending = false;
+            break;
+        default:
+            break; // QoS 2 flows are never requested
+    }
+    return total;
+}
+
+bool MqttEngine::receive(MqttEvent& event) {
+    for (;;) {
+        if (rxLen < sizeof(rx)) {
+            ssize_t n = recv(sock, rx + rxLen, sizeof(rx) - rxLen, MSG_DONTWAIT);
+            if (n == 0) return false; // closed by the broker
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            if (n > 0) {
+                lastRx = millis();
+                if (rxSkip) {
+                    size_t skip = (size_t)n < rxSkip ? n : rxSkip;
+                    rxSkip -= skip;
+                    memmove(rx + rxLen, rx + rxLen + skip, n - skip);
+                    n -= skip;
+                }
+                rxLen += n;
+            } else if (rxLen == 0) {
+                return true;
+            }
+        }
+
+        size_t used = 0;
+        while (used < rxLen && state != STATE_IDLE) {
+            int n = handlePacket(rx + used, rxLen - used, event);
+            if (n < 0) return false;
+            if (n == 0) break;
+            used += n;
+            if (event == MQTT_EVENT_CONNECTED) break; // let the caller react first
+        }
+        if (used) {
+            memmove(rx, rx + used, rxLen - used);
+            rxLen -= used;
+        }
+        // Nothing consumed: incomplete or held back, wait for the next poll
+        if (!used || event == MQTT_EVENT_CONNECTED) return true;
+    }
+}
+
+MqttEvent MqttEngine::poll() {
+    if (state == STATE_IDLE) return MQTT_EVENT_NONE;
+    unsigned long now = millis();
+
+    if (state == STATE_TCP_CONNECTING) {
+        // Connecting again reports how the handshake went. Unlike select()
+        // this works for any descriptor number (host builds with thousands
+        // of engines exceed FD_SETSIZE).
+        if (::connect(sock, (struct sockaddr*)&address, sizeof(address)) == 0 || errno == EISCONN) {
+            state = STATE_CONNACK_WAIT;
+            if (!queueConnect()) return fail();
+        } else if ((errno != EINPROGRESS && errno != EALREADY) || now - connectStartedAt >= MQTT_CONNECT_TIMEOUT_MS) {
+            return fail();
+        } else {
+            return MQTT_EVENT_NONE;
+        }
+    }
+    if (state == STATE_CONNACK_WAIT && now - connectStartedAt >= MQTT_CONNECT_TIMEOUT_MS) return fail();
+
+    MqttEvent event = MQTT_EVENT_NONE;
+    if (!receive(event)) {
+        MqttEvent failed = fail();
+        return event == MQTT_EVENT_CONNECT_FAILED ? MQTT_EVENT_CONNECT_FAILED : failed;
+    }
+
+    if (state == STATE_CONNECTED) {
+        now = millis();
+        for (Inflight& f : inflight) {
+            if (f.id && !f.resend && now - f.sentAt >= MQTT_RETRY_MS) f.resend = true;
+        }
+        unsigned long keepAliveMs = keepAliveSec * 1000UL;
+        if (pingPending && now - pingSentAt >= keepAliveMs / 2) return fail(); // broker gone
+        if (keepAliveMs && !pingPending && (now - lastTx >= keepAliveMs / 2 || now - lastRx >= keepAliveMs / 2)) {
+            uint8_t ping[2] = {PKT_PINGREQ, 0};
+            if (queueCtrl(ping, sizeof(ping))) {
+                pingPending = true;
+                pingSentAt = now;
+            }
+        }
+    }
+    if (!flush()) return fail();
+    return event;
+}
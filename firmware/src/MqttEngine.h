@@ -0,0 +1,183 @@
+#ifndef MQTT_ENGINE_H
+#define MQTT_ENGINE_H
+
+#include <Arduino.h>
+#include <lwip/sockets.h>
+
+// Asynchronous MQTT 3.1.1 client on a non-blocking lwIP socket.
+//
+// Only resolving a host name blocks, and only when the address is not
+// already known. connect() just starts the TCP handshake. poll() then
+// finishes it, writes whatever the socket accepts, parses incoming packets,
+// and handles keep-alive and retransmits.
+//
+// Publishing is zero-copy. The packet header goes into a small staging
+// buffer and the payload is sent straight from the caller's memory. That
+// memory must stay valid until the release handler runs for its tag: for
+// QoS 0 once the packet is written, for QoS 1 once the PUBACK arrives.
+//
+// Up to the in-flight window of QoS 1 publishes may be unacknowledged at a
+// time. A publish is sent again, with DUP set, after MQTT_RETRY_MS without
+// a PUBACK and after a reconnect. With clean session off, the broker keeps
+// the subscriptions and queues QoS 1 messages while the client is away.
+
+#ifndef MQTT_INFLIGHT_MAX
+#define MQTT_INFLIGHT_MAX 4
+#endif
+#ifndef MQTT_RX_BUFFER_SIZE
+#define MQTT_RX_BUFFER_SIZE 512
+#endif
+#define MQTT_CTRL_BUFFER_SIZE 256
+#define MQTT_ENGINE_TOPIC_MAX 127
+#define MQTT_CONNECT_TIMEOUT_MS 5000
+#ifndef MQTT_RETRY_MS
+#define MQTT_RETRY_MS 10000
+#endif
+#ifndef MQTT_KEEPALIVE_SEC
+#define MQTT_KEEPALIVE_SEC 30
+#endif
+
+enum MqttEvent : uint8_t {
+    MQTT_EVENT_NONE,
+    MQTT_EVENT_CONNECTED,      // CONNACK accepted (see isSessionPresent())
+    MQTT_EVENT_CONNECT_FAILED, // TCP or CONNACK failure, timeout
+    MQTT_EVENT_DISCONNECTED    // connection lost after CONNECTED
+};
+
+struct MqttEngineStats {
+    uint32_t connects;
+    uint32_t published;
+    uint32_t acked;
+    uint32_t retransmits;
+    uint32_t received;
+    uint32_t dropped;        // oversized messages, in or out
+    uint32_t inflightHighWater;
+};
+
+class MqttEngine {
+public:
+    // Return false to leave the message in the receive buffer; it is
+    // offered again on the next poll() (nothing after it is read meanwhile)
+    typedef bool (*MessageHandler)(void* ctx, const char* topic, const uint8_t* payload, size_t length);
+    // The buffer of a publish is no longer needed. delivered = false when
+    // it was dropped unsent (connection lost, abandonInflight(), oversized)
+    typedef void (*ReleaseHandler)(void* ctx, void* tag, bool delivered);
+
+private:
+    enum State : uint8_t { STATE_IDLE, STATE_TCP_CONNECTING, STATE_CONNACK_WAIT, STATE_CONNECTED };
+
+    struct Inflight {
+        uint16_t id;          // 0 = free slot
+        bool resend;
+        bool retain;
+        uint16_t length;
+        const char* topic;
+        const uint8_t* payload;
+        void* tag;
+        unsigned long sentAt;
+    };
+
+    // Settings (pointers are kept, the strings must outlive the engine)
+    const char* host = nullptr;
+    uint16_t port = 1883;
+    const char* clientId = "";
+    const char* willTopic = nullptr;
+    const char* willMessage = nullptr;
+    bool willRetain = false;
+    bool cleanSession = true;
+    uint16_t keepAliveSec = MQTT_KEEPALIVE_SEC;
+    uint8_t window = MQTT_INFLIGHT_MAX;
+    MessageHandler messageHandler = nullptr;
+    ReleaseHandler releaseHandler = nullptr;
+    void* handlerCtx = nullptr;
+
+    // Connection
+    int sock = -1;
+    State state = STATE_IDLE;
+    struct sockaddr_in address = {};
+    bool resolved = false;
+    bool sessionPresent = false;
+    unsigned long connectStartedAt = 0;
+    unsigned long lastTx = 0;
+    unsigned long lastRx = 0;
+    bool pingPending = false;
+    unsigned long pingSentAt = 0;
+    uint16_t lastPacketId = 0;
+
+    // Control packets (CONNECT, SUBSCRIBE, PUBACK, PINGREQ), written in order
+    uint8_t ctrl[MQTT_CTRL_BUFFER_SIZE];
+    size_t ctrlLen = 0;
+    size_t ctrlWritten = 0;
+
+    // The publish being written: staged header, then the caller's payload
+    uint8_t pubHead[5 + 2 + MQTT_ENGINE_TOPIC_MAX + 2];
+    size_t pubHeadLen = 0;
+    const uint8_t* pubPayload = nullptr;
+    size_t pubPayloadLen = 0;
+    size_t pubWritten = 0;
+    bool pubActive = false;
+    void* pubTag = nullptr; // QoS 0 only: released once written
+
+    Inflight inflight[MQTT_INFLIGHT_MAX] = {};
+
+    uint8_t rx[MQTT_RX_BUFFER_SIZE];
+    size_t rxLen = 0;
+    size_t rxSkip = 0; // rest of an oversized packet still to discard
+
+    MqttEngineStats stats = {};
+
+    bool resolve();
+    void closeSocket();
+    MqttEvent fail();
+    bool ctrlHasRoom(size_t length) const;
+    bool queueCtrl(const uint8_t* data, size_t length);
+    bool queueConnect();
+    void stagePublish(const char* topic, size_t topicLen, size_t length, uint8_t qos, bool retain, bool dup, uint16_t id);
+    bool flush();
+    bool startResend();
+    bool receive(MqttEvent& event);
+    // Bytes consumed, 0 when incomplete or held back, -1 on a protocol error
+    int handlePacket(const uint8_t* p, size_t avail, MqttEvent& event);
+    int inflightCount() const;
+    uint16_t nextPacketId();
+
+public:
+    void setServer(const char* hostName, uint16_t portNumber);
+    void setClientId(const char* id) { clientId = id; }
+    void setWill(const char* topic, const char* message, bool retain);
+    // false: persistent session, resumed by the next connect with the same client id
+    void setCleanSession(bool clean) { cleanSession = clean; }
+    void setKeepAlive(uint16_t seconds) { keepAliveSec = seconds; }
+    // QoS 1 publishes awaiting PUBACK, 1..MQTT_INFLIGHT_MAX
+    void setInflightWindow(uint8_t size);
+    void setHandlers(MessageHandler onMessage, ReleaseHandler onRelease, void* ctx);
+
+    // Starts a connection attempt; the outcome comes from poll()
+    bool connect();
+    // DISCONNECT (no last will) and close; in-flight publishes are kept
+    void disconnect();
+    MqttEvent poll();
+
+    bool connected() const { return state == STATE_CONNECTED; }
+    bool connecting() const { return state == STATE_TCP_CONNECTING || state == STATE_CONNACK_WAIT; }
+    bool isSessionPresent() const { return sessionPresent; }
+    // For callers that wait on readiness (epoll) instead of polling: the
+    // socket, -1 while idle, new with every connect(); and whether poll()
+    // has output for it once it turns writable
+    int getSocket() const { return sock; }
+    bool wantsWrite() const { return state == STATE_TCP_CONNECTING || pubActive || ctrlWritten < ctrlLen; }
+    // Room for another publish right now (writer idle, window not full)
+    bool canPublish(uint8_t qos) const;
+    int getInflight() const { return inflightCount(); }
+    MqttEngineStats getStats() const { return stats; }
+
+    // False while the writer is busy or the in-flight window is full: try
+    // again after the next poll(). Oversized messages are dropped (released
+    // undelivered) and count as accepted.
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain, void* tag);
+    bool subscribe(const char* topic, uint8_t qos);
+    // Releases every unacknowledged publish as undelivered (e.g. to spool them)
+    void abandonInflight();
+};
+
+#endif
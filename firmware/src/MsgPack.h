@@ -0,0 +1,106 @@
+#ifndef MSG_PACK_H
+#define MSG_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal MessagePack writer over a caller-owned buffer. No heap, no
+// exceptions: a write that does not fit sets the overflow flag and is dropped.
+class MsgPackWriter {
+private:
+    uint8_t* buf;
+    size_t cap;
+    size_t len = 0;
+    bool overflow = false;
+
+    bool reserve(size_t n) {
+        if (overflow || len + n > cap) {
+            overflow = true;
+            return false;
+        }
+        return true;
+    }
+    void put8(uint8_t v) { buf[len++] = v; }
+    void put16(uint16_t v) { put8(v >> 8); put8(v); }
+    void put32(uint32_t v) { put16(v >> 16); put16(v); }
+
+public:
+    // Worst-case encoded size of one int32/uint32 (int16, int8) value or array header
+    static const size_t MAX_INT_SIZE = 5;
+    static const size_t MAX_INT16_SIZE = 3;
+    static const size_t MAX_INT8_SIZE = 2;
+    static const size_t MAX_ARRAY_HEADER_SIZE = 5;
+
+    MsgPackWriter(uint8_t* buffer, size_t capacity) : buf(buffer), cap(capacity) {}
+
+    size_t size() const { return len; }
+    bool ok() const { return !overflow; }
+
+    void writeRaw(uint8_t byte) {
+        if (reserve(1)) put8(byte);
+    }
+
+    void writeNil() {
+        if (reserve(1)) put8(0xc0);
+    }
+
+    void writeBool(bool v) {
+        if (reserve(1)) put8(v ? 0xc3 : 0xc2);
+    }
+
+    void writeUInt(uint32_t v) {
+        if (v < 0x80) {
+            if (reserve(1)) put8(v);
+        } else if (v <= 0xff) {
+            if (reserve(2)) { put8(0xcc); put8(v); }
+        } else if (v <= 0xffff) {
+            if (reserve(3)) { put8(0xcd); put16(v); }
+        } else {
+            if (reserve(5)) { put8(0xce); put32(v); }
+        }
+    }
+
+    void writeInt(int32_t v) {
+        if (v >= 0) {
+            writeUInt(v);
+        } else if (v >= -32) {
+            if (reserve(1)) put8((uint8_t)(int8_t)v); // negative fixint
+        } else if (v >= -128) {
+            if (reserve(2)) { put8(0xd0); put8((uint8_t)(int8_t)v); }
+        } else if (v >= -32768) {
+            if (reserve(3)) { put8(0xd1); put16((uint16_t)(int16_t)v); }
+        } else {
+            if (reserve(5)) { put8(0xd2); put32((uint32_t)v); }
+        }
+    }
+
+    void writeArray(uint32_t count) {
+        if (count < 16) {
+            if (reserve(1)) put8(0x90 | count);
+        } else if (count <= 0xffff) {
+            if (reserve(3)) { put8(0xdc); put16(count); }
+        } else {
+            if (reserve(5)) { put8(0xdd); put32(count); }
+        }
+    }
+
+    void writeStr(const char* str, uint32_t n) {
+        size_t header = n < 32 ? 1 : (n <= 0xff ? 2 : 3);
+        if (n > 0xffff || !reserve(header + n)) { overflow = true; return; }
+        if (n < 32) put8(0xa0 | n);
+        else if (n <= 0xff) { put8(0xd9); put8(n); }
+        else { put8(0xda); put16(n); }
+        for (uint32_t i = 0; i < n; i++) put8(str[i]);
+    }
+
+    void writeBin(const uint8_t* data, uint32_t n) {
+        size_t header = n <= 0xff ? 2 : (n <= 0xffff ? 3 : 5);
+        if (!reserve(header + n)) return;
+        if (n <= 0xff) { put8(0xc4); put8(n); }
+        else if (n <= 0xffff) { put8(0xc5); put16(n); }
+        else { put8(0xc6); put32(n); }
+        for (uint32_t i = 0; i < n; i++) put8(data[i]);
+    }
+};
+
+#endif
@@ -1,4 +1,19 @@
 #include "NetworkManager.h"
+#include "BootProfiler.h"
+#include "PerfCounters.h"
+#include <esp_system.h>
+#include <time.h>
+
+// Before the first NTP sync the client counts from 1970
+static const unsigned long MIN_VALID_EPOCH = 1600000000UL;
+
+static const char* FAST_CONNECT_NAMESPACE = "netcache";
+static const char* FAST_CONNECT_KEY = "ap";
+static const uint32_t FAST_CONNECT_MAGIC = 0x4e434631; // "NCF1"
+
+#if MQTT_ASYNC
+static const uint8_t ONLINE_PAYLOAD[] = {'t', 'r', 'u', 'e'};
+#endif
 
 // Flag for saving data
 bool shouldSaveConfig = false;
@@ -9,23 +24,59 @@ void NetworkManager::saveConfigCallback() {
 
 
 
+#if MQTT_ASYNC
+NetworkManager::NetworkManager() {
+#else
 NetworkManager::NetworkManager() : client(espClient) {
+#endif
     // UTC+7 = 7 * 3600 = 25200 seconds
-    timeClient = new NTPClient(ntpUDP, "pool.ntp.org", 25200, 60000);
+    timeClient = new NTPClient(ntpUDP, NTP_SERVER, NTP_UTC_OFFSET_SEC, 60000);
 }
 
-void NetworkManager::begin(ConfigManager* config) {
+void NetworkManager::begin(ConfigManager* config, bool startNow) {
     configManager = config;
     
     // Start NTP moved to after WiFi
     // timeClient->begin();
 
     // Load MQTT config
-    String server = configManager->loadMqttServer();
-    String port = String(configManager->loadMqttPort());
-    
-    server.toCharArray(mqtt_server, 40);
-    port.toCharArray(mqtt_port, 6);
+    snprintf(mqtt_server, sizeof(mqtt_server), "%s", configManager->loadMqttServer());
+    snprintf(mqtt_port, sizeof(mqtt_port), "%d", configManager->loadMqttPort());
+
+#if MQTT_ASYNC
+    // Stable client id: the broker keeps the session (subscription, queued
+    // commands, unacknowledged publishes) under it between connections
+    snprintf(clientId, sizeof(clientId), "PlantCare-%s", DEVICE_ID);
+    getDeviceTopic("online", willTopic, sizeof(willTopic));
+    getDeviceTopic("cmd", cmdTopic, sizeof(cmdTopic));
+    getDeviceTopic("spool", spoolTopic, sizeof(spoolTopic));
+    mqtt.setClientId(clientId);
+    // If we die, the broker sends "false" (valid JSON)
+    mqtt.setWill(willTopic, "false", true);
+    mqtt.setCleanSession(false);
+    mqtt.setInflightWindow(MQTT_INFLIGHT_WINDOW);
+    mqtt.setHandlers(onEngineMessage, onEngineRelease, this);
+#endif
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    getDeviceTopic("peers", peersTopic, sizeof(peersTopic));
+    gateway.begin(&peerLink);
+#endif
+
+    if (spool.begin()) {
+        spoolPendingCache = spool.pending();
+        Serial.printf("Spool: %u records pending\n", (unsigned)spool.pending());
+    }
+
+    radioWanted = startNow;
+    if (startNow) startRadio();
+}
+
+void NetworkManager::startRadio() {
+    radioStarted = true;
+#if NODE_ROLE == NODE_ROLE_LEAF
+    peerLink.begin(PEER_CHANNEL);
+    return;
+#endif
 
     // WiFiManager Parameters
     WiFiManagerParameter custom_mqtt_server("server", "mqtt server", mqtt_server, 40);
@@ -37,88 +88,644 @@ void NetworkManager::begin(ConfigManager* config) {
 
     // Non-blocking
     wm.setConfigPortalBlocking(false);
-    
-    // Auto connect or start portal
-    if(wm.autoConnect("PlantCare_AP")) {
+#ifdef STATIC_IP
+    IPAddress ip, gateway, subnet, dns;
+    ip.fromString(STATIC_IP);
+    gateway.fromString(STATIC_GATEWAY);
+    subnet.fromString(STATIC_SUBNET);
+    dns.fromString(STATIC_DNS);
+    wm.setSTAStaticIPConfig(ip, gateway, subnet, dns);
+#endif
+
+    // Cached AP first, then auto connect or start portal
+    netCache.begin(FAST_CONNECT_NAMESPACE, false);
+    if (fastConnect()) {
+        Serial.println("Connected to WiFi (fast connect)");
+    } else if(wm.autoConnect("PlantCare_AP")) {
         Serial.println("Connected to WiFi!");
     } else {
         Serial.println("Config Portal started...");
     }
 
-    // Save params if updated
+    // Save params if updated (stored by the control side, see postPortalSettings)
     if (shouldSaveConfig) {
         strcpy(mqtt_server, custom_mqtt_server.getValue());
         strcpy(mqtt_port, custom_mqtt_port.getValue());
-        
-        configManager->saveMqttServer(String(mqtt_server));
-        configManager->saveMqttPort(atoi(mqtt_port));
+        portalSettingsPending = !postPortalSettings();
     }
 
     // MQTT Setup
-    client.setBufferSize(1024); // Support large JSON payloads
+#if MQTT_ASYNC
+    mqtt.setServer(mqtt_server, atoi(mqtt_port));
+#else
+    client.setBufferSize(MQTT_BUFFER_SIZE); // Support large JSON payloads
     client.setServer(mqtt_server, atoi(mqtt_port));
+#endif
     
     // Start NTP only if connected to avoid crash
-    if (WiFi.status() == WL_CONNECTED) {
-        timeClient->begin();
+    if (WiFi.status() == WL_CONNECTED) onWifiConnected();
+    if (!clockEpoch) hourCache = timeClient->getHours();
+}
+
+void NetworkManager::onWifiConnected() {
+    wifiSeen = true;
+    bootProfiler.mark(BOOT_WIFI);
+    saveFastConnect();
+    // SNTP runs in the background while MQTT connects; the blocking
+    // NTPClient only resyncs once the broker session is up (updateClock)
+    configTime(0, 0, NTP_SERVER);
+    timeClient->begin();
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    // On the AP's channel, which the leaves are set to
+    peerLink.begin(0);
+#endif
+}
+
+bool NetworkManager::applyStaticIp(const FastConnectCache& cache) {
+#ifdef STATIC_IP
+    (void)cache;
+    IPAddress ip, gateway, subnet, dns;
+    ip.fromString(STATIC_IP);
+    gateway.fromString(STATIC_GATEWAY);
+    subnet.fromString(STATIC_SUBNET);
+    dns.fromString(STATIC_DNS);
+    WiFi.config(ip, gateway, subnet, dns);
+    return false; // fixed address: nothing to undo on fallback
+#else
+    if (!FAST_CONNECT_REUSE_LEASE || !cache.ip || esp_reset_reason() == ESP_RST_POWERON) return false;
+    return WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+#endif
+}
+
+bool NetworkManager::fastConnect() {
+    FastConnectCache cache;
+    if (netCache.getBytes(FAST_CONNECT_KEY, &cache, sizeof(cache)) != sizeof(cache)) return false;
+    if (cache.magic != FAST_CONNECT_MAGIC) return false;
+
+    WiFi.mode(WIFI_STA);
+    bool leaseReused = applyStaticIp(cache);
+    WiFi.begin(cache.ssid, cache.pass, cache.channel, cache.bssid);
+
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start >= FAST_CONNECT_TIMEOUT_MS) {
+            // AP moved channel or was replaced: forget it and do the full connect
+            Serial.println("Fast connect timed out");
+            WiFi.disconnect();
+            if (leaseReused) WiFi.config(IPAddress(), IPAddress(), IPAddress()); // back to DHCP
+            netCache.remove(FAST_CONNECT_KEY);
+            return false;
+        }
+        delay(10);
     }
+    bootProfiler.setFastConnect(true);
+    return true;
+}
+
+void NetworkManager::saveFastConnect() {
+    const uint8_t* bssid = WiFi.BSSID();
+    if (!bssid) return;
+
+    FastConnectCache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.magic = FAST_CONNECT_MAGIC;
+    snprintf(cache.ssid, sizeof(cache.ssid), "%s", WiFi.SSID().c_str());
+    snprintf(cache.pass, sizeof(cache.pass), "%s", WiFi.psk().c_str());
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.subnet = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
+
+    // Usually unchanged: no NVS write on every boot
+    FastConnectCache old;
+    if (netCache.getBytes(FAST_CONNECT_KEY, &old, sizeof(old)) == sizeof(old) && memcmp(&old, &cache, sizeof(cache)) == 0) {
+        return;
+    }
+    netCache.putBytes(FAST_CONNECT_KEY, &cache, sizeof(cache));
+}
+
+void NetworkManager::seedClock(uint32_t localEpoch) {
+    clockEpoch = localEpoch;
+    clockMillis = millis();
+    localEpochCache = localEpoch;
+    hourCache = (localEpoch % 86400) / 3600;
+}
+
+void NetworkManager::cancelSleep() {
+    sleepRequested = false;
+    sleepReady = false;
+}
+
+void NetworkManager::updateClock() {
+    bool ntpSynced = false;
+    if (NODE_ROLE != NODE_ROLE_LEAF && radioStarted && WiFi.status() == WL_CONNECTED) {
+        rssiCache = WiFi.RSSI();
+        // NTPClient blocks until its reply arrives: only once the broker session is up
+        if (mqttConnected()) timeClient->update();
+        unsigned long epoch = timeClient->getEpochTime();
+        if (epoch >= MIN_VALID_EPOCH) {
+            clockEpoch = epoch;
+            clockMillis = millis();
+            ntpSynced = true;
+        }
+#ifdef ARDUINO_ARCH_ESP32
+        else if (time(nullptr) >= (time_t)MIN_VALID_EPOCH) {
+            // Background SNTP (started at WiFi-up) usually answers first
+            clockEpoch = time(nullptr) + NTP_UTC_OFFSET_SEC;
+            clockMillis = millis();
+        }
+#endif
+        if (ntpSynced || !clockEpoch) hourCache = timeClient->getHours();
+    }
+    if (!clockEpoch) return;
+
+    // NTP, SNTP or the time retained across deep sleep, run on by millis()
+    uint32_t local = clockEpoch + (millis() - clockMillis) / 1000;
+    localEpochCache = local;
+    if (!ntpSynced) hourCache = (local % 86400) / 3600;
+    bootProfiler.mark(BOOT_TIME);
 }
 
 void NetworkManager::loop() {
-    wm.process(); // Critical for non-blocking portal
-    
-    if (WiFi.status() == WL_CONNECTED) {
-       timeClient->update();
+    if (sleepRequested) {
+        // Clean disconnect so the broker does not fire the last will
+        if (!sleepReady) {
+#if NODE_ROLE == NODE_ROLE_LEAF
+            peerLink.end();
+            radioStarted = false;
+#elif MQTT_ASYNC
+            mqtt.disconnect();
+#else
+            if (client.connected()) client.disconnect();
+#endif
+#if NODE_ROLE != NODE_ROLE_LEAF
+            if (radioStarted) WiFi.disconnect(true);
+#endif
+            connectedCache = false;
+            sleepReady = true;
+        }
+        return;
     }
+    if (!radioStarted) {
+        updateClock();
+        if (!radioWanted) return; // queued messages wait for requestRadio()
+        startRadio();
+    }
+
+#if NODE_ROLE == NODE_ROLE_LEAF
+    receiveFromGateway();
+    // Frames go out (broadcast at first) as soon as the radio is up
+    connectedCache = peerLink.isStarted();
+    flushOutbox();
+    updateClock();
+    return;
+#endif
 
-    if (!client.connected()) {
+    wm.process(); // Critical for non-blocking portal
+    if (portalSettingsPending) portalSettingsPending = !postPortalSettings(); // inbox was full
+    if (!wifiSeen && WiFi.status() == WL_CONNECTED) onWifiConnected(); // e.g. after the portal
+
+#if MQTT_ASYNC
+    pollMqtt();
+    if (!mqtt.connected() && !mqtt.connecting()) {
+#else
+    if (client.connected()) {
+        client.loop();
+    } else {
+#endif
         long now = millis();
-        if (now - lastReconnectAttempt > 5000) {
+        // First attempt right away, then throttled
+        if (!reconnectAttempted || now - lastReconnectAttempt > MQTT_RECONNECT_INTERVAL_MS) {
+            reconnectAttempted = true;
             lastReconnectAttempt = now;
             reconnect();
         }
+    }
+    connectedCache = mqttConnected();
+    if (connectedCache) bootProfiler.mark(BOOT_MQTT);
+
+    flushOutbox();
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    stepGateway();
+#endif
+    drainSpool();
+    // After the first publish: the NTP round trip must not delay it
+    updateClock();
+}
+
+bool NetworkManager::mqttConnected() {
+#if MQTT_ASYNC
+    return mqtt.connected();
+#else
+    return client.connected();
+#endif
+}
+
+#if NODE_ROLE == NODE_ROLE_LEAF
+void NetworkManager::receiveFromGateway() {
+    PeerSendResult result;
+    while (peerLink.takeSendResult(result)) {
+        if (!gatewayKnown || memcmp(result.mac, gatewayMac, 6) != 0) continue;
+        gatewayFailures = result.ok ? 0 : gatewayFailures + 1;
+        if (gatewayFailures >= LEAF_GATEWAY_FAILURES) {
+            // Gone or replaced: look for one by broadcast again
+            Serial.println("Gateway lost");
+            gatewayKnown = false;
+        }
+    }
+
+    while (PeerPacket* packet = peerLink.receive()) {
+        if (packet->length >= PEER_DOWN_HEADER && packet->data[0] == PEER_FRAME_DOWN) {
+            if (!gatewayKnown || memcmp(packet->mac, gatewayMac, 6) != 0) {
+                if (!peerLink.addPeer(packet->mac)) break;
+                memcpy(gatewayMac, packet->mac, 6);
+                gatewayKnown = true;
+                gatewayFailures = 0;
+            }
+            uint32_t epoch = packet->data[2] | packet->data[3] << 8 | packet->data[4] << 16 | (uint32_t)packet->data[5] << 24;
+            if (epoch >= MIN_VALID_EPOCH) {
+                // The gateway's local time is ours too
+                clockEpoch = epoch;
+                clockMillis = millis();
+            }
+            size_t length = packet->length - PEER_DOWN_HEADER;
+            // A repeated seq is a command whose delivery report got lost
+            if (length && packet->data[1] != lastCommandSeq) {
+                char topic[50];
+                getDeviceTopic("cmd", topic, sizeof(topic));
+                if (!onMessage(topic, packet->data + PEER_DOWN_HEADER, length)) break; // inbox full: next loop
+                lastCommandSeq = packet->data[1];
+            }
+        }
+        peerLink.releaseReceived();
+    }
+}
+
+void NetworkManager::flushOutbox() {
+    while (OutboundMessage* msg = outbox.front()) {
+        const uint8_t* to = gatewayKnown ? gatewayMac : PeerLink::BROADCAST;
+        if (!peerLink.sendMessage(to, upSeq, msg->topic, msg->payload, msg->length)) {
+            PERF_COUNT(PERF_PUBLISH_FAILS);
+            break; // radio queue full or down: the whole message again next loop
+        }
+        bootProfiler.mark(BOOT_FIRST_PUBLISH);
+        upSeq++;
+        outbox.release();
+    }
+}
+#endif
+
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+void NetworkManager::stepGateway() {
+    if (!peerLink.isStarted()) return;
+    unsigned long now = millis();
+    gateway.setClock(localEpochCache);
+    while (PeerPacket* packet = peerLink.receive()) {
+        gateway.onPacket(*packet, now);
+        peerLink.releaseReceived();
+        publishPeerBatch(); // a burst of wake-ups can fill several batches
+    }
+    gateway.step(now);
+    publishPeerBatch();
+
+    // Command topics of new leaves, subscribed on their behalf
+    if (mqttConnected()) {
+        int peer;
+        while ((peer = gateway.pendingSubscription()) >= 0) {
+            char topic[MQTT_TOPIC_SIZE];
+            gateway.getCommandTopic(peer, topic, sizeof(topic));
+#if MQTT_ASYNC
+            if (!mqtt.subscribe(topic, MQTT_PUBLISH_QOS)) break;
+#else
+            if (!client.subscribe(topic)) break;
+#endif
+            gateway.setSubscribed(peer);
+        }
+    }
+}
+
+void NetworkManager::publishPeerBatch() {
+    size_t length;
+    const uint8_t* batch;
+#if MQTT_ASYNC
+    if (mqtt.connected()) {
+        // Zero-copy like the spool batch, released oldest first in onEngineRelease()
+        while ((batch = gateway.readyBatch(length, peerBatchesInFlight)) &&
+               mqtt.publish(peersTopic, batch, length, MQTT_PUBLISH_QOS, false, &gateway)) {
+            peerBatchesInFlight++;
+        }
+        return;
+    }
+    // While reconnecting they may still go out on the resumed session
+    if (mqtt.connecting() || peerBatchesInFlight) return;
+#endif
+    while ((batch = gateway.readyBatch(length))) {
+#if !MQTT_ASYNC
+        if (client.connected() && client.publish(peersTopic, batch, length, false)) {
+            gateway.releaseBatch();
+            continue;
+        }
+#endif
+        PERF_COUNT(PERF_PUBLISH_FAILS);
+        if (spool.append(peersTopic, batch, length, utcNow())) spoolPendingCache = spool.pending();
+        gateway.releaseBatch();
+    }
+}
+#endif
+
+#if MQTT_ASYNC
+void NetworkManager::pollMqtt() {
+    switch (mqtt.poll()) {
+        case MQTT_EVENT_CONNECTED:
+            Serial.printf("MQTT connected (%s session)\n", mqtt.isSessionPresent() ? "resumed" : "new");
+            // Immediately say we are ONLINE (retained), ahead of anything queued
+            onlinePending = true;
+            // Also when resumed: cheap, and covers a broker that lost its state
+            mqtt.subscribe(cmdTopic, MQTT_PUBLISH_QOS);
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+            gateway.resetSubscriptions();
+#endif
+            break;
+        case MQTT_EVENT_CONNECT_FAILED:
+            PERF_COUNT(PERF_MQTT_CONNECT_FAILS);
+            Serial.println("MQTT connect failed, try again in 5 seconds");
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            Serial.println("MQTT connection lost");
+            break;
+        default:
+            break;
+    }
+}
+
+#if NODE_ROLE != NODE_ROLE_LEAF
+void NetworkManager::flushOutbox() {
+    if (mqtt.connected()) {
+        if (onlinePending && mqtt.publish(willTopic, ONLINE_PAYLOAD, sizeof(ONLINE_PAYLOAD), MQTT_PUBLISH_QOS, true, nullptr)) {
+            onlinePending = false;
+        }
+        if (!onlinePending) {
+            // Published in place: each slot stays queued until the engine releases it
+            while (OutboundMessage* msg = outbox.peek(outboxSent)) {
+                if (!mqtt.publish(msg->topic, msg->payload, msg->length, MQTT_PUBLISH_QOS, msg->retain, msg)) break;
+                outboxSent++;
+            }
+        }
+    } else if (!mqtt.connecting()) {
+        // No broker: what was not acknowledged goes to the spool, as before
+        // (while reconnecting it may still go out on the resumed session)
+        mqtt.abandonInflight();
+        for (uint32_t i = outboxSent; OutboundMessage* msg = outbox.peek(i); i++) {
+            PERF_COUNT(PERF_PUBLISH_FAILS);
+            // Retained topics (online, config) are republished on change anyway
+            if (!msg->retain) spoolMessage(*msg);
+            msg->done = true;
+        }
+    }
+    // In order, up to the first one still being written or awaiting its PUBACK
+    while (OutboundMessage* msg = outbox.front()) {
+        if (!msg->done) break;
+        outbox.release();
+        if (outboxSent) outboxSent--;
+    }
+}
+#endif
+
+bool NetworkManager::onEngineMessage(void* ctx, const char* topic, const uint8_t* payload, size_t length) {
+    return static_cast<NetworkManager*>(ctx)->onMessage(topic, payload, length);
+}
+
+void NetworkManager::onEngineRelease(void* ctx, void* tag, bool delivered) {
+    NetworkManager* self = static_cast<NetworkManager*>(ctx);
+    if (!tag) return; // online status
+    if (!delivered) PERF_COUNT(PERF_PUBLISH_FAILS);
+    if (tag == self->spoolFrame) {
+        // Batch records leave the spool only once the broker has them
+        self->spoolInFlight = false;
+        if (delivered) {
+            self->spool.ack(self->spoolAckSeq);
+            self->spoolPendingCache = self->spool.pending();
+        }
+        return;
+    }
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    if (tag == &self->gateway) {
+        if (self->peerBatchesInFlight) self->peerBatchesInFlight--;
+        size_t length;
+        const uint8_t* batch = self->gateway.readyBatch(length);
+        if (!delivered && batch && self->spool.append(self->peersTopic, batch, length, self->utcNow())) {
+            self->spoolPendingCache = self->spool.pending();
+        }
+        self->gateway.releaseBatch();
+        return;
+    }
+#endif
+    OutboundMessage* msg = static_cast<OutboundMessage*>(tag);
+    if (delivered) bootProfiler.mark(BOOT_FIRST_PUBLISH);
+    else if (!msg->retain) self->spoolMessage(*msg);
+    msg->done = true;
+}
+#elif NODE_ROLE != NODE_ROLE_LEAF
+void NetworkManager::flushOutbox() {
+    while (OutboundMessage* msg = outbox.front()) {
+        bool sent = client.connected() && client.publish(msg->topic, msg->payload, msg->length, msg->retain);
+        if (sent) bootProfiler.mark(BOOT_FIRST_PUBLISH);
+        else PERF_COUNT(PERF_PUBLISH_FAILS);
+        // Retained topics (online, config) are republished on change anyway
+        if (!sent && !msg->retain) spoolMessage(*msg);
+        outbox.release();
+    }
+}
+#endif
+
+uint32_t NetworkManager::utcNow() {
+    // Last NTP time (or the time retained across deep sleep) run on by millis()
+    if (!clockEpoch) return 0;
+    return clockEpoch + (millis() - clockMillis) / 1000 - NTP_UTC_OFFSET_SEC;
+}
+
+void NetworkManager::spoolMessage(const OutboundMessage& msg) {
+    if (spool.append(msg.topic, msg.payload, msg.length, utcNow())) {
+        spoolPendingCache = spool.pending();
+    }
+}
+
+void NetworkManager::drainSpool() {
+    // One batch per interval so a long backlog does not starve live traffic
+    if (!mqttConnected() || spool.pending() == 0) return;
+#if MQTT_ASYNC
+    if (spoolInFlight) return;
+#endif
+    unsigned long now = millis();
+    if (now - lastSpoolDrain < SPOOL_DRAIN_INTERVAL_MS) return;
+    lastSpoolDrain = now;
+
+    uint32_t ackSeq;
+    size_t length = spool.buildBatch(spoolFrame, sizeof(spoolFrame), ackSeq);
+    if (length == 0) {
+        spool.ack(ackSeq); // only unreadable records were left
     } else {
-        client.loop();
+#if MQTT_ASYNC
+        // Acknowledged in onEngineRelease() once the broker has the batch
+        spoolInFlight = true;
+        spoolAckSeq = ackSeq;
+        if (!mqtt.publish(spoolTopic, spoolFrame, length, MQTT_PUBLISH_QOS, false, spoolFrame)) {
+            spoolInFlight = false; // writer busy: next interval
+        }
+        return;
+#else
+        char topic[50];
+        getDeviceTopic("spool", topic, sizeof(topic));
+        if (!client.publish(topic, spoolFrame, length, false)) {
+            PERF_COUNT(PERF_PUBLISH_FAILS);
+            return; // retried next interval
+        }
+        spool.ack(ackSeq);
+#endif
+    }
+    spoolPendingCache = spool.pending();
+}
+
+void NetworkManager::enqueue(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (length > OUTBOX_PAYLOAD_SIZE) return;
+    OutboundMessage* msg = outbox.prepare();
+    if (!msg) return; // full: counted as dropped
+    snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+    memcpy(msg->payload, payload, length);
+    msg->length = length;
+    msg->retain = retain;
+    msg->done = false;
+    outbox.commit();
+}
+
+bool NetworkManager::onMessage(const char* topic, const uint8_t* payload, size_t length) {
+    // Runs inside the MQTT client's poll on the network side: copy out of its buffer
+    if (length > INBOX_PAYLOAD_SIZE || strlen(topic) >= MQTT_TOPIC_SIZE) return true;
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    // A leaf's command: held for it, see PeerGateway.h
+    if (gateway.queueCommand(topic, payload, length)) return true;
+#endif
+#if MQTT_ASYNC
+    // Held back by the engine until dispatchCommands() makes room
+    if (inbox.depth() >= inbox.capacity()) return false;
+#endif
+    InboundMessage* msg = inbox.prepare();
+    if (!msg) return true; // full: counted as dropped
+    snprintf(msg->topic, sizeof(msg->topic), "%s", topic);
+    memcpy(msg->payload, payload, length);
+    msg->payload[length] = '\0';
+    msg->length = length;
+    msg->kind = INBOUND_COMMAND;
+    inbox.commit();
+    if (inboxListener) inboxListener();
+    return true;
+}
+
+bool NetworkManager::postPortalSettings() {
+    if (inbox.depth() >= inbox.capacity()) return false;
+    InboundMessage* msg = inbox.prepare();
+    if (!msg) return false;
+    msg->topic[0] = '\0';
+    msg->length = snprintf((char*)msg->payload, sizeof(msg->payload), "%s:%s", mqtt_server, mqtt_port);
+    msg->kind = INBOUND_PORTAL_SETTINGS;
+    inbox.commit();
+    if (inboxListener) inboxListener();
+    return true;
+}
+
+void NetworkManager::dispatchCommands() {
+    // Handlers work on the queue slot itself; it is released afterwards
+    while (InboundMessage* msg = inbox.front()) {
+        if (msg->kind == INBOUND_PORTAL_SETTINGS) {
+            // Same task as the config commit job, so the blob is never written concurrently
+            char* colon = strrchr((char*)msg->payload, ':');
+            if (colon) {
+                *colon = '\0';
+                configManager->saveMqttServer((const char*)msg->payload);
+                configManager->saveMqttPort(atoi(colon + 1));
+            }
+        } else if (commandCallback) {
+            commandCallback(msg->topic, msg->payload, msg->length);
+        }
+        inbox.release();
     }
 }
 
 void NetworkManager::reconnect() {
     Serial.print("Attempting MQTT connection...");
-    String clientId = "PlantCare-" + String(random(0xffff), HEX);
+    PERF_COUNT(PERF_MQTT_RECONNECTS);
+#if MQTT_ASYNC
+    // Non-blocking: pollMqtt() reports the outcome
+    if (mqtt.connect()) {
+        Serial.println("started");
+    } else {
+        PERF_COUNT(PERF_MQTT_CONNECT_FAILS);
+        Serial.println("failed, try again in 5 seconds");
+    }
+#else
+    char clientId[20];
+    snprintf(clientId, sizeof(clientId), "PlantCare-%lx", (unsigned long)random(0xffff));
     
     // Last Will: Topic, Payload, Retain, QoS
     char willTopic[50];
     getDeviceTopic("online", willTopic, sizeof(willTopic));
 
     // Connect with LWT: if we die, broker sends "false" (valid JSON)
-    if (client.connect(clientId.c_str(), willTopic, 0, true, "false")) {
+    if (client.connect(clientId, willTopic, 0, true, "false")) {
         Serial.println("connected");
         
-        // Immediately say we are ONLINE (Retained)
-        publishDevice("online", "true");
+        // Immediately say we are ONLINE (Retained), ahead of anything queued
+        client.publish(willTopic, "true", true);
 
         char topic[50];
         getDeviceTopic("cmd", topic, sizeof(topic));
         client.subscribe(topic);
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+        gateway.resetSubscriptions();
+#endif
     } else {
+        PERF_COUNT(PERF_MQTT_CONNECT_FAILS);
         Serial.print("failed, rc=");
         Serial.print(client.state());
         Serial.println(" try again in 5 seconds");
     }
+#endif
 }
 
 void NetworkManager::publish(const char* topic, const char* payload) {
-    if (client.connected()) {
-        client.publish(topic, payload);
-    }
+    enqueue(topic, (const uint8_t*)payload, strlen(payload), false);
 }
 
 void NetworkManager::setCallback(MQTT_CALLBACK_SIGNATURE) {
-    client.setCallback(callback);
+    commandCallback = callback;
+#if !MQTT_ASYNC
+    client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+        onMessage(topic, payload, length);
+    });
+#endif
 }
 
 bool NetworkManager::isConnected() {
-    return client.connected();
+    return connectedCache;
+}
+
+int NetworkManager::getRssi() {
+    return rssiCache;
+}
+
+NetworkQueueStats NetworkManager::getQueueStats() {
+    NetworkQueueStats stats;
+    stats.outboxDepth = outbox.depth();
+    stats.outboxHighWater = outbox.getHighWater();
+    stats.outboxDropped = outbox.getDropped();
+    stats.inboxDepth = inbox.depth();
+    stats.inboxHighWater = inbox.getHighWater();
+    stats.inboxDropped = inbox.getDropped();
+    stats.spoolPending = spoolPendingCache;
+    stats.spoolOverwritten = spool.getOverwritten();
+    return stats;
 }
 
 void NetworkManager::getDeviceTopic(const char* suffix, char* buffer, size_t len) {
@@ -132,16 +739,17 @@ void NetworkManager::publishDevice(const char* suffix, const char* payload) {
     // For simplicity, we just publish. If we want retain for ONLINE, we need to add a parameter.
     // Let's modify publish to check if it is "online" topic or add a bool.
     // For now, simple publish is fine, but for LWT "ONLINE" it's best to be retained so new clients see it.
-    bool retain = (strcmp(suffix, "online") == 0);
-    client.publish(topic, payload, retain);
+    // "config" carries the stable settings and is retained too, see PlantControl::publishConfig()
+    bool retain = (strcmp(suffix, "online") == 0 || strcmp(suffix, "config") == 0);
+    enqueue(topic, (const uint8_t*)payload, strlen(payload), retain);
 }
 
-int NetworkManager::getHour() {
-    return timeClient->getHours();
+void NetworkManager::publishDevice(const char* suffix, const uint8_t* payload, size_t length) {
+    char topic[50];
+    getDeviceTopic(suffix, topic, sizeof(topic));
+    enqueue(topic, payload, length, false);
 }
 
-
-
-String NetworkManager::getFormattedTime() {
-    return timeClient->getFormattedTime();
+int NetworkManager::getHour() {
+    return hourCache;
 }
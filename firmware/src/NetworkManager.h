@@ -2,18 +2,160 @@
 #define NETWORK_MANAGER_H
 
 #include <WiFiManager.h>
-#include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <WiFiUdp.h>
 #include <NTPClient.h>
+#include <atomic>
+#include <functional>
 #include "ConfigManager.h"
+#include "MqttEngine.h"
+#include "PeerGateway.h"
+#include "PeerLink.h"
+#include "SpscQueue.h"
+#include "TelemetrySpool.h"
+
+// MQTT client: the asynchronous engine (MqttEngine.h) on the device. Native
+// builds keep the broker-less PubSubClient stand-in for the benches; build
+// them with -D MQTT_ASYNC=1 to talk to a real broker instead.
+#ifndef MQTT_ASYNC
+#ifdef ARDUINO_ARCH_ESP32
+#define MQTT_ASYNC 1
+#else
+#define MQTT_ASYNC 0
+#endif
+#endif
+
+#if MQTT_ASYNC
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+#else
+#include <PubSubClient.h>
+#endif
+
+// QoS of device publishes and of the command subscription. With QoS 1 and
+// the persistent session, commands sent while the device is offline are
+// queued by the broker and delivered on reconnect.
+#ifndef MQTT_PUBLISH_QOS
+#define MQTT_PUBLISH_QOS 1
+#endif
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW MQTT_INFLIGHT_MAX
+#endif
+
+// PubSubClient packet buffer: bounds topic + payload of a single publish
+#define MQTT_BUFFER_SIZE 1024
+
+// Slots of the queues between the control side and the network side
+#define MQTT_TOPIC_SIZE 64
+#define OUTBOX_PAYLOAD_SIZE 512
+#define INBOX_PAYLOAD_SIZE 256
+#define OUTBOX_DEPTH 8
+#define INBOX_DEPTH 4
+
+// Local time zone of the NTP client (UTC+7); spooled records are stamped in UTC
+#define NTP_UTC_OFFSET_SEC 25200
+#define NTP_SERVER "pool.ntp.org"
+
+// Fast connect: WiFi.begin() with the channel/BSSID of the last session skips
+// the scan; after resets, brownouts and deep sleep the last DHCP lease is
+// reused as a static config too (not after power-on: the lease may be gone).
+// On timeout the cache is dropped and WiFiManager does the full connect.
+#ifndef FAST_CONNECT_TIMEOUT_MS
+#define FAST_CONNECT_TIMEOUT_MS 3000
+#endif
+#ifndef FAST_CONNECT_REUSE_LEASE
+#define FAST_CONNECT_REUSE_LEASE 1
+#endif
+// Optional fixed address for both paths, e.g.
+//   -D STATIC_IP='"192.168.1.50"' -D STATIC_GATEWAY='"192.168.1.1"' -D STATIC_SUBNET='"255.255.255.0"' -D STATIC_DNS='"192.168.1.1"'
+
+#define MQTT_RECONNECT_INTERVAL_MS 5000
+
+// Last successful association, in NVS namespace "netcache"
+struct FastConnectCache {
+    uint32_t magic;
+    char ssid[33];
+    char pass[64];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+struct OutboundMessage {
+    char topic[MQTT_TOPIC_SIZE];
+    uint16_t length;
+    bool retain;
+    bool done; // network side: written or acknowledged, the slot can go
+    uint8_t payload[OUTBOX_PAYLOAD_SIZE];
+};
+
+// Inbox entries are MQTT commands, or settings the network side picked up
+// itself (WiFi portal) for the control side to store: ConfigManager is only
+// ever written from the control task
+enum InboundKind : uint8_t {
+    INBOUND_COMMAND,
+    INBOUND_PORTAL_SETTINGS // payload "<server>:<port>"
+};
+
+struct InboundMessage {
+    char topic[MQTT_TOPIC_SIZE];
+    uint16_t length;
+    uint8_t kind; // InboundKind
+    uint8_t payload[INBOX_PAYLOAD_SIZE + 1]; // NUL-terminated for convenience
+};
 
+struct NetworkQueueStats {
+    uint32_t outboxDepth, outboxHighWater, outboxDropped;
+    uint32_t inboxDepth, inboxHighWater, inboxDropped;
+    uint32_t spoolPending, spoolOverwritten;
+};
 
 class NetworkManager {
 private:
     WiFiManager wm;
+#if MQTT_ASYNC
+    // Outbox slots are published in place and released in order once
+    // written (QoS 0) or acknowledged (QoS 1); see flushOutbox()
+    MqttEngine mqtt;
+    char clientId[48];
+    char willTopic[50];
+    char cmdTopic[50];
+    char spoolTopic[50];
+    uint32_t outboxSent = 0; // slots at the front handed to the engine
+    bool onlinePending = false;
+    bool spoolInFlight = false;
+    uint32_t spoolAckSeq = 0;
+
+    static bool onEngineMessage(void* ctx, const char* topic, const uint8_t* payload, size_t length);
+    static void onEngineRelease(void* ctx, void* tag, bool delivered);
+    void pollMqtt();
+#else
     WiFiClient espClient;
     PubSubClient client;
+#endif
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    // Leaves in range: their traffic rides on this node's MQTT session
+    PeerLink peerLink;
+    PeerGateway gateway;
+    char peersTopic[50];
+    int peerBatchesInFlight = 0;
+
+    void stepGateway();
+    void publishPeerBatch();
+#elif NODE_ROLE == NODE_ROLE_LEAF
+    // No WiFi association: the outbox goes to the gateway over ESP-NOW,
+    // broadcast until the first frame from the gateway says where it is
+    PeerLink peerLink;
+    uint8_t gatewayMac[6];
+    bool gatewayKnown = false;
+    uint8_t gatewayFailures = 0;
+    uint8_t upSeq = 0;
+    int lastCommandSeq = -1;
+
+    void receiveFromGateway();
+#endif
     ConfigManager* configManager;
 
     WiFiUDP ntpUDP;
@@ -23,24 +165,108 @@ private:
     char mqtt_port[6];
     
     unsigned long lastReconnectAttempt = 0;
+    bool reconnectAttempted = false;
+    bool wifiSeen = false; // first association of this boot handled
+    bool portalSettingsPending = false; // not yet handed to the control side
+    Preferences netCache;
+
+    // Control -> network (publishes) and network -> control (commands).
+    // The network side owns PubSubClient/WiFi/NTP; everything the control
+    // side needs crosses these queues or the cached values below.
+    SpscQueue<OutboundMessage, OUTBOX_DEPTH> outbox;
+    SpscQueue<InboundMessage, INBOX_DEPTH> inbox;
+    std::function<void(char*, uint8_t*, unsigned int)> commandCallback;
+    void (*inboxListener)() = nullptr;
+
+    // Telemetry that could not be sent is kept in flash and replayed in
+    // batches on plantcare/<id>/spool once the broker is back
+    TelemetrySpool spool;
+    unsigned long lastSpoolDrain = 0;
+    uint8_t spoolFrame[MQTT_BUFFER_SIZE - MQTT_TOPIC_SIZE];
+    std::atomic<uint32_t> spoolPendingCache{0};
+
+    std::atomic<bool> connectedCache{false};
+    std::atomic<int> hourCache{0};
+    std::atomic<int> rssiCache{0};
+
+    // Battery mode: WiFi only comes up when there is something to send, and
+    // is shut down before deep sleep (see PowerManager.h)
+    std::atomic<bool> radioWanted{true};
+    std::atomic<bool> radioStarted{false};
+    std::atomic<bool> sleepRequested{false};
+    std::atomic<bool> sleepReady{false};
+    // Local time: last NTP time, or the one retained across deep sleep, run on by millis()
+    unsigned long clockEpoch = 0;
+    unsigned long clockMillis = 0;
+    std::atomic<uint32_t> localEpochCache{0};
 
+    void startRadio();
+    bool fastConnect();
+    // true when the cached lease was applied (undone if the fast connect fails)
+    bool applyStaticIp(const FastConnectCache& cache);
+    void saveFastConnect();
+    void onWifiConnected();
+    void updateClock();
     void reconnect();
+    bool mqttConnected();
+    // false: inbox full, leave the message with the MQTT client for now
+    bool onMessage(const char* topic, const uint8_t* payload, size_t length);
+    // Hands portal settings to the control side; false while the inbox is full
+    bool postPortalSettings();
+    void enqueue(const char* topic, const uint8_t* payload, size_t length, bool retain);
+    void spoolMessage(const OutboundMessage& msg);
+    void drainSpool();
+    uint32_t utcNow();
     static void saveConfigCallback();
 
 
 public:
     NetworkManager();
-    void begin(ConfigManager* config);
+    // startRadio = false defers WiFi until requestRadio() (deep-sleep wake-ups)
+    void begin(ConfigManager* config, bool startRadio = true);
+
+    // -- Network side --
+    // WiFi portal, NTP, MQTT session, then drains the outbox
     void loop();
+    void flushOutbox();
+
+    // -- Control side (any other single task) --
+    // Queued; sent by the next loop()
     void publish(const char* topic, const char* payload);
+    // The callback runs from dispatchCommands(), on the caller's task
     void setCallback(MQTT_CALLBACK_SIGNATURE);
+    // Called on the network side after a command was queued (e.g. to wake the control task)
+    void setInboxListener(void (*listener)()) { inboxListener = listener; }
+    void dispatchCommands();
     bool isConnected();
     int getHour();
-    String getFormattedTime();
+    int getRssi();
+    NetworkQueueStats getQueueStats();
+#if MQTT_ASYNC
+    MqttEngineStats getMqttStats() { return mqtt.getStats(); }
+#endif
+#if NODE_ROLE == NODE_ROLE_GATEWAY
+    GatewayStats getGatewayStats() { return gateway.getStats(); }
+#endif
+
+    // -- Battery mode (control side) --
+    void requestRadio() { radioWanted = true; }
+    bool isRadioOn() { return radioStarted; }
+    // Queued publishes or spooled records waiting for the broker
+    bool hasPendingTraffic() { return outbox.depth() > 0 || spoolPendingCache > 0; }
+    // Local epoch seconds, 0 until NTP synced or seedClock()
+    uint32_t getLocalEpoch() { return localEpochCache; }
+    // Before begin(): time retained across deep sleep, used until NTP answers
+    void seedClock(uint32_t localEpoch);
+    // Asks the network side to close MQTT and WiFi; ready once isReadyToSleep()
+    void prepareSleep() { sleepRequested = true; }
+    bool isReadyToSleep() { return sleepReady; }
+    void cancelSleep();
     
     // Helpers to avoid redundancy
     void getDeviceTopic(const char* suffix, char* buffer, size_t len);
     void publishDevice(const char* suffix, const char* payload);
+    void publishDevice(const char* suffix, const uint8_t* payload, size_t length);
 
 
 
@@ -0,0 +1,271 @@
+#include "PeerGateway.h"
+
+static const char TOPIC_PREFIX[] = "plantcare/";
+static const size_t TOPIC_PREFIX_LEN = sizeof(TOPIC_PREFIX) - 1;
+
+PeerGateway::Peer* PeerGateway::findPeer(const uint8_t* mac) {
+    for (Peer& peer : peers) {
+        if (peer.used && memcmp(peer.mac, mac, 6) == 0) return &peer;
+    }
+    return nullptr;
+}
+
+PeerGateway::Peer* PeerGateway::addPeer(const uint8_t* mac, unsigned long now) {
+    Peer* slot = nullptr;
+    for (Peer& peer : peers) {
+        if (!peer.used) {
+            slot = &peer;
+            break;
+        }
+        // Full: a leaf that went offline makes room
+        if (!slot && !peer.online) slot = &peer;
+    }
+    if (!slot) return nullptr;
+    if (slot->used) link->removePeer(slot->mac);
+    if (!link->addPeer(mac)) return nullptr;
+
+    memset(slot, 0, sizeof(Peer));
+    slot->used = true;
+    memcpy(slot->mac, mac, 6);
+    slot->lastSeen = now;
+    // Leaves drop a command whose seq repeats the last one; a rebooted
+    // gateway should not start where it might have left off
+    slot->downSeq = (uint8_t)random(256);
+    return slot;
+}
+
+void PeerGateway::setOnline(Peer& peer, bool online, unsigned long now) {
+    peer.online = online;
+    char topic[PEER_ID_SIZE + 20];
+    int topicLen = snprintf(topic, sizeof(topic), "plantcare/%s/online", peer.id);
+    const char* payload = online ? "true" : "false";
+    appendRecord(topic, topicLen, (const uint8_t*)payload, strlen(payload), now);
+}
+
+void PeerGateway::onPacket(const PeerPacket& packet, unsigned long now) {
+    stats.frames++;
+    if (packet.length < PEER_UP_HEADER || packet.data[0] != PEER_FRAME_UP) return;
+    uint8_t seq = packet.data[1];
+    uint8_t index = packet.data[2] >> 4;
+    uint8_t count = packet.data[2] & 0x0f;
+    if (count == 0 || index >= count) return;
+
+    Peer* peer = findPeer(packet.mac);
+    if (!peer) peer = addPeer(packet.mac, now);
+    if (!peer) {
+        stats.dropped++;
+        return;
+    }
+    // First frame of a wake-up: answer with the time, which also tells the
+    // leaf where the gateway is
+    if (!peer->online || now - peer->lastSeen >= GATEWAY_LISTEN_MS) peer->synced = false;
+    peer->lastSeen = now;
+    peer->waitForPeer = false;
+
+    if (index == 0) {
+        peer->seq = seq;
+        peer->count = count;
+        peer->length = 0;
+    } else if (peer->nextIndex != index || peer->seq != seq || peer->count != count) {
+        // A fragment went missing: the rest of this message is useless
+        if (peer->nextIndex) stats.dropped++;
+        peer->nextIndex = 0;
+        return;
+    }
+    size_t n = packet.length - PEER_UP_HEADER;
+    if (peer->length + n > PEER_MESSAGE_SIZE) {
+        stats.dropped++;
+        peer->nextIndex = 0;
+        return;
+    }
+    memcpy(peer->message + peer->length, packet.data + PEER_UP_HEADER, n);
+    peer->length += n;
+    peer->nextIndex = index + 1;
+    if (peer->nextIndex < count) return;
+
+    peer->nextIndex = 0;
+    // The leaf sends a message again when a fragment was not acknowledged
+    if (peer->delivered && peer->deliveredSeq == seq && now - peer->deliveredAt < GATEWAY_LISTEN_MS) return;
+    peer->delivered = true;
+    peer->deliveredSeq = seq;
+    peer->deliveredAt = now;
+    onMessage(*peer, now);
+}
+
+void PeerGateway::onMessage(Peer& peer, unsigned long now) {
+    size_t topicLen = peer.message[0];
+    if (1 + topicLen > peer.length || topicLen <= TOPIC_PREFIX_LEN) return;
+    const char* topic = (const char*)peer.message + 1;
+    if (memcmp(topic, TOPIC_PREFIX, TOPIC_PREFIX_LEN) != 0) return;
+
+    // plantcare/<id>/<type>: the id names the leaf from now on
+    const char* id = topic + TOPIC_PREFIX_LEN;
+    const char* slash = (const char*)memchr(id, '/', topic + topicLen - id);
+    if (!slash || slash == id || (size_t)(slash - id) >= PEER_ID_SIZE) return;
+    size_t idLen = slash - id;
+    if (strlen(peer.id) != idLen || memcmp(peer.id, id, idLen) != 0) {
+        memcpy(peer.id, id, idLen);
+        peer.id[idLen] = '\0';
+        peer.subscribed = false;
+    }
+
+    stats.messages++;
+    if (!peer.online) setOnline(peer, true, now);
+    appendRecord(topic, topicLen, peer.message + 1 + topicLen, peer.length - 1 - topicLen, now);
+}
+
+void PeerGateway::appendRecord(const char* topic, size_t topicLen, const uint8_t* payload, size_t length, unsigned long now) {
+    size_t need = 1 + topicLen + 2 + length;
+    if (topicLen > 255 || 2 + need > GATEWAY_BATCH_SIZE) {
+        stats.dropped++;
+        return;
+    }
+    if (batchLen && (batchLen + need > GATEWAY_BATCH_SIZE || batch[1] == 255)) {
+        // Uplink backed up: nowhere to go
+        if (readyCount == GATEWAY_READY_DEPTH) {
+            stats.dropped++;
+            return;
+        }
+        seal();
+    }
+    if (batchLen == 0) {
+        batch[0] = PEER_BATCH_V1;
+        batch[1] = 0;
+        batchLen = 2;
+        batchStartedAt = now;
+    }
+    uint8_t* p = batch + batchLen;
+    *p++ = (uint8_t)topicLen;
+    memcpy(p, topic, topicLen);
+    p += topicLen;
+    *p++ = length & 0xff;
+    *p++ = length >> 8;
+    memcpy(p, payload, length);
+    batchLen += need;
+    batch[1]++;
+}
+
+void PeerGateway::seal() {
+    uint8_t slot = (readyHead + readyCount) % GATEWAY_READY_DEPTH;
+    memcpy(ready[slot], batch, batchLen);
+    readyLen[slot] = batchLen;
+    readyCount++;
+    batchLen = 0;
+    stats.batches++;
+}
+
+void PeerGateway::sendDown(Peer& peer, unsigned long now) {
+    uint8_t frame[PEER_FRAME_SIZE];
+    frame[0] = PEER_FRAME_DOWN;
+    frame[1] = peer.downSeq;
+    frame[2] = localEpoch & 0xff;
+    frame[3] = (localEpoch >> 8) & 0xff;
+    frame[4] = (localEpoch >> 16) & 0xff;
+    frame[5] = localEpoch >> 24;
+    size_t length = PEER_DOWN_HEADER;
+    if (peer.commandCount) {
+        memcpy(frame + length, peer.commands[0].payload, peer.commands[0].length);
+        length += peer.commands[0].length;
+    }
+    if (link->send(peer.mac, frame, length)) {
+        peer.sending = true;
+        peer.sendingCommand = peer.commandCount > 0;
+        peer.sentAt = now;
+    } else {
+        peer.waitForPeer = true;
+    }
+}
+
+void PeerGateway::step(unsigned long now) {
+    PeerSendResult result;
+    while (link->takeSendResult(result)) {
+        Peer* peer = findPeer(result.mac);
+        if (!peer || !peer->sending) continue;
+        peer->sending = false;
+        if (!result.ok) {
+            // Asleep or out of range: the next frame from it says it listens
+            peer->waitForPeer = true;
+            continue;
+        }
+        peer->synced = true;
+        peer->lastSync = now;
+        if (peer->sendingCommand && peer->commandCount) {
+            memmove(&peer->commands[0], &peer->commands[1], (peer->commandCount - 1) * sizeof(PeerCommand));
+            peer->commandCount--;
+            peer->downSeq++;
+            stats.commands++;
+        }
+    }
+
+    for (Peer& peer : peers) {
+        if (!peer.used) continue;
+        if (peer.sending && now - peer.sentAt >= GATEWAY_SEND_TIMEOUT_MS) peer.sending = false;
+        if (peer.online && now - peer.lastSeen >= GATEWAY_PEER_TIMEOUT_MS) {
+            setOnline(peer, false, now);
+            peer.nextIndex = 0;
+        }
+        if (!peer.online || peer.sending || peer.waitForPeer || now - peer.lastSeen >= GATEWAY_LISTEN_MS) continue;
+        bool syncDue = !peer.synced || (localEpoch && now - peer.lastSync >= GATEWAY_SYNC_MS);
+        if (peer.commandCount || syncDue) sendDown(peer, now);
+    }
+
+    if (batchLen && readyCount < GATEWAY_READY_DEPTH && now - batchStartedAt >= GATEWAY_BATCH_MS) seal();
+}
+
+const uint8_t* PeerGateway::readyBatch(size_t& length, int index) {
+    if (index >= readyCount) return nullptr;
+    uint8_t slot = (readyHead + index) % GATEWAY_READY_DEPTH;
+    length = readyLen[slot];
+    return ready[slot];
+}
+
+void PeerGateway::releaseBatch() {
+    if (!readyCount) return;
+    readyHead = (readyHead + 1) % GATEWAY_READY_DEPTH;
+    readyCount--;
+}
+
+bool PeerGateway::queueCommand(const char* topic, const uint8_t* payload, size_t length) {
+    if (strncmp(topic, TOPIC_PREFIX, TOPIC_PREFIX_LEN) != 0) return false;
+    const char* id = topic + TOPIC_PREFIX_LEN;
+    const char* slash = strchr(id, '/');
+    if (!slash || strcmp(slash, "/cmd") != 0) return false;
+    size_t idLen = slash - id;
+
+    for (Peer& peer : peers) {
+        if (!peer.used || strlen(peer.id) != idLen || memcmp(peer.id, id, idLen) != 0) continue;
+        if (length == 0 || length > PEER_COMMAND_SIZE || peer.commandCount >= GATEWAY_COMMAND_DEPTH) {
+            stats.dropped++;
+            return true;
+        }
+        PeerCommand& cmd = peer.commands[peer.commandCount++];
+        memcpy(cmd.payload, payload, length);
+        cmd.length = length;
+        return true;
+    }
+    return false;
+}
+
+int PeerGateway::pendingSubscription() {
+    for (int i = 0; i < GATEWAY_MAX_PEERS; i++) {
+        if (peers[i].used && peers[i].id[0] && !peers[i].subscribed) return i;
+    }
+    return -1;
+}
+
+void PeerGateway::getCommandTopic(int peer, char* buffer, size_t len) {
+    snprintf(buffer, len, "plantcare/%s/cmd", peers[peer].id);
+}
+
+void PeerGateway::resetSubscriptions() {
+    for (Peer& peer : peers) peer.subscribed = false;
+}
+
+GatewayStats PeerGateway::getStats() {
+    GatewayStats out = stats;
+    out.peers = 0;
+    for (const Peer& peer : peers) {
+        if (peer.used && peer.online) out.peers++;
+    }
+    return out;
+}
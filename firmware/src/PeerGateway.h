@@ -0,0 +1,142 @@
+#ifndef PEER_GATEWAY_H
+#define PEER_GATEWAY_H
+
+#include <Arduino.h>
+#include "PeerLink.h"
+
+// Gateway side of the peer link (network task only).
+//
+// Leaves send their MQTT messages as PEER_FRAME_UP fragments; complete ones
+// are appended to one uplink batch, published on plantcare/<gateway>/peers
+// once it is full or GATEWAY_BATCH_MS old. A leaf counts as online from its
+// first message until GATEWAY_PEER_TIMEOUT_MS of silence; both changes go
+// into the batch as plantcare/<leaf>/online records.
+//
+// Commands for plantcare/<leaf>/cmd (subscribed on the leaf's behalf) wait
+// in a small per-leaf queue. A leaf only listens right after it sent
+// something, so a command goes out then, and leaves the queue once the
+// radio reports it delivered. Every frame down carries the gateway's local
+// time, which is also the leaves' clock.
+//
+// Batch frame (little endian): [PEER_BATCH_V1][record count], then per
+// record [topic length][topic][payload length, uint16][payload]. It fits a
+// spool slot, so it is spooled as is while the broker is away.
+
+#ifndef GATEWAY_MAX_PEERS
+#define GATEWAY_MAX_PEERS 16
+#endif
+#define GATEWAY_BATCH_SIZE 512
+// Sealed batches waiting for the uplink
+#define GATEWAY_READY_DEPTH 4
+#ifndef GATEWAY_BATCH_MS
+#define GATEWAY_BATCH_MS 1000
+#endif
+#ifndef GATEWAY_PEER_TIMEOUT_MS
+#define GATEWAY_PEER_TIMEOUT_MS (30UL * 60 * 1000)
+#endif
+#define GATEWAY_SYNC_MS (10UL * 60 * 1000)
+// How long after its last frame a leaf is assumed to be listening
+#define GATEWAY_LISTEN_MS 2000
+// Send result overdue (its report was lost): try again
+#define GATEWAY_SEND_TIMEOUT_MS 500
+#define GATEWAY_COMMAND_DEPTH 2
+#define PEER_BATCH_V1 0x01
+#define PEER_ID_SIZE 32
+// Reassembled [topic length][topic][payload] of one leaf message
+#define PEER_MESSAGE_SIZE (1 + 64 + 512)
+
+struct GatewayStats {
+    uint32_t peers;      // online now
+    uint32_t frames;
+    uint32_t messages;   // reassembled
+    uint32_t batches;
+    uint32_t dropped;    // records, fragments or commands that did not fit
+    uint32_t commands;   // delivered to leaves
+};
+
+class PeerGateway {
+private:
+    struct PeerCommand {
+        uint8_t length;
+        uint8_t payload[PEER_COMMAND_SIZE];
+    };
+
+    struct Peer {
+        bool used;
+        bool online;
+        bool subscribed;
+        uint8_t mac[6];
+        char id[PEER_ID_SIZE]; // from its topics, "" until its first message
+        unsigned long lastSeen;
+        unsigned long lastSync;
+        bool synced;
+        bool waitForPeer;      // last frame down failed: wait for its next one
+
+        // Reassembly
+        uint8_t seq;
+        uint8_t nextIndex;     // 0 = no message in progress
+        uint8_t count;
+        uint16_t length;
+        uint8_t message[PEER_MESSAGE_SIZE];
+        bool delivered;
+        uint8_t deliveredSeq;
+        unsigned long deliveredAt;
+
+        // Commands down
+        PeerCommand commands[GATEWAY_COMMAND_DEPTH];
+        uint8_t commandCount;
+        uint8_t downSeq;
+        bool sending;          // a frame down awaits its send result
+        bool sendingCommand;
+        unsigned long sentAt;
+    };
+
+    PeerLink* link = nullptr;
+    Peer peers[GATEWAY_MAX_PEERS] = {};
+    uint32_t localEpoch = 0;
+
+    uint8_t batch[GATEWAY_BATCH_SIZE];
+    size_t batchLen = 0;
+    unsigned long batchStartedAt = 0;
+    uint8_t ready[GATEWAY_READY_DEPTH][GATEWAY_BATCH_SIZE];
+    uint16_t readyLen[GATEWAY_READY_DEPTH];
+    uint8_t readyHead = 0;
+    uint8_t readyCount = 0;
+
+    GatewayStats stats = {};
+
+    Peer* findPeer(const uint8_t* mac);
+    Peer* addPeer(const uint8_t* mac, unsigned long now);
+    void setOnline(Peer& peer, bool online, unsigned long now);
+    void onMessage(Peer& peer, unsigned long now);
+    void appendRecord(const char* topic, size_t topicLen, const uint8_t* payload, size_t length, unsigned long now);
+    void seal();
+    void sendDown(Peer& peer, unsigned long now);
+
+public:
+    void begin(PeerLink* peerLink) { link = peerLink; }
+    // Local epoch seconds handed to the leaves, 0 = not known yet
+    void setClock(uint32_t epoch) { localEpoch = epoch; }
+
+    void onPacket(const PeerPacket& packet, unsigned long now);
+    // Send results, timeouts, frames down, batch age
+    void step(unsigned long now);
+
+    // index-th oldest sealed batch for the uplink, or nullptr; valid until
+    // it is released, oldest first
+    const uint8_t* readyBatch(size_t& length, int index = 0);
+    void releaseBatch();
+
+    // Queues a command if topic is plantcare/<leaf>/cmd of a known leaf
+    bool queueCommand(const char* topic, const uint8_t* payload, size_t length);
+    // Leaf whose command topic still needs a subscription, or -1
+    int pendingSubscription();
+    void getCommandTopic(int peer, char* buffer, size_t len);
+    void setSubscribed(int peer) { peers[peer].subscribed = true; }
+    // New broker session: subscribe again
+    void resetSubscriptions();
+
+    GatewayStats getStats();
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "PeerLink.h"
+#include <WiFi.h>
+#include <esp_now.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_wifi.h>
+#endif
+
+PeerLink* PeerLink::instance = nullptr;
+const uint8_t PeerLink::BROADCAST[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+static void espNowReceived(const esp_now_recv_info_t* info, const uint8_t* data, int length) {
+    PeerLink::dispatchReceive(info->src_addr, data, length);
+}
+#else
+static void espNowReceived(const uint8_t* mac, const uint8_t* data, int length) {
+    PeerLink::dispatchReceive(mac, data, length);
+}
+#endif
+
+static void espNowSent(const uint8_t* mac, esp_now_send_status_t status) {
+    PeerLink::dispatchSent(mac, status == ESP_NOW_SEND_SUCCESS);
+}
+
+bool PeerLink::begin(uint8_t channel) {
+    if (started) return true;
+    instance = this;
+    WiFi.mode(WIFI_STA);
+#ifdef ARDUINO_ARCH_ESP32
+    if (channel) esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+#else
+    (void)channel;
+#endif
+    if (esp_now_init() != ESP_OK) {
+        Serial.println("ESP-NOW init failed");
+        return false;
+    }
+    esp_now_register_recv_cb(espNowReceived);
+    esp_now_register_send_cb(espNowSent);
+    started = addPeer(BROADCAST);
+    return started;
+}
+
+void PeerLink::end() {
+    if (!started) return;
+    esp_now_deinit();
+    started = false;
+}
+
+bool PeerLink::addPeer(const uint8_t* mac) {
+    if (esp_now_is_peer_exist(mac)) return true;
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = 0; // current channel
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+void PeerLink::removePeer(const uint8_t* mac) {
+    esp_now_del_peer(mac);
+}
+
+bool PeerLink::send(const uint8_t* mac, const uint8_t* data, size_t length) {
+    if (!started || length > PEER_FRAME_SIZE) return false;
+    return esp_now_send(mac, data, length) == ESP_OK;
+}
+
+bool PeerLink::sendMessage(const uint8_t* mac, uint8_t seq, const char* topic, const uint8_t* payload, size_t length) {
+    size_t topicLen = strlen(topic);
+    if (topicLen > 255) return false;
+    size_t total = 1 + topicLen + length;
+    size_t count = (total + PEER_FRAGMENT_SIZE - 1) / PEER_FRAGMENT_SIZE;
+    if (count > PEER_MAX_FRAGMENTS) return false;
+
+    // The message is laid out as [topic length][topic][payload] and cut
+    // into fragments without assembling it first
+    uint8_t frame[PEER_FRAME_SIZE];
+    size_t offset = 0;
+    for (size_t index = 0; index < count; index++) {
+        frame[0] = PEER_FRAME_UP;
+        frame[1] = seq;
+        frame[2] = (uint8_t)(index << 4 | count);
+        size_t n = 0;
+        for (; n < PEER_FRAGMENT_SIZE && offset < total; n++, offset++) {
+            uint8_t b;
+            if (offset == 0) b = (uint8_t)topicLen;
+            else if (offset <= topicLen) b = (uint8_t)topic[offset - 1];
+            else b = payload[offset - 1 - topicLen];
+            frame[PEER_UP_HEADER + n] = b;
+        }
+        // A partial message is discarded by the gateway at the next index 0
+        if (!send(mac, frame, PEER_UP_HEADER + n)) return false;
+    }
+    return true;
+}
+
+void PeerLink::dispatchReceive(const uint8_t* mac, const uint8_t* data, int length) {
+    PeerLink* self = instance;
+    if (!self || length <= 0 || length > PEER_FRAME_SIZE) return;
+    PeerPacket* packet = self->rx.prepare();
+    if (!packet) return; // full: counted as dropped
+    memcpy(packet->mac, mac, 6);
+    memcpy(packet->data, data, length);
+    packet->length = (uint8_t)length;
+    self->rx.commit();
+}
+
+void PeerLink::dispatchSent(const uint8_t* mac, bool ok) {
+    PeerLink* self = instance;
+    if (!self) return;
+    PeerSendResult result;
+    memcpy(result.mac, mac, 6);
+    result.ok = ok;
+    self->sent.push(result);
+}
@@ -0,0 +1,95 @@
+#ifndef PEER_LINK_H
+#define PEER_LINK_H
+
+#include <Arduino.h>
+#include "SpscQueue.h"
+
+// Node role, chosen per build (-D NODE_ROLE=1):
+//   standalone  own WiFi association and MQTT session (default)
+//   gateway     standalone, and relays the leaves in radio range: their
+//               messages go up batched on plantcare/<gateway>/peers, their
+//               commands are fanned back out (PeerGateway.h)
+//   leaf        never joins WiFi or opens a socket; everything goes through
+//               the gateway over ESP-NOW, which needs no association and
+//               is on air for about a millisecond per frame
+#define NODE_ROLE_STANDALONE 0
+#define NODE_ROLE_GATEWAY 1
+#define NODE_ROLE_LEAF 2
+#ifndef NODE_ROLE
+#define NODE_ROLE NODE_ROLE_STANDALONE
+#endif
+
+// Leaves have no AP to follow: this must be the channel of the gateway's AP
+#ifndef PEER_CHANNEL
+#define PEER_CHANNEL 1
+#endif
+
+// Failed unicasts in a row after which a leaf looks for its gateway again
+#define LEAF_GATEWAY_FAILURES 3
+
+// ESP-NOW frame (ESP_NOW_MAX_DATA_LEN)
+#define PEER_FRAME_SIZE 250
+#define PEER_RX_DEPTH 32
+
+// Frames start with [type][seq]:
+//   PEER_FRAME_UP    leaf -> gateway, one MQTT message in up to
+//                    PEER_MAX_FRAGMENTS frames: [index << 4 | count], then
+//                    the next bytes of [topic length][topic][payload]
+//   PEER_FRAME_DOWN  gateway -> leaf: [local epoch, uint32 LE][command];
+//                    no command = clock sync only
+#define PEER_FRAME_UP 0x55
+#define PEER_FRAME_DOWN 0x44
+#define PEER_UP_HEADER 3
+#define PEER_DOWN_HEADER 6
+#define PEER_MAX_FRAGMENTS 15
+#define PEER_FRAGMENT_SIZE (PEER_FRAME_SIZE - PEER_UP_HEADER)
+#define PEER_COMMAND_SIZE (PEER_FRAME_SIZE - PEER_DOWN_HEADER)
+
+struct PeerPacket {
+    uint8_t mac[6];
+    uint8_t length;
+    uint8_t data[PEER_FRAME_SIZE];
+};
+
+struct PeerSendResult {
+    uint8_t mac[6];
+    bool ok;
+};
+
+// ESP-NOW wrapper. The radio callbacks run on the WiFi task and only copy
+// into queues; receive() and takeSendResult() are for the network task.
+class PeerLink {
+private:
+    SpscQueue<PeerPacket, PEER_RX_DEPTH> rx;
+    SpscQueue<PeerSendResult, PEER_RX_DEPTH> sent;
+    bool started = false;
+
+    // ESP-NOW callbacks carry no context pointer
+    static PeerLink* instance;
+
+public:
+    static const uint8_t BROADCAST[6];
+
+    // channel 0: stay on the current one (the gateway follows its AP)
+    bool begin(uint8_t channel);
+    void end();
+    bool isStarted() const { return started; }
+    bool addPeer(const uint8_t* mac);
+    void removePeer(const uint8_t* mac);
+    // Queued for the radio; the outcome comes from takeSendResult()
+    bool send(const uint8_t* mac, const uint8_t* data, size_t length);
+    // All fragments of one message; false when the radio refused one (resend it whole)
+    bool sendMessage(const uint8_t* mac, uint8_t seq, const char* topic, const uint8_t* payload, size_t length);
+
+    // Oldest received frame (valid until releaseReceived()), or nullptr
+    PeerPacket* receive() { return rx.front(); }
+    void releaseReceived() { rx.release(); }
+    bool takeSendResult(PeerSendResult& out) { return sent.pop(out); }
+    uint32_t getDropped() { return rx.getDropped(); }
+
+    // From the ESP-NOW callbacks (WiFi task)
+    static void dispatchReceive(const uint8_t* mac, const uint8_t* data, int length);
+    static void dispatchSent(const uint8_t* mac, bool ok);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "PerfCounters.h"
+
+#if PERF_COUNTERS
+
+PerfCounters perfCounters;
+
+static const char* const SECTION_NAMES[PERF_SECTION_COUNT] = {"net_loop", "control", "sensors", "status"};
+
+PerfCounters::PerfCounters() {
+    for (Section& s : sections) {
+        for (auto& b : s.buckets) b.store(0, std::memory_order_relaxed);
+    }
+    for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+}
+
+void PerfCounters::record(PerfSection section, uint32_t cycles) {
+    // The cycle counter follows the current CPU clock
+    uint32_t us = cycles / getCpuFrequencyMhz();
+    Section& s = sections[section];
+
+    int bucket = us ? 32 - __builtin_clz(us) : 0;
+    if (bucket >= PERF_BUCKETS) bucket = PERF_BUCKETS - 1;
+    bump(s.buckets[bucket]);
+    bump(s.runs);
+    s.totalUs.store(s.totalUs.load(std::memory_order_relaxed) + us, std::memory_order_relaxed);
+    if (us > s.maxUs.load(std::memory_order_relaxed)) s.maxUs.store(us, std::memory_order_relaxed);
+}
+
+size_t PerfCounters::buildReport(char* buffer, size_t capacity) {
+    size_t len = 0;
+    auto append = [&](const char* fmt, auto... args) {
+        if (len < capacity) len += snprintf(buffer + len, capacity - len, fmt, args...);
+    };
+
+    append("{\"perf\":{");
+    for (int i = 0; i < PERF_SECTION_COUNT; i++) {
+        const Section& s = sections[i];
+        uint32_t runs = s.runs.load(std::memory_order_relaxed);
+        uint64_t total = s.totalUs.load(std::memory_order_relaxed);
+        append("%s\"%s\":[%lu,%lu,%lu,[", i ? "," : "", SECTION_NAMES[i], (unsigned long)runs,
+               (unsigned long)(runs ? total / runs : 0), (unsigned long)s.maxUs.load(std::memory_order_relaxed));
+        int used = PERF_BUCKETS;
+        while (used > 0 && s.buckets[used - 1].load(std::memory_order_relaxed) == 0) used--;
+        for (int b = 0; b < used; b++) {
+            append("%s%lu", b ? "," : "", (unsigned long)s.buckets[b].load(std::memory_order_relaxed));
+        }
+        append("]]");
+    }
+    append("},\"heap\":{\"free\":%lu,\"min_free\":%lu,\"largest\":%lu}", (unsigned long)ESP.getFreeHeap(),
+           (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+    append(",\"mqtt\":{\"reconnects\":%lu,\"connect_fails\":%lu,\"publish_fails\":%lu}}",
+           (unsigned long)getCount(PERF_MQTT_RECONNECTS), (unsigned long)getCount(PERF_MQTT_CONNECT_FAILS),
+           (unsigned long)getCount(PERF_PUBLISH_FAILS));
+    return len < capacity ? len : 0;
+}
+
+#endif
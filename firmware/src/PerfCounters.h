@@ -0,0 +1,93 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Field performance counters, published every PERF_METRICS_INTERVAL_MS on
+// plantcare/<id>/metrics as
+//   {"perf":{"<section>":[runs, avg_us, max_us, [hist...]], ...},
+//    "heap":{"free","min_free","largest"},
+//    "mqtt":{"reconnects","connect_fails","publish_fails"}}
+// Sections are timed with the CPU cycle counter (PERF_SCOPE). hist[k]
+// counts runs of 2^(k-1) to 2^k - 1 us (hist[0]: under 1 us), trailing
+// empty buckets left out. Counts are since boot; the dashboard diffs them.
+//
+// Each section and counter is written by one task only, so updates are
+// plain relaxed loads and stores. Build with -D PERF_COUNTERS=0 to compile
+// the probes out entirely.
+
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS 1
+#endif
+#ifndef PERF_METRICS_INTERVAL_MS
+#define PERF_METRICS_INTERVAL_MS 60000
+#endif
+// Last bucket collects everything from 2^(PERF_BUCKETS - 2) us (~0.5 s) up
+#define PERF_BUCKETS 20
+
+enum PerfSection {
+    PERF_NETWORK_LOOP,  // NetworkManager::loop(), network task
+    PERF_CONTROL_STEP,  // commands and due timers, control task
+    PERF_SENSOR_UPDATE, // SensorManager::update()
+    PERF_STATUS,        // PlantControl::broadcastStatus()
+    PERF_SECTION_COUNT
+};
+
+enum PerfCounter {
+    PERF_MQTT_RECONNECTS,    // broker connect attempts
+    PERF_MQTT_CONNECT_FAILS,
+    PERF_PUBLISH_FAILS,      // publishes the client refused (spooled or dropped)
+    PERF_COUNTER_COUNT
+};
+
+class PerfCounters {
+private:
+    struct Section {
+        std::atomic<uint32_t> runs{0};
+        std::atomic<uint32_t> maxUs{0};
+        std::atomic<uint64_t> totalUs{0};
+        std::atomic<uint32_t> buckets[PERF_BUCKETS];
+    };
+
+    Section sections[PERF_SECTION_COUNT];
+    std::atomic<uint32_t> counters[PERF_COUNTER_COUNT];
+
+    static void bump(std::atomic<uint32_t>& v) { v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+public:
+    PerfCounters();
+
+    void record(PerfSection section, uint32_t cycles);
+    void count(PerfCounter counter) { bump(counters[counter]); }
+
+    uint32_t getRuns(PerfSection section) const { return sections[section].runs.load(std::memory_order_relaxed); }
+    uint32_t getMaxUs(PerfSection section) const { return sections[section].maxUs.load(std::memory_order_relaxed); }
+    uint32_t getCount(PerfCounter counter) const { return counters[counter].load(std::memory_order_relaxed); }
+
+    // Returns the JSON length, or 0 if it did not fit
+    size_t buildReport(char* buffer, size_t capacity);
+};
+
+extern PerfCounters perfCounters;
+
+// Times the enclosing scope into a section
+class PerfScope {
+private:
+    PerfSection section;
+    uint32_t start;
+
+public:
+    explicit PerfScope(PerfSection s) : section(s), start(ESP.getCycleCount()) {}
+    ~PerfScope() { perfCounters.record(section, ESP.getCycleCount() - start); }
+};
+
+#if PERF_COUNTERS
+#define PERF_SCOPE(section) PerfScope perfScope_(section)
+#define PERF_COUNT(counter) perfCounters.count(counter)
+#else
+#define PERF_SCOPE(section) do {} while (0)
+#define PERF_COUNT(counter) do {} while (0)
+#endif
+
+#endif
@@ -1,4 +1,27 @@
 #include "PlantControl.h"
+#include "StatusEncoder.h"
+#include "SystemTasks.h"
+#include "PerfCounters.h"
+#include "JsonWriter.h"
+
+static_assert(StatusEncoder::MAX_SIZE + 64 <= MQTT_BUFFER_SIZE, "binary status must fit one MQTT packet with its topic");
+static_assert(SampleBatcher::MAX_SIZE <= OUTBOX_PAYLOAD_SIZE, "batch frame must fit one outbox slot");
+static_assert(JSON_STATUS_FIXED_MAX + SOIL_SENSOR_COUNT * JSON_STATUS_CHANNEL_MAX < OUTBOX_PAYLOAD_SIZE,
+              "JSON status with percentages only must fit one outbox slot");
+static_assert(JSON_STATUS_FIXED_MAX + JSON_STATUS_DETAIL_KEYS +
+              JSON_DETAIL_CHANNELS * (JSON_STATUS_CHANNEL_MAX + JSON_STATUS_DETAIL_MAX) < OUTBOX_PAYLOAD_SIZE,
+              "detailed JSON status must fit one outbox slot");
+static_assert(CONFIG_CAL_POINTS == CAL_MAX_POINTS, "stored and compiled calibration points differ");
+
+enum CommandFlags : uint8_t {
+    CMD_BATCHABLE = 1 // settings only: allowed inside BATCH
+};
+
+enum CommandEffects : uint8_t {
+    EFFECT_CONFIG = 1,          // republish the retained config topic
+    EFFECT_STATUS = 2,          // publish a status now
+    EFFECT_STATUS_PERIODIC = 4  // publish a status in periodic telemetry mode
+};
 
 PlantControl::PlantControl(SensorManager* s, NetworkManager* n, ConfigManager* c) {
     sensors = s;
@@ -7,27 +30,89 @@ PlantControl::PlantControl(SensorManager* s, NetworkManager* n, ConfigManager* c
     currentState = IDLE;
 }
 
-void PlantControl::begin() {
-    pinMode(PUMP_PIN, OUTPUT);
-    turnPump(false);
+void PlantControl::begin(Scheduler* s) {
+    scheduler = s;
+    stateJob = scheduler->add("state", onStateTimer, this);
+    configJob = scheduler->add("config_pub", onConfigTimer, this);
+    batchJob = scheduler->add("batch", onBatchTimer, this);
+    historyJob = scheduler->add("history", onHistoryTimer, this);
+
+    network->getDeviceTopic("cmd", cmdTopic, sizeof(cmdTopic));
+    pump.begin(PUMP_PIN, FLOW_SENSOR_PIN);
+    pump.setFlowCalibration(config->loadFlowCalibration());
+    pump.setStopListener(wakeControlTask);
     
     // Load calibration from Config
-    // We can't know size easily without getting readings first or exposing size.
-    // Let's assume SensorManager is initialized.
-    std::vector<SensorDetail> readings = sensors->getReadings();
-    for(int i=0; i<readings.size(); i++) {
+    for (int i = 0; i < sensors->getSensorCount(); i++) {
         int air = config->loadAirValue(i);
         int water = config->loadWaterValue(i);
         sensors->setCalibration(i, air, water);
+        for (int slot = 0; slot < CAL_MAX_POINTS; slot++) {
+            sensors->setCalibrationPoint(i, slot, config->loadCalRaw(i, slot), config->loadCalPercent(i, slot));
+        }
+        sensors->setTempco(i, config->loadTempco(i));
     }
+
+    dose.begin(*config);
+
+    stateStartTime = millis();
+    armStateTimer(stateTimerPeriod());
+    scheduler->once(configJob, 0); // retained config after boot
+    armBatchTimer();
+    scheduler->every(historyJob, HISTORY_SAMPLE_INTERVAL_MS);
 }
 
 void PlantControl::setState(State newState) {
     currentState = newState;
     stateStartTime = millis();
+    if (newState == WATERING) forecast.restart();
+    // The pump follows the state: leaving WATERING for any reason stops it
+    turnPump(newState == WATERING);
+    armStateTimer(stateTimerPeriod());
     broadcastStatus();
 }
 
+void PlantControl::retain(PlantRetained& out) {
+    out.state = currentState;
+    out.configPending = configPending;
+    out.savedAtMs = millis();
+    out.stateTimerMs = scheduler ? scheduler->msUntil(stateJob) : 0;
+    out.stateStartTime = stateStartTime;
+    out.lastSkipLog = lastSkipLog;
+    memcpy(out.snapshot, sensors->getSnapshot(), sizeof(out.snapshot));
+    memcpy(out.telemetry, &telemetry, sizeof(out.telemetry));
+    memcpy(out.forecast, &forecast, sizeof(out.forecast));
+    memcpy(out.dose, &dose, sizeof(out.dose));
+    out.preemptWindow = preemptWindow;
+    memcpy(out.failMessage, failMessage, sizeof(out.failMessage));
+}
+
+void PlantControl::resume(const PlantRetained& in, unsigned long sleptMs) {
+    // millis() restarted at boot: shift retained timestamps by the time that passed
+    unsigned long shift = in.savedAtMs + sleptMs;
+    currentState = (State)in.state;
+    configPending = in.configPending;
+    stateStartTime = in.stateStartTime - shift;
+    lastSkipLog = in.lastSkipLog ? in.lastSkipLog - shift : 0;
+    sensors->restoreSnapshot(in.snapshot);
+    memcpy(&telemetry, in.telemetry, sizeof(telemetry));
+    telemetry.rebase(shift);
+    memcpy(&forecast, in.forecast, sizeof(forecast));
+    memcpy(&dose, in.dose, sizeof(dose));
+    forecast.rebase(shift);
+    preemptWindow = in.preemptWindow;
+    memcpy(failMessage, in.failMessage, sizeof(failMessage));
+
+    // Pick the state timer up where it was left (a WATERING run gets its remaining time)
+    turnPump(currentState == WATERING);
+    armStateTimer(in.stateTimerMs > sleptMs ? in.stateTimerMs - sleptMs : 0);
+    if (!configPending) scheduler->cancel(configJob);
+}
+
+unsigned long PlantControl::msUntilStateTimer() {
+    return scheduler ? scheduler->msUntil(stateJob) : 0;
+}
+
 bool PlantControl::needsWater() {
     float avg = sensors->getAverageMoisture();
     int threshold = config->loadThreshold();
@@ -38,20 +123,21 @@ bool PlantControl::needsWater() {
         return avg < threshold;
     }
     
-    std::vector<SensorDetail> readings = sensors->getReadings();
+    const int8_t* percents = sensors->getPercents();
+    int count = sensors->getSensorCount();
     
     // Mode 1: ANY (Water if ANY sensor is below threshold)
     if (mode == 1) { 
-        for(auto& r : readings) {
-            if(r.percent < threshold) return true;
+        for (int i = 0; i < count; i++) {
+            if (percents[i] < threshold) return true;
         }
         return false;
     }
     
     // Mode 2: ALL (Water only if ALL sensors are below threshold)
     if (mode == 2) { 
-        for(auto& r : readings) {
-            if(r.percent >= threshold) return false;
+        for (int i = 0; i < count; i++) {
+            if (percents[i] >= threshold) return false;
         }
         return true;
     }
@@ -60,210 +146,780 @@ bool PlantControl::needsWater() {
 }
 
 void PlantControl::turnPump(bool on) {
-    digitalWrite(PUMP_PIN, on ? HIGH : LOW);
-    // If relay is active low, invert this. Assuming Active High for now.
+    // If relay is active low, invert in PumpDriver. Assuming Active High for now.
+    PumpRun run;
+    pump.stop();
+    if (pump.takeRun(run)) {
+        // Cut short by a state change; a restart keeps the new pulse length
+        if (!on) dose.recordPulse(run.onMs);
+        reportPumpRun(run);
+    }
+    if (on) pump.start(doseMl ? PUMP_MAX_ON_MS : dose.getPulseMs(), doseMl);
+}
+
+void PlantControl::handlePumpEvents() {
+    PumpRun run;
+    if (!pump.takeRun(run)) return;
+    dose.recordPulse(run.onMs);
+    reportPumpRun(run);
+    if (currentState != WATERING) return;
+    if (run.reason == PUMP_STOP_DRY) {
+        // No flow within FLOW_DRY_MS: no need to soak to find out
+        strcpy(failMessage, "Tank Empty / No Flow");
+        setState(ERROR_TANK_EMPTY);
+    } else {
+        setState(SOAKING);
+    }
 }
 
-void PlantControl::update() {
-    unsigned long elapsed = millis() - stateStartTime;
+void PlantControl::reportPumpRun(const PumpRun& run) {
+    static const char* const REASONS[] = {"time", "volume", "dry", "stopped"};
+    char buffer[96];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("ms", (unsigned long)run.onMs);
+    json.key("ml");
+    if (pump.hasFlowMeter()) json.value((unsigned long)run.ml);
+    else json.valueNull();
+    json.field("pulses", (unsigned long)run.pulses);
+    json.field("stop", REASONS[run.reason]);
+    json.endObject();
+    if (json.ok()) network->publishDevice("dose", buffer);
+}
 
+unsigned long PlantControl::stateTimerPeriod() {
     switch (currentState) {
+        case IDLE: {
+            // Battery mode checks once per wake-up
+            unsigned long sleepMs = (unsigned long)config->loadSleepSec() * 1000;
+            return sleepMs > 0 ? sleepMs : CHECK_INTERVAL;
+        }
+        case WATERING:
+            // The pump stops itself; this only catches a missed cutoff
+            return (doseMl ? PUMP_MAX_ON_MS : dose.getPulseMs()) + PUMP_STOP_GRACE_MS;
+        case SOAKING:
+            return SOAK_DURATION;
+        default:
+            // Stay here until reset; resend the alert every hour
+            return ALERT_INTERVAL;
+    }
+}
+
+void PlantControl::armStateTimer(unsigned long firstDelayMs) {
+    if (!scheduler) return;
+    if (currentState == WATERING || currentState == SOAKING) {
+        scheduler->once(stateJob, firstDelayMs);
+    } else {
+        scheduler->every(stateJob, stateTimerPeriod(), firstDelayMs);
+    }
+}
+
+void PlantControl::armBatchTimer() {
+    if (!scheduler) return;
+    if (config->loadBatchSamples() > 0) {
+        if (!scheduler->isArmed(batchJob)) scheduler->every(batchJob, BATCH_SAMPLE_INTERVAL_MS);
+    } else {
+        scheduler->cancel(batchJob);
+    }
+}
+
+void PlantControl::onStateTimer(void* arg) {
+    PlantControl* self = static_cast<PlantControl*>(arg);
+    switch (self->currentState) {
         case IDLE:
-            // Check sensors periodically (e.g. every 5 seconds) or every loop
-            // For checking threshold:
-            {
-                // Simple hygiene check interval could be added here
-                if (elapsed > CHECK_INTERVAL) { 
-                    sensors->update();
-                    float avg = sensors->getAverageMoisture();
-                    int threshold = config->loadThreshold();
-                    
-                    
-                    if (needsWater()) {
-                         // Check Time: Morning (6-10) OR Afternoon (16-19)
-                         int h = network->getHour();
-                         int mStart = config->loadMorningStart();
-                         int mEnd = config->loadMorningEnd();
-                         int aStart = config->loadAfternoonStart();
-                         int aEnd = config->loadAfternoonEnd();
-
-                         bool isMorning = (h >= mStart && h < mEnd);
-                         bool isAfternoon = (h >= aStart && h < aEnd);
-                         
-                         if (isMorning || isAfternoon) {
-                                 // Snapshot usage for validation logic later
-                                 sensors->snapshotMoisture();
-                                 setState(WATERING);
-                         } else {
-                             // Restricted time
-                             if (elapsed > 3600000) { // Log once an hour
-                                 char msg[64];
-                                 snprintf(msg, sizeof(msg), "Skipping water (Values: %.1f%%). Time: %02d:00", avg, h);
-                                 network->publish("plantcare/log", msg);
-                                 stateStartTime = millis(); 
-                             }
-                         }
-                    }
-                    // Reset timer to avoid flooding logs/checks if we were just idle
-                    if (currentState == IDLE) { // Only reset if we didn't switch state
-                         stateStartTime = millis(); 
-                         broadcastStatus(); 
-                    }
-                }
-            }
+            self->checkMoisture();
             break;
-
         case WATERING:
-            turnPump(true);
-            if (elapsed >= WATERING_DURATION) {
-                turnPump(false);
-                setState(SOAKING);
-            }
+            self->setState(SOAKING);
             break;
-
         case SOAKING:
-            if (elapsed >= SOAK_DURATION) {
-                // End of soak. Check results.
-                sensors->update();
-                std::vector<bool> results = sensors->validateRise(RISE_THRESHOLD);
-                bool tankEmpty = sensors->checkTankEmpty(results);
-
-                if (tankEmpty) {
-                    strcpy(failMessage, "Tank Empty / Pump Failure");
-                    setState(ERROR_TANK_EMPTY);
-                } else {
-                    // Check for individual faulty sensors
-                    bool anyFault = false;
-                    for (int i = 0; i < results.size(); i++) {
-                        if (!results[i]) {
-                             anyFault = true;
-                             // Log specific sensor fault logic here or send MQTT alert
-                             String msg = "Warning: Sensor " + String(i) + " did not respond to watering.";
-                             network->publishDevice("alert", msg.c_str());
-                        }
-                    }
-
-                    // Decide if we need more water or back to IDLE
-                    if (needsWater()) {
-                         // Need more water, but ensure we don't loop forever if tank is empty behavior matches but sensors are just weird.
-                         // For now, loop back to WATERING
-                         sensors->snapshotMoisture(); // New snapshot
-                         setState(WATERING);
-                    } else {
-                         setState(IDLE);
-                    }
-                }
-            }
+            self->finishSoak();
             break;
-
         case ERROR_TANK_EMPTY:
         case ERROR_SENSOR_FAULT:
-            // Stay here until reset
-            // Maybe blink LED
-            if (elapsed > 3600000) { // 1 Hour
-                 network->publishDevice("alert", failMessage);
-                 stateStartTime = millis(); // Resend alert every hour
-            }
+            self->network->publishDevice("alert", self->failMessage);
             break;
     }
 }
 
+void PlantControl::onConfigTimer(void* arg) {
+    PlantControl* self = static_cast<PlantControl*>(arg);
+    if (!self->configPending) return;
+    if (self->network->isConnected()) {
+        self->publishConfig();
+        // First status right behind it instead of at the next check
+        if (!self->bootStatusSent) self->broadcastStatus();
+        self->bootStatusSent = true;
+    } else {
+        // Poll faster until the first session of this boot is up
+        self->scheduler->once(self->configJob, self->bootStatusSent ? self->CONFIG_RETRY_INTERVAL : self->BOOT_RETRY_INTERVAL);
+    }
+}
+
+void PlantControl::onBatchTimer(void* arg) {
+    PlantControl* self = static_cast<PlantControl*>(arg);
+    int batchSamples = self->config->loadBatchSamples();
+    unsigned long maxLatencyMs = (unsigned long)self->config->loadBatchLatencySec() * 1000;
+    // The job period is the sample interval, so sample on every run
+    if (self->batcher.sample(*self->sensors, 0, batchSamples, maxLatencyMs)) self->publishBatch();
+}
+
+void PlantControl::onHistoryTimer(void* arg) {
+    PlantControl* self = static_cast<PlantControl*>(arg);
+    self->history.add(*self->sensors, self->network->getLocalEpoch(), NTP_UTC_OFFSET_SEC);
+}
+
+void PlantControl::checkMoisture() {
+    sensors->update();
+    forecast.update(*sensors);
+    float avg = sensors->getAverageMoisture();
+
+    if (needsWater()) {
+        // Check Time: Morning (6-10) OR Afternoon (16-19)
+        int h = network->getHour();
+        int mStart = config->loadMorningStart();
+        int mEnd = config->loadMorningEnd();
+        int aStart = config->loadAfternoonStart();
+        int aEnd = config->loadAfternoonEnd();
+
+        bool isMorning = (h >= mStart && h < mEnd);
+        bool isAfternoon = (h >= aStart && h < aEnd);
+
+        if (isMorning || isAfternoon) {
+            startWatering(true);
+        } else if (lastSkipLog == 0 || millis() - lastSkipLog >= ALERT_INTERVAL) {
+            // Restricted time, log once an hour
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Skipping water (Values: %.1f%%). Time: %02d:00", avg, h);
+            network->publish("plantcare/log", msg);
+            lastSkipLog = millis();
+        }
+    } else {
+        waterAhead();
+    }
+    if (currentState == IDLE) {
+        reportStatus();
+        stretchIdleCheck();
+    }
+}
+
+long PlantControl::windowSecondsLeft(uint32_t secondOfDay) {
+    int starts[] = {config->loadMorningStart(), config->loadAfternoonStart()};
+    int ends[] = {config->loadMorningEnd(), config->loadAfternoonEnd()};
+    for (int i = 0; i < 2; i++) {
+        uint32_t start = starts[i] * 3600, end = ends[i] * 3600;
+        if (secondOfDay >= start && secondOfDay < end) return end - secondOfDay;
+    }
+    return -1;
+}
+
+uint32_t PlantControl::secondsToNextWindow(uint32_t secondOfDay) {
+    int starts[] = {config->loadMorningStart(), config->loadAfternoonStart()};
+    int ends[] = {config->loadMorningEnd(), config->loadAfternoonEnd()};
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < 2; i++) {
+        if (starts[i] >= ends[i]) continue; // disabled window
+        long until = (long)starts[i] * 3600 - secondOfDay;
+        if (until <= 0) until += 86400; // started already: tomorrow's
+        if ((uint32_t)until < best) best = until;
+    }
+    return best;
+}
+
+bool PlantControl::waterAhead() {
+    // Still wet enough now, but forecast to dry out before the next window
+    // opens: water in the last part of this window instead of waiting outside it
+    uint32_t epoch = network->getLocalEpoch();
+    if (!epoch || !forecast.isReady()) return false;
+    uint32_t secondOfDay = epoch % 86400;
+    long left = windowSecondsLeft(secondOfDay);
+    if (left < 0) return false;
+    // As late as possible, but with at least one more check inside the window
+    unsigned long leadSec = 2 * stateTimerPeriod() / 1000;
+    if (leadSec < PREEMPT_LEAD_SEC) leadSec = PREEMPT_LEAD_SEC;
+    if ((unsigned long)left > leadSec) return false;
+    uint32_t windowEnd = epoch + left;
+    if (windowEnd == preemptWindow) return false; // once per window
+
+    float hours = forecast.hoursToTrigger(*sensors, config->loadThreshold(), config->loadTriggerMode());
+    uint32_t nextWindowSec = secondsToNextWindow(secondOfDay);
+    if (hours == FORECAST_NEVER || hours * 3600 >= nextWindowSec) return false;
+
+    preemptWindow = windowEnd;
+    // Enough to last until the next window opens, not just threshold + margin now
+    float reserve = forecast.dryingRate(config->loadTriggerMode()) * nextWindowSec / 3600.0f;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "Watering ahead: threshold in %.1f h, next window in %.1f h, reserve %.1f%%", hours,
+             nextWindowSec / 3600.0f, reserve);
+    network->publish("plantcare/log", msg);
+    return startWatering(true, reserve);
+}
+
+void PlantControl::stretchIdleCheck() {
+    // Battery mode: nothing can be watered outside the windows, so only wake
+    // for the telemetry heartbeat or when the next window opens
+    uint32_t epoch = network->getLocalEpoch();
+    if (config->loadSleepSec() == 0 || !epoch || !scheduler) return;
+    uint32_t secondOfDay = epoch % 86400;
+    if (windowSecondsLeft(secondOfDay) >= 0) return;
+
+    unsigned long periodMs = stateTimerPeriod();
+    unsigned long delayMs = (unsigned long)config->loadHeartbeatSec() * 1000;
+    uint32_t nextWindowSec = secondsToNextWindow(secondOfDay);
+    if (nextWindowSec < delayMs / 1000) delayMs = (unsigned long)nextWindowSec * 1000;
+    if (delayMs > periodMs) scheduler->every(stateJob, periodMs, delayMs);
+}
+
+void PlantControl::finishSoak() {
+    // End of soak. Check results.
+    sensors->update();
+    RiseResults results = sensors->validateRise(RISE_THRESHOLD);
+    bool tankEmpty = sensors->checkTankEmpty(results);
+
+    if (tankEmpty) {
+        strcpy(failMessage, "Tank Empty / Pump Failure");
+        setState(ERROR_TANK_EMPTY);
+        return;
+    }
+
+    // Check for individual faulty sensors
+    for (int i = 0; i < (int)results.size(); i++) {
+        if (!results[i]) {
+            // Log specific sensor fault logic here or send MQTT alert
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Warning: Sensor %d did not respond to watering.", i);
+            network->publishDevice("alert", msg);
+        }
+    }
+
+    dose.learn(sensors->getSnapshot(), sensors->getPercents(), results, *config);
+
+    // Decide if we need more water or back to IDLE
+    if (needsWater()) {
+        // Next pulse sized from the updated gains; the session budget keeps
+        // sensors that read dry whatever happens from running the tank dry
+        if (!startWatering(false)) {
+            network->publishDevice("alert", "Watering limit reached, soil still reads dry");
+            setState(IDLE);
+        }
+    } else {
+        setState(IDLE);
+    }
+}
+
+bool PlantControl::startWatering(bool newSession, float reserve) {
+    doseMl = 0;
+    if (!dose.nextPulse(sensors->getPercents(), config->loadThreshold(), config->loadTriggerMode(), newSession, reserve)) {
+        return false;
+    }
+    // Snapshot usage for validation logic later
+    sensors->snapshotMoisture();
+    setState(WATERING);
+    return true;
+}
+
+void PlantControl::reportStatus() {
+    // With batching on, the readings travel in batch frames; statuses only carry changes
+    if (config->loadTelemetryMode() == TELEMETRY_EXCEPTION || config->loadBatchSamples() > 0) {
+        unsigned long heartbeatMs = (unsigned long)config->loadHeartbeatSec() * 1000;
+        if (!telemetry.shouldPublish(currentState, *sensors, config->loadTelemetryDeadband(), heartbeatMs)) return;
+    }
+    broadcastStatus();
+}
+
 void PlantControl::broadcastStatus() {
-    // Build JSON
-    JsonDocument doc;
-    doc["device_id"] = DEVICE_ID;
-    doc["state"] = currentState;
-    doc["moisture"] = sensors->getAverageMoisture();
+    PERF_SCOPE(PERF_STATUS);
+    // Leaves always send the compact form: it fits one ESP-NOW frame
+    if (NODE_ROLE == NODE_ROLE_LEAF || config->loadStatusFormat() == STATUS_FORMAT_BINARY_V1) {
+        broadcastStatusBinary();
+    } else {
+        broadcastStatusJson();
+    }
+    telemetry.markPublished(currentState, *sensors);
+}
+
+void PlantControl::applyEffects(uint8_t effects) {
+    if (effects & EFFECT_CONFIG) {
+        configPending = true;
+        if (scheduler) scheduler->once(configJob, 0);
+    }
+    // Periodic mode keeps the old contract: every change is echoed in a full status
+    bool periodic = config->loadTelemetryMode() == TELEMETRY_PERIODIC;
+    if ((effects & EFFECT_STATUS) || ((effects & EFFECT_STATUS_PERIODIC) && periodic)) broadcastStatus();
+}
+
+void PlantControl::publishConfig() {
+    // Stable settings, retained so dashboards get them without waiting for a status.
+    // Republished after every settings change, so written without a document on the heap.
+    configPending = false;
+    char buffer[OUTBOX_PAYLOAD_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("threshold", config->loadThreshold());
+    json.field("mode", config->loadTriggerMode());
+
+    json.key("windows");
+    json.beginObject();
+    json.field("m_start", config->loadMorningStart());
+    json.field("m_end", config->loadMorningEnd());
+    json.field("a_start", config->loadAfternoonStart());
+    json.field("a_end", config->loadAfternoonEnd());
+    json.endObject();
+
+    json.key("calibration");
+    json.beginArray();
+    for (int i = 0; i < sensors->getSensorCount() && i < JSON_CONFIG_CHANNELS; i++) {
+        json.beginObject();
+        json.field("index", i);
+        json.field("air", sensors->getAirValue(i));
+        json.field("water", sensors->getWaterValue(i));
+        // Multi-point curve and temperature coefficient, only when set
+        bool points = false;
+        for (int slot = 0; slot < CAL_MAX_POINTS; slot++) {
+            CalPoint p = sensors->getCalibrationPoint(i, slot);
+            if (p.raw == 0) continue;
+            if (!points) {
+                json.key("points");
+                json.beginArray();
+                points = true;
+            }
+            json.beginArray();
+            json.value(slot);
+            json.value((int)p.raw);
+            json.value((int)p.percent);
+            json.endArray();
+        }
+        if (points) json.endArray();
+        if (sensors->getTempco(i)) json.field("tempco", sensors->getTempco(i));
+        json.endObject();
+    }
+    json.endArray();
+
+    json.field("status_format", config->loadStatusFormat());
+    json.key("telemetry");
+    json.beginObject();
+    json.field("mode", config->loadTelemetryMode());
+    json.field("deadband", config->loadTelemetryDeadband());
+    json.field("heartbeat", config->loadHeartbeatSec());
+    json.endObject();
+    json.key("batch");
+    json.beginObject();
+    json.field("samples", config->loadBatchSamples());
+    json.field("latency", config->loadBatchLatencySec());
+    json.endObject();
+    json.field("sleep", config->loadSleepSec());
+    json.field("flow", config->loadFlowCalibration());
+    json.endObject();
+
+    // Calibration curves on many channels can outgrow an outbox slot; a truncated
+    // retained config would stick on the broker, so it is dropped instead
+    if (!json.ok()) {
+        Serial.println("Config JSON over buffer, not sent");
+        return;
+    }
+    network->publishDevice("config", buffer);
+}
+
+void PlantControl::publishBatch() {
+    uint8_t buffer[SampleBatcher::MAX_SIZE];
+    size_t len = batcher.encode(buffer, sizeof(buffer));
+    if (len > 0) network->publishDevice("batch", buffer, len);
+}
+
+void PlantControl::broadcastStatusBinary() {
+    // Encoded straight from sensor/config state, no intermediate document
+    uint8_t buffer[StatusEncoder::MAX_SIZE];
+    size_t len = StatusEncoder::encodeBinary(buffer, sizeof(buffer), currentState, *sensors, *config,
+                                             forecast, network->getRssi());
+    if (len > 0) network->publishDevice("status", buffer, len);
+}
+
+void PlantControl::broadcastStatusJson() {
+    // Report-by-exception leaves the stable settings to the retained config topic
+    bool full = config->loadTelemetryMode() == TELEMETRY_PERIODIC;
+    int count = sensors->getSensorCount();
+
+    // Written straight into the publish buffer, no document on the heap
+    char buffer[OUTBOX_PAYLOAD_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("device_id", DEVICE_ID);
+    json.field("state", (int)currentState);
+    json.field("moisture", roundf(sensors->getAverageMoisture() * 10) / 10);
     
     // Add individual values (backward compatibility)
-    JsonArray peaks = doc["sensors"].to<JsonArray>();
-    std::vector<SensorDetail> readings = sensors->getReadings();
-    for(auto& val : readings) peaks.add(val.percent);
+    json.key("sensors");
+    json.beginArray();
+    for (int i = 0; i < count; i++) json.value(sensors->getPercent(i));
+    json.endArray();
 
     // Add detailed debug info
-    JsonArray details = doc["sensor_details"].to<JsonArray>();
-    for(int i=0; i<readings.size(); i++) {
-        SensorDetail& val = readings[i];
-        JsonObject d = details.add<JsonObject>();
-        d["pin"] = val.pin;
-        d["adc"] = val.raw;
-        d["pct"] = val.percent;
-        d["air_cal"] = sensors->getAirValue(i);
-        d["water_cal"] = sensors->getWaterValue(i);
+    bool detailed = count <= JSON_DETAIL_CHANNELS;
+    if (detailed) {
+        json.key("sensor_details");
+        json.beginArray();
+        for (int i = 0; i < count; i++) {
+            SensorDetail val = sensors->getReading(i);
+            json.beginObject();
+            json.field("pin", val.pin);
+            json.field("adc", val.raw);
+            json.field("pct", val.percent);
+            if (full) {
+                json.field("air_cal", sensors->getAirValue(i));
+                json.field("water_cal", sensors->getWaterValue(i));
+            }
+            json.endObject();
+        }
+        json.endArray();
     }
     
     // Explicit array for calibration (more robust)
-    JsonArray cal = doc["calibration"].to<JsonArray>();
-    for(int i=0; i<readings.size(); i++) {
-        JsonObject c = cal.add<JsonObject>();
-        c["index"] = i;
-        c["air"] = sensors->getAirValue(i);
-        c["water"] = sensors->getWaterValue(i);
+    if (full && detailed) {
+        json.key("calibration");
+        json.beginArray();
+        for (int i = 0; i < count; i++) {
+            json.beginObject();
+            json.field("index", i);
+            json.field("air", sensors->getAirValue(i));
+            json.field("water", sensors->getWaterValue(i));
+            json.endObject();
+        }
+        json.endArray();
     }
 
     DHTReading dht = sensors->getDHT();
-    doc["temp"] = dht.temperature;
-    doc["humidity"] = dht.humidity;
-    doc["threshold"] = config->loadThreshold();
-    
-    JsonObject windows = doc["windows"].to<JsonObject>();
-    windows["m_start"] = config->loadMorningStart();
-    windows["m_end"] = config->loadMorningEnd();
-    windows["a_start"] = config->loadAfternoonStart();
-    windows["a_end"] = config->loadAfternoonEnd();
-    
-    doc["mode"] = config->loadTriggerMode(); // 0=AVG, 1=ANY, 2=ALL
+    json.field("temp", dht.temperature);
+    json.field("humidity", dht.humidity);
+    // Seconds since last good frame, capped at a day
+    if (dht.valid) json.field("dht_age", dht.ageMs < 86400000UL ? dht.ageMs / 1000 : 86400UL);
+
+    if (full) {
+        json.field("threshold", config->loadThreshold());
+
+        json.key("windows");
+        json.beginObject();
+        json.field("m_start", config->loadMorningStart());
+        json.field("m_end", config->loadMorningEnd());
+        json.field("a_start", config->loadAfternoonStart());
+        json.field("a_end", config->loadAfternoonEnd());
+        json.endObject();
+
+        json.field("mode", config->loadTriggerMode()); // 0=AVG, 1=ANY, 2=ALL
+    }
+
+    // Drying forecast: hours until watering is needed (null: not within the horizon or still learning)
+    json.key("forecast");
+    json.beginObject();
+    float hours = forecast.hoursToTrigger(*sensors, config->loadThreshold(), config->loadTriggerMode());
+    json.key("hours");
+    if (hours == FORECAST_NEVER) json.valueNull();
+    else json.value(roundf(hours * 10) / 10);
+    if (detailed) {
+        json.key("rate"); // % per hour
+        json.beginArray();
+        for (int i = 0; i < count; i++) {
+            // Clamped to the budget's width; no bed dries 100 % an hour
+            float rate = constrain(forecast.getRate(i), -99.99f, 99.99f);
+            json.value(roundf(rate * 100) / 100);
+        }
+        json.endArray();
+    }
+    json.endObject();
 
-    doc["rssi"] = WiFi.RSSI();
+    json.field("rssi", network->getRssi());
+    json.endObject();
 
-    char buffer[512];
-    serializeJson(doc, buffer);
+    if (!json.ok()) {
+        Serial.println("Status JSON over buffer, not sent");
+        return;
+    }
     network->publishDevice("status", buffer);
 }
 
+void PlantControl::publishDiagnostics() {
+    // Task stack head-room, network queue pressure, the offline spool, the
+    // dosing state and per-job timer stats: [runs, avg_us, max_us, max_late_ms]
+    TaskStats tasks = getTaskStats();
+    NetworkQueueStats queues = network->getQueueStats();
+
+    char buffer[OUTBOX_PAYLOAD_SIZE];
+    int len = snprintf(buffer, sizeof(buffer),
+             "{\"tasks\":%s,\"net_stack_free\":%lu,\"ctl_stack_free\":%lu,"
+             "\"outbox\":[%lu,%lu,%lu],\"inbox\":[%lu,%lu,%lu],"
+             "\"spool\":{\"pending\":%lu,\"overwritten\":%lu},"
+             "\"dose\":{\"pulse_ms\":%lu,\"session_ms\":%lu,\"gain\":[",
+             tasks.running ? "true" : "false",
+             (unsigned long)tasks.networkStackFree, (unsigned long)tasks.controlStackFree,
+             (unsigned long)queues.outboxDepth, (unsigned long)queues.outboxHighWater, (unsigned long)queues.outboxDropped,
+             (unsigned long)queues.inboxDepth, (unsigned long)queues.inboxHighWater, (unsigned long)queues.inboxDropped,
+             (unsigned long)queues.spoolPending, (unsigned long)queues.spoolOverwritten,
+             (unsigned long)dose.getPulseMs(), (unsigned long)dose.getSessionMs());
+    // Learned gains, % per pump-second x100
+    for (int i = 0; i < sensors->getSensorCount() && i < JSON_CONFIG_CHANNELS && len < (int)sizeof(buffer); i++) {
+        len += snprintf(buffer + len, sizeof(buffer) - len, "%s%ld", i ? "," : "", lroundf(dose.getGain(i) * 100));
+    }
+    if (len < (int)sizeof(buffer)) len += snprintf(buffer + len, sizeof(buffer) - len, "]},\"jobs\":{");
+    for (int i = 0; scheduler && i < scheduler->getJobCount() && len < (int)sizeof(buffer); i++) {
+        const JobStats& j = scheduler->getStats(i);
+        len += snprintf(buffer + len, sizeof(buffer) - len, "%s\"%s\":[%lu,%lu,%lu,%lu]", i ? "," : "", j.name,
+                        (unsigned long)j.runs, (unsigned long)(j.runs ? j.totalUs / j.runs : 0),
+                        (unsigned long)j.maxUs, (unsigned long)j.maxLateMs);
+    }
+    // Share of uptime spent in jobs, in ppm
+    unsigned long busyPpm = scheduler ? (unsigned long)((uint64_t)scheduler->getBusyUs() * 1000 / (millis() ? millis() : 1)) : 0;
+    if (len < (int)sizeof(buffer)) snprintf(buffer + len, sizeof(buffer) - len, "},\"busy_ppm\":%lu}", busyPpm);
+    network->publishDevice("diag", buffer);
+}
+
+// -- Commands --
+
+#define CMD_NAME(n) n, sizeof(n) - 1
+#define CMD_SETTING CMD_BATCHABLE, EFFECT_CONFIG | EFFECT_STATUS_PERIODIC
+
+// Name, argument ranges and handler; parsed in place, no sscanf
+const PlantControl::CommandSpec PlantControl::COMMANDS[] = {
+    {CMD_NAME("PUMP_ON"), 0, 0, 0, {}, {}, &PlantControl::cmdPumpOn, nullptr},
+    {CMD_NAME("PUMP_ML"), 1, 0, 0, {1}, {FLOW_MAX_ML}, &PlantControl::cmdPumpMl, nullptr},
+    {CMD_NAME("RESET"), 0, 0, 0, {}, {}, &PlantControl::cmdReset, nullptr},
+    {CMD_NAME("DIAG"), 0, 0, 0, {}, {}, &PlantControl::cmdDiag, nullptr},
+    {CMD_NAME("HISTORY"), 2, 0, 0, {HISTORY_MINUTE, 0}, {HISTORY_DAY, 1000}, &PlantControl::cmdHistory, nullptr},
+    {CMD_NAME("SET_THRESHOLD"), 1, CMD_SETTING, {0}, {100},
+        &PlantControl::cmdThreshold, "Threshold updated"},
+    {CMD_NAME("SET_CALIBRATION_VALUES"), 3, CMD_SETTING, {0, 0, 0}, {CONFIG_MAX_SENSORS - 1, 4095, 4095},
+        &PlantControl::cmdCalibration, "Calibration updated"},
+    {CMD_NAME("SET_CAL_POINT"), 4, CMD_SETTING, {0, 0, 0, 0}, {CONFIG_MAX_SENSORS - 1, CAL_MAX_POINTS - 1, CAL_RAW_MAX, 100},
+        &PlantControl::cmdCalPoint, "Calibration updated"},
+    {CMD_NAME("SET_CAL_TEMPCO"), 2, CMD_SETTING, {0, -CAL_TEMPCO_MAX}, {CONFIG_MAX_SENSORS - 1, CAL_TEMPCO_MAX},
+        &PlantControl::cmdTempco, "Calibration updated"},
+    {CMD_NAME("SET_TIME_WINDOW"), 4, CMD_SETTING, {0, 0, 0, 0}, {24, 24, 24, 24},
+        &PlantControl::cmdTimeWindow, nullptr},
+    {CMD_NAME("SET_TRIGGER_MODE"), 1, CMD_SETTING, {0}, {2},
+        &PlantControl::cmdTriggerMode, "Trigger mode updated"},
+    // First status in the new format / fresh reference point for the deadbands
+    {CMD_NAME("SET_STATUS_FORMAT"), 1, CMD_BATCHABLE, EFFECT_CONFIG | EFFECT_STATUS,
+        {STATUS_FORMAT_JSON}, {STATUS_FORMAT_BINARY_V1}, &PlantControl::cmdStatusFormat, nullptr},
+    {CMD_NAME("SET_TELEMETRY"), 3, CMD_BATCHABLE, EFFECT_CONFIG | EFFECT_STATUS,
+        {TELEMETRY_PERIODIC, 1, 30}, {TELEMETRY_EXCEPTION, 100, 65535}, &PlantControl::cmdTelemetry, nullptr},
+    {CMD_NAME("SET_FLOW"), 1, CMD_BATCHABLE, EFFECT_CONFIG, {0}, {FLOW_MAX_PULSES_PER_L},
+        &PlantControl::cmdFlow, nullptr},
+    {CMD_NAME("SET_SLEEP"), 1, CMD_BATCHABLE, EFFECT_CONFIG, {0}, {86400},
+        &PlantControl::cmdSleep, nullptr},
+    {CMD_NAME("SET_BATCH"), 2, CMD_BATCHABLE, EFFECT_CONFIG, {0, 5}, {BATCH_MAX_SAMPLES, 3600},
+        &PlantControl::cmdBatch, nullptr},
+};
+const size_t PlantControl::COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// Parses one "NAME[:arg...]" at p. Returns the position after it (at ';' or
+// the end), or nullptr if the name is unknown or an argument is missing or out of range.
+const char* PlantControl::parseCommand(const char* p, ParsedCommand& out) {
+    size_t len = 0;
+    while (p[len] && p[len] != ':' && p[len] != ';' && p[len] != '\r' && p[len] != '\n') len++;
+
+    out.spec = nullptr;
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (COMMANDS[i].nameLen == len && memcmp(COMMANDS[i].name, p, len) == 0) {
+            out.spec = &COMMANDS[i];
+            break;
+        }
+    }
+    if (!out.spec) return nullptr;
+    p += len;
+
+    for (int a = 0; a < out.spec->argc; a++) {
+        if (*p != ':') return nullptr;
+        p++;
+        bool negative = (*p == '-');
+        if (negative) p++;
+        if (*p < '0' || *p > '9') return nullptr;
+        int32_t v = 0;
+        while (*p >= '0' && *p <= '9') {
+            if (v > 100000) return nullptr; // far outside every range
+            v = v * 10 + (*p++ - '0');
+        }
+        if (negative) v = -v;
+        if (v < out.spec->min[a] || v > out.spec->max[a]) return nullptr;
+        out.args[a] = v;
+    }
+
+    // Zero-argument commands tolerate trailing text, like the old prefix match
+    if (out.spec->argc == 0) {
+        while (*p && *p != ';') p++;
+    }
+    while (*p == '\r' || *p == '\n' || *p == ' ') p++;
+    if (*p && *p != ';') return nullptr;
+    return p;
+}
+
 void PlantControl::processCommand(const char* topic, const char* payload) {
-    char cmdTopic[50];
-    network->getDeviceTopic("cmd", cmdTopic, sizeof(cmdTopic));
+    if (strcmp(topic, cmdTopic) != 0) return;
 
-    if (strcmp(topic, cmdTopic) == 0) {
-        if (strncmp(payload, "PUMP_ON", 7) == 0) {
-            sensors->snapshotMoisture(); // Snapshot before manual run
-            setState(WATERING); // Manual trigger
-        } else if (strncmp(payload, "RESET", 5) == 0) {
-            setState(IDLE);
-        } else if (strncmp(payload, "SET_THRESHOLD:", 14) == 0) {
-            int newThresh = atoi(payload + 14);
-            config->saveThreshold(newThresh);
-            network->publish("plantcare/log", "Threshold updated");
-            broadcastStatus(); // Confirm change to frontend immediately
-        } else if (strncmp(payload, "SET_CALIBRATION_VALUES:", 23) == 0) {
-             // Format: SET_CALIBRATION_VALUES:index:air:water
-             int idx, air, water;
-             if (sscanf(payload, "SET_CALIBRATION_VALUES:%d:%d:%d", &idx, &air, &water) == 3) {
-                 sensors->setCalibration(idx, air, water);
-                 config->saveAirValue(idx, air);
-                 config->saveWaterValue(idx, water);
-                 network->publish("plantcare/log", "Calibration updated");
-                 broadcastStatus();
-             }
-        } else if (strncmp(payload, "SET_TIME_WINDOW:", 16) == 0) {
-             // Format: SET_TIME_WINDOW:mStart:mEnd:aStart:aEnd
-             int mStart, mEnd, aStart, aEnd;
-             if (sscanf(payload, "SET_TIME_WINDOW:%d:%d:%d:%d", &mStart, &mEnd, &aStart, &aEnd) == 4) {
-                 config->saveMorningStart(mStart);
-                 config->saveMorningEnd(mEnd);
-                 config->saveAfternoonStart(aStart);
-                 config->saveAfternoonEnd(aEnd);
-                 
-                 broadcastStatus();
-             }
-        } else if (strncmp(payload, "SET_TRIGGER_MODE:", 17) == 0) {
-            int mode = atoi(payload + 17);
-            if (mode >= 0 && mode <= 2) {
-                config->saveTriggerMode(mode);
-                network->publish("plantcare/log", "Trigger mode updated");
-                broadcastStatus();
-            }
+    if (strncmp(payload, "BATCH:", 6) == 0) {
+        processBatch(payload + 6);
+        return;
+    }
+
+    ParsedCommand cmd;
+    if (!parseCommand(payload, cmd)) {
+        Serial.printf("Rejected command: %.40s\n", payload);
+        return;
+    }
+    (this->*cmd.spec->apply)(cmd.args);
+    if (cmd.spec->log) network->publish("plantcare/log", cmd.spec->log);
+    applyEffects(cmd.spec->effects);
+}
+
+void PlantControl::processBatch(const char* p) {
+    // Format: <id>;CMD;CMD... -- all or nothing
+    const char* id = p;
+    size_t idLen = 0;
+    while (p[idLen] && p[idLen] != ';') idLen++;
+    if (idLen >= CMD_ID_SIZE) idLen = CMD_ID_SIZE - 1;
+    p += idLen;
+    while (*p && *p != ';') p++;
+
+    ParsedCommand cmds[CMD_BATCH_MAX];
+    int count = 0;
+    while (*p == ';') {
+        p++;
+        if (*p == '\0') break; // trailing separator
+        if (count == CMD_BATCH_MAX) {
+            sendAck(id, idLen, false, 0, "too many commands");
+            return;
+        }
+        const char* next = parseCommand(p, cmds[count]);
+        if (!next || !(cmds[count].spec->flags & CMD_BATCHABLE)) {
+            char error[48];
+            snprintf(error, sizeof(error), "invalid command %d", count);
+            sendAck(id, idLen, false, 0, error);
+            return;
         }
+        count++;
+        p = next;
+    }
+
+    uint8_t effects = 0;
+    for (int i = 0; i < count; i++) {
+        (this->*cmds[i].spec->apply)(cmds[i].args);
+        effects |= cmds[i].spec->effects;
+    }
+    if (count > 0) {
+        config->flush(); // one NVS commit for the whole transaction
+        network->publish("plantcare/log", "Settings updated");
+    }
+    applyEffects(effects);
+    sendAck(id, idLen, true, count, nullptr);
+}
+
+void PlantControl::sendAck(const char* id, size_t idLen, bool ok, int applied, const char* error) {
+    char idCopy[CMD_ID_SIZE];
+    snprintf(idCopy, sizeof(idCopy), "%.*s", (int)idLen, id);
+
+    char buffer[128];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("id", (const char*)idCopy);
+    json.field("ok", ok);
+    json.field("applied", applied);
+    if (error) json.field("error", error);
+    json.endObject();
+    if (json.ok()) network->publishDevice("ack", buffer);
+}
+
+void PlantControl::cmdPumpOn(const int32_t* args) {
+    (void)args;
+    doseMl = 0;
+    dose.manualPulse();
+    sensors->snapshotMoisture(); // Snapshot before manual run
+    setState(WATERING); // Manual trigger
+}
+
+void PlantControl::cmdPumpMl(const int32_t* args) {
+    if (!pump.hasFlowMeter()) {
+        network->publishDevice("alert", "PUMP_ML needs a flow meter (SET_FLOW)");
+        return;
     }
+    doseMl = args[0];
+    dose.manualPulse();
+    sensors->snapshotMoisture();
+    setState(WATERING);
+}
+
+void PlantControl::cmdFlow(const int32_t* args) {
+    // Flow meter pulses per litre, 0 = none fitted
+    pump.setFlowCalibration(args[0]);
+    config->saveFlowCalibration(args[0]);
+}
+
+void PlantControl::cmdReset(const int32_t* args) {
+    (void)args;
+    setState(IDLE);
+}
+
+void PlantControl::cmdDiag(const int32_t* args) {
+    (void)args;
+    publishDiagnostics();
+}
+
+void PlantControl::cmdHistory(const int32_t* args) {
+    // tier:page
+    uint8_t buffer[OUTBOX_PAYLOAD_SIZE];
+    size_t len = history.encodePage(args[0], args[1], buffer, sizeof(buffer));
+    if (len > 0) network->publishDevice("history", buffer, len);
+}
+
+void PlantControl::cmdThreshold(const int32_t* args) {
+    config->saveThreshold(args[0]);
+}
+
+void PlantControl::cmdCalibration(const int32_t* args) {
+    // index:air:water
+    sensors->setCalibration(args[0], args[1], args[2]);
+    config->saveAirValue(args[0], args[1]);
+    config->saveWaterValue(args[0], args[2]);
+}
+
+void PlantControl::cmdCalPoint(const int32_t* args) {
+    // index:slot:raw:percent, raw 0 clears the slot
+    sensors->setCalibrationPoint(args[0], args[1], args[2], args[3]);
+    config->saveCalPoint(args[0], args[1], args[2], args[3]);
+}
+
+void PlantControl::cmdTempco(const int32_t* args) {
+    // index:counts per 10 C
+    sensors->setTempco(args[0], args[1]);
+    config->saveTempco(args[0], args[1]);
+}
+
+void PlantControl::cmdTimeWindow(const int32_t* args) {
+    // mStart:mEnd:aStart:aEnd
+    config->saveMorningStart(args[0]);
+    config->saveMorningEnd(args[1]);
+    config->saveAfternoonStart(args[2]);
+    config->saveAfternoonEnd(args[3]);
+}
+
+void PlantControl::cmdStatusFormat(const int32_t* args) {
+    config->saveStatusFormat(args[0]);
+}
+
+void PlantControl::cmdTelemetry(const int32_t* args) {
+    // mode:deadband:heartbeatSec
+    config->saveTelemetry(args[0], args[1], args[2]);
+}
+
+void PlantControl::cmdBatch(const int32_t* args) {
+    // samples:maxLatencySec (samples 0 = one status per sample)
+    publishBatch(); // flush what was collected under the old settings
+    config->saveBatch(args[0], args[1]);
+    armBatchTimer();
+}
+
+void PlantControl::cmdSleep(const int32_t* args) {
+    // seconds between wake-ups, 0 = always on
+    config->saveSleepSec(args[0]);
+    if (currentState == IDLE) armStateTimer(stateTimerPeriod());
+}
+
+void PlantControl::cmdTriggerMode(const int32_t* args) {
+    config->saveTriggerMode(args[0]);
 }
@@ -5,6 +5,67 @@
 #include "SensorManager.h"
 #include "NetworkManager.h"
 #include "ConfigManager.h"
+#include "TelemetryPolicy.h"
+#include "SampleBatcher.h"
+#include "MoistureForecast.h"
+#include "DoseController.h"
+#include "HistoryStore.h"
+#include "PumpDriver.h"
+#include "Scheduler.h"
+
+// Commands on plantcare/<id>/cmd: "NAME[:arg[:arg...]]", integer arguments.
+// HISTORY:<tier>:<page> answers on plantcare/<id>/history (see HistoryStore.h).
+// Several SET_* commands can be sent as one transaction:
+//   BATCH:<id>;SET_THRESHOLD:35;SET_TIME_WINDOW:6:10:16:19
+// All are validated first and applied together (one NVS commit, one status),
+// then acked on plantcare/<id>/ack with the correlation id.
+#define CMD_MAX_ARGS 4
+#define CMD_BATCH_MAX 8
+#define CMD_ID_SIZE 24
+
+// JSON status size budget: it has to fit one outbox slot (NUL included).
+// Worst cases, every value at its widest: moisture and drying rates are
+// rounded when written, rates and the DHT age clamped, DHT22 readings stay
+// within the sensor's range, settings within what their commands accept.
+#define JSON_STATUS_FIXED_MAX (sizeof("{\"device_id\":\"" DEVICE_ID "\",\"state\":4,\"moisture\":99.9," \
+    "\"sensors\":[],\"temp\":-39.9,\"humidity\":99.9,\"dht_age\":86400,\"threshold\":100," \
+    "\"windows\":{\"m_start\":24,\"m_end\":24,\"a_start\":24,\"a_end\":24},\"mode\":2," \
+    "\"forecast\":{\"hours\":71.9},\"rssi\":-128}") - 1)
+#define JSON_STATUS_DETAIL_KEYS (sizeof(",\"sensor_details\":[],\"calibration\":[],\"rate\":[]") - 1)
+// Per channel: its percentage in "sensors"...
+#define JSON_STATUS_CHANNEL_MAX (sizeof("100,") - 1)
+// ...and its sensor_details, calibration and rate entries
+#if SOIL_EXT_ADC_CHIPS > 0
+// ExternalAdc scales to the on-chip 12-bit range, so "adc" stays within 4095 here too
+#define JSON_STATUS_DETAIL_MAX (sizeof("{\"pin\":131,\"adc\":4095,\"pct\":100,\"air_cal\":4095,\"water_cal\":4095}," \
+    "{\"index\":31,\"air\":4095,\"water\":4095},-99.99,") - 1)
+#else
+#define JSON_STATUS_DETAIL_MAX (sizeof("{\"pin\":39,\"adc\":4095,\"pct\":100,\"air_cal\":4095,\"water_cal\":4095}," \
+    "{\"index\":9,\"air\":4095,\"water\":4095},-99.99,") - 1)
+#endif
+// The JSON status carries per-channel details up to as many channels as fit
+// the budget; larger builds send percentages only, the binary status has it all
+#define JSON_DETAIL_CHANNELS ((int)((OUTBOX_PAYLOAD_SIZE - 1 - JSON_STATUS_FIXED_MAX - JSON_STATUS_DETAIL_KEYS) / \
+    (JSON_STATUS_CHANNEL_MAX + JSON_STATUS_DETAIL_MAX)))
+// Retained config and diagnostics list calibration and gains up to this many channels
+#define JSON_CONFIG_CHANNELS 8
+
+// Battery mode: what PlantControl needs to continue after a deep sleep.
+// Kept in RTC memory by PowerManager, so it must stay trivially copyable.
+struct PlantRetained {
+    uint8_t state;
+    bool configPending;
+    uint32_t savedAtMs;      // millis() at retain()
+    uint32_t stateTimerMs;   // state timer deadline, from savedAtMs
+    uint32_t stateStartTime;
+    uint32_t lastSkipLog;
+    int8_t snapshot[SOIL_SENSOR_COUNT];
+    uint8_t telemetry[sizeof(TelemetryPolicy)];
+    uint8_t forecast[sizeof(MoistureForecast)];
+    uint8_t dose[sizeof(DoseController)];
+    uint32_t preemptWindow;
+    char failMessage[100];
+};
 
 enum State {
     IDLE,
@@ -24,23 +85,127 @@ private:
     ConfigManager* config;
 
     unsigned long stateStartTime;
-    const unsigned long WATERING_DURATION = 5000; // 5 seconds
+    unsigned long lastSkipLog = 0;
     const unsigned long SOAK_DURATION = 1000 * 60 * 1;    // 1 minutes
     const unsigned long CHECK_INTERVAL = 1000 * 30; // 30 seconds
     const int RISE_THRESHOLD = 2; // 2% rise expected
+    const unsigned long ALERT_INTERVAL = 3600000; // error alerts / skip logs: hourly
+    const unsigned long CONFIG_RETRY_INTERVAL = 1000;
+    const unsigned long BOOT_RETRY_INTERVAL = 50;
+    // Pre-emptive watering happens in the last part of a window, at least this long
+    const unsigned long PREEMPT_LEAD_SEC = 3600;
 
     char failMessage[100];
 
+    TelemetryPolicy telemetry;
+    bool configPending = true; // retained config topic needs (re)publishing
+    bool bootStatusSent = false;
+    SampleBatcher batcher;
+    MoistureForecast forecast;
+    DoseController dose; // WATERING pulse lengths
+    PumpDriver pump;     // hardware-timed output and flow metering
+    uint32_t doseMl = 0; // metered dose of the current run, 0 = timed
+    // The state timer backs up the pump's own cutoff by this much
+    const unsigned long PUMP_STOP_GRACE_MS = 500;
+    HistoryStore history;
+    uint32_t preemptWindow = 0; // local epoch at the end of the window last watered pre-emptively
+
+    // Timers on the control task's scheduler; the state job is re-armed by setState()
+    Scheduler* scheduler = nullptr;
+    int stateJob = -1;
+    int configJob = -1;
+    int batchJob = -1;
+    int historyJob = -1;
+    static void onStateTimer(void* arg);
+    static void onConfigTimer(void* arg);
+    static void onBatchTimer(void* arg);
+    static void onHistoryTimer(void* arg);
+    unsigned long stateTimerPeriod();
+    void armStateTimer(unsigned long firstDelayMs);
+    void armBatchTimer();
+    void checkMoisture();
+    // Watering windows, from the local second of day
+    long windowSecondsLeft(uint32_t secondOfDay);
+    uint32_t secondsToNextWindow(uint32_t secondOfDay);
+    bool waterAhead();
+    void stretchIdleCheck();
+    void finishSoak();
+    // Sizes the pulse (reserve: extra points, see DoseController.h) and enters
+    // WATERING; false when the session budget is used up
+    bool startWatering(bool newSession, float reserve = 0);
+
+    // One row of the command table (see PlantControl.cpp)
+    struct CommandSpec {
+        const char* name;
+        uint8_t nameLen;
+        uint8_t argc;
+        uint8_t flags;   // CMD_* flags
+        uint8_t effects; // EFFECT_* applied after the handler
+        int32_t min[CMD_MAX_ARGS];
+        int32_t max[CMD_MAX_ARGS];
+        void (PlantControl::*apply)(const int32_t* args);
+        const char* log; // plantcare/log line for single commands, or nullptr
+    };
+    struct ParsedCommand {
+        const CommandSpec* spec;
+        int32_t args[CMD_MAX_ARGS];
+    };
+    static const CommandSpec COMMANDS[];
+    static const size_t COMMAND_COUNT;
+
+    char cmdTopic[MQTT_TOPIC_SIZE];
+
+    static const char* parseCommand(const char* p, ParsedCommand& out);
+    void applyEffects(uint8_t effects);
+    void processBatch(const char* p);
+    void sendAck(const char* id, size_t idLen, bool ok, int applied, const char* error);
+
+    void cmdPumpOn(const int32_t* args);
+    void cmdPumpMl(const int32_t* args);
+    void cmdFlow(const int32_t* args);
+    void cmdReset(const int32_t* args);
+    void cmdDiag(const int32_t* args);
+    void cmdThreshold(const int32_t* args);
+    void cmdCalibration(const int32_t* args);
+    void cmdCalPoint(const int32_t* args);
+    void cmdTempco(const int32_t* args);
+    void cmdTimeWindow(const int32_t* args);
+    void cmdStatusFormat(const int32_t* args);
+    void cmdTelemetry(const int32_t* args);
+    void cmdBatch(const int32_t* args);
+    void cmdTriggerMode(const int32_t* args);
+    void cmdSleep(const int32_t* args);
+    void cmdHistory(const int32_t* args);
+
     void setState(State newState);
     void turnPump(bool on);
-    void broadcastStatus();
+    void reportPumpRun(const PumpRun& run);
     bool needsWater();
+    void broadcastStatusJson();
+    void broadcastStatusBinary();
+    void reportStatus();
+    void publishConfig();
+    void publishBatch();
+    void publishDiagnostics();
 
 public:
     PlantControl(SensorManager* s, NetworkManager* n, ConfigManager* c);
-    void begin();
-    void update();
+    // Registers the state, config, batch and history jobs on the control task's scheduler
+    void begin(Scheduler* s);
     void processCommand(const char* topic, const char* payload);
+    // Control task: reacts to the pump stopping by itself (time, dose, no flow)
+    void handlePumpEvents();
+
+    State getState() const { return currentState; }
+    int getPumpPin() const { return PUMP_PIN; }
+
+    // Battery mode (see PowerManager.h)
+    bool canSleep() const { return currentState != WATERING; }
+    unsigned long msUntilStateTimer();
+    void retain(PlantRetained& out);
+    // Instead of the cold-boot timers set by begin(): continue from a retain(), sleptMs later
+    void resume(const PlantRetained& in, unsigned long sleptMs);
+    void broadcastStatus();
 };
 
 #endif
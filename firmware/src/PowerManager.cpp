@@ -0,0 +1,177 @@
+#include "PowerManager.h"
+#include "Scheduler.h"
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <type_traits>
+
+// How often the control task looks at the radio while it has work to do
+static const uint32_t RADIO_POLL_MS = 10;
+// Longest wait for the network side to close MQTT and WiFi
+static const uint32_t SLEEP_CLOSE_TIMEOUT_MS = 500;
+
+static const uint32_t RETAINED_MAGIC = 0x50575253; // "SRWP"
+
+// Survives deep sleep (not power loss): zeroed at power-on, so magic is 0 then
+struct RetainedState {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t sleptMs;      // the sleep this boot woke up from
+    uint32_t localEpoch;   // wall clock when it started, 0 = unknown
+    PlantConfig config;
+    PlantRetained plant;
+    // Since power-on
+    uint32_t wakes;
+    uint32_t radioWakes;
+    uint32_t lastWakeMs;
+    uint32_t maxWakeMs;
+    uint64_t awakeMs;
+    uint64_t radioMs;
+    uint64_t sleptTotalMs;
+};
+
+// No constructors may run on it at boot, or every wake-up would reset it
+static_assert(std::is_trivial<RetainedState>::value, "RTC state must be trivial");
+static_assert(std::is_trivially_copyable<TelemetryPolicy>::value, "TelemetryPolicy is retained as bytes");
+static_assert(std::is_trivially_copyable<MoistureForecast>::value, "MoistureForecast is retained as bytes");
+static_assert(std::is_trivially_copyable<DoseController>::value, "DoseController is retained as bytes");
+
+RTC_DATA_ATTR static RetainedState rtc;
+
+PowerManager::PowerManager(ConfigManager* c, NetworkManager* n, PlantControl* p) {
+    config = c;
+    network = n;
+    plant = p;
+}
+
+bool PowerManager::begin() {
+    bool timerWake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    resumed = timerWake && rtc.magic == RETAINED_MAGIC && rtc.size == sizeof(RetainedState);
+    if (!resumed) memset(&rtc, 0, sizeof(rtc)); // power-on, reset or new firmware layout
+    startCycle(0);
+    return resumed;
+}
+
+const PlantConfig* PowerManager::getRetainedConfig() {
+    return resumed ? &rtc.config : nullptr;
+}
+
+void PowerManager::resume() {
+    if (!resumed) return;
+    plant->resume(rtc.plant, rtc.sleptMs);
+    if (rtc.localEpoch) network->seedClock(rtc.localEpoch + rtc.sleptMs / 1000);
+}
+
+void PowerManager::startCycle(unsigned long now) {
+    wakeStartMs = now;
+    radioRequestedMs = 0;
+    connectedMs = 0;
+    closingSinceMs = 0;
+}
+
+void PowerManager::useRadio(unsigned long now) {
+    if (radioRequestedMs) return;
+    radioRequestedMs = now ? now : 1;
+    network->requestRadio();
+    publishMetrics(); // rides along with whatever needed the radio
+}
+
+uint32_t PowerManager::step(uint32_t waitMs) {
+#ifndef ARDUINO_ARCH_ESP32
+    if (hostAsleep) {
+        // Host builds cannot power down: the control task idles until the wake-up
+        // time, or until battery mode is switched off (a bench driving commands)
+        unsigned long now = millis();
+        int32_t left = (int32_t)(sleepMs - (now - closingSinceMs));
+        if (left > 0 && config->loadSleepSec() != 0) return waitMs < (uint32_t)left ? waitMs : left;
+        hostAsleep = false;
+        network->cancelSleep();
+        startCycle(now);
+    }
+#endif
+
+    if (!closingSinceMs && (config->loadSleepSec() == 0 || !plant->canSleep())) return waitMs;
+    unsigned long now = millis();
+
+    if (closingSinceMs) {
+        if (network->isReadyToSleep() || now - closingSinceMs >= SLEEP_CLOSE_TIMEOUT_MS) enterSleep(now);
+        return RADIO_POLL_MS;
+    }
+
+    unsigned long untilTimer = plant->msUntilStateTimer();
+    if (untilTimer < SLEEP_MIN_MS) return waitMs;
+
+    // Queued messages, or no wall clock yet for the watering windows, need the radio
+    if (network->hasPendingTraffic() || network->getLocalEpoch() == 0) useRadio(now);
+    if (radioRequestedMs) {
+        if (!connectedMs && network->isConnected()) connectedMs = now;
+        bool done = connectedMs && now - connectedMs >= SLEEP_LISTEN_MS &&
+                    !network->hasPendingTraffic() && network->getLocalEpoch() != 0;
+        // Unsent messages are spooled to flash by the network side meanwhile
+        if (!done && now - radioRequestedMs < SLEEP_RADIO_TIMEOUT_MS) {
+            return waitMs < RADIO_POLL_MS ? waitMs : RADIO_POLL_MS;
+        }
+    }
+
+    config->flush(); // pending settings must be in NVS before RAM goes away
+    sleepMs = untilTimer;
+    closingSinceMs = now ? now : 1;
+    network->prepareSleep();
+    return RADIO_POLL_MS;
+}
+
+void PowerManager::enterSleep(unsigned long now) {
+    // The state timer kept running while the network side shut down
+    unsigned long closing = now - closingSinceMs;
+    uint32_t ms = sleepMs > closing ? sleepMs - closing : 0;
+
+    uint32_t awake = now - wakeStartMs;
+    rtc.wakes++;
+    rtc.lastWakeMs = awake;
+    if (awake > rtc.maxWakeMs) rtc.maxWakeMs = awake;
+    rtc.awakeMs += awake;
+    if (radioRequestedMs) {
+        rtc.radioWakes++;
+        rtc.radioMs += now - radioRequestedMs;
+    }
+    rtc.sleptTotalMs += ms;
+    rtc.sleptMs = ms;
+
+    plant->retain(rtc.plant);
+    rtc.config = config->getConfig();
+    rtc.localEpoch = network->getLocalEpoch();
+    rtc.size = sizeof(RetainedState);
+    rtc.magic = RETAINED_MAGIC;
+
+    esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+    esp_deep_sleep_start();
+#ifndef ARDUINO_ARCH_ESP32
+    hostAsleep = true;
+    sleepMs = ms;
+    closingSinceMs = now ? now : 1;
+#endif
+}
+
+PowerStats PowerManager::getStats() {
+    PowerStats stats = {rtc.wakes, rtc.radioWakes, rtc.lastWakeMs, rtc.maxWakeMs, 0, 0};
+    if (rtc.wakes) stats.avgWakeMs = rtc.awakeMs / rtc.wakes;
+    uint64_t totalMs = rtc.awakeMs + rtc.sleptTotalMs;
+    if (totalMs) {
+        uint64_t chargeUaMs = (rtc.awakeMs - rtc.radioMs) * POWER_ACTIVE_MA * 1000 +
+                              rtc.radioMs * POWER_RADIO_MA * 1000 + rtc.sleptTotalMs * POWER_SLEEP_UA;
+        stats.avgCurrentUa = chargeUaMs / totalMs;
+    }
+    return stats;
+}
+
+void PowerManager::publishMetrics() {
+    if (rtc.wakes == 0) return; // nothing measured yet
+    PowerStats stats = getStats();
+    char buffer[192];
+    snprintf(buffer, sizeof(buffer),
+             "{\"power\":{\"sleep_sec\":%d,\"wakes\":%lu,\"radio_wakes\":%lu,\"wake_ms\":%lu,"
+             "\"wake_ms_avg\":%lu,\"wake_ms_max\":%lu,\"avg_ua\":%lu}}",
+             config->loadSleepSec(), (unsigned long)stats.wakes, (unsigned long)stats.radioWakes,
+             (unsigned long)stats.lastWakeMs, (unsigned long)stats.avgWakeMs, (unsigned long)stats.maxWakeMs,
+             (unsigned long)stats.avgCurrentUa);
+    network->publishDevice("metrics", buffer);
+}
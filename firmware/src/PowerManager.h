@@ -0,0 +1,95 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "ConfigManager.h"
+#include "NetworkManager.h"
+#include "PlantControl.h"
+
+// Battery mode (SET_SLEEP:<seconds>, 0 = always on).
+//
+// Between state timer deadlines the device deep-sleeps. PlantControl's state,
+// timers, moisture snapshot and telemetry reference, the config and the wall
+// clock are kept in RTC memory, so a timer wake-up skips NVS and NTP and
+// continues IDLE checks or a SOAKING wait where it left off. WiFi only comes
+// up when something is queued for the broker; after sending, the device
+// listens for SLEEP_LISTEN_MS for commands, then sleeps again. It never
+// sleeps while WATERING.
+//
+// Wake time, radio time and sleep time are accumulated across cycles and
+// turned into an average current with the model below; they are published
+// on plantcare/<id>/metrics whenever the radio is up anyway.
+
+// Shorter waits are spent awake
+#ifndef SLEEP_MIN_MS
+#define SLEEP_MIN_MS 3000
+#endif
+// Give up on the broker after this long and sleep (messages stay in the spool)
+#ifndef SLEEP_RADIO_TIMEOUT_MS
+#define SLEEP_RADIO_TIMEOUT_MS 20000
+#endif
+// Time connected before sleeping, for commands to arrive
+#ifndef SLEEP_LISTEN_MS
+#define SLEEP_LISTEN_MS 1500
+#endif
+
+// Current model for the average-current metric
+#ifndef POWER_ACTIVE_MA
+#define POWER_ACTIVE_MA 40  // CPU on, radio off
+#endif
+#ifndef POWER_RADIO_MA
+#define POWER_RADIO_MA 120  // WiFi associated and transmitting
+#endif
+#ifndef POWER_SLEEP_UA
+#define POWER_SLEEP_UA 150  // deep sleep incl. regulator and sensor bias
+#endif
+
+struct PowerStats {
+    uint32_t wakes;         // completed wake cycles since power-on
+    uint32_t radioWakes;    // of which brought WiFi up
+    uint32_t lastWakeMs;    // wake-to-sleep time of the last cycle
+    uint32_t maxWakeMs;
+    uint32_t avgWakeMs;
+    uint32_t avgCurrentUa;  // modelled, over awake + asleep time
+};
+
+class PowerManager {
+private:
+    ConfigManager* config;
+    NetworkManager* network;
+    PlantControl* plant;
+
+    bool resumed = false;
+    unsigned long wakeStartMs = 0;
+    unsigned long radioRequestedMs = 0; // 0 = radio not needed on this wake
+    unsigned long connectedMs = 0;      // first time the broker was seen on this wake
+    unsigned long closingSinceMs = 0;   // waiting for the network side to shut down
+    uint32_t sleepMs = 0;
+#ifndef ARDUINO_ARCH_ESP32
+    bool hostAsleep = false;
+#endif
+
+    void useRadio(unsigned long now);
+    void publishMetrics();
+    void enterSleep(unsigned long now);
+    void startCycle(unsigned long now);
+
+public:
+    PowerManager(ConfigManager* c, NetworkManager* n, PlantControl* p);
+
+    // First thing in setup(): true when waking from deep sleep with retained state
+    bool begin();
+    bool isResumed() const { return resumed; }
+    // Settings kept across sleep, or nullptr (read NVS)
+    const PlantConfig* getRetainedConfig();
+    // After PlantControl::begin(): hands the retained state back (no-op on cold boot)
+    void resume();
+
+    // After the control task ran its timers; may enter deep sleep and not return.
+    // Returns how long the control task should wait.
+    uint32_t step(uint32_t waitMs);
+
+    PowerStats getStats();
+};
+
+#endif
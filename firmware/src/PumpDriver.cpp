@@ -0,0 +1,144 @@
+#include "PumpDriver.h"
+
+// PCNT glitch filter in APB cycles (80 MHz): ignores spikes under 12.5 us
+static const uint16_t FLOW_FILTER_CYCLES = 1000;
+
+void PumpDriver::begin(int pumpPin, int flowPin) {
+    pin = pumpPin;
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+
+    esp_timer_create_args_t args = {};
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.arg = this;
+
+    args.callback = &PumpDriver::onCutoff;
+    args.name = "pump_cutoff";
+    esp_timer_create(&args, &cutoffTimer);
+
+    args.callback = &PumpDriver::onFlowCheck;
+    args.name = "pump_flow";
+    args.skip_unhandled_events = true;
+    esp_timer_create(&args, &flowTimer);
+
+    if (flowPin < 0) return;
+    pcnt_config_t pc = {};
+    pc.pulse_gpio_num = flowPin;
+    pc.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    pc.channel = PCNT_CHANNEL_0;
+    pc.unit = FLOW_PCNT_UNIT;
+    pc.pos_mode = PCNT_COUNT_INC; // rising edges
+    pc.neg_mode = PCNT_COUNT_DIS;
+    pc.lctrl_mode = PCNT_MODE_KEEP;
+    pc.hctrl_mode = PCNT_MODE_KEEP;
+    pc.counter_h_lim = INT16_MAX;
+    pc.counter_l_lim = 0;
+    if (pcnt_unit_config(&pc) != ESP_OK) return;
+    pcnt_set_filter_value(FLOW_PCNT_UNIT, FLOW_FILTER_CYCLES);
+    pcnt_filter_enable(FLOW_PCNT_UNIT);
+    pcnt_isr_service_install(0);
+    pcnt_isr_handler_add(FLOW_PCNT_UNIT, &PumpDriver::onFlowThreshold, this);
+    meterReady = true;
+}
+
+int16_t PumpDriver::readPulses() {
+    int16_t count = 0;
+    if (meterReady) pcnt_get_counter_value(FLOW_PCNT_UNIT, &count);
+    return count;
+}
+
+void PumpDriver::start(uint32_t maxMs, uint32_t ml) {
+    settle(); // a run halted by the interrupt but not recorded yet
+    uint8_t expected = phase.load();
+    if (expected == PHASE_RUNNING || expected == PHASE_SETTLING) return;
+
+    if (maxMs > PUMP_MAX_ON_MS) maxMs = PUMP_MAX_ON_MS;
+    targetPulses = 0;
+    if (metered()) {
+        pcnt_counter_pause(FLOW_PCNT_UNIT);
+        pcnt_counter_clear(FLOW_PCNT_UNIT);
+        if (ml > 0) {
+            uint32_t pulses = (ml * pulsesPerLiter + 500) / 1000;
+            targetPulses = pulses < 1 ? 1 : (pulses > FLOW_MAX_PULSES ? FLOW_MAX_PULSES : pulses);
+            pcnt_set_event_value(FLOW_PCNT_UNIT, PCNT_EVT_THRES_0, targetPulses);
+            pcnt_event_enable(FLOW_PCNT_UNIT, PCNT_EVT_THRES_0);
+        } else {
+            pcnt_event_disable(FLOW_PCNT_UNIT, PCNT_EVT_THRES_0);
+        }
+        pcnt_counter_resume(FLOW_PCNT_UNIT);
+    }
+
+    lastPulses = 0;
+    startUs = lastFlowUs = esp_timer_get_time();
+    phase.store(PHASE_RUNNING);
+    digitalWrite(pin, HIGH);
+    esp_timer_start_once(cutoffTimer, (uint64_t)maxMs * 1000);
+    if (metered()) esp_timer_start_periodic(flowTimer, (uint64_t)FLOW_CHECK_MS * 1000);
+}
+
+void PumpDriver::stop() {
+    halt(PUMP_STOP_CMD);
+    settle();
+}
+
+bool IRAM_ATTR PumpDriver::halt(PumpStop reason) {
+    uint8_t expected = PHASE_RUNNING;
+    if (!phase.compare_exchange_strong(expected, PHASE_HALTED)) return false;
+    digitalWrite(pin, LOW);
+    stopUs.store(esp_timer_get_time());
+    stopReason.store(reason);
+    return true;
+}
+
+void PumpDriver::settle() {
+    uint8_t expected = PHASE_HALTED;
+    if (!phase.compare_exchange_strong(expected, PHASE_SETTLING)) return;
+    esp_timer_stop(cutoffTimer);
+    esp_timer_stop(flowTimer);
+    if (meterReady) pcnt_event_disable(FLOW_PCNT_UNIT, PCNT_EVT_THRES_0);
+
+    // Read after the stop, so water still running out of the line counts
+    uint32_t pulses = metered() ? (uint16_t)readPulses() : 0;
+    last.onMs = (uint32_t)((stopUs.load() - startUs) / 1000);
+    last.pulses = pulses;
+    last.ml = metered() ? (pulses * 1000 + pulsesPerLiter / 2) / pulsesPerLiter : 0;
+    last.reason = (PumpStop)stopReason.load();
+    phase.store(PHASE_READY);
+    if (stopListener) stopListener();
+}
+
+bool PumpDriver::takeRun(PumpRun& out) {
+    uint8_t expected = PHASE_READY;
+    if (!phase.compare_exchange_strong(expected, PHASE_IDLE)) return false;
+    out = last;
+    return true;
+}
+
+void PumpDriver::onCutoff(void* arg) {
+    PumpDriver* self = static_cast<PumpDriver*>(arg);
+    self->halt(PUMP_STOP_TIME);
+    self->settle();
+}
+
+void PumpDriver::onFlowCheck(void* arg) {
+    PumpDriver* self = static_cast<PumpDriver*>(arg);
+    if (self->phase.load() == PHASE_RUNNING) {
+        int16_t pulses = self->readPulses();
+        int64_t now = esp_timer_get_time();
+        if (self->targetPulses && (uint32_t)pulses >= self->targetPulses) {
+            // Backstop for a missed threshold interrupt
+            self->halt(PUMP_STOP_VOLUME);
+        } else if (pulses != self->lastPulses) {
+            self->lastPulses = pulses;
+            self->lastFlowUs = now;
+        } else if (now - self->lastFlowUs >= (int64_t)FLOW_DRY_MS * 1000) {
+            self->halt(PUMP_STOP_DRY);
+        }
+    }
+    // Also picks up a stop by the threshold interrupt
+    self->settle();
+}
+
+void IRAM_ATTR PumpDriver::onFlowThreshold(void* arg) {
+    static_cast<PumpDriver*>(arg)->halt(PUMP_STOP_VOLUME);
+}
@@ -0,0 +1,109 @@
+#ifndef PUMP_DRIVER_H
+#define PUMP_DRIVER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/pcnt.h>
+#include <esp_timer.h>
+
+// Pump output with its cutoff on a hardware timer.
+//
+// start() switches the pump on and arms a one-shot esp_timer for the pulse,
+// never longer than PUMP_MAX_ON_MS, so the on-time no longer depends on how
+// soon the control task gets to run. With a flow meter (pulses per litre
+// set) a PCNT unit counts its pulses: a dose in ml becomes a counter
+// threshold whose interrupt stops the pump at the exact count, and a check
+// every FLOW_CHECK_MS stops it once no pulse came for FLOW_DRY_MS (tank
+// empty, pump running dry).
+//
+// The stop listener (control task wake-up) runs once the run is recorded;
+// the control task then collects it with takeRun().
+
+#ifndef FLOW_SENSOR_PIN
+#define FLOW_SENSOR_PIN 27
+#endif
+#define FLOW_PCNT_UNIT PCNT_UNIT_0
+// Hard limit for any single run, timed or metered
+#ifndef PUMP_MAX_ON_MS
+#define PUMP_MAX_ON_MS 60000
+#endif
+#define FLOW_CHECK_MS 100
+#ifndef FLOW_DRY_MS
+#define FLOW_DRY_MS 1000
+#endif
+// Largest dose the 16-bit counter meters in one run
+#define FLOW_MAX_PULSES 32000
+// Accepted by PUMP_ML and SET_FLOW
+#define FLOW_MAX_ML 10000
+#define FLOW_MAX_PULSES_PER_L 20000
+
+enum PumpStop : uint8_t {
+    PUMP_STOP_TIME,   // pulse length or PUMP_MAX_ON_MS reached
+    PUMP_STOP_VOLUME, // dose delivered
+    PUMP_STOP_DRY,    // no flow for FLOW_DRY_MS
+    PUMP_STOP_CMD     // stop() from the control task
+};
+
+// One pump run, reported per watering cycle
+struct PumpRun {
+    uint32_t onMs;
+    uint32_t pulses;
+    uint32_t ml;      // 0 without a flow meter
+    PumpStop reason;
+};
+
+class PumpDriver {
+private:
+    enum Phase : uint8_t {
+        PHASE_IDLE,
+        PHASE_RUNNING,
+        PHASE_HALTED,   // output off, run not recorded yet
+        PHASE_SETTLING,
+        PHASE_READY     // recorded, waiting for takeRun()
+    };
+
+    int pin = -1;
+    uint16_t pulsesPerLiter = 0;
+    bool meterReady = false;
+    esp_timer_handle_t cutoffTimer = nullptr;
+    esp_timer_handle_t flowTimer = nullptr;
+    void (*stopListener)() = nullptr;
+
+    std::atomic<uint8_t> phase{PHASE_IDLE};
+    std::atomic<uint8_t> stopReason{PUMP_STOP_CMD};
+    int64_t startUs = 0;
+    std::atomic<int64_t> stopUs{0};
+    // Flow check state (esp_timer task only)
+    int16_t lastPulses = 0;
+    int64_t lastFlowUs = 0;
+    uint32_t targetPulses = 0;
+    PumpRun last = {};
+
+    bool metered() const { return meterReady && pulsesPerLiter > 0; }
+    int16_t readPulses();
+    // Output off; safe from the PCNT interrupt. False if not running.
+    bool halt(PumpStop reason);
+    // Records a halted run and notifies the listener (task context only)
+    void settle();
+    static void onCutoff(void* arg);
+    static void onFlowCheck(void* arg);
+    static void onFlowThreshold(void* arg);
+
+public:
+    // flowPin < 0: no flow meter fitted
+    void begin(int pumpPin, int flowPin);
+    // Flow meter pulses per litre, 0 = not metered
+    void setFlowCalibration(uint16_t pulses) { pulsesPerLiter = pulses; }
+    bool hasFlowMeter() const { return metered(); }
+    void setStopListener(void (*listener)()) { stopListener = listener; }
+
+    // Runs for maxMs (capped at PUMP_MAX_ON_MS), or until ml are delivered
+    // when ml > 0 and a flow meter is set
+    void start(uint32_t maxMs, uint32_t ml);
+    void stop();
+    bool isRunning() const { return phase.load() == PHASE_RUNNING; }
+    // The last run, once, after it stopped; false while running or already taken
+    bool takeRun(PumpRun& out);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "SampleBatcher.h"
+
+bool SampleBatcher::sample(SensorManager& sensors, unsigned long intervalMs, int batchSamples, unsigned long maxLatencyMs) {
+    unsigned long now = millis();
+    if (count == 0 || now - lastSample >= intervalMs) {
+        if (count < BATCH_MAX_SAMPLES) {
+            Sample& s = samples[count++];
+            s.timeMs = now;
+            for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+                s.percent[i] = i < sensors.getSensorCount() ? sensors.getPercent(i) : 0;
+            }
+            DHTReading dht = sensors.getDHT();
+            s.dhtValid = dht.valid;
+            s.temp10 = dht.valid ? lroundf(dht.temperature * 10) : 0;
+            s.humidity10 = dht.valid ? lroundf(dht.humidity * 10) : 0;
+        }
+        lastSample = now;
+    }
+
+    if (count == 0) return false;
+    if (count >= batchSamples || count >= BATCH_MAX_SAMPLES) return true;
+    return now - samples[0].timeMs >= maxLatencyMs;
+}
+
+void SampleBatcher::writeSeries(MsgPackWriter& w, const int16_t* values, const bool* valid, int n) {
+    // Deltas against the previous valid value keep most entries at one byte
+    w.writeArray(n);
+    bool havePrev = false;
+    int prev = 0;
+    for (int i = 0; i < n; i++) {
+        if (!valid[i]) {
+            w.writeNil();
+            continue;
+        }
+        w.writeInt(havePrev ? values[i] - prev : values[i]);
+        prev = values[i];
+        havePrev = true;
+    }
+}
+
+size_t SampleBatcher::encode(uint8_t* buf, size_t cap) {
+    if (count == 0 || cap < 1) return 0;
+
+    MsgPackWriter w(buf, cap);
+    w.writeRaw(BATCH_FRAME_V1);
+    w.writeArray(5);
+    w.writeUInt(millis() - samples[count - 1].timeMs);
+
+    w.writeArray(count);
+    for (int i = 0; i < count; i++) {
+        w.writeUInt(i == 0 ? 0 : (samples[i].timeMs - samples[i - 1].timeMs + 50) / 100);
+    }
+
+    int16_t values[BATCH_MAX_SAMPLES];
+    bool valid[BATCH_MAX_SAMPLES];
+
+    w.writeArray(SOIL_SENSOR_COUNT);
+    for (int ch = 0; ch < SOIL_SENSOR_COUNT; ch++) {
+        for (int i = 0; i < count; i++) {
+            values[i] = samples[i].percent[ch];
+            valid[i] = true;
+        }
+        writeSeries(w, values, valid, count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        values[i] = samples[i].temp10;
+        valid[i] = samples[i].dhtValid;
+    }
+    writeSeries(w, values, valid, count);
+
+    for (int i = 0; i < count; i++) values[i] = samples[i].humidity10;
+    writeSeries(w, values, valid, count);
+
+    count = 0;
+    return w.ok() ? w.size() : 0;
+}
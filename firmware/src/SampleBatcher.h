@@ -0,0 +1,59 @@
+#ifndef SAMPLE_BATCHER_H
+#define SAMPLE_BATCHER_H
+
+#include <Arduino.h>
+#include "MsgPack.h"
+#include "SensorManager.h"
+
+// Collects moisture/temperature/humidity samples and emits them as one
+// delta-encoded frame on plantcare/<id>/batch, instead of one status per
+// sample. Configured with SET_BATCH:<samples>:<max_latency_s>.
+
+#ifndef BATCH_SAMPLE_INTERVAL_MS
+#define BATCH_SAMPLE_INTERVAL_MS 5000
+#endif
+// Bounded so one frame fits an outbox slot whatever the channel count
+#define BATCH_MAX_SAMPLES (SOIL_SENSOR_COUNT <= 4 ? 16 : (SOIL_SENSOR_COUNT <= 16 ? 8 : 4))
+
+// Frame: one version byte, then a MessagePack array
+//   [age, dt[], moisture[channel][], temp[], humidity[]]
+// age   ms between the last sample and encoding (receiver anchors time on it)
+// dt    per sample, 0.1 s since the previous one (first entry is 0)
+// series first value absolute, then deltas; temperature and humidity are
+//        x10 and nil where the DHT had no valid reading (deltas skip nils)
+#define BATCH_FRAME_V1 0x01
+
+class SampleBatcher {
+private:
+    struct Sample {
+        uint32_t timeMs;
+        int8_t percent[SOIL_SENSOR_COUNT];
+        int16_t temp10;
+        int16_t humidity10;
+        bool dhtValid;
+    };
+
+    Sample samples[BATCH_MAX_SAMPLES];
+    int count = 0;
+    unsigned long lastSample = 0;
+
+    static void writeSeries(MsgPackWriter& w, const int16_t* values, const bool* valid, int n);
+
+public:
+    // Worst case per sample: dt (uint32), moisture deltas (int8), temperature and humidity deltas (int16)
+    static constexpr size_t MAX_SAMPLE_SIZE = MsgPackWriter::MAX_INT_SIZE +
+        SOIL_SENSOR_COUNT * MsgPackWriter::MAX_INT8_SIZE + 2 * MsgPackWriter::MAX_INT16_SIZE;
+    static constexpr size_t MAX_SIZE = 1 + MsgPackWriter::MAX_ARRAY_HEADER_SIZE * (5 + SOIL_SENSOR_COUNT) +
+        MsgPackWriter::MAX_INT_SIZE + BATCH_MAX_SAMPLES * MAX_SAMPLE_SIZE;
+
+    // Takes a sample every `intervalMs`; true once the frame is due, i.e.
+    // `batchSamples` are collected or the oldest is `maxLatencyMs` old.
+    bool sample(SensorManager& sensors, unsigned long intervalMs, int batchSamples, unsigned long maxLatencyMs);
+    int size() const { return count; }
+    void clear() { count = 0; }
+
+    // Encodes and clears the collected samples; 0 if there were none
+    size_t encode(uint8_t* buf, size_t cap);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "Scheduler.h"
+
+int Scheduler::add(const char* name, JobFn fn, void* arg) {
+    if (jobCount >= SCHED_MAX_JOBS) return -1;
+    Job& job = jobs[jobCount];
+    job.fn = fn;
+    job.arg = arg;
+    job.dueMs = 0;
+    job.periodMs = 0;
+    job.heapPos = -1;
+    job.stats = {name, 0, 0, 0, 0, 0};
+    return jobCount++;
+}
+
+void Scheduler::swapNodes(int a, int b) {
+    uint8_t tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    jobs[heap[a]].heapPos = a;
+    jobs[heap[b]].heapPos = b;
+}
+
+void Scheduler::siftUp(int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!earlier(pos, parent)) break;
+        swapNodes(pos, parent);
+        pos = parent;
+    }
+}
+
+void Scheduler::siftDown(int pos) {
+    for (;;) {
+        int left = 2 * pos + 1;
+        int right = left + 1;
+        int best = pos;
+        if (left < heapSize && earlier(left, best)) best = left;
+        if (right < heapSize && earlier(right, best)) best = right;
+        if (best == pos) break;
+        swapNodes(pos, best);
+        pos = best;
+    }
+}
+
+void Scheduler::arm(int id, uint32_t dueMs) {
+    Job& job = jobs[id];
+    job.dueMs = dueMs;
+    if (job.heapPos < 0) {
+        job.heapPos = heapSize;
+        heap[heapSize++] = id;
+    }
+    // New deadline may be earlier or later than the old one
+    siftUp(job.heapPos);
+    siftDown(job.heapPos);
+}
+
+void Scheduler::every(int id, uint32_t periodMs, uint32_t firstDelayMs) {
+    if (id < 0 || id >= jobCount) return;
+    jobs[id].periodMs = periodMs;
+    arm(id, millis() + firstDelayMs);
+}
+
+void Scheduler::once(int id, uint32_t delayMs) {
+    if (id < 0 || id >= jobCount) return;
+    jobs[id].periodMs = 0;
+    arm(id, millis() + delayMs);
+}
+
+void Scheduler::cancel(int id) {
+    if (!isArmed(id)) return;
+    int pos = jobs[id].heapPos;
+    swapNodes(pos, --heapSize);
+    jobs[id].heapPos = -1;
+    if (pos < heapSize) {
+        siftUp(pos);
+        siftDown(pos);
+    }
+}
+
+void Scheduler::trigger(int id) {
+    if (isArmed(id)) arm(id, millis());
+}
+
+uint32_t Scheduler::msUntil(int id) const {
+    if (!isArmed(id)) return UINT32_MAX;
+    int32_t wait = (int32_t)(jobs[id].dueMs - millis());
+    return wait > 0 ? wait : 0;
+}
+
+uint32_t Scheduler::msUntilNext() const {
+    return heapSize > 0 ? msUntil(heap[0]) : SCHED_IDLE_MAX_MS;
+}
+
+uint32_t Scheduler::runDue() {
+    // At most one run per job per call, so a job re-arming itself with no
+    // delay cannot starve the caller
+    for (int budget = jobCount; heapSize > 0; budget--) {
+        if (budget == 0) return 0;
+        int id = heap[0];
+        Job& job = jobs[id];
+        uint32_t now = millis();
+        int32_t wait = (int32_t)(job.dueMs - now);
+        if (wait > 0) return wait;
+
+        // Re-arm before running so the job may cancel or re-arm itself
+        uint32_t late = now - job.dueMs;
+        if (job.periodMs) {
+            // Skip missed periods instead of running a burst to catch up
+            uint32_t next = job.dueMs + job.periodMs;
+            if ((int32_t)(next - now) <= 0) next = now + job.periodMs;
+            arm(id, next);
+        } else {
+            cancel(id);
+        }
+
+        unsigned long start = micros();
+        job.fn(job.arg);
+        uint32_t took = micros() - start;
+
+        JobStats& s = job.stats;
+        s.runs++;
+        s.totalUs += took;
+        if (took > s.maxUs) s.maxUs = took;
+        s.lastLateMs = late;
+        if (late > s.maxLateMs) s.maxLateMs = late;
+        busyUs += took;
+    }
+    return SCHED_IDLE_MAX_MS;
+}
@@ -0,0 +1,76 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Deadline scheduler for the control task.
+// Components register jobs once and then arm them as periodic or one-shot.
+// Armed jobs sit in a min-heap ordered by deadline. runDue() runs what is
+// due and returns the time to the next deadline, which the control task
+// sleeps for (or until a command wakes it). Every run records its run time
+// and how late it started.
+
+#define SCHED_MAX_JOBS 16
+#define SCHED_IDLE_MAX_MS 1000 // longest sleep when nothing is armed
+
+typedef void (*JobFn)(void* arg);
+
+struct JobStats {
+    const char* name;
+    uint32_t runs;
+    uint64_t totalUs; // a uint32_t would wrap after ~71 min of job time
+    uint32_t maxUs;
+    uint32_t maxLateMs;
+    uint32_t lastLateMs;
+};
+
+class Scheduler {
+private:
+    struct Job {
+        JobFn fn;
+        void* arg;
+        uint32_t dueMs;
+        uint32_t periodMs; // 0 = one-shot
+        int8_t heapPos;    // -1 when not armed
+        JobStats stats;
+    };
+
+    Job jobs[SCHED_MAX_JOBS];
+    uint8_t heap[SCHED_MAX_JOBS]; // job ids, earliest deadline first
+    int jobCount = 0;
+    int heapSize = 0;
+    uint64_t busyUs = 0; // time spent in jobs since boot
+
+    bool earlier(int a, int b) const { return (int32_t)(jobs[heap[a]].dueMs - jobs[heap[b]].dueMs) < 0; }
+    void swapNodes(int a, int b);
+    void siftUp(int pos);
+    void siftDown(int pos);
+    void arm(int id, uint32_t dueMs);
+
+public:
+    // Returns the job id, or -1 when the table is full. Jobs start disarmed.
+    int add(const char* name, JobFn fn, void* arg);
+
+    // Runs every periodMs, first after firstDelayMs
+    void every(int id, uint32_t periodMs, uint32_t firstDelayMs);
+    void every(int id, uint32_t periodMs) { every(id, periodMs, periodMs); }
+    // Runs once after delayMs (re-arming replaces the previous deadline)
+    void once(int id, uint32_t delayMs);
+    void cancel(int id);
+    // Makes an armed job due now; a periodic job keeps its period from there
+    void trigger(int id);
+    bool isArmed(int id) const { return id >= 0 && id < jobCount && jobs[id].heapPos >= 0; }
+    // ms until the job is due: 0 when overdue, UINT32_MAX when not armed
+    uint32_t msUntil(int id) const;
+    // ms until the earliest armed job (0 when overdue), SCHED_IDLE_MAX_MS when none is
+    uint32_t msUntilNext() const;
+
+    // Runs every due job; returns ms until the next deadline (0: more are due)
+    uint32_t runDue();
+
+    int getJobCount() const { return jobCount; }
+    const JobStats& getStats(int id) const { return jobs[id].stats; }
+    uint64_t getBusyUs() const { return busyUs; }
+};
+
+#endif
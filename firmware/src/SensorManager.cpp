@@ -1,98 +1,107 @@
 #include "SensorManager.h"
+#include "PerfCounters.h"
 
-SensorManager::SensorManager() : dht(DHTPIN, DHTTYPE) {
-    int count = sizeof(SOIL_PINS) / sizeof(SOIL_PINS[0]);
-    for (int i = 0; i < count; i++) {
-        int pin = SOIL_PINS[i];
-        sensorPins.push_back(pin);
-        currentReadings.push_back({pin, 0, 0});
-        snapshotReadings.push_back({pin, 0, 0});
+SensorManager::SensorManager() : dht(DHTPIN) {
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+#if SOIL_EXT_ADC_CHIPS > 0
+        pins[i] = EXT_ADC_PIN_BASE + i;
+#else
+        pins[i] = SOIL_PINS[i];
+#endif
+        raw[i] = 0;
+        percent[i] = 0;
+        percent256[i] = 0;
+        snapshotPercent[i] = 0;
         
         // Default calibration
-        airValues.push_back(1700);
-        waterValues.push_back(700);
+        airValues[i] = 1700;
+        waterValues[i] = 700;
+        for (CalPoint& p : calPoints[i]) p = {0, 0};
+        compileCalibration(i);
     }
 }
 
 void SensorManager::begin() {
     dht.begin();
-    for (int pin : sensorPins) {
-        pinMode(pin, INPUT);
+#if SOIL_EXT_ADC_CHIPS > 0
+    Wire.begin(EXT_ADC_SDA, EXT_ADC_SCL, EXT_ADC_I2C_HZ);
+    if (SOIL_EXT_ADC_CHIPS > 4) Wire1.begin(EXT_ADC_SDA1, EXT_ADC_SCL1, EXT_ADC_I2C_HZ);
+    for (int chip = 0; chip < SOIL_EXT_ADC_CHIPS; chip++) {
+        extAdc.addChip(chip < 4 ? Wire : Wire1, 0x48 + chip % 4);
     }
+    extAdc.begin();
+#else
+    for (int pin : SOIL_PINS) {
+        sampler.addChannel(pin);
+    }
+    sampler.begin();
+#endif
 }
 
-void SensorManager::update() {
-    for (int i = 0; i < sensorPins.size(); i++) {
-        int raw = 0;
-        int pct = readSensor(i, sensorPins[i], raw);
-        currentReadings[i] = {sensorPins[i], raw, pct};
-    }
+void SensorManager::configureSampling(int oversampling, AdcFilter filter, int trim) {
+#if SOIL_EXT_ADC_CHIPS == 0
+    sampler.configure(oversampling, filter, trim);
+#else
+    // The ADS1115 scan runs at its own data rate, the sampler settings do not apply
+    (void)oversampling;
+    (void)filter;
+    (void)trim;
+#endif
 }
 
-int SensorManager::readSensor(int index, int pin, int& rawArg) {
-    long sum = 0;
-    for(int i=0; i<5; i++) {
-        sum += analogRead(pin);
-        delay(2); // tiny delay for ADC stability
-    }
-    int raw = sum / 5;
-    
-    rawArg = raw;
-    // Map raw to 0-100%
-    // Use index to get specific calibration. Modulo for safety against out-of-bounds.
-    if (index < 0 || index >= airValues.size()) return 0; // Error
-    
-    int air = airValues[index];
-    int water = waterValues[index];
+uint16_t SensorManager::readRaw(int index) {
+    // Channels are registered in order, so index == sampler/ADS channel
+#if SOIL_EXT_ADC_CHIPS > 0
+    return extAdc.read(index);
+#else
+    return sampler.read(index);
+#endif
+}
 
-    int percent = map(raw, air, water, 0, 100);
-    return constrain(percent, 0, 100);
+void SensorManager::update() {
+    PERF_SCOPE(PERF_SENSOR_UPDATE);
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        raw[i] = readRaw(i);
+    }
+    // Compensate to the DHT temperature; no reading = no correction
+    DHTReading env = dht.read();
+    int temp10 = env.valid ? (int)lroundf(env.temperature * 10) : CAL_REF_TEMP10;
+    calibration.apply(raw, temp10, percent256, percent);
 }
 
 float SensorManager::getAverageMoisture() {
     long sum = 0;
-    for (auto& val : currentReadings) {
-        sum += val.percent;
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        sum += percent[i];
     }
-    return (float)sum / sensorPins.size();
+    return (float)sum / SOIL_SENSOR_COUNT;
 }
 
-std::vector<SensorDetail> SensorManager::getReadings() {
-    return currentReadings;
+SensorReadings SensorManager::getReadings() {
+    SensorReadings readings;
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) readings.push_back(getReading(i));
+    return readings;
 }
 
 DHTReading SensorManager::getDHT() {
-    unsigned long now = millis();
-    if (now - lastDHTReadTime > 2000 || lastDHTReadTime == 0) { // Read every 2 seconds min (DHT22 limit)
-        // Ideally we don't block here, but DHT lib blocks. 
-        // We just ensure we don't call it FASTER than allowed.
-        // Actually, let's cache for 10 seconds to improve loop perf.
-        if (now - lastDHTReadTime > 10000 || lastDHTReadTime == 0) {
-            float t = dht.readTemperature();
-            float h = dht.readHumidity();
-            if (!isnan(t)) cachedDHT.temperature = t;
-            if (!isnan(h)) cachedDHT.humidity = h;
-            lastDHTReadTime = now;
-        }
-    }
-    return cachedDHT;
+    return dht.read();
 }
 
 void SensorManager::snapshotMoisture() {
     // Copy current readings to snapshot
-    snapshotReadings = currentReadings;
+    memcpy(snapshotPercent, percent, sizeof(percent));
 }
 
-std::vector<bool> SensorManager::validateRise(int riseThreshold) {
-    std::vector<bool> results;
-    for (int i = 0; i < sensorPins.size(); i++) {
-        int delta = currentReadings[i].percent - snapshotReadings[i].percent;
+RiseResults SensorManager::validateRise(int riseThreshold) {
+    RiseResults results;
+    for (int i = 0; i < SOIL_SENSOR_COUNT; i++) {
+        int delta = percent[i] - snapshotPercent[i];
         results.push_back(delta >= riseThreshold);
     }
     return results;
 }
 
-bool SensorManager::checkTankEmpty(const std::vector<bool>& validationResults) {
+bool SensorManager::checkTankEmpty(Span<const bool> validationResults) {
     // If ALL sensors failed to rise, assume tank is empty
     for (bool rise : validationResults) {
         if (rise) return false; // At least one sensor rose, so tank is NOT empty
@@ -101,18 +110,33 @@ bool SensorManager::checkTankEmpty(const std::vector<bool>& validationResults) {
 }
 
 void SensorManager::setCalibration(int index, int air, int water) {
-    if (index >= 0 && index < airValues.size()) {
+    if (index >= 0 && index < SOIL_SENSOR_COUNT) {
         airValues[index] = air;
         waterValues[index] = water;
+        compileCalibration(index);
     }
 }
 
+void SensorManager::setCalibrationPoint(int index, int slot, int raw, int percent) {
+    if (index < 0 || index >= SOIL_SENSOR_COUNT || slot < 0 || slot >= CAL_MAX_POINTS) return;
+    calPoints[index][slot] = {(int16_t)raw, (int8_t)(raw ? percent : 0)};
+    compileCalibration(index);
+}
+
+void SensorManager::setTempco(int index, int countsPer10C) {
+    if (index >= 0 && index < SOIL_SENSOR_COUNT) calibration.setTempco(index, countsPer10C);
+}
+
+void SensorManager::compileCalibration(int index) {
+    calibration.compile(index, airValues[index], waterValues[index], calPoints[index], CAL_MAX_POINTS);
+}
+
 int SensorManager::getAirValue(int index) {
-    if (index >= 0 && index < airValues.size()) return airValues[index];
+    if (index >= 0 && index < SOIL_SENSOR_COUNT) return airValues[index];
     return 1700;
 }
 
 int SensorManager::getWaterValue(int index) {
-    if (index >= 0 && index < waterValues.size()) return waterValues[index];
+    if (index >= 0 && index < SOIL_SENSOR_COUNT) return waterValues[index];
     return 700;
 }
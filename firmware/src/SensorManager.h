@@ -2,15 +2,35 @@
 #define SENSOR_MANAGER_H
 
 #include <Arduino.h>
-#include <DHT.h>
-#include <vector>
+#include "FixedVector.h"
+#include "AdcSampler.h"
+#include "ExternalAdc.h"
+#include "DhtReader.h"
+#include "CalibrationLut.h"
 
-#define DHTPIN 4
-#define DHTTYPE DHT22
+#define DHTPIN 4 // DHT22
 
 // Soil Sensor Pins (ADC)
 const int SOIL_PINS[] = {32, 34}; 
-// NUM_SENSORS is now dynamic based on SOIL_PINS array size calculated in cpp
+
+// Larger beds: soil probes on ADS1115 modules instead of SOIL_PINS.
+// Chips 0-3 on Wire (0x48-0x4B), chips 4-7 on Wire1; 4 probes per chip.
+#ifndef SOIL_EXT_ADC_CHIPS
+#define SOIL_EXT_ADC_CHIPS 0
+#endif
+#define EXT_ADC_SDA 21
+#define EXT_ADC_SCL 22
+#define EXT_ADC_SDA1 25
+#define EXT_ADC_SCL1 26
+// Reported "pin" of external channel n
+#define EXT_ADC_PIN_BASE 100
+
+#if SOIL_EXT_ADC_CHIPS > 0
+const int SOIL_SENSOR_COUNT = SOIL_EXT_ADC_CHIPS * ADS1115_CHANNELS;
+#else
+const int SOIL_SENSOR_COUNT = sizeof(SOIL_PINS) / sizeof(SOIL_PINS[0]);
+#endif
+static_assert(SOIL_EXT_ADC_CHIPS <= EXT_ADC_MAX_CHIPS, "at most 8 ADS1115 (4 addresses x 2 buses)");
 
 struct SensorDetail {
     int pin;
@@ -18,48 +38,74 @@ struct SensorDetail {
     int percent;
 };
 
-struct DHTReading {
-    float temperature;
-    float humidity;
-};
+// Sized for every channel, returned by value without touching the heap
+typedef FixedVector<SensorDetail, SOIL_SENSOR_COUNT> SensorReadings;
+typedef FixedVector<bool, SOIL_SENSOR_COUNT> RiseResults;
 
 class SensorManager {
 private:
-    DHT dht;
-    std::vector<int> sensorPins;
-    std::vector<SensorDetail> currentReadings; // calibrated %
-    std::vector<SensorDetail> snapshotReadings; // for rise validation
-
-    // Cache
-    DHTReading cachedDHT = {0, 0};
-    unsigned long lastDHTReadTime = 0;
+    DhtReader dht; // interrupt-driven, see DhtReader.h
+#if SOIL_EXT_ADC_CHIPS > 0
+    ExternalAdc extAdc; // pipelined ADS1115 scan, see ExternalAdc.h
+#else
+    AdcSampler sampler; // background ADC sampling, see AdcSampler.h
+#endif
 
-    // Calibration constants (can be moved to ConfigManager later)
-    // Calibration Values (Dynamic)
-    std::vector<int> airValues; 
-    std::vector<int> waterValues;
+    // Struct-of-arrays per channel: the per-update pass touches only raw/percent/calibration
+    int16_t pins[SOIL_SENSOR_COUNT];
+    int16_t raw[SOIL_SENSOR_COUNT];
+    int8_t percent[SOIL_SENSOR_COUNT];          // calibrated %
+    uint16_t percent256[SOIL_SENSOR_COUNT];     // calibrated % x256
+    int8_t snapshotPercent[SOIL_SENSOR_COUNT];  // for rise validation
+    int16_t airValues[SOIL_SENSOR_COUNT];
+    int16_t waterValues[SOIL_SENSOR_COUNT];
+    CalPoint calPoints[SOIL_SENSOR_COUNT][CAL_MAX_POINTS];
+    CalibrationLut<SOIL_SENSOR_COUNT> calibration; // see CalibrationLut.h
 
-    int readSensor(int index, int pin, int& rawArg);
+    uint16_t readRaw(int index);
+    void compileCalibration(int index);
 
 public:
     SensorManager();
     void begin();
+    // Non-blocking: picks up the sampler's latest filtered values
     void update();
+
+    void configureSampling(int oversampling, AdcFilter filter, int trim);
     
     float getAverageMoisture();
-    std::vector<SensorDetail> getReadings();
+    SensorReadings getReadings();
+    // Copy-free access for hot paths
+    int getSensorCount() const { return SOIL_SENSOR_COUNT; }
+    SensorDetail getReading(int index) const { return {pins[index], raw[index], percent[index]}; }
+    int getPercent(int index) const { return percent[index]; }
+    const int8_t* getPercents() const { return percent; }
+    // Calibrated % without rounding, for trend estimation
+    float getPercentExact(int index) const { return percent256[index] / 256.0f; }
+    int getRaw(int index) const { return raw[index]; }
+    int getPin(int index) const { return pins[index]; }
+    // Non-blocking: last valid DHT22 sample and its age
     DHTReading getDHT();
 
     // Verification Logic
     void snapshotMoisture();
-    // Returns map where key is index, value is boolean (true = rose/OK, false = no rise)
-    std::vector<bool> validateRise(int riseThreshold);
-    bool checkTankEmpty(const std::vector<bool>& validationResults);
+    // Snapshot kept across deep sleep (SOIL_SENSOR_COUNT values)
+    const int8_t* getSnapshot() const { return snapshotPercent; }
+    void restoreSnapshot(const int8_t* values) { memcpy(snapshotPercent, values, sizeof(snapshotPercent)); }
+    // Per channel: true = rose/OK, false = no rise
+    RiseResults validateRise(int riseThreshold);
+    bool checkTankEmpty(Span<const bool> validationResults);
 
     // Dynamic Calibration
     void setCalibration(int index, int air, int water);
     int getAirValue(int index);
     int getWaterValue(int index);
+    // Interior curve point `slot` (< CAL_MAX_POINTS); raw 0 removes it
+    void setCalibrationPoint(int index, int slot, int raw, int percent);
+    CalPoint getCalibrationPoint(int index, int slot) const { return calPoints[index][slot]; }
+    // Temperature coefficient, raw counts per 10 C
+    void setTempco(int index, int countsPer10C);
+    int getTempco(int index) const { return calibration.getTempco(index); }
 };
 
 #endif
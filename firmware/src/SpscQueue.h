@@ -0,0 +1,92 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// Exactly one task may push and exactly one (other) task may pop. N must be a
+// power of two; usable capacity is N. Items are copied in and out, so T
+// should be a plain fixed-size struct.
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0}; // next slot to pop (consumer-owned)
+    std::atomic<uint32_t> tail{0}; // next slot to push (producer-owned)
+    std::atomic<uint32_t> highWater{0};
+    std::atomic<uint32_t> dropped{0};
+
+public:
+    // Producer side. Returns false (and counts a drop) when full.
+    bool push(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        if (t - h >= N) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+
+        uint32_t depth = t + 1 - h;
+        if (depth > highWater.load(std::memory_order_relaxed)) highWater.store(depth, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Producer side: reserve the next slot to fill in place, then commit().
+    // Avoids building large items on the stack first. Returns nullptr when full.
+    T* prepare() {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &items[t & (N - 1)];
+    }
+
+    void commit() {
+        uint32_t t = tail.load(std::memory_order_relaxed) + 1;
+        tail.store(t, std::memory_order_release);
+        uint32_t depth = t - head.load(std::memory_order_relaxed);
+        if (depth > highWater.load(std::memory_order_relaxed)) highWater.store(depth, std::memory_order_relaxed);
+    }
+
+    // Consumer side: pointer to the oldest item (valid until release()), or nullptr when empty.
+    T* front() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &items[h & (N - 1)];
+    }
+
+    // Consumer side: the i-th oldest item (0 = front), or nullptr past the newest
+    T* peek(size_t i) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (i >= tail.load(std::memory_order_acquire) - h) return nullptr;
+        return &items[(h + i) & (N - 1)];
+    }
+
+    void release() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& out) {
+        T* item = front();
+        if (!item) return false;
+        out = *item;
+        release();
+        return true;
+    }
+
+    // Safe from any task (approximate while the queue is in use)
+    size_t depth() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    size_t capacity() const { return N; }
+    uint32_t getHighWater() const { return highWater.load(std::memory_order_relaxed); }
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "StatusEncoder.h"
+
+size_t StatusEncoder::encodeBinary(uint8_t* buffer, size_t capacity, int state,
+                                   SensorManager& sensors, ConfigManager& config,
+                                   const MoistureForecast& forecast, int rssi) {
+    StatusSnapshot s;
+    const int n = sensors.getSensorCount();
+
+    s.state = state;
+    s.moistureAvg = sensors.getAverageMoisture();
+    s.channels = n;
+    for (int i = 0; i < n; i++) {
+        s.percent[i] = sensors.getPercent(i);
+        s.raw[i] = sensors.getRaw(i);
+        s.pin[i] = sensors.getPin(i);
+        s.air[i] = sensors.getAirValue(i);
+        s.water[i] = sensors.getWaterValue(i);
+        s.rate[i] = forecast.getRate(i);
+    }
+
+    DHTReading dht = sensors.getDHT();
+    s.dhtValid = dht.valid;
+    s.temperature = dht.temperature;
+    s.humidity = dht.humidity;
+    s.dhtAgeMs = dht.ageMs;
+
+    s.threshold = config.loadThreshold();
+    s.windows[0] = config.loadMorningStart();
+    s.windows[1] = config.loadMorningEnd();
+    s.windows[2] = config.loadAfternoonStart();
+    s.windows[3] = config.loadAfternoonEnd();
+    s.triggerMode = config.loadTriggerMode();
+    s.rssi = rssi;
+    s.forecastHours = forecast.hoursToTrigger(sensors, s.threshold, s.triggerMode);
+
+    return encode(buffer, capacity, s);
+}
+
+size_t StatusEncoder::encode(uint8_t* buffer, size_t capacity, const StatusSnapshot& s) {
+    MsgPackWriter w(buffer, capacity);
+    const int n = s.channels;
+
+    w.writeRaw(STATUS_FORMAT_BINARY_V1);
+    w.writeArray(FIELD_COUNT);
+
+    w.writeUInt(s.state);
+    w.writeInt((int32_t)lroundf(s.moistureAvg * 10));
+
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) w.writeInt(s.percent[i]);
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) w.writeInt(s.raw[i]);
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) w.writeInt(s.pin[i]);
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) w.writeInt(s.air[i]);
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) w.writeInt(s.water[i]);
+
+    if (s.dhtValid) {
+        w.writeInt((int32_t)lroundf(s.temperature * 10));
+        w.writeInt((int32_t)lroundf(s.humidity * 10));
+        w.writeUInt(s.dhtAgeMs / 1000);
+    } else {
+        w.writeNil();
+        w.writeNil();
+        w.writeNil();
+    }
+
+    w.writeInt(s.threshold);
+    w.writeArray(4);
+    for (int i = 0; i < 4; i++) w.writeInt(s.windows[i]);
+    w.writeUInt(s.triggerMode);
+    w.writeInt(s.rssi);
+
+    if (s.forecastHours == FORECAST_NEVER) w.writeNil();
+    else w.writeInt((int32_t)lroundf(s.forecastHours * 10));
+    w.writeArray(n);
+    for (int i = 0; i < n; i++) {
+        // int16 bound for MAX_SIZE
+        int32_t rate = lroundf(s.rate[i] * 100);
+        w.writeInt(rate < -32768 ? -32768 : (rate > 32767 ? 32767 : rate));
+    }
+
+    return w.ok() ? w.size() : 0;
+}
@@ -0,0 +1,84 @@
+#ifndef STATUS_ENCODER_H
+#define STATUS_ENCODER_H
+
+#include <Arduino.h>
+#include "MsgPack.h"
+#include "SensorManager.h"
+#include "ConfigManager.h"
+#include "MoistureForecast.h"
+
+// Status payload formats, selected with SET_STATUS_FORMAT:<n>
+enum StatusFormat {
+    STATUS_FORMAT_JSON = 0,
+    STATUS_FORMAT_BINARY_V1 = 1
+};
+
+// Binary status v1: one version byte (0x01, never '{') followed by a
+// MessagePack array with a fixed positional schema:
+//
+//   0  state               uint
+//   1  moisture avg x10    int
+//   2  percent[N]          array of int
+//   3  adc raw[N]          array of int
+//   4  pin[N]              array of int
+//   5  air cal[N]          array of int
+//   6  water cal[N]        array of int
+//   7  temperature x10     int, nil until the first DHT sample
+//   8  humidity x10        int, nil until the first DHT sample
+//   9  dht age (s)         uint, nil until the first DHT sample
+//  10  threshold           int
+//  11  windows[4]          [m_start, m_end, a_start, a_end]
+//  12  trigger mode        uint
+//  13  rssi                int
+//  14  forecast hours x10  int, nil when no watering is due within the horizon
+//  15  drying rate[N]      array of int, % per hour x100
+//
+// backend/src/mqtt/status.codec.js decodes it into the JSON status shape.
+
+// One report's values in schema order, unscaled. encodeBinary() fills it
+// from the managers; host tools (sim/) fill it from their own models.
+struct StatusSnapshot {
+    int state;
+    float moistureAvg;
+    int channels;
+    int percent[SOIL_SENSOR_COUNT];
+    int raw[SOIL_SENSOR_COUNT];
+    int pin[SOIL_SENSOR_COUNT];
+    int air[SOIL_SENSOR_COUNT];
+    int water[SOIL_SENSOR_COUNT];
+    bool dhtValid;
+    float temperature;
+    float humidity;
+    uint32_t dhtAgeMs;
+    int threshold;
+    int windows[4];
+    int triggerMode;
+    int rssi;
+    float forecastHours;          // FORECAST_NEVER: none due within the horizon
+    float rate[SOIL_SENSOR_COUNT]; // % per hour
+};
+
+class StatusEncoder {
+public:
+    static const int FIELD_COUNT = 16;
+    static const int SCALAR_FIELDS = 9;
+    static const int CHANNEL_ARRAYS = 6;
+
+    // Per channel: percent (int8) plus raw, pin, air, water and rate (int16)
+    static const size_t MAX_CHANNEL_SIZE = MsgPackWriter::MAX_INT8_SIZE + 5 * MsgPackWriter::MAX_INT16_SIZE;
+
+    // Upper bound for the encoded size, assuming every integer takes its widest form
+    static constexpr size_t MAX_SIZE =
+        1 + MsgPackWriter::MAX_ARRAY_HEADER_SIZE
+        + SCALAR_FIELDS * MsgPackWriter::MAX_INT_SIZE
+        + CHANNEL_ARRAYS * MsgPackWriter::MAX_ARRAY_HEADER_SIZE + SOIL_SENSOR_COUNT * MAX_CHANNEL_SIZE
+        + MsgPackWriter::MAX_ARRAY_HEADER_SIZE + 4 * MsgPackWriter::MAX_INT_SIZE;
+
+    // Returns the encoded length, or 0 if the buffer was too small
+    static size_t encodeBinary(uint8_t* buffer, size_t capacity, int state,
+                               SensorManager& sensors, ConfigManager& config,
+                               const MoistureForecast& forecast, int rssi);
+    static size_t encode(uint8_t* buffer, size_t capacity, const StatusSnapshot& status);
+};
+
+#endif
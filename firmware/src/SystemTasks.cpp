@@ -0,0 +1,85 @@
+#include "SystemTasks.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+static TaskHandle_t networkTask = nullptr;
+static TaskHandle_t controlTask = nullptr;
+
+static void (*networkStepFn)() = nullptr;
+static uint32_t (*controlStepFn)() = nullptr;
+
+static void runNetworkTask(void* arg) {
+    (void)arg;
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        networkStepFn();
+        // Fixed cadence; also yields so the idle task can feed the watchdog
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(NETWORK_TASK_PERIOD_MS));
+    }
+}
+
+static void runControlTask(void* arg) {
+    (void)arg;
+    for (;;) {
+        uint32_t waitMs = controlStepFn();
+        TickType_t ticks = pdMS_TO_TICKS(waitMs);
+        // Block until the next deadline or a command notification
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+    }
+}
+
+static void enableLightSleep() {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_esp32_t pm = {};
+    pm.max_freq_mhz = PM_MAX_FREQ_MHZ;
+    pm.min_freq_mhz = PM_MIN_FREQ_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    pm.light_sleep_enable = true;
+#endif
+    if (esp_pm_configure(&pm) != ESP_OK) Serial.println("Power management not enabled");
+#endif
+}
+
+void startSystemTasks(void (*networkStep)(), uint32_t (*controlStep)()) {
+    networkStepFn = networkStep;
+    controlStepFn = controlStep;
+    enableLightSleep();
+
+    xTaskCreatePinnedToCore(runNetworkTask, "network", NETWORK_TASK_STACK, nullptr, 1, &networkTask, NETWORK_TASK_CORE);
+    // Higher priority than the network task: actuation wins on contention
+    xTaskCreatePinnedToCore(runControlTask, "control", CONTROL_TASK_STACK, nullptr, 2, &controlTask, CONTROL_TASK_CORE);
+}
+
+void wakeControlTask() {
+    if (controlTask) xTaskNotifyGive(controlTask);
+}
+
+TaskStats getTaskStats() {
+    TaskStats stats = {false, 0, 0};
+    if (!networkTask || !controlTask) return stats;
+    stats.running = true;
+    // ESP-IDF reports the high-water mark in bytes
+    stats.networkStackFree = uxTaskGetStackHighWaterMark(networkTask);
+    stats.controlStackFree = uxTaskGetStackHighWaterMark(controlTask);
+    return stats;
+}
+
+#else
+
+// Host builds run both steps from loop() in sequence
+void startSystemTasks(void (*networkStep)(), uint32_t (*controlStep)()) {
+    (void)networkStep;
+    (void)controlStep;
+}
+
+void wakeControlTask() {}
+
+TaskStats getTaskStats() {
+    return {false, 0, 0};
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SYSTEM_TASKS_H
+#define SYSTEM_TASKS_H
+
+#include <Arduino.h>
+
+// Pinned FreeRTOS tasks: network (WiFi/MQTT/NTP) on core 0, control
+// (sensors, pump, state machine) on core 1. They only share data through
+// NetworkManager's SPSC queues and cached values, so a blocking broker
+// connect on core 0 never delays pump timing on core 1.
+//
+// The network task polls (the MQTT client and WiFiManager need it). The
+// control task is event-driven: its step returns the time to its next timer
+// deadline and it blocks that long, or until wakeControlTask() signals a
+// queued command, so an idle device leaves core 1 free to sleep.
+
+#define NETWORK_TASK_CORE 0
+#define CONTROL_TASK_CORE 1
+#define NETWORK_TASK_STACK 8192
+#define CONTROL_TASK_STACK 8192
+#define NETWORK_TASK_PERIOD_MS 5
+
+// Light sleep between deadlines needs CONFIG_PM_ENABLE and tickless idle in
+// the IDF sdkconfig; without them the idle task just waits for the next tick
+#ifndef PM_MAX_FREQ_MHZ
+#define PM_MAX_FREQ_MHZ 240
+#endif
+#ifndef PM_MIN_FREQ_MHZ
+#define PM_MIN_FREQ_MHZ 80
+#endif
+
+struct TaskStats {
+    bool running;                 // false on single-loop builds (native)
+    uint32_t networkStackFree;    // bytes never used (high-water mark)
+    uint32_t controlStackFree;
+};
+
+// Each step function is called forever from its own task. networkStep runs
+// every NETWORK_TASK_PERIOD_MS; controlStep returns how long to wait (ms).
+void startSystemTasks(void (*networkStep)(), uint32_t (*controlStep)());
+// Wakes the control task before its deadline; safe from the network task
+void wakeControlTask();
+TaskStats getTaskStats();
+
+#endif
@@ -0,0 +1,31 @@
+#include "TelemetryPolicy.h"
+
+bool TelemetryPolicy::shouldPublish(int state, SensorManager& sensors, int deadband, unsigned long heartbeatMs) {
+    if (!published || state != lastState) return true;
+    if (millis() - lastPublish >= heartbeatMs) return true;
+
+    for (int i = 0; i < sensors.getSensorCount() && i < SOIL_SENSOR_COUNT; i++) {
+        if (abs(sensors.getPercent(i) - lastPercent[i]) >= deadband) return true;
+    }
+
+    DHTReading dht = sensors.getDHT();
+    if (dht.valid) {
+        if (abs((int)lroundf(dht.temperature * 10) - lastTemp10) >= TEMP_DEADBAND_X10) return true;
+        if (abs((int)lroundf(dht.humidity * 10) - lastHumidity10) >= HUMIDITY_DEADBAND_X10) return true;
+    }
+    return false;
+}
+
+void TelemetryPolicy::markPublished(int state, SensorManager& sensors) {
+    for (int i = 0; i < sensors.getSensorCount() && i < SOIL_SENSOR_COUNT; i++) {
+        lastPercent[i] = sensors.getPercent(i);
+    }
+    DHTReading dht = sensors.getDHT();
+    if (dht.valid) {
+        lastTemp10 = lroundf(dht.temperature * 10);
+        lastHumidity10 = lroundf(dht.humidity * 10);
+    }
+    lastState = state;
+    lastPublish = millis();
+    published = true;
+}
@@ -0,0 +1,37 @@
+#ifndef TELEMETRY_POLICY_H
+#define TELEMETRY_POLICY_H
+
+#include <Arduino.h>
+#include "SensorManager.h"
+
+// Telemetry modes, selected with SET_TELEMETRY:<mode>:<deadband>:<heartbeat_s>
+enum TelemetryMode {
+    TELEMETRY_PERIODIC = 0,  // full status every check interval (legacy)
+    TELEMETRY_EXCEPTION = 1  // report-by-exception: deadbands + heartbeat
+};
+
+// Decides whether a status is worth publishing in report-by-exception mode.
+// A status goes out when the state changed, a moisture channel moved at
+// least `deadband` points, temperature/humidity moved past their fixed
+// deadbands, or nothing was sent for `heartbeat` ms.
+class TelemetryPolicy {
+private:
+    static const int TEMP_DEADBAND_X10 = 5;      // 0.5 C
+    static const int HUMIDITY_DEADBAND_X10 = 30; // 3 %RH
+
+    int lastPercent[SOIL_SENSOR_COUNT];
+    int lastTemp10 = 0;
+    int lastHumidity10 = 0;
+    int lastState = -1;
+    unsigned long lastPublish = 0;
+    bool published = false;
+
+public:
+    bool shouldPublish(int state, SensorManager& sensors, int deadband, unsigned long heartbeatMs);
+    // Records what was just published as the new reference point
+    void markPublished(int state, SensorManager& sensors);
+    // After a deep sleep millis() restarted: move the heartbeat reference back by shiftMs
+    void rebase(unsigned long shiftMs) { lastPublish -= shiftMs; }
+};
+
+#endif
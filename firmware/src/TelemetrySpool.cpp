@@ -0,0 +1,160 @@
+#include "TelemetrySpool.h"
+#include "Crc32.h"
+#include "MsgPack.h"
+
+static const char* DATA_PATH = "/spool.bin";
+static const char* INDEX_PATH = "/spool.idx";
+static const uint16_t SLOT_MAGIC = 0x5053;
+static const uint32_t INDEX_MAGIC = 0x58445053; // "SPDX"
+
+bool TelemetrySpool::begin() {
+    if (!LittleFS.begin(true)) { // format on first use
+        Serial.println("Spool: LittleFS mount failed");
+        return false;
+    }
+
+    if (!LittleFS.exists(DATA_PATH)) {
+        // Preallocate the whole ring once so appends never grow the file
+        File f = LittleFS.open(DATA_PATH, "w");
+        if (!f) return false;
+        uint8_t zeros[SPOOL_SLOT_SIZE];
+        memset(zeros, 0, sizeof(zeros));
+        for (int i = 0; i < SPOOL_SLOTS; i++) f.write(zeros, sizeof(zeros));
+        f.close();
+        LittleFS.remove(INDEX_PATH);
+    }
+
+    data = LittleFS.open(DATA_PATH, "r+");
+    if (!data) return false;
+
+    uint32_t index[2] = {0, 0};
+    File idx = LittleFS.open(INDEX_PATH, "r");
+    if (idx) {
+        if (idx.read((uint8_t*)index, sizeof(index)) != sizeof(index) || index[0] != INDEX_MAGIC) index[1] = 0;
+        idx.close();
+    }
+    nextSend = index[1];
+
+    // The newest valid slot tells where appending continues
+    bool any = false;
+    uint32_t maxSeq = 0;
+    for (int slot = 0; slot < SPOOL_SLOTS; slot++) {
+        SlotHeader h;
+        data.seek((uint32_t)slot * SPOOL_SLOT_SIZE);
+        if (data.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || h.magic != SLOT_MAGIC) continue;
+        if (h.seq % SPOOL_SLOTS != (uint32_t)slot) continue;
+        if (!any || (int32_t)(h.seq - maxSeq) > 0) maxSeq = h.seq;
+        any = true;
+    }
+    nextSeq = any ? maxSeq + 1 : nextSend;
+
+    if ((int32_t)(nextSeq - nextSend) < 0) nextSend = nextSeq;
+    if (nextSeq - nextSend > SPOOL_SLOTS) nextSend = nextSeq - SPOOL_SLOTS;
+
+    ready = true;
+    return true;
+}
+
+bool TelemetrySpool::append(const char* topic, const uint8_t* payload, size_t length, uint32_t timestamp) {
+    if (!ready || length > SPOOL_PAYLOAD_SIZE || strlen(topic) >= SPOOL_TOPIC_SIZE) return false;
+
+    // Ring is full: the oldest undelivered record is lost
+    if (nextSeq - nextSend >= SPOOL_SLOTS) {
+        nextSend++;
+        overwritten++;
+    }
+
+    uint8_t slot[SPOOL_SLOT_SIZE];
+    SlotHeader h;
+    h.magic = SLOT_MAGIC;
+    h.length = length;
+    h.seq = nextSeq;
+    h.timestamp = timestamp;
+
+    char* topicField = (char*)slot + sizeof(h);
+    memset(topicField, 0, SPOOL_TOPIC_SIZE);
+    memcpy(topicField, topic, strlen(topic));
+    memcpy(slot + sizeof(h) + SPOOL_TOPIC_SIZE, payload, length);
+    h.crc = crc32(topicField, SPOOL_TOPIC_SIZE + length);
+    memcpy(slot, &h, sizeof(h));
+
+    // Header, topic and payload go down in one write; the slot tail is left as is
+    data.seek((nextSeq % SPOOL_SLOTS) * SPOOL_SLOT_SIZE);
+    size_t n = sizeof(h) + SPOOL_TOPIC_SIZE + length;
+    if (data.write(slot, n) != n) return false;
+    data.flush();
+    nextSeq++;
+    return true;
+}
+
+bool TelemetrySpool::readSlot(uint32_t seq, SlotHeader& header, uint8_t* body) {
+    data.seek((seq % SPOOL_SLOTS) * SPOOL_SLOT_SIZE);
+    if (data.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) return false;
+    if (header.magic != SLOT_MAGIC || header.seq != seq || header.length > SPOOL_PAYLOAD_SIZE) return false;
+
+    size_t n = SPOOL_TOPIC_SIZE + header.length;
+    if (data.read(body, n) != n || crc32(body, n) != header.crc) return false;
+    body[SPOOL_TOPIC_SIZE - 1] = '\0';
+    return true;
+}
+
+size_t TelemetrySpool::buildBatch(uint8_t* out, size_t capacity, uint32_t& ackSeq) {
+    ackSeq = nextSend;
+    if (!ready || pending() == 0 || capacity < 8) return 0;
+
+    // version byte + array16 header (count patched in at the end)
+    const size_t prefix = 4;
+    MsgPackWriter w(out + prefix, capacity - prefix);
+    uint16_t count = 0;
+
+    uint8_t body[SPOOL_TOPIC_SIZE + SPOOL_PAYLOAD_SIZE];
+    char* topic = (char*)body;
+    uint8_t* payload = body + SPOOL_TOPIC_SIZE;
+
+    uint32_t seq = nextSend;
+    while (seq != nextSeq && count < SPOOL_BATCH_RECORDS) {
+        SlotHeader h;
+        if (!readSlot(seq, h, body)) {
+            seq++; // corrupt or never written: skip it
+            continue;
+        }
+
+        // Only the last topic level travels; the batch topic names the device
+        const char* suffix = strrchr(topic, '/');
+        suffix = suffix ? suffix + 1 : topic;
+        size_t suffixLen = strlen(suffix);
+
+        size_t need = MsgPackWriter::MAX_ARRAY_HEADER_SIZE + MsgPackWriter::MAX_INT_SIZE + 3 + suffixLen + 5 + h.length;
+        if (w.size() + need > capacity - prefix) break; // next batch
+
+        w.writeArray(3);
+        w.writeUInt(h.timestamp);
+        w.writeStr(suffix, suffixLen);
+        w.writeBin(payload, h.length);
+        count++;
+        seq++;
+    }
+
+    ackSeq = seq;
+    if (count == 0 || !w.ok()) return 0;
+
+    out[0] = SPOOL_FRAME_V1;
+    out[1] = 0xdc; // array16
+    out[2] = count >> 8;
+    out[3] = count & 0xff;
+    return prefix + w.size();
+}
+
+void TelemetrySpool::ack(uint32_t seq) {
+    if ((int32_t)(seq - nextSend) <= 0) return;
+    nextSend = (int32_t)(seq - nextSeq) > 0 ? nextSeq : seq;
+    saveIndex();
+}
+
+void TelemetrySpool::saveIndex() {
+    uint32_t index[2] = {INDEX_MAGIC, nextSend};
+    File idx = LittleFS.open(INDEX_PATH, "w");
+    if (!idx) return;
+    idx.write((const uint8_t*)index, sizeof(index));
+    idx.close();
+}
@@ -0,0 +1,71 @@
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+// Store-and-forward spool for telemetry published while MQTT is down.
+//
+// One preallocated file of SPOOL_SLOTS fixed-size slots used as a ring:
+// record `seq` lives in slot seq % SPOOL_SLOTS, so the newest SPOOL_SLOTS
+// records are retained and older ones are overwritten. A small index file
+// holds the next sequence number to send; it is rewritten once per drained
+// batch, not per record.
+//
+// On-flash slot (little endian, SPOOL_SLOT_SIZE bytes):
+//   uint16 magic      0x5053 ("SP")
+//   uint16 length     payload bytes
+//   uint32 seq
+//   uint32 timestamp  unix seconds UTC, 0 if the clock was not set yet
+//   uint32 crc        CRC-32 over topic + payload
+//   char   topic[SPOOL_TOPIC_SIZE]  NUL-terminated
+//   uint8  payload[length]
+
+#define SPOOL_SLOTS 256
+#define SPOOL_TOPIC_SIZE 48
+#define SPOOL_PAYLOAD_SIZE 512
+#define SPOOL_SLOT_SIZE (16 + SPOOL_TOPIC_SIZE + SPOOL_PAYLOAD_SIZE)
+
+// Replay pacing after a reconnect
+#define SPOOL_DRAIN_INTERVAL_MS 1000
+#define SPOOL_BATCH_RECORDS 8
+
+// Batch frame published on plantcare/<id>/spool: one version byte, then a
+// MessagePack array of [timestamp, topic suffix, payload (bin)] records.
+#define SPOOL_FRAME_V1 0x01
+
+class TelemetrySpool {
+private:
+    struct SlotHeader {
+        uint16_t magic;
+        uint16_t length;
+        uint32_t seq;
+        uint32_t timestamp;
+        uint32_t crc;
+    };
+
+    File data;
+    bool ready = false;
+    uint32_t nextSeq = 0;   // sequence number of the next append
+    uint32_t nextSend = 0;  // oldest record not yet delivered
+    uint32_t overwritten = 0;
+
+    // Reads topic + payload into body (SPOOL_TOPIC_SIZE + SPOOL_PAYLOAD_SIZE bytes)
+    bool readSlot(uint32_t seq, SlotHeader& header, uint8_t* body);
+    void saveIndex();
+
+public:
+    bool begin();
+    bool append(const char* topic, const uint8_t* payload, size_t length, uint32_t timestamp);
+
+    uint32_t pending() const { return nextSeq - nextSend; }
+    uint32_t getOverwritten() const { return overwritten; }
+
+    // Encodes up to SPOOL_BATCH_RECORDS pending records into `out`.
+    // Returns the frame length (0 if nothing pending) and the sequence to ack.
+    size_t buildBatch(uint8_t* out, size_t capacity, uint32_t& ackSeq);
+    // Marks everything before `seq` as delivered
+    void ack(uint32_t seq);
+};
+
+#endif
@@ -3,49 +3,138 @@
 #include "NetworkManager.h"
 #include "SensorManager.h"
 #include "PlantControl.h"
+#include "SystemTasks.h"
+#include "Scheduler.h"
+#include "PowerManager.h"
+#include "BootProfiler.h"
+#include "PerfCounters.h"
+
+// Sensor refresh for status reports; the watering checks read on their own
+#ifndef SENSOR_UPDATE_INTERVAL_MS
+#define SENSOR_UPDATE_INTERVAL_MS 1000
+#endif
 
 // Global instances
 ConfigManager configManager;
 NetworkManager networkManager;
 SensorManager sensorManager;
 PlantControl plantControl(&sensorManager, &networkManager, &configManager);
+Scheduler scheduler; // control task timers
+PowerManager powerManager(&configManager, &networkManager, &plantControl);
+
+static int sensorJob = -1;
+static int configCommitJob = -1;
+static int bootReportJob = -1;
+#if PERF_COUNTERS
+static int perfMetricsJob = -1;
+#endif
+
+static void onSensorTimer(void*) {
+    sensorManager.update();
+}
 
-// MQTT Callback to pass to PlantControl
+static void onConfigCommitTimer(void*) {
+    configManager.loop();
+    // A later change restarted the debounce: look again shortly
+    if (configManager.isDirty()) scheduler.once(configCommitJob, CONFIG_COMMIT_DELAY_MS / 4);
+}
+
+// MQTT Callback to pass to PlantControl.
+// Runs on the control task (NetworkManager::dispatchCommands), payload is NUL-terminated
+// in the inbox slot and parsed in place.
 void mqttCallback(char* topic, uint8_t* payload, unsigned int length) {
-    // Convert payload to string
-    char p[length + 1];
-    memcpy(p, payload, length);
-    p[length] = '\0';
-    
-    Serial.printf("Message arrived [%s] %s\n", topic, p);
-    plantControl.processCommand(topic, p);
+    // The inbox slot NUL-terminates the payload, so the length is not needed
+    (void)length;
+    plantControl.processCommand(topic, (const char*)payload);
+}
+
+static void onBootReportTimer(void*) {
+    // Boot phase timings, once per boot
+    if (!bootProfiler.isReportDue()) return;
+    char buffer[256];
+    if (bootProfiler.buildReport(buffer, sizeof(buffer))) networkManager.publishDevice("metrics", buffer);
+    scheduler.cancel(bootReportJob);
+}
+
+#if PERF_COUNTERS
+static void onPerfMetricsTimer(void*) {
+    char buffer[OUTBOX_PAYLOAD_SIZE];
+    if (perfCounters.buildReport(buffer, sizeof(buffer))) networkManager.publishDevice("metrics", buffer);
+}
+#endif
+
+// Core 0: WiFi portal, NTP, MQTT session and outbound queue
+static void networkStep() {
+    PERF_SCOPE(PERF_NETWORK_LOOP);
+    networkManager.loop();
+}
+
+// Core 1: commands, then whatever timers are due (sensors, config commit,
+// watering state machine). Returns ms until the next deadline; the control
+// task sleeps that long unless a command arrives first. In battery mode the
+// device deep-sleeps instead when nothing is due soon.
+static uint32_t controlStep() {
+    uint32_t waitMs;
+    {
+        PERF_SCOPE(PERF_CONTROL_STEP);
+        networkManager.dispatchCommands();
+        plantControl.handlePumpEvents();
+        // Debounced NVS commit of settings changed by those commands
+        if (configManager.isDirty() && !scheduler.isArmed(configCommitJob)) {
+            scheduler.once(configCommitJob, CONFIG_COMMIT_DELAY_MS);
+        }
+        waitMs = scheduler.runDue();
+    }
+    return powerManager.step(waitMs);
 }
 
 void setup() {
     Serial.begin(115200);
+    bootProfiler.begin();
+
+    // 0. Timer wake-up from deep sleep: state, settings and clock come from RTC memory
+    bool resumed = powerManager.begin();
     
     // 1. Init Config (Preferences)
-    configManager.begin();
+    configManager.begin(powerManager.getRetainedConfig());
+    bootProfiler.mark(BOOT_CONFIG);
     
     // 2. Init Sensors
     sensorManager.begin();
+    bootProfiler.mark(BOOT_SENSORS);
     
     // 3. Init Network (WiFi + MQTT)
     // This might block if portal is active, but we set non-blocking
-    networkManager.begin(&configManager);
+    // After deep sleep WiFi stays off until there is something to send
+    networkManager.begin(&configManager, !resumed);
     networkManager.setCallback(mqttCallback);
+    networkManager.setInboxListener(wakeControlTask);
     
-    // 4. Init Plant Control
-    plantControl.begin();
+    // 4. Init Plant Control and the control task's timers
+    sensorJob = scheduler.add("sensors", onSensorTimer, nullptr);
+    configCommitJob = scheduler.add("config_commit", onConfigCommitTimer, nullptr);
+    bootReportJob = scheduler.add("boot_report", onBootReportTimer, nullptr);
+    scheduler.every(sensorJob, SENSOR_UPDATE_INTERVAL_MS);
+    scheduler.every(bootReportJob, 250);
+#if PERF_COUNTERS
+    perfMetricsJob = scheduler.add("perf_metrics", onPerfMetricsTimer, nullptr);
+    scheduler.every(perfMetricsJob, PERF_METRICS_INTERVAL_MS);
+#endif
+    plantControl.begin(&scheduler);
+    powerManager.resume();
+
+    // 5. Split network and control onto their own cores
+    startSystemTasks(networkStep, controlStep);
     
     Serial.println("System Initialized");
 }
 
 void loop() {
-    // Update all components
-    networkManager.loop();
-
-    // If OTA is running, skip other tasks to ensure timing
-    sensorManager.update();
-    plantControl.update();
+#ifdef ARDUINO_ARCH_ESP32
+    // All work runs in the pinned tasks started by setup()
+    vTaskDelete(NULL);
+#else
+    networkStep();
+    controlStep();
+#endif
 }